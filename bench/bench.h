@@ -0,0 +1,49 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Shared helpers for the benchmark programs in bench/. Each bench_*.c file is
+// its own executable, built with optimizations by `make bench`.
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Growable NUL-terminated text buffer for synthesizing corpora
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} BenchText;
+
+static inline void bench_text_append(BenchText* text, const char* str) {
+    size_t n = strlen(str);
+    if(text->len + n + 1 > text->capacity) {
+        text->capacity = (text->len + n + 1) * 2;
+        text->data = realloc(text->data, text->capacity);
+    }
+    memcpy(text->data + text->len, str, n + 1);
+    text->len += n;
+}
+
+// Repeat unit until the text is at least size bytes
+static inline BenchText bench_repeat(const char* unit, size_t size) {
+    BenchText text = {NULL, 0, 0};
+    while(text.len < size) {
+        bench_text_append(&text, unit);
+    }
+    return text;
+}
+
+static inline void bench_report(const char* label, size_t bytes, double seconds) {
+    printf("  %-28s %8.1f MB/s  (%.3f s)\n", label, (double)bytes / seconds / 1e6, seconds);
+}
+
+#endif  // BENCH_H
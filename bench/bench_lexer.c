@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/lexer.h"
+#include "../include/scan.h"
+#include "../include/token_buffer.h"
+#include "bench.h"
+
+#define CORPUS_SIZE (16u * 1024 * 1024)
+#define ROUNDS 5
+
+static const char* comment_unit =
+    "/* Generated block comment describing the declaration below in far more\n"
+    " * detail than anybody needs, spanning several lines of prose text.\n"
+    " */\n"
+    "abeg value = 1; // trailing note explaining the value for the reader\n";
+
+static const char* whitespace_unit =
+    "abeg                                                              x\n"
+    "        =                                                         1;\n"
+    "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\n"
+    "                                                                  \n";
+
+static const char* identifier_unit =
+    "abeg a_rather_long_generated_identifier_name_0001 = "
+    "another_fairly_long_generated_identifier_name_0002;\n";
+
+// Best-of-ROUNDS time to tokenize the corpus into a struct-of-arrays buffer
+static double time_tokenize(const BenchText* corpus, unsigned flags) {
+    double best = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+        lexer->flags = flags;
+        TokenBuffer buffer;
+        token_buffer_init(&buffer);
+
+        double start = bench_now();
+        lexer_tokenize_soa(lexer, &buffer);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        token_buffer_free(&buffer);
+        lexer_free(lexer);
+    }
+    return best;
+}
+
+static void run_corpus(const char* name, const char* unit, unsigned flags) {
+    BenchText corpus = bench_repeat(unit, CORPUS_SIZE);
+    printf("%s corpus (%zu bytes)\n", name, corpus.len);
+
+    ScanLevel levels[] = {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+    for(size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if(!scan_select(levels[i]))
+            continue;
+        bench_report(scan_kernels()->name, corpus.len, time_tokenize(&corpus, flags));
+    }
+
+    free(corpus.data);
+}
+
+int main(void) {
+    run_corpus("comment-heavy", comment_unit, 0);
+    run_corpus("comment-heavy, comments skipped", comment_unit, LEXER_SKIP_COMMENTS);
+    run_corpus("whitespace-heavy", whitespace_unit, 0);
+    run_corpus("identifier-heavy", identifier_unit, 0);
+    return 0;
+}
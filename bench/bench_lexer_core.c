@@ -0,0 +1,59 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/lexer.h"
+#include "../include/token_buffer.h"
+#include "bench.h"
+
+#define CORPUS_SIZE (16u * 1024 * 1024)
+#define ROUNDS 5
+
+// Typical source: short tokens, operators and keywords dominate
+static const char* program_unit =
+    "abeg greeting: string = \"hello\";\n"
+    "oya add(a: int, b: int): int {\n"
+    "    comot a + b * 2 - 3 / 4;\n"
+    "}\n"
+    "abi (x == 1.5 and !done) {\n"
+    "    waka(\"yes\");  // call\n"
+    "} naso {\n"
+    "    list[0] = y != z < w > v;\n"
+    "}\n";
+
+static const char* operator_unit = "a=b==c!=d+e-f*g/h<i>j;(k)[l]{m},n:o!p 12 3.5\n";
+
+// Best-of-ROUNDS time to tokenize the corpus with the given lexer flags
+static double time_tokenize(const BenchText* corpus, unsigned flags) {
+    double best = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+        lexer->flags = flags;
+        TokenBuffer buffer;
+        token_buffer_init(&buffer);
+
+        double start = bench_now();
+        lexer_tokenize_soa(lexer, &buffer);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        token_buffer_free(&buffer);
+        lexer_free(lexer);
+    }
+    return best;
+}
+
+static void run_corpus(const char* name, const char* unit) {
+    BenchText corpus = bench_repeat(unit, CORPUS_SIZE);
+    printf("%s corpus (%zu bytes)\n", name, corpus.len);
+
+    bench_report("switch core", corpus.len, time_tokenize(&corpus, LEXER_SWITCH_CORE));
+    bench_report("table-driven DFA core", corpus.len, time_tokenize(&corpus, 0));
+
+    free(corpus.data);
+}
+
+int main(void) {
+    run_corpus("program", program_unit);
+    run_corpus("operator-heavy", operator_unit);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+
+#include "../include/lexer.h"
+#include "../include/token_buffer.h"
+#include "bench.h"
+
+#define CORPUS_SIZE (64u * 1024 * 1024)
+#define ROUNDS 3
+
+static const char* program_unit =
+    "abeg greeting: string = \"hello\";\n"
+    "/* helper that adds\n   two numbers */\n"
+    "oya add(a: int, b: int): int {\n"
+    "    comot a + b * 2 - 3 / 4;  // arithmetic\n"
+    "}\n"
+    "abi (x == 1.5 and !done) { waka(\"yes\"); } naso { list[0] = y != z; }\n";
+
+// Best-of-ROUNDS time to tokenize the corpus with thread_count threads
+static double time_tokenize(const BenchText* corpus, unsigned thread_count) {
+    double best = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+        TokenBuffer buffer;
+        token_buffer_init(&buffer);
+
+        double start = bench_now();
+        lexer_tokenize_parallel(lexer, &buffer, thread_count);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        token_buffer_free(&buffer);
+        lexer_free(lexer);
+    }
+    return best;
+}
+
+int main(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned max_threads = cpus > 4 ? (unsigned)cpus : 4;
+
+    BenchText corpus = bench_repeat(program_unit, CORPUS_SIZE);
+    printf("parallel lexing, %zu bytes, %ld online CPUs\n", corpus.len, cpus);
+
+    for(unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        char label[32];
+        snprintf(label, sizeof(label), "%u thread%s", threads, threads == 1 ? "" : "s");
+        bench_report(label, corpus.len, time_tokenize(&corpus, threads));
+    }
+
+    free(corpus.data);
+    return 0;
+}
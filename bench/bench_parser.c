@@ -0,0 +1,322 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/lexer.h"
+#include "../include/parser/ast_cache.h"
+#include "../include/parser/ast_pass.h"
+#include "../include/parser/parser.h"
+#include "../include/parser/resolver.h"
+#include "../include/token_buffer.h"
+#include "bench.h"
+
+#define CORPUS_SIZE (8u * 1024 * 1024)
+#define ROUNDS 5
+
+static const char* program_unit =
+    "oya area(width: int, height: int): int {\n"
+    "    abeg scale: float = 1.5;\n"
+    "    abi (width > 0 and height > 0) { comot width * height + (width - 1) / 2; }\n"
+    "    naso { comot -1; }\n"
+    "}\n"
+    "abeg sizes = [1, 2, 3, area(4, 5), area(6 + 7, 8 * 9)];\n"
+    "abeg label = \"total: \\\"sizes\\\"\";\n"
+    "waka (count < 10) { count = count + 1; log(label, count, sizes[count]); }\n";
+
+typedef struct {
+    double parse;
+    double teardown;
+} ParseTimes;
+
+// Best-of-ROUNDS times to parse pre-lexed tokens and to free the tree
+static ParseTimes time_soa(const BenchText* corpus) {
+    ParseTimes best = {1e30, 1e30};
+    Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    lexer_tokenize_soa(lexer, &buffer);
+
+    for(int round = 0; round < ROUNDS; round++) {
+        Parser* parser = parser_init_soa(&buffer, lexer->source, "bench.soro");
+
+        double start = bench_now();
+        ASTNode* ast = parse(parser);
+        double parsed = bench_now();
+        ast_free_node(ast);
+        double freed = bench_now();
+
+        if(parsed - start < best.parse)
+            best.parse = parsed - start;
+        if(freed - parsed < best.teardown)
+            best.teardown = freed - parsed;
+        parser_free(parser);
+    }
+
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+    return best;
+}
+
+// Best-of-ROUNDS time to parse pre-lexed tokens into the index-based AST
+static double time_flat(const BenchText* corpus) {
+    double best = 1e30;
+    Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    lexer_tokenize_soa(lexer, &buffer);
+
+    for(int round = 0; round < ROUNDS; round++) {
+        Parser* parser = parser_init_soa(&buffer, lexer->source, "bench.soro");
+
+        double start = bench_now();
+        FlatAst* ast = parse_flat(parser);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        flat_ast_free(ast);
+        parser_free(parser);
+    }
+
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+    return best;
+}
+
+// Best-of-ROUNDS time to parse pre-lexed tokens on thread_count threads
+static double time_parallel(const BenchText* corpus, unsigned thread_count) {
+    double best = 1e30;
+    Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    lexer_tokenize_soa(lexer, &buffer);
+
+    for(int round = 0; round < ROUNDS; round++) {
+        Parser* parser = parser_init_soa(&buffer, lexer->source, "bench.soro");
+
+        double start = bench_now();
+        ASTNode* ast = parse_parallel(parser, thread_count);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        ast_free_node(ast);
+        parser_free(parser);
+    }
+
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+    return best;
+}
+
+// Best-of-ROUNDS time to lex and parse in one pull-driven pass
+static double time_streaming(const BenchText* corpus) {
+    double best = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        Lexer* lexer = lexer_init(corpus->data, "bench.soro", ".");
+        Parser* parser = parser_init_streaming(lexer, "bench.soro");
+
+        double start = bench_now();
+        ASTNode* ast = parse(parser);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        ast_free_node(ast);
+        parser_free(parser);
+        lexer_free(lexer);
+    }
+    return best;
+}
+
+// Best-of-ROUNDS times to lex and parse through the AST cache: on a miss
+// (lex, parse and store the entry) and on a hit (map and load it)
+static void time_cache(const BenchText* corpus, double* miss, double* hit) {
+    char directory[] = "/tmp/soro_bench_cache_XXXXXX";
+    if(!mkdtemp(directory)) {
+        *miss = *hit = 0;
+        return;
+    }
+
+    SourceFile* source = source_file_create(corpus->data, corpus->len, "bench.soro", ".");
+    uint64_t key = ast_cache_key(source->text, source->length);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 ".ast", directory, key);
+
+    *miss = *hit = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        bool found;
+        remove(path);
+        double start = bench_now();
+        FlatAst* ast = ast_cache_parse(directory, source, &found);
+        double elapsed = bench_now() - start;
+        if(elapsed < *miss)
+            *miss = elapsed;
+        flat_ast_free(ast);
+
+        start = bench_now();
+        ast = ast_cache_parse(directory, source, &found);
+        elapsed = bench_now() - start;
+        if(found && elapsed < *hit)
+            *hit = elapsed;
+        flat_ast_free(ast);
+    }
+
+    remove(path);
+    rmdir(directory);
+    source_file_release(source);
+}
+
+// Best-of-ROUNDS time to bring the tokens and the tree up to date after one
+// line is added to (or taken out of) a function in the middle of the corpus
+static double time_incremental(const BenchText* corpus) {
+    static const char* line = "    abeg extra = scale * 2;\n";
+    size_t line_len = strlen(line);
+    const char* middle = strstr(corpus->data + corpus->len / 2, "oya area");
+    size_t offset = (size_t)(strchr(middle, '\n') + 1 - corpus->data);
+
+    char* edited = malloc(corpus->len + line_len);
+    memcpy(edited, corpus->data, offset);
+    memcpy(edited + offset, line, line_len);
+    memcpy(edited + offset + line_len, corpus->data + offset, corpus->len - offset);
+    SourceFile* texts[2] = {
+        source_file_create(corpus->data, corpus->len, "bench.soro", "."),
+        source_file_create(edited, corpus->len + line_len, "bench.soro", "."),
+    };
+    free(edited);
+
+    Lexer* lexer = lexer_init_source(texts[0]);
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    lexer_tokenize_soa(lexer, &buffer);
+    lexer_free(lexer);
+    Parser* parser = parser_init_soa(&buffer, texts[0], "bench.soro");
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+
+    // Add the line, then take it out again, and so on
+    double best = 1e30;
+    for(int round = 0; round < 2 * ROUNDS; round++) {
+        bool add = round % 2 == 0;
+        LexerEdit edit = {offset, add ? 0 : line_len, add ? line_len : 0};
+        SourceFile* source = texts[add ? 1 : 0];
+
+        double start = bench_now();
+        LexerRelexSpan span;
+        lexer_relex_span(source, &buffer, &edit, 0, &span);
+        parser = parser_init_soa(&buffer, source, "bench.soro");
+        ast = parse_incremental(parser, ast, &edit, &span);
+        double elapsed = bench_now() - start;
+
+        if(elapsed < best)
+            best = elapsed;
+        parser_free(parser);
+    }
+
+    ast_free_node(ast);
+    token_buffer_free(&buffer);
+    source_file_release(texts[0]);
+    source_file_release(texts[1]);
+    return best;
+}
+
+#define PASS_COUNT 4
+
+static bool count_expr(void* state, Expr* expr, int depth) {
+    (void)depth;
+    ((uint64_t*)state)[expr->type]++;
+    return true;
+}
+
+static bool count_stmt(void* state, Stmt* stmt, int depth) {
+    (void)depth;
+    ((uint64_t*)state)[AST_EXPR_KINDS + stmt->type]++;
+    return true;
+}
+
+// Best-of-ROUNDS time to run PASS_COUNT node-counting passes over the tree,
+// fused into one walk or given a walk each
+static double time_passes(const ASTNode* ast, bool fused) {
+    static uint64_t counts[PASS_COUNT][AST_EXPR_KINDS + AST_STMT_KINDS];
+    AstPass passes[PASS_COUNT];
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    for(size_t i = 0; i < PASS_COUNT; i++) {
+        passes[i] = (AstPass){"count", fused ? 0 : AST_PASS_NEW_WALK, counts[i], NULL, NULL,
+                              {0}, {0}, {0}, {0}};
+        for(size_t k = 0; k < AST_EXPR_KINDS; k++) {
+            passes[i].pre_expr[k] = count_expr;
+        }
+        for(size_t k = 0; k < AST_STMT_KINDS; k++) {
+            passes[i].pre_stmt[k] = count_stmt;
+        }
+        ast_pass_manager_add(&manager, &passes[i]);
+    }
+
+    double best = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        double start = bench_now();
+        ast_pass_manager_run(&manager, (ASTNode*)ast);
+        double elapsed = bench_now() - start;
+        if(elapsed < best)
+            best = elapsed;
+    }
+    ast_pass_manager_free(&manager);
+    return best;
+}
+
+// Best-of-ROUNDS time to resolve every name in the tree
+static double time_resolve(ASTNode* ast) {
+    Resolver resolver;
+    resolver_init(&resolver);
+    resolver_define_global(&resolver, symbol_intern_cstr("log"));
+    resolver_define_global(&resolver, symbol_intern_cstr("count"));
+
+    double best = 1e30;
+    for(int round = 0; round < ROUNDS; round++) {
+        double start = bench_now();
+        resolver_resolve(&resolver, ast);
+        double elapsed = bench_now() - start;
+        if(elapsed < best)
+            best = elapsed;
+    }
+    resolver_free(&resolver);
+    return best;
+}
+
+int main(void) {
+    BenchText corpus = bench_repeat(program_unit, CORPUS_SIZE);
+    printf("program corpus (%zu bytes)\n", corpus.len);
+
+    ParseTimes soa = time_soa(&corpus);
+    bench_report("parse (struct-of-arrays)", corpus.len, soa.parse);
+    printf("  %-28s %8.3f ms\n", "free tree", soa.teardown * 1e3);
+    bench_report("parse (flat)", corpus.len, time_flat(&corpus));
+    for(unsigned threads = 2; threads <= 8; threads *= 2) {
+        char label[32];
+        snprintf(label, sizeof(label), "parse (%u threads)", threads);
+        bench_report(label, corpus.len, time_parallel(&corpus, threads));
+    }
+    bench_report("lex + parse (streaming)", corpus.len, time_streaming(&corpus));
+    printf("  %-28s %8.3f ms\n", "relex + reparse one line", time_incremental(&corpus) * 1e3);
+
+    double miss, hit;
+    time_cache(&corpus, &miss, &hit);
+    bench_report("cache miss (lex+parse+store)", corpus.len, miss);
+    bench_report("cache hit (load entry)", corpus.len, hit);
+
+    Lexer* lexer = lexer_init(corpus.data, "bench.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "bench.soro");
+    ASTNode* ast = parse(parser);
+    bench_report("4 passes (fused walk)", corpus.len, time_passes(ast, true));
+    bench_report("4 passes (walk each)", corpus.len, time_passes(ast, false));
+    bench_report("resolve names", corpus.len, time_resolve(ast));
+    ast_free_node(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+
+    free(corpus.data);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator that hands out memory from large chunks. Individual
+// allocations are never freed; arena_free releases every chunk at once.
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk* head;
+    size_t chunk_size;
+} Arena;
+
+// Initialize an empty arena (no memory is reserved until the first alloc)
+void arena_init(Arena* arena, size_t chunk_size);
+
+// Allocate size bytes aligned for any scalar type
+void* arena_alloc(Arena* arena, size_t size);
+
+// Copy len bytes of str into the arena and NUL-terminate the copy
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+
+// Make all memory available again, keeping one regular-size chunk for reuse.
+// Every pointer handed out before is invalidated.
+void arena_reset(Arena* arena);
+
+// Release every chunk owned by the arena
+void arena_free(Arena* arena);
+
+// Move every chunk of other into arena, leaving other empty. Pointers into
+// other stay valid and are released with arena from then on.
+void arena_adopt(Arena* arena, Arena* other);
+
+#endif  // ARENA_H
@@ -3,16 +3,22 @@
 
 #include <stdint.h>
 
+#include "line_index.h"
+
 typedef enum {
     LEXER_ERROR_NONE = 0,
     LEXER_ERROR_UNTERMINATED_STRING,
     LEXER_ERROR_INVALID_ESCAPE,
     LEXER_ERROR_UNTERMINATED_COMMENT,
     LEXER_ERROR_INVALID_CHAR,
+    LEXER_ERROR_TOKEN_TOO_LONG,
+    LEXER_ERROR_NUMBER_OVERFLOW,
 } LexerErrorType;
 
-// Print error message with context
-void lexer_error_print(LexerErrorType error, uint32_t line, uint32_t column,
-                       const char *input, const char *file_name);
+// Print error message with context. The location is resolved from offset
+// through lines. input is input_len bytes from offset 0 and need not be
+// NUL-terminated; pass NULL when the text is not resident.
+void lexer_error_print(LexerErrorType error, const LineIndex *lines, uint64_t offset,
+                       const char *input, uint64_t input_len, const char *file_name);
 
 #endif // ERROR_H
@@ -0,0 +1,12 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit hash of data[0..length) using the XXH64 algorithm: four independent
+// lanes over 32-byte stripes, so long inputs hash at close to memory speed.
+// Fine for cache keys and tables; not for keys chosen by an adversary.
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed);
+
+#endif  // HASH_H
@@ -1,41 +1,170 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "arena.h"
+#include "line_index.h"
+#include "scan.h"
+#include "source.h"
 #include "token.h"
+#include "token_buffer.h"
 
+// Pull up to size bytes into buffer; return the number read, 0 at end of input
+typedef size_t (*LexerReadFn)(void* context, char* buffer, size_t size);
+
+// Refillable input window for lexers fed from a read callback. Bytes before the
+// start of the token being scanned are discarded on refill, so the window stays
+// bounded by the chunk size plus the longest token.
+typedef struct {
+    LexerReadFn read;
+    void* context;
+    char* window;
+    size_t capacity;
+    size_t chunk_size;
+    uint64_t keep_from;  // Earliest offset that must survive the next refill
+    bool eof;
+} LexerStream;
+
+// Behaviour switches, set in Lexer.flags before tokenizing
+typedef enum {
+    // Use the original switch-dispatch core instead of the table-driven DFA
+    // (both produce identical tokens; kept for comparison and benchmarks)
+    LEXER_SWITCH_CORE = 1 << 0,
+    // Detect errors without printing diagnostics
+    LEXER_QUIET = 1 << 1,
+    // Consume comments without emitting TOKEN_COMMENT
+    LEXER_SKIP_COMMENTS = 1 << 2,
+    // Record the range of every comment in Lexer.comments (for formatters and
+    // doc tools); usually combined with LEXER_SKIP_COMMENTS
+    LEXER_COLLECT_COMMENTS = 1 << 3,
+} LexerFlags;
+
+// Source range of one comment, delimiters included
 typedef struct {
-    const char* input;
-    size_t input_len;
-    uint32_t position;
-    uint32_t line;
-    uint32_t column;
-    char* file_name;
-    char* file_directory;
+    uint64_t offset;
+    uint32_t length;
+} CommentRange;
+
+// Comments in source order, filled in under LEXER_COLLECT_COMMENTS
+typedef struct {
+    CommentRange* ranges;
+    size_t count;
+    size_t capacity;
+} CommentTable;
+
+typedef struct {
+    SourceFile* source;
+    const char* input;   // Bytes [base, input_len) of the input, not NUL-terminated
+    uint64_t base;       // Offset of input[0]; 0 unless streaming
+    uint64_t input_len;  // End of the bytes currently available
+    uint64_t position;
+
+    // Line starts seen so far; tokens get their line and column from here
+    // instead of the scanner counting them byte by byte
+    LineIndex lines;
+    size_t line_cursor;  // Line of the last token located, for forward walks
 
     // Dynamic array for tokens
     Token** tokens;
     size_t token_count;
     size_t token_capacity;
 
-    // Track string allocations for cleanup
-    char** string_allocations;
-    size_t string_count;
-    size_t string_capacity;
+    // Backing storage for tokens and their text; released in one go by lexer_free
+    Arena arena;
+
+    // Non-NULL for lexers created by lexer_init_stream
+    LexerStream* stream;
+
+    // Bulk scanning kernels (SIMD where available) chosen when the lexer is created
+    const ScanKernels* scan;
+
+    unsigned flags;  // LexerFlags
+    CommentTable comments;
 } Lexer;
 
-// Initialize lexer
+// Initialize lexer over a copy of a NUL-terminated string
 Lexer* lexer_init(const char* input, const char* file_name, const char* file_directory);
 
-// Free lexer and all associated memory
+// Initialize lexer over an already loaded source file (takes a new reference)
+Lexer* lexer_init_source(SourceFile* source);
+
+// Initialize lexer over a memory-mapped file; returns NULL if it cannot be opened
+Lexer* lexer_init_from_path(const char* path);
+
+// Initialize lexer that pulls chunk_size bytes at a time from read. The whole
+// input is never resident: token values are still available, but the source
+// file has no text, so token_text must not be used on the resulting tokens.
+Lexer* lexer_init_stream(LexerReadFn read, void* context, size_t chunk_size,
+                         const char* file_name, const char* file_directory);
+
+// LexerReadFn for a stdio stream (context is a FILE*), e.g. stdin or a pipe
+size_t lexer_read_file(void* context, char* buffer, size_t size);
+
+// Free lexer and all associated memory, including every token it produced
 void lexer_free(Lexer* lexer);
 
-// Tokenize entire input
+// Tokenize entire input. The list ends with TOKEN_EOF unless a lexer error
+// stopped it early, in which case it holds the tokens before the error; a
+// parser given such a list fails without reading past it.
 Token** lexer_tokenize(Lexer* lexer, size_t* token_count);
 
+// Tokenize entire input into a struct-of-arrays buffer without allocating
+// per-token storage. Returns false on a lexer error.
+bool lexer_tokenize_soa(Lexer* lexer, TokenBuffer* buffer);
+
+// Like lexer_tokenize_soa, but split resident input into up to thread_count
+// chunks that are lexed concurrently (serially under LEXER_COLLECT_COMMENTS).
+// Chunks start at line boundaries and are lexed speculatively; a serial pass
+// then stitches them together, re-lexing wherever a guess was wrong (e.g. a
+// split inside a comment or string) until the streams agree again. The
+// result is identical to lexer_tokenize_soa.
+bool lexer_tokenize_parallel(Lexer* lexer, TokenBuffer* buffer, unsigned thread_count);
+
 // Get next token
 Token* lexer_next_token(Lexer* lexer);
 
+// Scan the next token into *token, building its value in arena. Unlike
+// lexer_next_token nothing is kept by the lexer (beyond its line index), so a
+// caller that recycles token and arena lexes in bounded memory. Returns false
+// on a lexer error.
+bool lexer_scan_token(Lexer* lexer, Token* token, Arena* arena);
+
+// A change to a source: removed bytes at offset were replaced by inserted bytes
+typedef struct {
+    uint64_t offset;
+    uint64_t removed;
+    uint64_t inserted;
+} LexerEdit;
+
+// Bring tokens, lexed with flags from the text before edit, up to date with
+// source, which holds the text after it. Lexing restarts at the last token that
+// the edit cannot affect and stops as soon as a token lines up with the old
+// stream again; the tokens after that are only shifted. If relexed is not NULL
+// it receives the number of tokens actually scanned. Returns false on a lexer
+// error, leaving tokens unchanged.
+bool lexer_relex(SourceFile* source, TokenBuffer* tokens, const LexerEdit* edit, unsigned flags,
+                 size_t* relexed);
+
+// Where lexer_relex changed a buffer: tokens [first, first + count) of the
+// updated buffer were scanned afresh and replace old ones, and every token from
+// first + count on is an old token moved by the edit, line_delta lines down.
+// scanned is the number of tokens lexed, counting the one the streams
+// resynchronized on.
+typedef struct {
+    size_t first;
+    size_t count;
+    size_t scanned;
+    int64_t line_delta;
+} LexerRelexSpan;
+
+// lexer_relex, reporting the changed span (e.g. for parse_incremental)
+bool lexer_relex_span(SourceFile* source, TokenBuffer* tokens, const LexerEdit* edit,
+                      unsigned flags, LexerRelexSpan* span);
+
+// Resolve a byte offset the lexer has already reached to a 1-based line and column
+void lexer_location(Lexer* lexer, uint64_t offset, uint32_t* line, uint32_t* column);
+
 #endif  // LEXER_H
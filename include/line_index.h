@@ -0,0 +1,46 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte offsets at which each line of a source starts. The lexer only tracks
+// offsets; line and column are resolved from this table when they are needed.
+// starts[0] is always 0, so line n (1-based) begins at starts[n - 1].
+typedef struct {
+    uint64_t* starts;
+    size_t count;
+    size_t capacity;
+    uint64_t scanned;  // Offsets below this have been searched for newlines
+} LineIndex;
+
+// Initialize an index holding just the first line
+bool line_index_init(LineIndex* index);
+
+// Release the table
+void line_index_free(LineIndex* index);
+
+// Record the newlines in text, which holds the bytes at offsets [scanned, end).
+// Returns false if the table could not grow.
+bool line_index_scan(LineIndex* index, const char* text, uint64_t end);
+
+// Record that line (1-based) starts at start, for tables built from token
+// positions instead of by scanning text. Lines not noted before it get the
+// same start, which keeps lookups exact for offsets on noted lines. Returns
+// false if the table could not grow.
+bool line_index_note(LineIndex* index, uint32_t line, uint64_t start);
+
+// Replace entries [from, to) (the starts of lines from + 1 to to) with
+// starts[0, count) and move the entries after them by delta bytes, keeping a
+// table in step with an edit of its source. Returns false if the table could
+// not grow, leaving it unchanged.
+bool line_index_splice(LineIndex* index, size_t from, size_t to, const uint64_t* starts,
+                       size_t count, int64_t delta);
+
+// Resolve offset to a 1-based line and byte column by binary search. Offsets
+// past the scanned range resolve against the last known line.
+void line_index_lookup(const LineIndex* index, uint64_t offset, uint32_t* line,
+                       uint32_t* column);
+
+#endif  // LINE_INDEX_H
@@ -0,0 +1,23 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoding of numeric literals straight from their source text. Literals may
+// use '_' between digits; integers may also be written 0x... or 0b....
+
+typedef enum {
+    NUMBER_OK,
+    NUMBER_OVERFLOW,  // Does not fit the target type
+    NUMBER_INVALID,   // Not a well-formed literal
+} NumberStatus;
+
+// Decode an integer literal of len bytes into an int64
+NumberStatus number_parse_int(const char* text, size_t len, int64_t* value);
+
+// Decode a decimal float literal ("digits.digits") of len bytes, correctly
+// rounded and independent of the C locale
+NumberStatus number_parse_float(const char* text, size_t len, double* value);
+
+#endif  // NUMBER_H
@@ -4,12 +4,21 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "../arena.h"
+#include "../line_index.h"
 #include "../token.h"
 
 // Forward declarations
 typedef struct Expr Expr;
 typedef struct Stmt Stmt;
 
+// Bump allocator holding every node, child array and parameter list of a
+// parse result. Nodes are never freed one by one; the whole tree goes at once
+// when the arena is dropped (see ast_free_node).
+typedef Arena AstArena;
+
+#define AST_ARENA_CHUNK_SIZE (64 * 1024)
+
 // ===== Expression Types =====
 
 typedef enum {
@@ -29,15 +38,28 @@ typedef enum { LITERAL_INT, LITERAL_FLOAT, LITERAL_STRING, LITERAL_BOOL } Litera
 typedef struct {
     LiteralType type;
     union {
-        int int_val;
+        int64_t int_val;
         double float_val;
-        char* string_val;
+        Symbol string_val;  // Interned decoded text
         bool bool_val;
     } value;
 } Literal;
 
+// Names are interned symbols (see symbol.h); resolve them with symbol_name
+
+// Where a variable reference or assignment finds its variable, filled in by
+// the resolver (see resolver.h). The parser leaves it BINDING_UNRESOLVED.
+typedef enum { BINDING_UNRESOLVED, BINDING_LOCAL, BINDING_GLOBAL } BindingKind;
+
+typedef struct {
+    BindingKind kind;
+    uint32_t depth;  // Local: scopes to walk out from the innermost one
+    uint32_t slot;   // Local: index in that scope; global: index in the globals
+} Binding;
+
 typedef struct {
-    char* name;
+    Symbol name;
+    Binding binding;
 } Variable;
 
 typedef struct {
@@ -68,13 +90,14 @@ typedef struct {
 } Array;
 
 typedef struct {
-    char* name;
+    Symbol name;
+    Binding binding;
     Expr* value;
 } Assign;
 
 struct Expr {
     ExprType type;
-    Token* token;  // For error reporting
+    SourceLoc loc;  // Start of the node's first token, for error reporting
     union {
         Literal literal;
         Variable variable;
@@ -104,17 +127,17 @@ typedef struct {
 } ExprStmt;
 
 typedef struct {
-    char* name;
-    char* type_annotation;  // optional
-    Expr* initializer;      // optional
+    Symbol name;
+    Symbol type_annotation;  // optional (SYMBOL_NONE)
+    Expr* initializer;       // optional
 } VarDecl;
 
 typedef struct {
-    char* name;
-    char** param_names;
-    char** param_types;
+    Symbol name;
+    Symbol* param_names;
+    Symbol* param_types;
     size_t param_count;
-    char* return_type;
+    Symbol return_type;  // optional (SYMBOL_NONE)
     Stmt* body;
 } FunctionDecl;
 
@@ -140,6 +163,7 @@ typedef struct {
 
 struct Stmt {
     StmtType type;
+    SourceLoc loc;
     union {
         ExprStmt expr_stmt;
         VarDecl var_decl;
@@ -155,13 +179,23 @@ struct Stmt {
 
 typedef enum { NODE_PROGRAM } ASTNodeType;
 
+// parse_incremental leaves the move of the statements after an edit pending,
+// like the gap of a gap buffer: statements from shift_from on, and every node
+// below them, lie shift bytes past their loc until ast_settle_locs.
 typedef struct {
     Stmt** statements;
     size_t count;
+    size_t shift_from;
+    int64_t shift;
 } Program;
 
+// Node locations are bare offsets; the tree carries the line starts needed to
+// turn them into lines and columns, so it depends on neither the tokens nor
+// the lexer once parsing is done.
 typedef struct {
     ASTNodeType type;
+    AstArena arena;   // Owns every node below this one
+    LineIndex lines;  // Built by the parser from the tokens it located nodes at
     union {
         Program program;
     } as;
@@ -169,11 +203,34 @@ typedef struct {
 
 // ===== AST Utilities =====
 
-void ast_free_expr(Expr* expr);
-void ast_free_stmt(Stmt* stmt);
+// Release the tree by dropping its arena; O(chunks), not O(nodes)
 void ast_free_node(ASTNode* node);
 
-// Printing for debugging
+// 1-based line and byte column of the location of one of the tree's nodes
+void ast_resolve_loc(const ASTNode* node, SourceLoc loc, uint32_t* line, uint32_t* column);
+
+// Move the location of stmt and of every node below it by delta bytes
+void ast_shift_locs(Stmt* stmt, int64_t delta);
+
+// Apply a pending shift (see Program), so every loc is an offset into the
+// current text. ast_walk_node, ast_print_node and the pass manager do this
+// first; code reading the locations of a tree from parse_incremental any
+// other way calls it itself.
+void ast_settle_locs(ASTNode* node);
+
+// Callbacks for the walks below; either may be NULL. Returning false skips the
+// node's children.
+typedef struct {
+    bool (*enter_expr)(void* context, Expr* expr, int depth);
+    bool (*enter_stmt)(void* context, Stmt* stmt, int depth);
+} AstVisitor;
+
+// Depth-first walk in source order, parents before children, starting at depth
+// 0. Iterative, like printing, so tree depth is not limited by the C stack.
+void ast_walk_stmt(Stmt* stmt, const AstVisitor* visitor, void* context);
+void ast_walk_node(ASTNode* node, const AstVisitor* visitor, void* context);
+
+// Printing for debugging. Iterative, so any depth the parser accepts prints.
 void ast_print_expr(Expr* expr, int indent);
 void ast_print_stmt(Stmt* stmt, int indent);
 void ast_print_node(ASTNode* node);
@@ -0,0 +1,45 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../source.h"
+#include "flat_ast.h"
+
+// On-disk cache of parse results, so unchanged sources are not lexed and parsed
+// again on every start. An entry is the FlatAst of a source, which is already
+// position independent: its node, list and line arrays are written out as they
+// are, behind a fixed header, and loaded by mapping the file and copying them
+// back. Symbols are the only process-local ids in a FlatAst; an entry carries
+// the names it uses and its nodes refer to them by local index, which loading
+// maps back to symbols of the running process.
+//
+// Entries live in a directory, one file per key. The key hashes the source
+// text together with SORO_VERSION and the entry format, so an edited source or
+// a different compiler simply misses; stale entries are never read, only left
+// behind.
+
+// Bumped whenever the entry layout changes
+#define AST_CACHE_FORMAT 1
+
+// Key of the cache entry for text[0..length)
+uint64_t ast_cache_key(const char* text, uint64_t length);
+
+// Write ast as the entry for key, creating directory and its parents if
+// needed. The entry is written to a temporary file and renamed into place, so
+// concurrent readers see either nothing or a complete entry. Returns false on
+// an I/O error.
+bool ast_cache_store(const char* directory, uint64_t key, const FlatAst* ast);
+
+// Load the entry for key; NULL if there is none or it fails validation
+// (truncated, from another format, or with out-of-range indices)
+FlatAst* ast_cache_load(const char* directory, uint64_t key);
+
+// FlatAst for source: loaded from directory when an entry exists, otherwise
+// lexed, parsed and stored there. *hit tells which happened. Returns NULL on
+// a lex or parse error, which is reported as parse_flat reports it and is not
+// cached.
+FlatAst* ast_cache_parse(const char* directory, SourceFile* source, bool* hit);
+
+#endif  // AST_CACHE_H
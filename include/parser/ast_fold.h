@@ -0,0 +1,36 @@
+#ifndef AST_FOLD_H
+#define AST_FOLD_H
+
+#include <stddef.h>
+
+#include "ast.h"
+#include "ast_pass.h"
+
+// Constant folding over the pointer tree, as an AstPass. Bottom-up, so folded
+// operands fold their parents in the same walk:
+//
+//   - Unary and binary operators on literals of the same type are replaced by
+//     their result: int and float arithmetic and comparisons, bool logic and
+//     equality, string + and equality. Integer results that overflow, division
+//     by zero and operands of mixed types are left to run time.
+//   - false and x, true or x become their left operand.
+//   - x + 0, 0 + x, x - 0, x * 1, 1 * x and x / 1 become x when x is known
+//     to be an int (int arithmetic that could not be folded). There is no
+//     type checker, so a variable or call is left alone: it may be a string.
+//   - abi with a literal bool condition becomes the live branch; waka (false)
+//     and dead abi without naso are removed from their block.
+
+typedef struct {
+    size_t folded;      // Operators replaced by literals
+    size_t simplified;  // Operators replaced by an operand
+    size_t pruned;      // Statements replaced or removed
+} AstFoldStats;
+
+// Fill pass with the folding callbacks, counting into stats. The pass
+// rewrites the tree in place; nodes are never allocated or freed.
+void ast_fold_pass(AstPass* pass, AstFoldStats* stats);
+
+// Fold the whole tree in a walk of its own
+void ast_fold(ASTNode* node, AstFoldStats* stats);
+
+#endif  // AST_FOLD_H
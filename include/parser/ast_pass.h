@@ -0,0 +1,95 @@
+#ifndef AST_PASS_H
+#define AST_PASS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+
+// Analyses and rewrites over the pointer tree, written as passes with pre- and
+// post-order callbacks per node kind. A pass manager runs the passes added to
+// it in order, fusing consecutive compatible passes into one iterative walk:
+// each node is visited once and every pass's callbacks for it run back to
+// back, so N passes cost one traversal of the tree instead of N.
+
+#define AST_EXPR_KINDS (EXPR_ASSIGN + 1)
+#define AST_STMT_KINDS (STMT_BLOCK + 1)
+
+// Most passes one manager can hold
+#define AST_PASS_MAX 32
+
+// Pre-order callbacks run before the node's children and return false to keep
+// this pass out of the node's children (other passes still walk them; the
+// pass's own post-order callback for the node still runs). Post-order
+// callbacks run after the children and receive the slot that holds the node,
+// so a rewriting pass can replace it (with a node from the tree's arena).
+typedef bool (*AstPreExpr)(void* state, Expr* expr, int depth);
+typedef void (*AstPostExpr)(void* state, Expr** slot, int depth);
+typedef bool (*AstPreStmt)(void* state, Stmt* stmt, int depth);
+typedef void (*AstPostStmt)(void* state, Stmt** slot, int depth);
+
+typedef enum {
+    // The pass reads what the passes before it gathered over the whole tree,
+    // so it starts a walk of its own once they are done
+    AST_PASS_NEW_WALK = 1 << 0,
+    // Post-order callbacks may replace or change nodes. Passes after it start
+    // a new walk, as in a shared one they would see a node's children before
+    // the rewriter replaces the node. It shares a walk with the passes before
+    // it only if none has post-order callbacks, which would see its children
+    // already replaced. Either way each pass sees the tree it would see if the
+    // passes ran one after another.
+    AST_PASS_REWRITES = 1 << 1,
+} AstPassFlags;
+
+// A pass: per-kind callback tables (NULL entries are skipped), optional hooks
+// around the walk, and the state every callback receives
+typedef struct {
+    const char* name;
+    unsigned flags;  // AstPassFlags
+    void* state;
+    void (*begin)(void* state, ASTNode* node);  // Before the walk that runs the pass
+    void (*end)(void* state, ASTNode* node);    // After it
+    AstPreExpr pre_expr[AST_EXPR_KINDS];
+    AstPostExpr post_expr[AST_EXPR_KINDS];
+    AstPreStmt pre_stmt[AST_STMT_KINDS];
+    AstPostStmt post_stmt[AST_STMT_KINDS];
+} AstPass;
+
+// Counters of the last ast_pass_manager_run
+typedef struct {
+    uint64_t calls;    // Callbacks invoked
+    uint64_t nanos;    // Time inside them; only measured with timing on
+} AstPassStats;
+
+typedef struct PassItem PassItem;
+
+typedef struct {
+    const AstPass* passes[AST_PASS_MAX];
+    AstPassStats stats[AST_PASS_MAX];
+    size_t count;
+    bool timing;  // Measure time per pass (two clock reads per callback)
+
+    size_t walks;         // Traversals the last run needed
+    uint64_t nodes;       // Node visits over all of them
+    uint64_t walk_nanos;  // Wall time of the whole run
+
+    // Walk stack, kept between runs
+    PassItem* items;
+    size_t item_count;
+    size_t item_capacity;
+} AstPassManager;
+
+void ast_pass_manager_init(AstPassManager* manager);
+void ast_pass_manager_free(AstPassManager* manager);
+
+// Append a pass; the manager keeps the pointer. Returns false when full.
+bool ast_pass_manager_add(AstPassManager* manager, const AstPass* pass);
+
+// Run every pass over node, resetting the counters first
+void ast_pass_manager_run(AstPassManager* manager, ASTNode* node);
+
+// Print the counters of the last run, one line per pass
+void ast_pass_manager_report(const AstPassManager* manager, FILE* out);
+
+#endif  // AST_PASS_H
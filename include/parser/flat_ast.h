@@ -0,0 +1,126 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+// Index-based AST. Expressions and statements live in two contiguous node
+// arrays and refer to their children by 32-bit index instead of by pointer;
+// lists of children (call arguments, array elements, block statements,
+// parameters) are runs in a shared extra array. Source locations are kept in
+// arrays parallel to the nodes so walks that do not need them never touch
+// them.
+//
+// Nodes are appended after their children, so every child index is lower than
+// its parent's: a forward loop over exprs (or stmts) is a bottom-up pass and
+// needs no recursion or stack.
+
+typedef uint32_t FlatExpr;  // Index into FlatAst.exprs
+typedef uint32_t FlatStmt;  // Index into FlatAst.stmts
+typedef uint32_t FlatList;  // Index into FlatAst.extra: a count, then the items
+
+// Absent optional child (else branch, initializer, return value)
+#define FLAT_NONE UINT32_MAX
+
+// Operands per ExprType:
+//   EXPR_LITERAL   op = LiteralType, a/b = value bits (see flat_literal)
+//   EXPR_VARIABLE  a = name Symbol
+//   EXPR_BINARY    op = TokenType, a = left, b = right
+//   EXPR_UNARY     op = TokenType, a = operand
+//   EXPR_CALL      a = callee, b = FlatList of arguments
+//   EXPR_INDEX     a = object, b = index
+//   EXPR_ARRAY     a = FlatList of elements
+//   EXPR_ASSIGN    a = name Symbol, b = value
+typedef struct {
+    uint8_t type;  // ExprType
+    uint8_t op;
+    uint32_t a;
+    uint32_t b;
+} FlatExprNode;
+
+// Operands per StmtType:
+//   STMT_EXPR           a = expression
+//   STMT_VAR_DECL       a = name Symbol, b = type Symbol, c = initializer or FLAT_NONE
+//   STMT_FUNCTION_DECL  a = name Symbol, b = FlatList of parameters, c = body
+//                       (the parameter list holds the return type Symbol, then
+//                       name/type Symbol pairs; its count is 1 + 2 * params)
+//   STMT_IF             a = condition, b = then, c = else or FLAT_NONE
+//   STMT_WHILE          a = condition, b = body
+//   STMT_RETURN         a = value or FLAT_NONE
+//   STMT_BLOCK          a = FlatList of statements
+typedef struct {
+    uint8_t type;  // StmtType
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} FlatStmtNode;
+
+typedef struct {
+    FlatExprNode* exprs;
+    SourceLoc* expr_locs;
+    uint32_t expr_count;
+    uint32_t expr_capacity;
+
+    FlatStmtNode* stmts;
+    SourceLoc* stmt_locs;
+    uint32_t stmt_count;
+    uint32_t stmt_capacity;
+
+    uint32_t* extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    FlatList program;  // Top-level statements
+    LineIndex lines;   // Resolves the locations, as in ASTNode
+} FlatAst;
+
+// ===== Lifecycle =====
+
+FlatAst* flat_ast_create(void);
+void flat_ast_free(FlatAst* ast);
+
+// ===== Building =====
+// Children must be added before the node that refers to them.
+
+// Make room for at least this many nodes and extra words up front
+void flat_ast_reserve(FlatAst* ast, uint32_t exprs, uint32_t stmts, uint32_t extra);
+
+FlatExpr flat_ast_add_expr(FlatAst* ast, ExprType type, uint8_t op, uint32_t a, uint32_t b,
+                           SourceLoc loc);
+FlatStmt flat_ast_add_stmt(FlatAst* ast, StmtType type, uint32_t a, uint32_t b, uint32_t c,
+                           SourceLoc loc);
+FlatList flat_ast_add_list(FlatAst* ast, const uint32_t* items, uint32_t count);
+
+// Operand bits for a literal node and the value they decode to
+void flat_literal_bits(Literal literal, uint32_t* a, uint32_t* b);
+Literal flat_literal(const FlatAst* ast, FlatExpr expr);
+
+// Items of a list; *count receives their number
+static inline const uint32_t* flat_list(const FlatAst* ast, FlatList list, uint32_t* count) {
+    *count = ast->extra[list];
+    return &ast->extra[list + 1];
+}
+
+// ===== Consumers =====
+
+// 1-based line and byte column of a node location
+void flat_ast_resolve_loc(const FlatAst* ast, SourceLoc loc, uint32_t* line, uint32_t* column);
+
+// Pointer tree with the same shape, for code written against ast.h. Built in
+// one forward pass per node array, since children always come first.
+ASTNode* flat_ast_to_tree(const FlatAst* ast);
+
+// Callbacks for flat_ast_visit; either may be NULL. Returning false skips the
+// node's children.
+typedef struct {
+    bool (*enter_expr)(void* context, const FlatAst* ast, FlatExpr expr, int depth);
+    bool (*enter_stmt)(void* context, const FlatAst* ast, FlatStmt stmt, int depth);
+} FlatVisitor;
+
+// Depth-first walk in source order, parents before children, starting at the
+// top-level statements with depth 0
+void flat_ast_visit(const FlatAst* ast, const FlatVisitor* visitor, void* context);
+
+#endif
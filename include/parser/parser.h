@@ -3,7 +3,15 @@
 
 #include <stdbool.h>
 
+#include "../arena.h"
+#include "../lexer.h"
+#include "../token_buffer.h"
 #include "ast.h"
+#include "flat_ast.h"
+
+// Materialized tokens kept around in the struct-of-arrays and streaming
+// modes; covers the previous/current/next window the parser looks at
+#define PARSER_TOKEN_WINDOW 4
 
 // Precedence levels for Pratt parsing
 typedef enum {
@@ -20,33 +28,124 @@ typedef enum {
     PREC_PRIMARY
 } Precedence;
 
+// Operand and continuation stack entries of the expression engine (parser.c)
+typedef union ExprRef ExprRef;
+typedef struct PendingExpr PendingExpr;
+
 typedef struct Parser {
     Token** tokens;
     size_t current;
     size_t token_count;
 
+    // Struct-of-arrays input (parser_init_soa) or a lexer pulled on demand
+    // (parser_init_streaming). tokens is NULL in these modes: Token objects are
+    // only built for positions the parser looks at, in a ring of
+    // PARSER_TOKEN_WINDOW slots whose values live in per-slot arenas that are
+    // recycled with the slot, so a Token* from these modes must be used
+    // before the parser advances again.
+    const TokenBuffer* buffer;
+    Lexer* lexer;
+    SourceFile* source;
+    Arena token_arena;  // Scratch for decoding string literals
+    Token window[PARSER_TOKEN_WINDOW];
+    size_t window_index[PARSER_TOKEN_WINDOW];  // SIZE_MAX for an empty slot
+    Arena window_arena[PARSER_TOKEN_WINDOW];
+    size_t pulled;  // Tokens read from lexer so far
+
+    // Nodes built so far; parse() hands the arena to the tree it returns,
+    // along with the line starts of the tokens the nodes were located at
+    AstArena ast_arena;
+    LineIndex lines;
+    bool note_lines;  // Off while parse_incremental reparses, which updates the tree's table
+
+    // Children of the nodes under construction are staged here until their
+    // count is known, then copied into exactly sized arena arrays. Nested
+    // lists stage above their parent's and are finished first.
+    void** staged;
+    size_t staged_count;
+    size_t staged_capacity;
+    Symbol* staged_symbols;  // Parameter names and types, interleaved
+    size_t staged_symbol_count;
+    size_t staged_symbol_capacity;
+
+    // Expressions are parsed without recursion: finished operands and the
+    // operators still waiting for theirs live on these heap stacks, which
+    // are reused from one expression to the next
+    ExprRef* operands;
+    size_t operand_count;
+    size_t operand_capacity;
+    PendingExpr* pending;
+    size_t pending_count;
+    size_t pending_capacity;
+
     // Error handling
     bool had_error;
     bool panic_mode;
+    bool quiet;  // Detect errors without printing them
 
     // For error messages
     const char* filename;
 } Parser;
 
-// Function pointer types for Pratt parsing
-typedef Expr* (*PrefixParseFn)(Parser* parser);
-typedef Expr* (*InfixParseFn)(Parser* parser, Expr* left);
+// What a token does at the start of an expression...
+typedef enum {
+    PREFIX_NONE,
+    PREFIX_GROUPING,  // ( expr )
+    PREFIX_LITERAL,   // 42, 3.14, "hello", true
+    PREFIX_VARIABLE,  // identifier
+    PREFIX_UNARY,     // -expr, !expr
+    PREFIX_ARRAY      // [1, 2, 3]
+} PrefixRule;
+
+// ...and after a complete operand
+typedef enum {
+    INFIX_NONE,
+    INFIX_BINARY,  // left + right
+    INFIX_CALL,    // func(args)
+    INFIX_INDEX,   // arr[index]
+    INFIX_ASSIGN   // name = value
+} InfixRule;
 
 typedef struct {
-    PrefixParseFn prefix;
-    InfixParseFn infix;
+    PrefixRule prefix;
+    InfixRule infix;
     Precedence precedence;
 } ParseRule;
 
 // ===== Parser Lifecycle =====
 Parser* parser_init(Token** tokens, size_t count, const char* filename);
+Parser* parser_init_soa(const TokenBuffer* buffer, SourceFile* source, const char* filename);
+// Pull tokens from lexer as the parser needs them instead of tokenizing
+// up front, so token memory is bounded by the lookahead rather than the input.
+// Comments are dropped as they are pulled. The lexer must outlive the parser.
+Parser* parser_init_streaming(Lexer* lexer, const char* filename);
 void parser_free(Parser* parser);
 ASTNode* parse(Parser* parser);
+// Same grammar and errors as parse, emitted straight into the index-based
+// representation; NULL on error
+FlatAst* parse_flat(Parser* parser);
+// Same result and errors as parse for a parser over resident tokens (array or
+// struct-of-arrays mode). A pre-pass over the token types finds top-level
+// statement boundaries; runs of whole statements are parsed concurrently on
+// up to thread_count threads and the program is assembled in source order.
+// If any run fails, the input is parsed again serially so diagnostics are
+// exactly those of parse. Streaming parsers and small inputs just use parse.
+ASTNode* parse_parallel(Parser* parser, unsigned thread_count);
+// Bring previous, parsed from the tokens before an edit, up to date with the
+// struct-of-arrays tokens this parser reads, which lexer_relex_span has
+// updated for edit (relexed is the span it reported). Statements whose tokens
+// the relex left alone are kept, subtree and all, and only have their
+// locations moved; the edit is followed down into the block or function body
+// it falls in, and only the statements of that list that it touches are
+// parsed again. Within the top-level statement holding the edit locations
+// are moved at once; the top-level statements after it are left to the
+// program's pending shift (see Program), and the line table is updated around
+// the edit, so the work follows the edit rather than the size of the file.
+// previous is consumed: the result is previous updated in place, or, when the
+// touched statements do not reparse cleanly, a full parse with parse's result
+// and errors. Replaced nodes stay in the tree's arena.
+ASTNode* parse_incremental(Parser* parser, ASTNode* previous, const LexerEdit* edit,
+                           const LexerRelexSpan* relexed);
 
 // ===== Token Utilities =====
 Token* peek(Parser* parser);
@@ -75,10 +174,11 @@ Stmt* parse_block_statement(Parser* parser);       // { stmts }
 Stmt* parse_expression_statement(Parser* parser);
 
 // ===== Pratt Parsing - Expressions =====
+// Iterative: nesting depth is limited by memory, not by the C stack
 Expr* parse_expression(Parser* parser);
 Expr* parse_precedence(Parser* parser, Precedence precedence);
 
 // Helper
-ParseRule* get_rule(TokenType type);
+const ParseRule* get_rule(TokenType type);
 
 #endif
@@ -0,0 +1,94 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "ast_pass.h"
+
+// Lexical scope resolution, as an AstPass. Every EXPR_VARIABLE and
+// EXPR_ASSIGN gets the Binding of the declaration it refers to, so a later
+// stage reads variables by index instead of looking names up:
+//
+//   - Top-level abeg and oya declare globals, numbered in declaration order
+//     after the predefined ones (resolver_define_global). Top-level code sees
+//     a global variable from its declaration on, and every top-level function
+//     from the start; function bodies see every global.
+//   - Blocks open a scope. A function's parameters and the outermost
+//     statements of its body share one scope. Locals are numbered in
+//     declaration order within their scope.
+//   - abeg x = x refers to the x outside, as the initializer is resolved
+//     before x is declared. Nested functions see the locals around them.
+//
+// Names with no declaration in reach, and second declarations of a name in
+// one scope, are recorded as errors; their references stay unresolved.
+
+typedef enum {
+    RESOLVE_UNDEFINED,   // Reference to a name with no declaration in reach
+    RESOLVE_REDECLARED,  // Second declaration of a name in the same scope
+} ResolveErrorType;
+
+typedef struct {
+    ResolveErrorType type;
+    Symbol name;
+    SourceLoc loc;
+} ResolveError;
+
+typedef struct ResolverGlobal ResolverGlobal;
+typedef struct ResolverLocal ResolverLocal;
+typedef struct ResolverScope ResolverScope;
+
+typedef struct {
+    // Globals, by index; the first predefined_count are the predefined ones
+    ResolverGlobal* globals;
+    size_t global_count;
+    size_t global_capacity;
+    size_t predefined_count;
+
+    // Locals in reach, innermost last, and the scopes they are in
+    ResolverLocal* locals;
+    size_t local_count;
+    size_t local_capacity;
+    ResolverScope* scopes;
+    size_t scope_count;
+    size_t scope_capacity;
+    size_t function_depth;  // Function bodies the walk is inside
+
+    // Per symbol: 1 + index of its global and of its innermost local, or 0.
+    // Symbols are dense, so lookups are array loads.
+    uint32_t* global_of;
+    uint32_t* local_of;
+    size_t symbol_capacity;
+
+    ResolveError* errors;
+    size_t error_count;
+    size_t error_capacity;
+} Resolver;
+
+void resolver_init(Resolver* resolver);
+void resolver_free(Resolver* resolver);
+
+// Predefine a global visible everywhere, e.g. a builtin function, before the
+// first run; returns its index. Defining a name twice returns the first index.
+uint32_t resolver_define_global(Resolver* resolver, Symbol name);
+
+// Name of global index
+Symbol resolver_global_name(const Resolver* resolver, uint32_t index);
+
+// Fill pass with the resolving callbacks. Each run of the pass starts over
+// from the predefined globals and clears the errors.
+void resolver_pass(Resolver* resolver, AstPass* pass);
+
+// Resolve the whole tree in a walk of its own; false if there were errors
+bool resolver_resolve(Resolver* resolver, ASTNode* node);
+
+const char* resolve_error_message(ResolveErrorType type);
+
+// Print the errors of the last run, one per line, in the parser's format
+void resolver_report(const Resolver* resolver, const ASTNode* node, const char* filename,
+                     FILE* out);
+
+#endif  // RESOLVER_H
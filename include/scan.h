@@ -0,0 +1,45 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bulk byte-classification kernels used by the lexer's hot loops. Each kernel
+// scans [p, end) and returns a pointer to the first byte that stops the run
+// (or end). Vector implementations are picked at runtime from what the CPU
+// supports, with a scalar fallback everywhere.
+
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} ScanLevel;
+
+typedef struct {
+    ScanLevel level;
+    const char* name;
+
+    // First byte that is not ' ', '\t', '\n' or '\r'
+    const char* (*skip_whitespace)(const char* p, const char* end);
+
+    // First byte that is not [A-Za-z0-9_]
+    const char* (*skip_identifier)(const char* p, const char* end);
+
+    // First occurrence of c
+    const char* (*find_byte)(const char* p, const char* end, char c);
+
+    // First occurrence of a or b
+    const char* (*find_either)(const char* p, const char* end, char a, char b);
+
+    // Number of '\n' bytes; *last is set to the final one (left alone if none)
+    size_t (*count_newlines)(const char* p, const char* end, const char** last);
+} ScanKernels;
+
+// Kernels in use by the lexer; selects the best supported level on first call
+const ScanKernels* scan_kernels(void);
+
+// Force a specific level (e.g. for benchmarks). Returns false, leaving the
+// current selection alone, if the CPU does not support it.
+bool scan_select(ScanLevel level);
+
+#endif  // SCAN_H
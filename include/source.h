@@ -0,0 +1,45 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A loaded source file. Owns the input text and the path strings so tokens can
+// refer to it by handle instead of carrying their own copies.
+typedef struct SourceFile {
+    const char* text;  // Input bytes; not necessarily NUL-terminated, see length
+    uint64_t length;
+    char* name;
+    char* directory;
+    uint32_t refcount;
+    bool mapped;  // text is a read-only mmap of the file rather than a heap copy
+} SourceFile;
+
+// Position in a source file packed into 32 bits: the byte offset, saturated at
+// SOURCE_LOC_MAX. Line and column are not stored; they are resolved through a
+// line table when a diagnostic needs them (see ast_resolve_loc).
+typedef uint32_t SourceLoc;
+
+#define SOURCE_LOC_MAX UINT32_MAX
+
+// Inputs past 4 GiB share the last representable location
+static inline SourceLoc source_loc(uint64_t offset) {
+    return offset < SOURCE_LOC_MAX ? (SourceLoc)offset : SOURCE_LOC_MAX;
+}
+
+// Create a source file holding a copy of text[0..length). Starts with one reference.
+SourceFile* source_file_create(const char* text, uint64_t length, const char* name,
+                               const char* directory);
+
+// Map the file at path read-only, hinting the kernel for sequential access.
+// name and directory are derived from path. Returns NULL if it cannot be opened.
+SourceFile* source_file_map(const char* path);
+
+// Take another reference to the source file
+SourceFile* source_file_retain(SourceFile* source);
+
+// Drop a reference; the file is freed (or unmapped) when the last one goes away
+void source_file_release(SourceFile* source);
+
+#endif  // SOURCE_H
@@ -0,0 +1,31 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Interned names. Every distinct identifier, type name and string literal is
+// stored once in a process-wide table and referred to by a 32-bit Symbol, so
+// comparing two names is an integer compare. Symbols stay valid for the life
+// of the process and may be created and resolved from any thread.
+typedef uint32_t Symbol;
+
+// No name, e.g. a variable declared without a type annotation
+#define SYMBOL_NONE 0
+
+// Symbol for text[0..length), adding it to the table on first sight
+Symbol symbol_intern(const char* text, size_t length);
+
+// Symbol for a NUL-terminated string
+Symbol symbol_intern_cstr(const char* text);
+
+// Interned text of a symbol, NUL-terminated; "" for SYMBOL_NONE
+const char* symbol_name(Symbol symbol);
+
+// Length of the interned text in bytes
+uint32_t symbol_length(Symbol symbol);
+
+// Number of distinct symbols interned so far (not counting SYMBOL_NONE)
+size_t symbol_count(void);
+
+#endif  // SYMBOL_H
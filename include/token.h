@@ -1,8 +1,14 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "arena.h"
+#include "number.h"
+#include "source.h"
+#include "symbol.h"
+
 typedef enum {
     // Special tokens
     TOKEN_ILLEGAL,
@@ -59,23 +65,67 @@ typedef enum {
 
 typedef struct {
     TokenType type;
-    char* value;
+    const char* value;   // NUL-terminated text (decoded for string literals)
+    Symbol symbol;       // Interned name of identifiers and type names, else SYMBOL_NONE
+    union {
+        int64_t int_val;   // TOKEN_INTEGER
+        double float_val;  // TOKEN_FLOAT
+    } number;              // Decoded value of numeric literals
+    SourceFile* source;  // File the token was read from
+    uint64_t offset;     // Slice of source->text covered by the token
+    uint32_t length;
     uint32_t line;
     uint32_t column;
-    char* file_name;
-    char* file_directory;
 } Token;
 
-// Create a new token
-Token* token_create(TokenType type, const char* value, uint32_t line, uint32_t column,
-                    const char* file_name, const char* file_directory);
+// Create a standalone heap token. Tokens produced by the lexer live in the
+// lexer's arena instead and must not be passed to token_free.
+Token* token_create(TokenType type, const char* value, SourceFile* source, uint64_t offset,
+                    uint32_t length, uint32_t line, uint32_t column);
 
-// Free a token
+// Free a token made by token_create
 void token_free(Token* token);
 
+// Raw source text covered by the token (not NUL-terminated; see token->length)
+const char* token_text(const Token* token);
+
+// Canonical spelling of tokens with fixed text ("+", "==", "abeg", ""), or NULL
+// for tokens whose text varies (identifiers, literals, comments)
+const char* token_lexeme(TokenType type);
+
+// Build the NUL-terminated value of a token from its raw source slice: fixed
+// tokens reuse their lexeme, strings are unquoted and unescaped, comments lose
+// their delimiters. Variable text is copied into the arena.
+const char* token_value_from_slice(Arena* arena, TokenType type, const char* text, size_t len);
+
+// Body of the string literal text[0..len), quotes included, with the quotes
+// stripped and escapes decoded into *body_len bytes. Without escapes this is a
+// slice of text itself (not NUL-terminated, no copy); otherwise the body is
+// decoded in one pass into exactly *body_len + 1 bytes of arena storage.
+// Returns NULL if memory ran out.
+const char* token_string_body(Arena* arena, const char* text, size_t len, size_t* body_len);
+
+// Fill in token->value (and token->symbol for names) from the raw slice text,
+// which covers token->length bytes. Names are interned and their value is the
+// symbol's text; anything else goes through token_value_from_slice. Returns
+// false if memory ran out.
+bool token_materialize(Token* token, Arena* arena, const char* text);
+
+// Decode the numeric literal covering token->length bytes of text into
+// token->number. Tokens of other types are left alone and report NUMBER_OK.
+NumberStatus token_decode_number(Token* token, const char* text);
+
+// Map the character after a backslash to the character it denotes, or '\0' if
+// the escape is not valid
+char token_unescape(char escaped);
+
 // Get string representation of token type
 const char* token_type_to_string(TokenType type);
 
+// Classify the identifier ident[0..len) (not NUL-terminated) as a keyword,
+// TOKEN_TYPE for a type keyword, or TOKEN_IDENT. One hash lookup, no allocation.
+TokenType token_classify_ident(const char* ident, size_t len);
+
 // Check if identifier is a keyword, return token type or TOKEN_IDENT
 TokenType token_lookup_keyword(const char* ident);
 
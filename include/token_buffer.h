@@ -0,0 +1,40 @@
+#ifndef TOKEN_BUFFER_H
+#define TOKEN_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "token.h"
+
+// Struct-of-arrays token stream. Token i is described by types[i], starts[i],
+// lens[i], lines[i] and columns[i]; its text is a slice of the source file, so
+// no per-token allocation is needed and scanning types touches one byte per token.
+typedef struct {
+    uint8_t* types;  // TokenType values
+    uint64_t* starts;
+    uint32_t* lens;
+    uint32_t* lines;
+    uint32_t* columns;
+    size_t count;
+    size_t capacity;
+} TokenBuffer;
+
+// Initialize an empty buffer
+void token_buffer_init(TokenBuffer* buffer);
+
+// Release the arrays owned by the buffer
+void token_buffer_free(TokenBuffer* buffer);
+
+// Grow the arrays to hold at least capacity tokens
+bool token_buffer_reserve(TokenBuffer* buffer, size_t capacity);
+
+// Append one token; returns false if the arrays could not grow
+bool token_buffer_push(TokenBuffer* buffer, TokenType type, uint64_t start, uint32_t len,
+                       uint32_t line, uint32_t column);
+
+// Append tokens [first, from->count) of another buffer, shifting their lines by line_delta
+bool token_buffer_append(TokenBuffer* buffer, const TokenBuffer* from, size_t first,
+                         uint32_t line_delta);
+
+#endif  // TOKEN_BUFFER_H
@@ -0,0 +1,9 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+// Compiler version. Anything derived from a parse and kept across runs (the
+// AST cache) is keyed by it, so bump it whenever the grammar or the AST
+// layout changes.
+#define SORO_VERSION "0.1.0"
+
+#endif  // VERSION_H
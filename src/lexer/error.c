@@ -2,9 +2,13 @@
 #include "../../include/error.h"
 
 #include <stdio.h>
+#include <string.h>
+
+void lexer_error_print(LexerErrorType error, const LineIndex* lines, uint64_t offset,
+                       const char* input, uint64_t input_len, const char* file_name) {
+    uint32_t line, column;
+    line_index_lookup(lines, offset, &line, &column);
 
-void lexer_error_print(LexerErrorType error, uint32_t line, uint32_t column, const char* input,
-                       const char* file_name) {
     fprintf(stderr, "\033[1;31mLexer Error\033[0m in %s at line %u, column %u:\n",
             file_name ? file_name : "unknown", line, column);
 
@@ -21,28 +25,24 @@ void lexer_error_print(LexerErrorType error, uint32_t line, uint32_t column, con
         case LEXER_ERROR_INVALID_CHAR:
             fprintf(stderr, "  Invalid character\n");
             break;
+        case LEXER_ERROR_TOKEN_TOO_LONG:
+            fprintf(stderr, "  Token longer than 4 GiB\n");
+            break;
+        case LEXER_ERROR_NUMBER_OVERFLOW:
+            fprintf(stderr, "  Numeric literal out of range\n");
+            break;
         default:
             fprintf(stderr, "  Unknown error\n");
             break;
     }
 
-    // Show the line with error (simplified)
+    // Show the line with error
     if(input) {
-        // Find start of line
-        const char* line_start = input;
-        uint32_t current_line = 1;
-
-        while(current_line < line && *line_start) {
-            if(*line_start == '\n') {
-                current_line++;
-            }
-            line_start++;
-        }
-
-        // Find end of line
-        const char* line_end = line_start;
-        while(*line_end && *line_end != '\n') {
-            line_end++;
+        const char* input_end = input + input_len;
+        const char* line_start = input + lines->starts[line - 1];
+        const char* line_end = memchr(line_start, '\n', (size_t)(input_end - line_start));
+        if(!line_end) {
+            line_end = input_end;
         }
 
         // Print the line
@@ -2,6 +2,8 @@
 #include "../../include/lexer.h"
 
 #include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,66 +12,143 @@
 
 // Helper macros
 #define INITIAL_TOKEN_CAPACITY 512
-#define INITIAL_STRING_CAPACITY 128
+#define LEXER_ARENA_CHUNK_SIZE (64 * 1024)
+#define LINE_INDEX_STEP (64 * 1024)
+#define PARALLEL_MIN_CHUNK (16 * 1024)
 
 // Helper functions (forward declarations)
+static bool refill(Lexer* lexer);
+static bool has_more(Lexer* lexer);
+static const char* input_at(Lexer* lexer, uint64_t offset);
+static void index_lines(Lexer* lexer, uint64_t offset);
+static void locate_token(Lexer* lexer, Token* token);
+static void report_error(Lexer* lexer, LexerErrorType error, uint64_t offset);
 static char current_char(Lexer* lexer);
 static char peek_char(Lexer* lexer, size_t offset);
 static void advance(Lexer* lexer, uint32_t count);
+static void advance_to(Lexer* lexer, const char* stop);
 static void skip_whitespace(Lexer* lexer);
-static int is_ident_char(char c);
 static int is_digit(char c);
-
-static Token* read_number(Lexer* lexer);
-static Token* read_string(Lexer* lexer);
-static Token* read_identifier(Lexer* lexer);
-static Token* read_slash_or_comment(Lexer* lexer);
-static Token* create_token(Lexer* lexer, TokenType type, const char* value);
+static int is_hex_digit(char c);
+static int is_binary_digit(char c);
+
+static bool scan_token(Lexer* lexer, Token* token);
+static bool scan_raw_token(Lexer* lexer, Token* token);
+static bool record_comment(Lexer* lexer, const Token* token);
+static bool dispatch_switch(Lexer* lexer, Token* token);
+static bool dispatch_dfa(Lexer* lexer, Token* token);
+static bool read_number(Lexer* lexer, Token* token);
+static bool read_string(Lexer* lexer, Token* token);
+static bool read_string_body(Lexer* lexer, Token* token, char quote);
+static bool read_identifier(Lexer* lexer, Token* token);
+static bool read_slash_or_comment(Lexer* lexer, Token* token);
+static bool read_line_comment_body(Lexer* lexer, Token* token);
+static bool read_block_comment_body(Lexer* lexer, Token* token);
+static bool read_operator(Lexer* lexer, Token* token, TokenType type, uint32_t width);
 
 Lexer* lexer_init(const char* input, const char* file_name, const char* file_directory) {
+    SourceFile* source = source_file_create(input, strlen(input), file_name, file_directory);
+    if(!source)
+        return NULL;
+
+    Lexer* lexer = lexer_init_source(source);
+    source_file_release(source);
+    return lexer;
+}
+
+Lexer* lexer_init_from_path(const char* path) {
+    SourceFile* source = source_file_map(path);
+    if(!source)
+        return NULL;
+
+    Lexer* lexer = lexer_init_source(source);
+    source_file_release(source);
+    return lexer;
+}
+
+Lexer* lexer_init_source(SourceFile* source) {
     Lexer* lexer = malloc(sizeof(Lexer));
     if(!lexer)
         return NULL;
 
-    lexer->input = input;
-    lexer->input_len = strlen(input);
+    lexer->source = source_file_retain(source);
+    lexer->input = lexer->source->text;
+    lexer->base = 0;
+    lexer->input_len = lexer->source->length;
     lexer->position = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->file_name = file_name ? strdup(file_name) : strdup("unknown");
-    lexer->file_directory = file_directory ? strdup(file_directory) : strdup(".");
+    lexer->line_cursor = 0;
+    if(!line_index_init(&lexer->lines)) {
+        source_file_release(lexer->source);
+        free(lexer);
+        return NULL;
+    }
 
     // Initialize token array
     lexer->token_capacity = INITIAL_TOKEN_CAPACITY;
     lexer->token_count = 0;
     lexer->tokens = malloc(sizeof(Token*) * lexer->token_capacity);
 
-    // Initialize string allocation tracking
-    lexer->string_capacity = INITIAL_STRING_CAPACITY;
-    lexer->string_count = 0;
-    lexer->string_allocations = malloc(sizeof(char*) * lexer->string_capacity);
+    arena_init(&lexer->arena, LEXER_ARENA_CHUNK_SIZE);
+    lexer->stream = NULL;
+    lexer->scan = scan_kernels();
+    lexer->flags = 0;
+    lexer->comments.ranges = NULL;
+    lexer->comments.count = 0;
+    lexer->comments.capacity = 0;
 
     return lexer;
 }
 
+Lexer* lexer_init_stream(LexerReadFn read, void* context, size_t chunk_size,
+                         const char* file_name, const char* file_directory) {
+    // The source file only carries the names; its text is never resident
+    SourceFile* source = source_file_create("", 0, file_name, file_directory);
+    if(!source)
+        return NULL;
+
+    Lexer* lexer = lexer_init_source(source);
+    source_file_release(source);
+    if(!lexer)
+        return NULL;
+
+    LexerStream* stream = malloc(sizeof(LexerStream));
+    if(!stream) {
+        lexer_free(lexer);
+        return NULL;
+    }
+    stream->read = read;
+    stream->context = context;
+    stream->window = NULL;
+    stream->capacity = 0;
+    stream->chunk_size = chunk_size > 0 ? chunk_size : 1;
+    stream->keep_from = 0;
+    stream->eof = false;
+
+    lexer->stream = stream;
+    lexer->input = "";
+    return lexer;
+}
+
+size_t lexer_read_file(void* context, char* buffer, size_t size) {
+    return fread(buffer, 1, size, (FILE*)context);
+}
+
 void lexer_free(Lexer* lexer) {
     if(!lexer)
         return;
 
-    // Free all tokens
-    for(size_t i = 0; i < lexer->token_count; i++) {
-        token_free(lexer->tokens[i]);
-    }
+    // Tokens and their text all live in the arena
     free(lexer->tokens);
+    arena_free(&lexer->arena);
+    line_index_free(&lexer->lines);
+    free(lexer->comments.ranges);
 
-    // Free string allocations
-    for(size_t i = 0; i < lexer->string_count; i++) {
-        free(lexer->string_allocations[i]);
+    if(lexer->stream) {
+        free(lexer->stream->window);
+        free(lexer->stream);
     }
-    free(lexer->string_allocations);
 
-    free(lexer->file_name);
-    free(lexer->file_directory);
+    source_file_release(lexer->source);
     free(lexer);
 }
 
@@ -99,359 +178,1137 @@ Token** lexer_tokenize(Lexer* lexer, size_t* token_count) {
     return lexer->tokens;
 }
 
-Token* lexer_next_token(Lexer* lexer) {
-    skip_whitespace(lexer);
+bool lexer_tokenize_soa(Lexer* lexer, TokenBuffer* buffer) {
+    Token token;
 
-    if(lexer->position >= lexer->input_len) {
-        return create_token(lexer, TOKEN_EOF, "");
-    }
+    do {
+        if(!scan_token(lexer, &token)) {
+            return false;
+        }
+        if(!token_buffer_push(buffer, token.type, token.offset, token.length, token.line,
+                              token.column)) {
+            return false;
+        }
+    } while(token.type != TOKEN_EOF);
 
-    char ch = current_char(lexer);
+    return true;
+}
 
-    switch(ch) {
-        case '+': {
-            Token* tok = create_token(lexer, TOKEN_PLUS, "+");
-            advance(lexer, 1);
-            return tok;
+// One speculatively lexed slice of the input (see lexer_tokenize_parallel)
+typedef struct {
+    SourceFile* source;
+    unsigned flags;
+    uint64_t start;      // Line start where lexing begins
+    uint64_t end;        // Tokens starting at or after end belong to the next chunk
+    TokenBuffer tokens;  // Line numbers are relative to start
+    LineIndex lines;     // Line starts in [start, end), owned by the chunk
+    bool ok;             // lines is complete
+    pthread_t thread;
+    bool spawned;
+} LexChunk;
+
+// Lex a chunk as if a token started at chunk->start. The guess may be wrong, so
+// errors are not reported and simply end the chunk early.
+static void* lex_chunk(void* arg) {
+    LexChunk* chunk = arg;
+    Lexer* lexer = lexer_init_source(chunk->source);
+    if(!lexer)
+        return NULL;
+
+    lexer->flags = chunk->flags | LEXER_QUIET;
+    lexer->position = chunk->start;
+    lexer->lines.starts[0] = chunk->start;
+    lexer->lines.scanned = chunk->start;
+
+    Token token;
+    while(scan_token(lexer, &token) && token.offset < chunk->end) {
+        if(!token_buffer_push(&chunk->tokens, token.type, token.offset, token.length, token.line,
+                              token.column) ||
+           token.type == TOKEN_EOF) {
+            break;
         }
-        case '-': {
-            Token* tok = create_token(lexer, TOKEN_MINUS, "-");
-            advance(lexer, 1);
-            return tok;
+    }
+
+    // The stitch pass needs every line start in the chunk, even if lexing stopped early
+    uint64_t end = chunk->end < lexer->input_len ? chunk->end : lexer->input_len;
+    if(lexer->lines.scanned < end) {
+        chunk->ok = line_index_scan(&lexer->lines, input_at(lexer, lexer->lines.scanned), end);
+    } else {
+        chunk->ok = true;
+    }
+
+    chunk->lines = lexer->lines;
+    lexer->lines.starts = NULL;
+    lexer_free(lexer);
+    return NULL;
+}
+
+// Index of the token in tokens starting at offset, if there is one
+static bool find_token_at(const TokenBuffer* tokens, uint64_t offset, size_t* index) {
+    size_t low = 0;
+    size_t high = tokens->count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(tokens->starts[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
-        case '*': {
-            Token* tok = create_token(lexer, TOKEN_ASTERISK, "*");
-            advance(lexer, 1);
-            return tok;
+    }
+    *index = low;
+    return low < tokens->count && tokens->starts[low] == offset;
+}
+
+// Number of line starts in the chunk's index that fall before its end
+static size_t chunk_line_count(const LexChunk* chunk) {
+    size_t count = chunk->lines.count;
+    while(count > 1 && chunk->lines.starts[count - 1] >= chunk->end) {
+        count--;
+    }
+    return count;
+}
+
+// Replace the lexer's line index with the concatenation of the chunk indexes,
+// recording in line_base[i] the number of lines before chunk i
+static bool merge_line_indexes(Lexer* lexer, LexChunk* chunks, size_t count,
+                               size_t* line_base) {
+    size_t total = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(!chunks[i].ok)
+            return false;
+        line_base[i] = total;
+        total += chunk_line_count(&chunks[i]);
+    }
+
+    uint64_t* starts = realloc(lexer->lines.starts, sizeof(uint64_t) * total);
+    if(!starts)
+        return false;
+
+    for(size_t i = 0; i < count; i++) {
+        memcpy(starts + line_base[i], chunks[i].lines.starts,
+               sizeof(uint64_t) * chunk_line_count(&chunks[i]));
+    }
+    lexer->lines.starts = starts;
+    lexer->lines.count = total;
+    lexer->lines.capacity = total;
+    lexer->lines.scanned = lexer->input_len;
+    return true;
+}
+
+// Serially walk the true token stream, adopting each chunk's tokens from the
+// first offset where both agree. Lexing from a given token start is
+// deterministic, so once the offsets match, the rest of the chunk matches too.
+static bool stitch_chunks(Lexer* lexer, TokenBuffer* buffer, LexChunk* chunks, size_t count,
+                          const size_t* line_base) {
+    size_t total = buffer->count;
+    for(size_t i = 0; i < count; i++) {
+        total += chunks[i].tokens.count;
+    }
+    if(!token_buffer_reserve(buffer, total)) {
+        return false;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        LexChunk* chunk = &chunks[i];
+        const TokenBuffer* tokens = &chunk->tokens;
+
+        while(1) {
+            uint64_t resume = lexer->position;
+            Token token;
+            if(!scan_token(lexer, &token)) {
+                return false;
+            }
+            if(token.offset >= chunk->end) {
+                lexer->position = resume;  // First token of the next chunk
+                break;
+            }
+
+            size_t first;
+            if(!find_token_at(tokens, token.offset, &first)) {
+                // Speculation went wrong here; keep the serially lexed token
+                if(!token_buffer_push(buffer, token.type, token.offset, token.length,
+                                      token.line, token.column)) {
+                    return false;
+                }
+                if(token.type == TOKEN_EOF)
+                    return true;
+                continue;
+            }
+
+            if(!token_buffer_append(buffer, tokens, first, (uint32_t)line_base[i])) {
+                return false;
+            }
+
+            size_t last = tokens->count - 1;
+            if(tokens->types[last] == TOKEN_EOF)
+                return true;
+
+            // Carry on after the chunk's last token; the next one either starts
+            // the next chunk or is where the chunk stopped early
+            uint32_t line, column;
+            lexer->position = tokens->starts[last] + tokens->lens[last];
+            line_index_lookup(&lexer->lines, lexer->position, &line, &column);
+            lexer->line_cursor = line - 1;
         }
-        case '/':
-            return read_slash_or_comment(lexer);
-        case ';': {
-            Token* tok = create_token(lexer, TOKEN_SEMICOLON, ";");
-            advance(lexer, 1);
-            return tok;
+    }
+    return true;
+}
+
+bool lexer_tokenize_parallel(Lexer* lexer, TokenBuffer* buffer, unsigned thread_count) {
+    uint64_t length = lexer->input_len;
+    size_t count = thread_count;
+    if(count > length / PARALLEL_MIN_CHUNK) {
+        count = (size_t)(length / PARALLEL_MIN_CHUNK);
+    }
+    if(lexer->stream || lexer->position != 0 || count < 2 ||
+       (lexer->flags & LEXER_COLLECT_COMMENTS)) {
+        return lexer_tokenize_soa(lexer, buffer);
+    }
+
+    LexChunk* chunks = calloc(count, sizeof(LexChunk));
+    size_t* line_base = malloc(sizeof(size_t) * count);
+    if(!chunks || !line_base) {
+        free(chunks);
+        free(line_base);
+        return false;
+    }
+
+    // Move each even split point forward to the next line start
+    size_t used = 0;
+    uint64_t start = 0;
+    while(used < count) {
+        LexChunk* chunk = &chunks[used++];
+        chunk->source = lexer->source;
+        chunk->flags = lexer->flags;
+        chunk->start = start;
+        chunk->end = UINT64_MAX;
+        token_buffer_init(&chunk->tokens);
+
+        uint64_t split = length / count * used;
+        if(used == count)
+            break;
+        if(split < start)
+            split = start;
+
+        const char* end = input_at(lexer, length);
+        const char* newline = lexer->scan->find_byte(input_at(lexer, split), end, '\n');
+        if(newline + 1 >= end)
+            break;
+        chunk->end = (uint64_t)(newline + 1 - lexer->input);
+        start = chunk->end;
+    }
+
+    // Chunk 0 runs on the calling thread; any chunk whose thread cannot be
+    // started runs there too
+    for(size_t i = 1; i < used; i++) {
+        chunks[i].spawned = pthread_create(&chunks[i].thread, NULL, lex_chunk, &chunks[i]) == 0;
+    }
+    lex_chunk(&chunks[0]);
+    for(size_t i = 1; i < used; i++) {
+        if(chunks[i].spawned) {
+            pthread_join(chunks[i].thread, NULL);
+        } else {
+            lex_chunk(&chunks[i]);
         }
-        case ':': {
-            Token* tok = create_token(lexer, TOKEN_COLON, ":");
-            advance(lexer, 1);
-            return tok;
+    }
+
+    bool ok;
+    if(merge_line_indexes(lexer, chunks, used, line_base)) {
+        ok = stitch_chunks(lexer, buffer, chunks, used, line_base);
+    } else {
+        ok = lexer_tokenize_soa(lexer, buffer);
+    }
+
+    for(size_t i = 0; i < used; i++) {
+        token_buffer_free(&chunks[i].tokens);
+        line_index_free(&chunks[i].lines);
+    }
+    free(chunks);
+    free(line_base);
+    return ok;
+}
+
+Token* lexer_next_token(Lexer* lexer) {
+    Token* token = arena_alloc(&lexer->arena, sizeof(Token));
+    if(!token)
+        return NULL;
+
+    return lexer_scan_token(lexer, token, &lexer->arena) ? token : NULL;
+}
+
+bool lexer_scan_token(Lexer* lexer, Token* token, Arena* arena) {
+    if(!scan_token(lexer, token)) {
+        return false;
+    }
+    return token_materialize(token, arena, input_at(lexer, token->offset));
+}
+
+// ===== Incremental re-lexing =====
+
+// The lexer decides where a token ends by looking at most this many bytes past
+// it ("1." must see the byte after the dot), so a token ending closer than
+// that to an edit may change
+#define RELEX_LOOKAHEAD 2
+
+// First old token that may be affected by an edit at offset
+static size_t first_affected_token(const TokenBuffer* tokens, uint64_t offset) {
+    size_t low = 0;
+    size_t high = tokens->count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(tokens->starts[mid] + tokens->lens[mid] + RELEX_LOOKAHEAD <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
-        case ',': {
-            Token* tok = create_token(lexer, TOKEN_COMMA, ",");
-            advance(lexer, 1);
-            return tok;
+    }
+    return low;
+}
+
+// How old tokens after the edit move: offsets by delta, lines by line_delta,
+// and columns by column_delta on the line of the first one
+typedef struct {
+    int64_t delta;
+    int64_t line_delta;
+    int64_t column_delta;
+} TokenShift;
+
+// Move tail tokens from index to to index at, shifting offsets and lines on
+// the way, so they are swept once rather than moved and then shifted
+static void move_tokens(TokenBuffer* tokens, size_t to, size_t at, size_t tail,
+                        const TokenShift* shift) {
+    if(at != to) {
+        memmove(tokens->types + at, tokens->types + to, tail * sizeof(uint8_t));
+        memmove(tokens->lens + at, tokens->lens + to, tail * sizeof(uint32_t));
+        memmove(tokens->columns + at, tokens->columns + to, tail * sizeof(uint32_t));
+    }
+
+    uint64_t* starts = tokens->starts;
+    uint32_t* lines = tokens->lines;
+    uint64_t delta = (uint64_t)shift->delta;
+    uint32_t line_delta = (uint32_t)shift->line_delta;
+    if(at > to) {
+        // Moving up: back to front, so no token is overwritten before it moves
+        for(size_t k = tail; k > 0; k--) {
+            starts[at + k - 1] = starts[to + k - 1] + delta;
+            lines[at + k - 1] = lines[to + k - 1] + line_delta;
         }
-        case '(': {
-            Token* tok = create_token(lexer, TOKEN_LPAREN, "(");
-            advance(lexer, 1);
-            return tok;
+    } else if(at < to || delta != 0 || line_delta != 0) {
+        for(size_t k = 0; k < tail; k++) {
+            starts[at + k] = starts[to + k] + delta;
+            lines[at + k] = lines[to + k] + line_delta;
         }
-        case ')': {
-            Token* tok = create_token(lexer, TOKEN_RPAREN, ")");
-            advance(lexer, 1);
-            return tok;
+    }
+
+    // Lines only grow, so the column fix-up stops past the first line
+    uint32_t first_line = tail > 0 ? lines[at] : 0;
+    for(size_t k = at; k < at + tail && lines[k] == first_line; k++) {
+        tokens->columns[k] = (uint32_t)(tokens->columns[k] + shift->column_delta);
+    }
+}
+
+// Replace tokens [from, to) with all of replacement, moving the old tokens
+// after them into place
+static bool splice_tokens(TokenBuffer* tokens, size_t from, size_t to,
+                          const TokenBuffer* replacement, const TokenShift* shift) {
+    size_t tail = tokens->count - to;
+    size_t count = from + replacement->count + tail;
+    if(!token_buffer_reserve(tokens, count))
+        return false;
+
+    move_tokens(tokens, to, from + replacement->count, tail, shift);
+    tokens->count = from;
+    token_buffer_append(tokens, replacement, 0, 0);
+    tokens->count = count;
+    return true;
+}
+
+bool lexer_relex(SourceFile* source, TokenBuffer* tokens, const LexerEdit* edit, unsigned flags,
+                 size_t* relexed) {
+    LexerRelexSpan span;
+    bool ok = lexer_relex_span(source, tokens, edit, flags, &span);
+    if(relexed) {
+        *relexed = span.scanned;
+    }
+    return ok;
+}
+
+bool lexer_relex_span(SourceFile* source, TokenBuffer* tokens, const LexerEdit* edit,
+                      unsigned flags, LexerRelexSpan* span) {
+    int64_t delta = (int64_t)edit->inserted - (int64_t)edit->removed;
+    uint64_t edit_end = edit->offset + edit->inserted;  // In new offsets
+
+    // Restart right after the last token the edit cannot reach, which starts
+    // out unchanged: same offset, line and column
+    size_t first = first_affected_token(tokens, edit->offset);
+    uint64_t restart = 0;
+    uint32_t line = 1;
+    uint64_t line_start = 0;
+    if(first > 0) {
+        size_t safe = first - 1;
+        restart = tokens->starts[safe] + tokens->lens[safe];
+        line = tokens->lines[safe];
+        line_start = tokens->starts[safe] - (tokens->columns[safe] - 1);
+
+        // The safe token itself may span lines (block comments, strings)
+        const ScanKernels* scan = scan_kernels();
+        const char* last_newline = NULL;
+        line += (uint32_t)scan->count_newlines(source->text + tokens->starts[safe],
+                                               source->text + restart, &last_newline);
+        if(last_newline) {
+            line_start = (uint64_t)(last_newline + 1 - source->text);
         }
-        case '{': {
-            Token* tok = create_token(lexer, TOKEN_LBRACE, "{");
-            advance(lexer, 1);
-            return tok;
+    }
+
+    span->first = first;
+    span->count = 0;
+    span->scanned = 0;
+    span->line_delta = 0;
+
+    Lexer* lexer = lexer_init_source(source);
+    if(!lexer)
+        return false;
+    lexer->flags = flags;
+    lexer->position = restart;
+    lexer->lines.starts[0] = line_start;
+    lexer->lines.scanned = line_start;
+
+    TokenBuffer fresh;
+    token_buffer_init(&fresh);
+
+    bool ok = true;
+    size_t resync = tokens->count;  // Old token the new stream lined up with
+    int64_t line_delta = 0;
+    int64_t column_delta = 0;
+    Token token;
+    while(1) {
+        if(!scan_token(lexer, &token)) {
+            ok = false;
+            break;
         }
-        case '}': {
-            Token* tok = create_token(lexer, TOKEN_RBRACE, "}");
-            advance(lexer, 1);
-            return tok;
+        token.line += line - 1;
+
+        // Past the edit, a token starting where an old one did continues the old stream
+        if(token.offset >= edit_end && token.type != TOKEN_EOF) {
+            size_t old;
+            uint64_t old_offset = (uint64_t)((int64_t)token.offset - delta);
+            if(find_token_at(tokens, old_offset, &old) && old >= first) {
+                line_delta = (int64_t)token.line - tokens->lines[old];
+                column_delta = (int64_t)token.column - tokens->columns[old];
+                resync = old;
+                break;
+            }
         }
-        case '[': {
-            Token* tok = create_token(lexer, TOKEN_LBRACKET, "[");
-            advance(lexer, 1);
-            return tok;
+
+        if(!token_buffer_push(&fresh, token.type, token.offset, token.length, token.line,
+                              token.column)) {
+            ok = false;
+            break;
         }
-        case ']': {
-            Token* tok = create_token(lexer, TOKEN_RBRACKET, "]");
-            advance(lexer, 1);
-            return tok;
+        if(token.type == TOKEN_EOF)
+            break;
+    }
+
+    // The token that resynchronized was scanned too
+    span->count = fresh.count;
+    span->scanned = fresh.count + (resync < tokens->count ? 1 : 0);
+    span->line_delta = line_delta;
+    if(ok) {
+        TokenShift shift = {delta, line_delta, column_delta};
+        ok = splice_tokens(tokens, first, resync, &fresh, &shift);
+    }
+
+    token_buffer_free(&fresh);
+    lexer_free(lexer);
+    return ok;
+}
+
+// Scan one token into *token without allocating, applying the comment flags.
+// value is left NULL; callers that need it use token_materialize.
+static bool scan_token(Lexer* lexer, Token* token) {
+    while(scan_raw_token(lexer, token)) {
+        if(token->type != TOKEN_COMMENT) {
+            return true;
         }
-        case '<': {
-            Token* tok = create_token(lexer, TOKEN_LESS_THAN, "<");
-            advance(lexer, 1);
-            return tok;
+        if((lexer->flags & LEXER_COLLECT_COMMENTS) && !record_comment(lexer, token)) {
+            return false;
         }
-        case '>': {
-            Token* tok = create_token(lexer, TOKEN_GREATER_THAN, ">");
-            advance(lexer, 1);
-            return tok;
+        if(!(lexer->flags & LEXER_SKIP_COMMENTS)) {
+            return true;
         }
+    }
+    return false;
+}
+
+static bool record_comment(Lexer* lexer, const Token* token) {
+    CommentTable* comments = &lexer->comments;
+    if(comments->count >= comments->capacity) {
+        size_t capacity = comments->capacity ? comments->capacity * 2 : 64;
+        CommentRange* ranges = realloc(comments->ranges, sizeof(CommentRange) * capacity);
+        if(!ranges)
+            return false;
+        comments->ranges = ranges;
+        comments->capacity = capacity;
+    }
+
+    comments->ranges[comments->count].offset = token->offset;
+    comments->ranges[comments->count].length = token->length;
+    comments->count++;
+    return true;
+}
+
+static bool scan_raw_token(Lexer* lexer, Token* token) {
+    skip_whitespace(lexer);
+
+    // Everything before this token may be dropped when a stream refills
+    if(lexer->stream) {
+        lexer->stream->keep_from = lexer->position;
+    }
+
+    token->value = NULL;
+    token->symbol = SYMBOL_NONE;
+    token->source = lexer->source;
+    token->offset = lexer->position;
+    token->length = 0;
+    locate_token(lexer, token);
+
+    if(!has_more(lexer)) {
+        token->type = TOKEN_EOF;
+        return true;
+    }
+
+    bool ok = (lexer->flags & LEXER_SWITCH_CORE) ? dispatch_switch(lexer, token)
+                                                 : dispatch_dfa(lexer, token);
+
+    if(ok && lexer->position - token->offset > UINT32_MAX) {
+        report_error(lexer, LEXER_ERROR_TOKEN_TOO_LONG, token->offset);
+        return false;
+    }
+    token->length = (uint32_t)(lexer->position - token->offset);
+
+    // The digits are still in the window, so decode them before they can go
+    if(ok && token_decode_number(token, input_at(lexer, token->offset)) != NUMBER_OK) {
+        report_error(lexer, LEXER_ERROR_NUMBER_OVERFLOW, token->offset);
+        return false;
+    }
+    return ok;
+}
+
+// Original core: one switch case per leading character
+static bool dispatch_switch(Lexer* lexer, Token* token) {
+    char ch = current_char(lexer);
+    bool ok;
+
+    switch(ch) {
+        case '+':
+            ok = read_operator(lexer, token, TOKEN_PLUS, 1);
+            break;
+        case '-':
+            ok = read_operator(lexer, token, TOKEN_MINUS, 1);
+            break;
+        case '*':
+            ok = read_operator(lexer, token, TOKEN_ASTERISK, 1);
+            break;
+        case '/':
+            ok = read_slash_or_comment(lexer, token);
+            break;
+        case ';':
+            ok = read_operator(lexer, token, TOKEN_SEMICOLON, 1);
+            break;
+        case ':':
+            ok = read_operator(lexer, token, TOKEN_COLON, 1);
+            break;
+        case ',':
+            ok = read_operator(lexer, token, TOKEN_COMMA, 1);
+            break;
+        case '(':
+            ok = read_operator(lexer, token, TOKEN_LPAREN, 1);
+            break;
+        case ')':
+            ok = read_operator(lexer, token, TOKEN_RPAREN, 1);
+            break;
+        case '{':
+            ok = read_operator(lexer, token, TOKEN_LBRACE, 1);
+            break;
+        case '}':
+            ok = read_operator(lexer, token, TOKEN_RBRACE, 1);
+            break;
+        case '[':
+            ok = read_operator(lexer, token, TOKEN_LBRACKET, 1);
+            break;
+        case ']':
+            ok = read_operator(lexer, token, TOKEN_RBRACKET, 1);
+            break;
+        case '<':
+            ok = read_operator(lexer, token, TOKEN_LESS_THAN, 1);
+            break;
+        case '>':
+            ok = read_operator(lexer, token, TOKEN_GREATER_THAN, 1);
+            break;
         case '=':
             if(peek_char(lexer, 1) == '=') {
-                Token* tok = create_token(lexer, TOKEN_EQUAL, "==");
-                advance(lexer, 2);
-                return tok;
+                ok = read_operator(lexer, token, TOKEN_EQUAL, 2);
             } else {
-                Token* tok = create_token(lexer, TOKEN_ASSIGN, "=");
-                advance(lexer, 1);
-                return tok;
+                ok = read_operator(lexer, token, TOKEN_ASSIGN, 1);
             }
+            break;
         case '!':
             if(peek_char(lexer, 1) == '=') {
-                Token* tok = create_token(lexer, TOKEN_NOT_EQUAL, "!=");
-                advance(lexer, 2);
-                return tok;
+                ok = read_operator(lexer, token, TOKEN_NOT_EQUAL, 2);
             } else {
-                Token* tok = create_token(lexer, TOKEN_BANG, "!");
-                advance(lexer, 1);
-                return tok;
+                ok = read_operator(lexer, token, TOKEN_BANG, 1);
             }
+            break;
         case '"':
         case '\'':
-            return read_string(lexer);
+            ok = read_string(lexer, token);
+            break;
         case '0' ... '9':
-            return read_number(lexer);
+            ok = read_number(lexer, token);
+            break;
         default:
             if(isalpha(ch) || ch == '_') {
-                return read_identifier(lexer);
+                ok = read_identifier(lexer, token);
+            } else {
+                ok = read_operator(lexer, token, TOKEN_ILLEGAL, 1);
+            }
+            break;
+    }
+
+    return ok;
+}
+
+// ===== Table-driven core =====
+
+// Character classes; every byte maps to exactly one, independent of locale
+enum {
+    CC_OTHER,
+    CC_ALPHA,      // Letters that cannot appear in a number
+    CC_HEX_ALPHA,  // a c-f A C-F
+    CC_B,          // b B: binary prefix, also a hex digit
+    CC_X,          // x X: hex prefix
+    CC_UNDERSCORE,
+    CC_ZERO,
+    CC_ONE,
+    CC_DIGIT,  // 2-9
+    CC_DOT,
+    CC_EQ,
+    CC_BANG,
+    CC_SLASH,
+    CC_STAR,
+    CC_QUOTE,  // " and '
+    CC_PUNCT,  // Remaining single-character tokens
+    CC_COUNT
+};
+
+static const uint8_t char_class[256] = {
+    ['a'] = CC_HEX_ALPHA,     ['c' ... 'f'] = CC_HEX_ALPHA, ['g' ... 'w'] = CC_ALPHA,
+    ['y' ... 'z'] = CC_ALPHA, ['A'] = CC_HEX_ALPHA,     ['C' ... 'F'] = CC_HEX_ALPHA,
+    ['G' ... 'W'] = CC_ALPHA, ['Y' ... 'Z'] = CC_ALPHA,
+    ['b'] = CC_B,             ['B'] = CC_B,             ['x'] = CC_X,
+    ['X'] = CC_X,             ['_'] = CC_UNDERSCORE,    ['0'] = CC_ZERO,
+    ['1'] = CC_ONE,           ['2' ... '9'] = CC_DIGIT, ['.'] = CC_DOT,
+    ['='] = CC_EQ,            ['!'] = CC_BANG,          ['/'] = CC_SLASH,
+    ['*'] = CC_STAR,          ['"'] = CC_QUOTE,         ['\''] = CC_QUOTE,
+    ['+'] = CC_PUNCT,         ['-'] = CC_PUNCT,         [';'] = CC_PUNCT,
+    [':'] = CC_PUNCT,         [','] = CC_PUNCT,         ['('] = CC_PUNCT,
+    [')'] = CC_PUNCT,         ['{'] = CC_PUNCT,         ['}'] = CC_PUNCT,
+    ['['] = CC_PUNCT,         [']'] = CC_PUNCT,         ['<'] = CC_PUNCT,
+    ['>'] = CC_PUNCT,
+};
+
+// Token type of each single-character token, keyed by the character
+static const uint8_t single_type[256] = {
+    ['+'] = TOKEN_PLUS,      ['-'] = TOKEN_MINUS,     ['*'] = TOKEN_ASTERISK,
+    [';'] = TOKEN_SEMICOLON, [':'] = TOKEN_COLON,     [','] = TOKEN_COMMA,
+    ['('] = TOKEN_LPAREN,    [')'] = TOKEN_RPAREN,    ['{'] = TOKEN_LBRACE,
+    ['}'] = TOKEN_RBRACE,    ['['] = TOKEN_LBRACKET,  [']'] = TOKEN_RBRACKET,
+    ['<'] = TOKEN_LESS_THAN, ['>'] = TOKEN_GREATER_THAN,
+};
+
+// DFA states. S_DEAD is 0 so every transition left out of the table is dead.
+// States from S_STRING on hand the rest of the token to a body reader.
+enum {
+    S_DEAD,
+    S_START,
+    S_IDENT,
+    S_ZERO,  // A leading '0', which may open a 0x / 0b prefix
+    S_INT,
+    S_INT_SEP,  // '_' inside an integer, waiting for a digit
+    S_INT_DOT,  // Digits and a '.', waiting for a fraction digit
+    S_FLOAT,
+    S_FLOAT_SEP,
+    S_HEX_PREFIX,  // "0x", waiting for a hex digit
+    S_HEX,
+    S_HEX_SEP,
+    S_BIN_PREFIX,  // "0b", waiting for a binary digit
+    S_BIN,
+    S_BIN_SEP,
+    S_SINGLE,
+    S_ILLEGAL,
+    S_ASSIGN,
+    S_EQUAL,
+    S_BANG,
+    S_NOT_EQUAL,
+    S_SLASH,
+    S_STRING,
+    S_LINE_COMMENT,
+    S_BLOCK_COMMENT,
+    S_COUNT
+};
+
+#define S_FIRST_HANDOFF S_STRING
+
+// Transitions shared by several states
+#define NAME_CHARS(to)                                                                       \
+    [CC_ALPHA] = to, [CC_HEX_ALPHA] = to, [CC_B] = to, [CC_X] = to, [CC_UNDERSCORE] = to,    \
+    [CC_ZERO] = to, [CC_ONE] = to, [CC_DIGIT] = to
+#define DECIMAL_DIGITS(to) [CC_ZERO] = to, [CC_ONE] = to, [CC_DIGIT] = to
+#define HEX_DIGITS(to) DECIMAL_DIGITS(to), [CC_HEX_ALPHA] = to, [CC_B] = to
+#define BINARY_DIGITS(to) [CC_ZERO] = to, [CC_ONE] = to
+
+static const uint8_t transitions[S_COUNT][CC_COUNT] = {
+    [S_START] =
+        {
+            [CC_OTHER] = S_ILLEGAL,
+            [CC_ALPHA] = S_IDENT,
+            [CC_HEX_ALPHA] = S_IDENT,
+            [CC_B] = S_IDENT,
+            [CC_X] = S_IDENT,
+            [CC_UNDERSCORE] = S_IDENT,
+            [CC_ZERO] = S_ZERO,
+            [CC_ONE] = S_INT,
+            [CC_DIGIT] = S_INT,
+            [CC_DOT] = S_ILLEGAL,
+            [CC_EQ] = S_ASSIGN,
+            [CC_BANG] = S_BANG,
+            [CC_SLASH] = S_SLASH,
+            [CC_STAR] = S_SINGLE,
+            [CC_QUOTE] = S_STRING,
+            [CC_PUNCT] = S_SINGLE,
+        },
+    [S_IDENT] = {NAME_CHARS(S_IDENT)},
+    [S_ZERO] =
+        {
+            DECIMAL_DIGITS(S_INT),
+            [CC_UNDERSCORE] = S_INT_SEP,
+            [CC_DOT] = S_INT_DOT,
+            [CC_X] = S_HEX_PREFIX,
+            [CC_B] = S_BIN_PREFIX,
+        },
+    [S_INT] = {DECIMAL_DIGITS(S_INT), [CC_UNDERSCORE] = S_INT_SEP, [CC_DOT] = S_INT_DOT},
+    [S_INT_SEP] = {DECIMAL_DIGITS(S_INT)},
+    [S_INT_DOT] = {DECIMAL_DIGITS(S_FLOAT)},
+    [S_FLOAT] = {DECIMAL_DIGITS(S_FLOAT), [CC_UNDERSCORE] = S_FLOAT_SEP},
+    [S_FLOAT_SEP] = {DECIMAL_DIGITS(S_FLOAT)},
+    [S_HEX_PREFIX] = {HEX_DIGITS(S_HEX)},
+    [S_HEX] = {HEX_DIGITS(S_HEX), [CC_UNDERSCORE] = S_HEX_SEP},
+    [S_HEX_SEP] = {HEX_DIGITS(S_HEX)},
+    [S_BIN_PREFIX] = {BINARY_DIGITS(S_BIN)},
+    [S_BIN] = {BINARY_DIGITS(S_BIN), [CC_UNDERSCORE] = S_BIN_SEP},
+    [S_BIN_SEP] = {BINARY_DIGITS(S_BIN)},
+    [S_ASSIGN] = {[CC_EQ] = S_EQUAL},
+    [S_BANG] = {[CC_EQ] = S_NOT_EQUAL},
+    [S_SLASH] = {[CC_SLASH] = S_LINE_COMMENT, [CC_STAR] = S_BLOCK_COMMENT},
+};
+
+#undef NAME_CHARS
+#undef DECIMAL_DIGITS
+#undef HEX_DIGITS
+#undef BINARY_DIGITS
+
+// Token type produced when the scan stops in an accepting state. States whose
+// type depends on the lexeme (identifiers, single characters) or that hand off
+// to a body reader are resolved in dispatch_dfa instead.
+static const uint8_t accept_type[S_COUNT] = {
+    [S_IDENT] = TOKEN_IDENT,      [S_ZERO] = TOKEN_INTEGER,   [S_INT] = TOKEN_INTEGER,
+    [S_HEX] = TOKEN_INTEGER,      [S_BIN] = TOKEN_INTEGER,    [S_FLOAT] = TOKEN_FLOAT,
+    [S_ILLEGAL] = TOKEN_ILLEGAL,  [S_ASSIGN] = TOKEN_ASSIGN,  [S_EQUAL] = TOKEN_EQUAL,
+    [S_BANG] = TOKEN_BANG,        [S_NOT_EQUAL] = TOKEN_NOT_EQUAL, [S_SLASH] = TOKEN_SLASH,
+};
+
+// The number states waiting for a digit (after '.', '_' or a 0x / 0b prefix)
+// are the only non-accepting ones: "1." falls back to "1", "0x" to "0"
+static const bool accepting[S_COUNT] = {
+    [S_IDENT] = true,  [S_ZERO] = true,   [S_INT] = true,      [S_FLOAT] = true,
+    [S_HEX] = true,    [S_BIN] = true,    [S_SINGLE] = true,   [S_ILLEGAL] = true,
+    [S_ASSIGN] = true, [S_EQUAL] = true,  [S_BANG] = true,     [S_NOT_EQUAL] = true,
+    [S_SLASH] = true,  [S_STRING] = true, [S_LINE_COMMENT] = true, [S_BLOCK_COMMENT] = true,
+};
+
+// Run the DFA from the current position with maximal munch: remember the last
+// accepting state and fall back to it when the machine dies (e.g. "1." not
+// followed by a digit). String and comment openers hand off to body readers.
+static bool dispatch_dfa(Lexer* lexer, Token* token) {
+    uint64_t start = lexer->position;
+    unsigned char first = (unsigned char)*input_at(lexer, start);
+
+    uint8_t state = S_START;
+    uint8_t accepted = S_DEAD;
+    uint64_t accept_end = start;
+    uint64_t pos = start;
+
+    while(state < S_FIRST_HANDOFF && (pos < lexer->input_len || refill(lexer))) {
+        // Pointers are re-derived after every refill since the window moves
+        const unsigned char* from = (const unsigned char*)input_at(lexer, pos);
+        const unsigned char* end = (const unsigned char*)input_at(lexer, lexer->input_len);
+        const unsigned char* p = from;
+
+        while(p < end) {
+            uint8_t next = transitions[state][char_class[*p]];
+            if(next == S_DEAD) {
+                break;
+            }
+            state = next;
+            p++;
+            if(accepting[state]) {
+                accepted = state;
+                accept_end = pos + (uint64_t)(p - from);
             }
-            {
-                char buf[2] = {ch, '\0'};
-                Token* tok = create_token(lexer, TOKEN_ILLEGAL, buf);
-                advance(lexer, 1);
-                return tok;
+            if(state >= S_FIRST_HANDOFF) {
+                break;
             }
+        }
+
+        if(p < end) {
+            break;
+        }
+        pos = lexer->input_len;
+    }
+
+    lexer->position = accept_end;
+
+    switch(accepted) {
+        case S_IDENT:
+            token->type = token_classify_ident(input_at(lexer, start), accept_end - start);
+            return true;
+        case S_SINGLE:
+            token->type = (TokenType)single_type[first];
+            return true;
+        case S_STRING:
+            return read_string_body(lexer, token, (char)first);
+        case S_LINE_COMMENT:
+            return read_line_comment_body(lexer, token);
+        case S_BLOCK_COMMENT:
+            return read_block_comment_body(lexer, token);
+        default:
+            token->type = (TokenType)accept_type[accepted];
+            return true;
     }
 }
 
 // Helper function implementations
 
+// Pull the next chunk from the stream, discarding bytes before keep_from.
+// Returns false once the stream is exhausted (or for resident input).
+static bool refill(Lexer* lexer) {
+    LexerStream* stream = lexer->stream;
+    if(!stream || stream->eof) {
+        return false;
+    }
+
+    // Index the lines of everything about to leave the window
+    index_lines(lexer, lexer->input_len);
+
+    // Slide the bytes still needed to the front of the window
+    size_t keep = (size_t)(lexer->input_len - stream->keep_from);
+    if(keep > 0) {
+        memmove(stream->window, stream->window + (stream->keep_from - lexer->base), keep);
+    }
+    lexer->base = stream->keep_from;
+
+    if(stream->capacity < keep + stream->chunk_size) {
+        size_t capacity = keep + stream->chunk_size;
+        char* window = realloc(stream->window, capacity);
+        if(!window) {
+            stream->eof = true;
+            return false;
+        }
+        stream->window = window;
+        stream->capacity = capacity;
+    }
+
+    size_t got = stream->read(stream->context, stream->window + keep, stream->chunk_size);
+    if(got == 0) {
+        stream->eof = true;
+    }
+
+    lexer->input = stream->window;
+    lexer->input_len = lexer->base + keep + got;
+    return got > 0;
+}
+
+static bool has_more(Lexer* lexer) {
+    return lexer->position < lexer->input_len || refill(lexer);
+}
+
+// Pointer to the byte at an absolute offset; valid until the next refill
+static const char* input_at(Lexer* lexer, uint64_t offset) {
+    return lexer->input + (offset - lexer->base);
+}
+
+// Extend the line index past offset, scanning ahead in LINE_INDEX_STEP pieces
+// so a lexer started mid-file (see lexer_tokenize_parallel) only indexes the
+// part it covers
+static void index_lines(Lexer* lexer, uint64_t offset) {
+    uint64_t end = offset + LINE_INDEX_STEP;
+    if(end > lexer->input_len) {
+        end = lexer->input_len;
+    }
+    if(lexer->lines.scanned < end) {
+        line_index_scan(&lexer->lines, input_at(lexer, lexer->lines.scanned), end);
+    }
+}
+
+// Fill in the token's line and column. Tokens arrive in offset order, so the
+// cursor only ever walks forward and the cost is amortized O(1) per token.
+static void locate_token(Lexer* lexer, Token* token) {
+    if(token->offset >= lexer->lines.scanned) {
+        index_lines(lexer, token->offset);
+    }
+
+    const uint64_t* starts = lexer->lines.starts;
+    size_t cursor = lexer->line_cursor;
+    while(cursor + 1 < lexer->lines.count && starts[cursor + 1] <= token->offset) {
+        cursor++;
+    }
+    lexer->line_cursor = cursor;
+
+    token->line = (uint32_t)(cursor + 1);
+    token->column = (uint32_t)(token->offset - starts[cursor] + 1);
+}
+
+void lexer_location(Lexer* lexer, uint64_t offset, uint32_t* line, uint32_t* column) {
+    if(offset >= lexer->lines.scanned) {
+        index_lines(lexer, offset);
+    }
+    line_index_lookup(&lexer->lines, offset, line, column);
+}
+
+static void report_error(Lexer* lexer, LexerErrorType error, uint64_t offset) {
+    index_lines(lexer, offset);
+    if(lexer->flags & LEXER_QUIET) {
+        return;
+    }
+
+    // A stream only has the current window, so there is no line to show
+    const char* input = lexer->stream ? NULL : lexer->input;
+    lexer_error_print(error, &lexer->lines, offset, input, lexer->input_len,
+                      lexer->source->name);
+}
+
 static char current_char(Lexer* lexer) {
-    if(lexer->position >= lexer->input_len) {
+    if(!has_more(lexer)) {
         return '\0';
     }
-    return lexer->input[lexer->position];
+    return *input_at(lexer, lexer->position);
 }
 
 static char peek_char(Lexer* lexer, size_t offset) {
-    size_t pos = lexer->position + offset;
-    if(pos >= lexer->input_len) {
-        return '\0';
+    uint64_t pos = lexer->position + offset;
+    while(pos >= lexer->input_len) {
+        if(!refill(lexer)) {
+            return '\0';
+        }
     }
-    return lexer->input[pos];
+    return *input_at(lexer, pos);
 }
 
 static void advance(Lexer* lexer, uint32_t count) {
-    for(uint32_t i = 0; i < count && lexer->position < lexer->input_len; i++) {
-        if(lexer->input[lexer->position] == '\n') {
-            lexer->line++;
-            lexer->column = 1;
-        } else {
-            lexer->column++;
-        }
+    for(uint32_t i = 0; i < count && has_more(lexer); i++) {
         lexer->position++;
     }
 }
 
+// Consume everything up to stop (a pointer into the current window) in one step
+static void advance_to(Lexer* lexer, const char* stop) {
+    lexer->position += stop - input_at(lexer, lexer->position);
+}
+
 static void skip_whitespace(Lexer* lexer) {
-    while(lexer->position < lexer->input_len) {
-        char ch = current_char(lexer);
-        if(ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
-            advance(lexer, 1);
-        } else {
+    while(has_more(lexer)) {
+        // Whitespace is never part of a token, so a refill may drop it
+        if(lexer->stream) {
+            lexer->stream->keep_from = lexer->position;
+        }
+
+        const char* end = input_at(lexer, lexer->input_len);
+        const char* stop = lexer->scan->skip_whitespace(input_at(lexer, lexer->position), end);
+        advance_to(lexer, stop);
+        if(stop < end) {
             break;
         }
     }
 }
 
-static int is_ident_char(char c) {
-    return isalnum(c) || c == '_';
-}
-
 static int is_digit(char c) {
     return c >= '0' && c <= '9';
 }
 
-static Token* read_number(Lexer* lexer) {
-    size_t start = lexer->position;
-    uint32_t start_line = lexer->line;
-    uint32_t start_column = lexer->column;
-    int has_decimal = 0;
+static int is_hex_digit(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
 
-    // Read integer part
-    while(is_digit(current_char(lexer))) {
-        advance(lexer, 1);
+static int is_binary_digit(char c) {
+    return c == '0' || c == '1';
+}
+
+// Consume a run of digits; a '_' is part of the run only between two digits
+static void read_digits(Lexer* lexer, int (*is_valid)(char)) {
+    for(;;) {
+        if(is_valid(current_char(lexer))) {
+            advance(lexer, 1);
+        } else if(current_char(lexer) == '_' && is_valid(peek_char(lexer, 1))) {
+            advance(lexer, 2);
+        } else {
+            break;
+        }
     }
+}
 
-    // Check for decimal point
-    if(current_char(lexer) == '.' && is_digit(peek_char(lexer, 1))) {
-        has_decimal = 1;
-        advance(lexer, 1);  // consume '.'
+static bool read_number(Lexer* lexer, Token* token) {
+    token->type = TOKEN_INTEGER;
 
-        // Read decimal part
-        while(is_digit(current_char(lexer))) {
-            advance(lexer, 1);
+    // A 0x / 0b prefix only counts when a digit of that base follows it
+    if(current_char(lexer) == '0') {
+        char prefix = peek_char(lexer, 1);
+        if((prefix == 'x' || prefix == 'X') && is_hex_digit(peek_char(lexer, 2))) {
+            advance(lexer, 2);
+            read_digits(lexer, is_hex_digit);
+            return true;
+        }
+        if((prefix == 'b' || prefix == 'B') && is_binary_digit(peek_char(lexer, 2))) {
+            advance(lexer, 2);
+            read_digits(lexer, is_binary_digit);
+            return true;
         }
     }
 
-    size_t len = lexer->position - start;
-    char* num_str = strndup(lexer->input + start, len);
+    // Read integer part
+    read_digits(lexer, is_digit);
+
+    // Check for decimal point
+    if(current_char(lexer) == '.' && is_digit(peek_char(lexer, 1))) {
+        advance(lexer, 1);  // consume '.'
+        read_digits(lexer, is_digit);
+        token->type = TOKEN_FLOAT;
+    }
 
-    Token* token = token_create(has_decimal ? TOKEN_FLOAT : TOKEN_INTEGER, num_str, start_line,
-                                start_column, lexer->file_name, lexer->file_directory);
-    free(num_str);
-    return token;
+    return true;
 }
 
-static Token* read_string(Lexer* lexer) {
+static bool read_string(Lexer* lexer, Token* token) {
     char quote = current_char(lexer);
-    uint32_t start_line = lexer->line;
-    uint32_t start_column = lexer->column;
 
     advance(lexer, 1);  // Skip opening quote
+    return read_string_body(lexer, token, quote);
+}
 
-    char* buffer = malloc(256);
-    size_t capacity = 256;
-    size_t len = 0;
-
-    while(lexer->position < lexer->input_len) {
-        char ch = current_char(lexer);
-
-        if(ch == quote) {
-            advance(lexer, 1);  // Skip closing quote
-            buffer[len] = '\0';
-
-            Token* token = token_create(TOKEN_STRING, buffer, start_line, start_column,
-                                        lexer->file_name, lexer->file_directory);
-            return token;
+static bool read_string_body(Lexer* lexer, Token* token, char quote) {
+    // Jump from one quote or backslash to the next. Escapes are only validated
+    // here; decoding happens when the value is built from the slice.
+    while(has_more(lexer)) {
+        const char* from = input_at(lexer, lexer->position);
+        const char* end = input_at(lexer, lexer->input_len);
+        const char* stop = lexer->scan->find_either(from, end, quote, '\\');
+        lexer->position += stop - from;
+        if(stop == end) {
+            continue;
         }
 
-        if(ch == '\\') {
-            advance(lexer, 1);
-            if(lexer->position >= lexer->input_len) {
-                free(buffer);
-                lexer_error_print(LEXER_ERROR_INVALID_ESCAPE, lexer->line, lexer->column,
-                                  lexer->input, lexer->file_name);
-                return NULL;
-            }
-
-            char escaped = current_char(lexer);
-            switch(escaped) {
-                case 'n':
-                    ch = '\n';
-                    break;
-                case 't':
-                    ch = '\t';
-                    break;
-                case 'r':
-                    ch = '\r';
-                    break;
-                case '\\':
-                    ch = '\\';
-                    break;
-                case '"':
-                    ch = '"';
-                    break;
-                case '\'':
-                    ch = '\'';
-                    break;
-                default:
-                    free(buffer);
-                    lexer_error_print(LEXER_ERROR_INVALID_ESCAPE, lexer->line, lexer->column,
-                                      lexer->input, lexer->file_name);
-                    return NULL;
-            }
+        char hit = *stop;
+        advance(lexer, 1);  // Skip the quote or backslash
+        if(hit == quote) {
+            token->type = TOKEN_STRING;
+            return true;
         }
 
-        if(len >= capacity - 1) {
-            capacity *= 2;
-            buffer = realloc(buffer, capacity);
+        if(!has_more(lexer) || !token_unescape(current_char(lexer))) {
+            report_error(lexer, LEXER_ERROR_INVALID_ESCAPE, lexer->position);
+            return false;
         }
-
-        buffer[len++] = ch;
         advance(lexer, 1);
     }
 
-    free(buffer);
-    lexer_error_print(LEXER_ERROR_UNTERMINATED_STRING, lexer->line, lexer->column, lexer->input,
-                      lexer->file_name);
-    return NULL;
+    report_error(lexer, LEXER_ERROR_UNTERMINATED_STRING, lexer->position);
+    return false;
 }
 
-static Token* read_identifier(Lexer* lexer) {
-    size_t start = lexer->position;
-    uint32_t start_line = lexer->line;
-    uint32_t start_column = lexer->column;
+static bool read_identifier(Lexer* lexer, Token* token) {
+    uint64_t start = lexer->position;
 
-    while(is_ident_char(current_char(lexer))) {
-        advance(lexer, 1);
-    }
-
-    size_t len = lexer->position - start;
-    char* ident = strndup(lexer->input + start, len);
-
-    // Check if it's a keyword
-    TokenType type = token_lookup_keyword(ident);
-
-    // Check if it's a type keyword
-    if(type == TOKEN_IDENT && token_is_type_keyword(ident)) {
-        type = TOKEN_TYPE;
+    while(has_more(lexer)) {
+        const char* from = input_at(lexer, lexer->position);
+        const char* end = input_at(lexer, lexer->input_len);
+        const char* stop = lexer->scan->skip_identifier(from, end);
+        lexer->position += stop - from;
+        if(stop < end) {
+            break;
+        }
     }
 
-    Token* token = token_create(type, ident, start_line, start_column, lexer->file_name,
-                                lexer->file_directory);
-    free(ident);
-
-    return token;
+    // Keyword, type keyword or plain identifier, straight from the input slice
+    token->type = token_classify_ident(input_at(lexer, start), lexer->position - start);
+    return true;
 }
 
-static Token* read_slash_or_comment(Lexer* lexer) {
-    uint32_t start_line = lexer->line;
-    uint32_t start_column = lexer->column;
-
+static bool read_slash_or_comment(Lexer* lexer, Token* token) {
     // Single-line comment
     if(peek_char(lexer, 1) == '/') {
         advance(lexer, 2);  // consume '//'
-        size_t comment_start = lexer->position;
-
-        while(current_char(lexer) != '\n' && lexer->position < lexer->input_len) {
-            advance(lexer, 1);
-        }
-
-        size_t len = lexer->position - comment_start;
-        char* comment = strndup(lexer->input + comment_start, len);
-
-        Token* token = token_create(TOKEN_COMMENT, comment, start_line, start_column,
-                                    lexer->file_name, lexer->file_directory);
-        return token;
+        return read_line_comment_body(lexer, token);
     }
 
     // Multi-line comment
     if(peek_char(lexer, 1) == '*') {
         advance(lexer, 2);  // consume '/*'
-        size_t comment_start = lexer->position;
+        return read_block_comment_body(lexer, token);
+    }
 
-        while(lexer->position < lexer->input_len) {
-            if(current_char(lexer) == '*' && peek_char(lexer, 1) == '/') {
-                size_t len = lexer->position - comment_start;
-                char* comment = strndup(lexer->input + comment_start, len);
+    // Standalone '/'
+    return read_operator(lexer, token, TOKEN_SLASH, 1);
+}
 
-                advance(lexer, 2);  // consume '*/'
+static bool read_line_comment_body(Lexer* lexer, Token* token) {
+    // Runs to the next newline, which is left for skip_whitespace
+    while(has_more(lexer)) {
+        const char* from = input_at(lexer, lexer->position);
+        const char* end = input_at(lexer, lexer->input_len);
+        const char* stop = lexer->scan->find_byte(from, end, '\n');
+        lexer->position += stop - from;
+        if(stop < end) {
+            break;
+        }
+    }
 
-                Token* token = token_create(TOKEN_COMMENT, comment, start_line, start_column,
-                                            lexer->file_name, lexer->file_directory);
-                return token;
-            }
-            advance(lexer, 1);
+    token->type = TOKEN_COMMENT;
+    return true;
+}
+
+static bool read_block_comment_body(Lexer* lexer, Token* token) {
+    while(has_more(lexer)) {
+        // Jump to the next '*' candidate
+        const char* end = input_at(lexer, lexer->input_len);
+        const char* star = lexer->scan->find_byte(input_at(lexer, lexer->position), end, '*');
+        advance_to(lexer, star);
+        if(star == end) {
+            continue;
         }
 
-        lexer_error_print(LEXER_ERROR_UNTERMINATED_COMMENT, lexer->line, lexer->column,
-                          lexer->input, lexer->file_name);
-        return NULL;
+        if(peek_char(lexer, 1) == '/') {
+            advance(lexer, 2);  // consume '*/'
+            token->type = TOKEN_COMMENT;
+            return true;
+        }
+        advance(lexer, 1);
     }
 
-    // Standalone '/'
-    Token* tok = create_token(lexer, TOKEN_SLASH, "/");
-    advance(lexer, 1);
-    return tok;
+    report_error(lexer, LEXER_ERROR_UNTERMINATED_COMMENT, lexer->position);
+    return false;
 }
 
-static Token* create_token(Lexer* lexer, TokenType type, const char* value) {
-    return token_create(type, value, lexer->line, lexer->column, lexer->file_name,
-                        lexer->file_directory);
+static bool read_operator(Lexer* lexer, Token* token, TokenType type, uint32_t width) {
+    token->type = type;
+    advance(lexer, width);
+    return true;
 }
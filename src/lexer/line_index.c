@@ -0,0 +1,114 @@
+#include "../../include/line_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/scan.h"
+
+#define INITIAL_LINE_CAPACITY 256
+
+bool line_index_init(LineIndex* index) {
+    index->starts = malloc(sizeof(uint64_t) * INITIAL_LINE_CAPACITY);
+    if(!index->starts)
+        return false;
+
+    index->starts[0] = 0;
+    index->count = 1;
+    index->capacity = INITIAL_LINE_CAPACITY;
+    index->scanned = 0;
+    return true;
+}
+
+void line_index_free(LineIndex* index) {
+    free(index->starts);
+    index->starts = NULL;
+    index->count = 0;
+    index->capacity = 0;
+    index->scanned = 0;
+}
+
+// Make room for one more line start
+static bool reserve_line(LineIndex* index) {
+    if(index->count < index->capacity)
+        return true;
+
+    size_t capacity = index->capacity * 2;
+    uint64_t* starts = realloc(index->starts, sizeof(uint64_t) * capacity);
+    if(!starts)
+        return false;
+    index->starts = starts;
+    index->capacity = capacity;
+    return true;
+}
+
+bool line_index_scan(LineIndex* index, const char* text, uint64_t end) {
+    const ScanKernels* scan = scan_kernels();
+    const char* from = text;
+    const char* stop = text + (end - index->scanned);
+
+    // Vectorized search from one newline to the next
+    while((from = scan->find_byte(from, stop, '\n')) < stop) {
+        if(!reserve_line(index))
+            return false;
+        from++;
+        index->starts[index->count++] = index->scanned + (uint64_t)(from - text);
+    }
+
+    index->scanned = end;
+    return true;
+}
+
+bool line_index_note(LineIndex* index, uint32_t line, uint64_t start) {
+    while(index->count < line) {
+        if(!reserve_line(index))
+            return false;
+        index->starts[index->count++] = start;
+    }
+    return true;
+}
+
+bool line_index_splice(LineIndex* index, size_t from, size_t to, const uint64_t* starts,
+                       size_t count, int64_t delta) {
+    size_t tail = index->count - to;
+    size_t total = from + count + tail;
+    if(total > index->capacity) {
+        size_t capacity = index->capacity;
+        while(capacity < total) {
+            capacity *= 2;
+        }
+        uint64_t* grown = realloc(index->starts, sizeof(uint64_t) * capacity);
+        if(!grown)
+            return false;
+        index->starts = grown;
+        index->capacity = capacity;
+    }
+
+    uint64_t* moved = index->starts + from + count;
+    memmove(moved, index->starts + to, sizeof(uint64_t) * tail);
+    if(count > 0) {
+        memcpy(index->starts + from, starts, sizeof(uint64_t) * count);
+    }
+    for(size_t i = 0; i < tail; i++) {
+        moved[i] = (uint64_t)((int64_t)moved[i] + delta);
+    }
+    index->count = total;
+    return true;
+}
+
+void line_index_lookup(const LineIndex* index, uint64_t offset, uint32_t* line,
+                       uint32_t* column) {
+    // Last line start at or before offset
+    size_t low = 0;
+    size_t high = index->count;
+    while(high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if(index->starts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    *line = (uint32_t)(low + 1);
+    *column = (uint32_t)(offset - index->starts[low] + 1);
+}
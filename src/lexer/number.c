@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/number.h"
+
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int digit_value(char c) {
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+NumberStatus number_parse_int(const char* text, size_t len, int64_t* value) {
+    unsigned base = 10;
+    size_t i = 0;
+    if(len > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        i = 2;
+    } else if(len > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B')) {
+        base = 2;
+        i = 2;
+    }
+
+    uint64_t result = 0;
+    bool any = false;
+    for(; i < len; i++) {
+        if(text[i] == '_')
+            continue;
+        int digit = digit_value(text[i]);
+        if(digit < 0 || (unsigned)digit >= base)
+            return NUMBER_INVALID;
+        if(result > ((uint64_t)INT64_MAX - (uint64_t)digit) / base)
+            return NUMBER_OVERFLOW;
+        result = result * base + (uint64_t)digit;
+        any = true;
+    }
+    if(!any)
+        return NUMBER_INVALID;
+
+    *value = (int64_t)result;
+    return NUMBER_OK;
+}
+
+// ===== Floats =====
+
+// Decimal digits that always fit in a uint64 mantissa
+#define MAX_MANTISSA_DIGITS 19
+
+// Range of decimal exponents handled by the fast paths below
+#define MIN_FAST_EXPONENT -27
+#define MAX_FAST_EXPONENT 27
+
+// 128-bit approximations of 5^q, normalized so the top bit is set: exact
+// (truncated) for q >= 0, rounded up for q < 0 as Eisel-Lemire requires
+static const uint64_t powers_of_five[][2] = {
+    {0x9e74d1b791e07e48u, 0x775ea264cf55347eu},  // 5^-27
+    {0xc612062576589ddau, 0x95364afe032a819eu},  // 5^-26
+    {0xf79687aed3eec551u, 0x3a83ddbd83f52205u},  // 5^-25
+    {0x9abe14cd44753b52u, 0xc4926a9672793543u},  // 5^-24
+    {0xc16d9a0095928a27u, 0x75b7053c0f178294u},  // 5^-23
+    {0xf1c90080baf72cb1u, 0x5324c68b12dd6339u},  // 5^-22
+    {0x971da05074da7beeu, 0xd3f6fc16ebca5e04u},  // 5^-21
+    {0xbce5086492111aeau, 0x88f4bb1ca6bcf585u},  // 5^-20
+    {0xec1e4a7db69561a5u, 0x2b31e9e3d06c32e6u},  // 5^-19
+    {0x9392ee8e921d5d07u, 0x3aff322e62439fd0u},  // 5^-18
+    {0xb877aa3236a4b449u, 0x09befeb9fad487c3u},  // 5^-17
+    {0xe69594bec44de15bu, 0x4c2ebe687989a9b4u},  // 5^-16
+    {0x901d7cf73ab0acd9u, 0x0f9d37014bf60a11u},  // 5^-15
+    {0xb424dc35095cd80fu, 0x538484c19ef38c95u},  // 5^-14
+    {0xe12e13424bb40e13u, 0x2865a5f206b06fbau},  // 5^-13
+    {0x8cbccc096f5088cbu, 0xf93f87b7442e45d4u},  // 5^-12
+    {0xafebff0bcb24aafeu, 0xf78f69a51539d749u},  // 5^-11
+    {0xdbe6fecebdedd5beu, 0xb573440e5a884d1cu},  // 5^-10
+    {0x89705f4136b4a597u, 0x31680a88f8953031u},  // 5^-9
+    {0xabcc77118461cefcu, 0xfdc20d2b36ba7c3eu},  // 5^-8
+    {0xd6bf94d5e57a42bcu, 0x3d32907604691b4du},  // 5^-7
+    {0x8637bd05af6c69b5u, 0xa63f9a49c2c1b110u},  // 5^-6
+    {0xa7c5ac471b478423u, 0x0fcf80dc33721d54u},  // 5^-5
+    {0xd1b71758e219652bu, 0xd3c36113404ea4a9u},  // 5^-4
+    {0x83126e978d4fdf3bu, 0x645a1cac083126eau},  // 5^-3
+    {0xa3d70a3d70a3d70au, 0x3d70a3d70a3d70a4u},  // 5^-2
+    {0xccccccccccccccccu, 0xcccccccccccccccdu},  // 5^-1
+    {0x8000000000000000u, 0x0000000000000000u},  // 5^0
+    {0xa000000000000000u, 0x0000000000000000u},  // 5^1
+    {0xc800000000000000u, 0x0000000000000000u},  // 5^2
+    {0xfa00000000000000u, 0x0000000000000000u},  // 5^3
+    {0x9c40000000000000u, 0x0000000000000000u},  // 5^4
+    {0xc350000000000000u, 0x0000000000000000u},  // 5^5
+    {0xf424000000000000u, 0x0000000000000000u},  // 5^6
+    {0x9896800000000000u, 0x0000000000000000u},  // 5^7
+    {0xbebc200000000000u, 0x0000000000000000u},  // 5^8
+    {0xee6b280000000000u, 0x0000000000000000u},  // 5^9
+    {0x9502f90000000000u, 0x0000000000000000u},  // 5^10
+    {0xba43b74000000000u, 0x0000000000000000u},  // 5^11
+    {0xe8d4a51000000000u, 0x0000000000000000u},  // 5^12
+    {0x9184e72a00000000u, 0x0000000000000000u},  // 5^13
+    {0xb5e620f480000000u, 0x0000000000000000u},  // 5^14
+    {0xe35fa931a0000000u, 0x0000000000000000u},  // 5^15
+    {0x8e1bc9bf04000000u, 0x0000000000000000u},  // 5^16
+    {0xb1a2bc2ec5000000u, 0x0000000000000000u},  // 5^17
+    {0xde0b6b3a76400000u, 0x0000000000000000u},  // 5^18
+    {0x8ac7230489e80000u, 0x0000000000000000u},  // 5^19
+    {0xad78ebc5ac620000u, 0x0000000000000000u},  // 5^20
+    {0xd8d726b7177a8000u, 0x0000000000000000u},  // 5^21
+    {0x878678326eac9000u, 0x0000000000000000u},  // 5^22
+    {0xa968163f0a57b400u, 0x0000000000000000u},  // 5^23
+    {0xd3c21bcecceda100u, 0x0000000000000000u},  // 5^24
+    {0x84595161401484a0u, 0x0000000000000000u},  // 5^25
+    {0xa56fa5b99019a5c8u, 0x0000000000000000u},  // 5^26
+    {0xcecb8f27f4200f3au, 0x0000000000000000u},  // 5^27
+};
+
+static const double exact_powers_of_ten[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                             1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                             1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Eisel-Lemire: w * 10^q correctly rounded, for w != 0 and q in the fast
+// range. Returns false when the truncated product cannot decide the rounding,
+// in which case the caller must use the slow path.
+static bool eisel_lemire(uint64_t w, int q, double* value) {
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+
+    const uint64_t* power = powers_of_five[q - MIN_FAST_EXPONENT];
+    unsigned __int128 first = (unsigned __int128)w * power[0];
+    unsigned __int128 second = (unsigned __int128)w * power[1];
+    uint64_t high = (uint64_t)(first >> 64);
+    uint64_t low = (uint64_t)first;
+    uint64_t carry = (uint64_t)(second >> 64);
+    low += carry;
+    if(low < carry) {
+        high++;
+    }
+
+    // Keep 54 bits (53 + a rounding bit); the rest only decide ties. The
+    // product is low by less than 2 units of low, so refuse when the dropped
+    // bits are too close to zero or to a carry.
+    int upperbit = (int)(high >> 63);
+    int shift = upperbit + 64 - 52 - 3;
+    uint64_t dropped_mask = ((uint64_t)1 << shift) - 1;
+    uint64_t dropped = high & dropped_mask;
+    if((dropped == 0 && low <= 2) || (dropped == dropped_mask && low >= UINT64_MAX - 1)) {
+        return false;
+    }
+
+    uint64_t mantissa = high >> shift;
+    int64_t power2 = (((152170 + 65536) * (int64_t)q) >> 16) + 63 + upperbit - lz + 1023;
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if(mantissa >= ((uint64_t)2 << 52)) {
+        mantissa = (uint64_t)1 << 52;
+        power2++;
+    }
+    mantissa &= ~((uint64_t)1 << 52);
+
+    uint64_t bits = mantissa | ((uint64_t)power2 << 52);
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+}
+
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+static locale_t c_locale;
+
+static void create_c_locale(void) {
+    c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+
+// Exact fallback: strtod in the C locale on the digits without separators
+static NumberStatus parse_float_slow(const char* text, size_t len, double* value) {
+    char small[128];
+    char* digits = len < sizeof(small) ? small : malloc(len + 1);
+    if(!digits)
+        return NUMBER_INVALID;
+
+    size_t n = 0;
+    for(size_t i = 0; i < len; i++) {
+        if(text[i] != '_') {
+            digits[n++] = text[i];
+        }
+    }
+    digits[n] = '\0';
+
+    pthread_once(&c_locale_once, create_c_locale);
+    locale_t previous = c_locale ? uselocale(c_locale) : (locale_t)0;
+    char* end;
+    double result = strtod(digits, &end);
+    if(c_locale) {
+        uselocale(previous);
+    }
+
+    bool complete = (size_t)(end - digits) == n;
+    if(digits != small) {
+        free(digits);
+    }
+    if(!complete)
+        return NUMBER_INVALID;
+    if(isinf(result))
+        return NUMBER_OVERFLOW;
+
+    *value = result;
+    return NUMBER_OK;
+}
+
+NumberStatus number_parse_float(const char* text, size_t len, double* value) {
+    // Collect up to MAX_MANTISSA_DIGITS significant digits as w * 10^q
+    uint64_t w = 0;
+    int digits = 0;
+    int q = 0;
+    bool seen_dot = false;
+    bool truncated = false;
+    for(size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if(c == '_')
+            continue;
+        if(c == '.') {
+            seen_dot = true;
+            continue;
+        }
+        if(c < '0' || c > '9')
+            return NUMBER_INVALID;
+        if(digits == 0 && c == '0') {
+            q -= seen_dot;  // Leading zeros only move the point
+            continue;
+        }
+        if(digits < MAX_MANTISSA_DIGITS) {
+            w = w * 10 + (uint64_t)(c - '0');
+            digits++;
+            q -= seen_dot;
+        } else {
+            truncated = true;
+            q += !seen_dot;
+        }
+    }
+
+    if(w == 0 && !truncated) {
+        *value = 0.0;
+        return NUMBER_OK;
+    }
+
+    if(!truncated) {
+        // Clinger's fast path: both operands exact, so one operation rounds once
+        if(w <= ((uint64_t)1 << 53) && q >= -22 && q <= 22) {
+            double d = (double)w;
+            *value = q < 0 ? d / exact_powers_of_ten[-q] : d * exact_powers_of_ten[q];
+            return NUMBER_OK;
+        }
+        if(q >= MIN_FAST_EXPONENT && q <= MAX_FAST_EXPONENT && eisel_lemire(w, q, value)) {
+            return NUMBER_OK;
+        }
+    }
+
+    return parse_float_slow(text, len, value);
+}
@@ -0,0 +1,312 @@
+#include "../../include/scan.h"
+
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// ===== Scalar =====
+
+static inline bool is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool is_ident(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static const char* scalar_skip_whitespace(const char* p, const char* end) {
+    while(p < end && is_space((unsigned char)*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char* scalar_skip_identifier(const char* p, const char* end) {
+    while(p < end && is_ident((unsigned char)*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char* scalar_find_byte(const char* p, const char* end, char c) {
+    while(p < end && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+static const char* scalar_find_either(const char* p, const char* end, char a, char b) {
+    while(p < end && *p != a && *p != b) {
+        p++;
+    }
+    return p;
+}
+
+static size_t scalar_count_newlines(const char* p, const char* end, const char** last) {
+    size_t count = 0;
+    for(; p < end; p++) {
+        if(*p == '\n') {
+            count++;
+            *last = p;
+        }
+    }
+    return count;
+}
+
+static const ScanKernels scalar_kernels = {
+    .level = SCAN_SCALAR,
+    .name = "scalar",
+    .skip_whitespace = scalar_skip_whitespace,
+    .skip_identifier = scalar_skip_identifier,
+    .find_byte = scalar_find_byte,
+    .find_either = scalar_find_either,
+    .count_newlines = scalar_count_newlines,
+};
+
+#ifdef SCAN_X86
+
+// ===== SSE2 (16 bytes per step) =====
+
+static inline unsigned sse2_space_mask(__m128i v) {
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    return (unsigned)_mm_movemask_epi8(ws);
+}
+
+// Signed byte compares: bytes >= 0x80 are negative and fall outside every range
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+}
+
+static inline unsigned sse2_ident_mask(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i id = _mm_or_si128(
+        _mm_or_si128(sse2_in_range(lower, 'a', 'z'), sse2_in_range(v, '0', '9')),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    return (unsigned)_mm_movemask_epi8(id);
+}
+
+static const char* sse2_skip_whitespace(const char* p, const char* end) {
+    while(end - p >= 16) {
+        unsigned stop = ~sse2_space_mask(_mm_loadu_si128((const __m128i*)p)) & 0xFFFF;
+        if(stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 16;
+    }
+    return scalar_skip_whitespace(p, end);
+}
+
+static const char* sse2_skip_identifier(const char* p, const char* end) {
+    while(end - p >= 16) {
+        unsigned stop = ~sse2_ident_mask(_mm_loadu_si128((const __m128i*)p)) & 0xFFFF;
+        if(stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 16;
+    }
+    return scalar_skip_identifier(p, end);
+}
+
+static const char* sse2_find_byte(const char* p, const char* end, char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    while(end - p >= 16) {
+        unsigned hit =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), needle));
+        if(hit) {
+            return p + __builtin_ctz(hit);
+        }
+        p += 16;
+    }
+    return scalar_find_byte(p, end, c);
+}
+
+static const char* sse2_find_either(const char* p, const char* end, char a, char b) {
+    __m128i first = _mm_set1_epi8(a);
+    __m128i second = _mm_set1_epi8(b);
+    while(end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned hit = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, first), _mm_cmpeq_epi8(v, second)));
+        if(hit) {
+            return p + __builtin_ctz(hit);
+        }
+        p += 16;
+    }
+    return scalar_find_either(p, end, a, b);
+}
+
+static size_t sse2_count_newlines(const char* p, const char* end, const char** last) {
+    __m128i nl = _mm_set1_epi8('\n');
+    size_t count = 0;
+    while(end - p >= 16) {
+        unsigned hit =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), nl));
+        if(hit) {
+            count += __builtin_popcount(hit);
+            *last = p + (31 - __builtin_clz(hit));
+        }
+        p += 16;
+    }
+    return count + scalar_count_newlines(p, end, last);
+}
+
+static const ScanKernels sse2_kernels = {
+    .level = SCAN_SSE2,
+    .name = "sse2",
+    .skip_whitespace = sse2_skip_whitespace,
+    .skip_identifier = sse2_skip_identifier,
+    .find_byte = sse2_find_byte,
+    .find_either = sse2_find_either,
+    .count_newlines = sse2_count_newlines,
+};
+
+// ===== AVX2 (32 bytes per step) =====
+
+#define AVX2_TARGET __attribute__((target("avx2,popcnt")))
+
+AVX2_TARGET static inline uint32_t avx2_space_mask(__m256i v) {
+    __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                 _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+    return (uint32_t)_mm256_movemask_epi8(ws);
+}
+
+AVX2_TARGET static inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), v));
+}
+
+AVX2_TARGET static inline uint32_t avx2_ident_mask(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i id = _mm256_or_si256(
+        _mm256_or_si256(avx2_in_range(lower, 'a', 'z'), avx2_in_range(v, '0', '9')),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    return (uint32_t)_mm256_movemask_epi8(id);
+}
+
+AVX2_TARGET static const char* avx2_skip_whitespace(const char* p, const char* end) {
+    while(end - p >= 32) {
+        uint32_t stop = ~avx2_space_mask(_mm256_loadu_si256((const __m256i*)p));
+        if(stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 32;
+    }
+    return sse2_skip_whitespace(p, end);
+}
+
+AVX2_TARGET static const char* avx2_skip_identifier(const char* p, const char* end) {
+    while(end - p >= 32) {
+        uint32_t stop = ~avx2_ident_mask(_mm256_loadu_si256((const __m256i*)p));
+        if(stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 32;
+    }
+    return sse2_skip_identifier(p, end);
+}
+
+AVX2_TARGET static const char* avx2_find_byte(const char* p, const char* end, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    while(end - p >= 32) {
+        uint32_t hit = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), needle));
+        if(hit) {
+            return p + __builtin_ctz(hit);
+        }
+        p += 32;
+    }
+    return sse2_find_byte(p, end, c);
+}
+
+AVX2_TARGET static const char* avx2_find_either(const char* p, const char* end, char a,
+                                                char b) {
+    __m256i first = _mm256_set1_epi8(a);
+    __m256i second = _mm256_set1_epi8(b);
+    while(end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        uint32_t hit = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, first), _mm256_cmpeq_epi8(v, second)));
+        if(hit) {
+            return p + __builtin_ctz(hit);
+        }
+        p += 32;
+    }
+    return sse2_find_either(p, end, a, b);
+}
+
+AVX2_TARGET static size_t avx2_count_newlines(const char* p, const char* end, const char** last) {
+    __m256i nl = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    while(end - p >= 32) {
+        uint32_t hit = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), nl));
+        if(hit) {
+            count += __builtin_popcount(hit);
+            *last = p + (31 - __builtin_clz(hit));
+        }
+        p += 32;
+    }
+    return count + sse2_count_newlines(p, end, last);
+}
+
+static const ScanKernels avx2_kernels = {
+    .level = SCAN_AVX2,
+    .name = "avx2",
+    .skip_whitespace = avx2_skip_whitespace,
+    .skip_identifier = avx2_skip_identifier,
+    .find_byte = avx2_find_byte,
+    .find_either = avx2_find_either,
+    .count_newlines = avx2_count_newlines,
+};
+
+#endif  // SCAN_X86
+
+// ===== Dispatch =====
+
+static const ScanKernels* selected = NULL;
+
+static const ScanKernels* kernels_for(ScanLevel level) {
+    switch(level) {
+        case SCAN_SCALAR:
+            return &scalar_kernels;
+#ifdef SCAN_X86
+        case SCAN_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+        case SCAN_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")
+                       ? &avx2_kernels
+                       : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+const ScanKernels* scan_kernels(void) {
+    if(!selected) {
+        ScanLevel levels[] = {SCAN_AVX2, SCAN_SSE2, SCAN_SCALAR};
+        for(size_t i = 0; !selected && i < sizeof(levels) / sizeof(levels[0]); i++) {
+            selected = kernels_for(levels[i]);
+        }
+    }
+    return selected;
+}
+
+bool scan_select(ScanLevel level) {
+    const ScanKernels* kernels = kernels_for(level);
+    if(!kernels)
+        return false;
+    selected = kernels;
+    return true;
+}
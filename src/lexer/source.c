@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../../include/source.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Shared text for empty mapped files, which have nothing to map
+static const char empty_text[] = "";
+
+static SourceFile* source_file_alloc(const char* name, const char* directory) {
+    SourceFile* source = malloc(sizeof(SourceFile));
+    if(!source)
+        return NULL;
+
+    source->text = NULL;
+    source->length = 0;
+    source->name = strdup(name ? name : "unknown");
+    source->directory = strdup(directory ? directory : ".");
+    source->refcount = 1;
+    source->mapped = false;
+    return source;
+}
+
+SourceFile* source_file_create(const char* text, uint64_t length, const char* name,
+                               const char* directory) {
+    SourceFile* source = source_file_alloc(name, directory);
+    if(!source)
+        return NULL;
+
+    char* copy = malloc(length + 1);
+    if(!copy) {
+        source_file_release(source);
+        return NULL;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    source->text = copy;
+    source->length = length;
+    return source;
+}
+
+SourceFile* source_file_map(const char* path) {
+    // Split path into the file name and its directory
+    const char* slash = strrchr(path, '/');
+    char* directory = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : NULL;
+
+    SourceFile* source = source_file_alloc(slash ? slash + 1 : path, directory);
+    free(directory);
+    if(!source)
+        return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        source_file_release(source);
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        source_file_release(source);
+        return NULL;
+    }
+
+    // mmap rejects zero-length mappings; an empty file is just empty text
+    if(st.st_size == 0) {
+        close(fd);
+        source->text = empty_text;
+        return source;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        source_file_release(source);
+        return NULL;
+    }
+    posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    source->text = data;
+    source->length = (uint64_t)st.st_size;
+    source->mapped = true;
+    return source;
+}
+
+SourceFile* source_file_retain(SourceFile* source) {
+    if(source)
+        source->refcount++;
+    return source;
+}
+
+void source_file_release(SourceFile* source) {
+    if(!source || --source->refcount > 0)
+        return;
+
+    if(source->mapped) {
+        munmap((void*)source->text, (size_t)source->length);
+    } else if(source->text != empty_text) {
+        free((char*)source->text);
+    }
+    free(source->name);
+    free(source->directory);
+    free(source);
+}
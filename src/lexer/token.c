@@ -46,20 +46,97 @@ static const char* token_type_strings[] = {
     [TOKEN_TYPE] = "TYPE",
 };
 
-Token* token_create(TokenType type, const char* value, uint32_t line, uint32_t column,
-                    const char* file_name, const char* file_directory) {
-    // INFO: Always duplicate in token_create
+static const char* token_lexemes[] = {
+    [TOKEN_EOF] = "",
+    [TOKEN_ASSIGN] = "=",
+    [TOKEN_PLUS] = "+",
+    [TOKEN_MINUS] = "-",
+    [TOKEN_ASTERISK] = "*",
+    [TOKEN_SLASH] = "/",
+    [TOKEN_BANG] = "!",
+    [TOKEN_EQUAL] = "==",
+    [TOKEN_NOT_EQUAL] = "!=",
+    [TOKEN_LESS_THAN] = "<",
+    [TOKEN_GREATER_THAN] = ">",
+    [TOKEN_COMMA] = ",",
+    [TOKEN_SEMICOLON] = ";",
+    [TOKEN_COLON] = ":",
+    [TOKEN_LPAREN] = "(",
+    [TOKEN_RPAREN] = ")",
+    [TOKEN_LBRACE] = "{",
+    [TOKEN_RBRACE] = "}",
+    [TOKEN_LBRACKET] = "[",
+    [TOKEN_RBRACKET] = "]",
+    [TOKEN_ABEG] = "abeg",
+    [TOKEN_OYA] = "oya",
+    [TOKEN_WAKA] = "waka",
+    [TOKEN_COMOT] = "comot",
+    [TOKEN_ABI] = "abi",
+    [TOKEN_NASO] = "naso",
+    [TOKEN_TRUE] = "true",
+    [TOKEN_FALSE] = "false",
+    [TOKEN_AND] = "and",
+    [TOKEN_OR] = "or",
+    [TOKEN_OR_ELSE] = "orelse",
+};
+
+// Keywords and type keywords live in a 64-slot table indexed by a perfect hash
+// of (length, first char, last char). The constants were searched offline so
+// that no two of the 19 words share a slot; a lookup is one hash plus one
+// memcmp to confirm the match.
+#define KEYWORD_TABLE_SIZE 64
+#define KEYWORD_MAX_LEN 9
+#define KEYWORD_HASH(len, first, last) \
+    ((((size_t)(len) + (first)) * 3 + (size_t)(last) * 5) & (KEYWORD_TABLE_SIZE - 1))
+#define KEYWORD(word, first, last, type) \
+    [KEYWORD_HASH(sizeof(word) - 1, first, last)] = {word, sizeof(word) - 1, type}
+
+typedef struct {
+    const char* word;
+    uint8_t len;
+    uint8_t type;
+} KeywordEntry;
+
+static const KeywordEntry keyword_table[KEYWORD_TABLE_SIZE] = {
+    KEYWORD("abeg", 'a', 'g', TOKEN_ABEG),
+    KEYWORD("oya", 'o', 'a', TOKEN_OYA),
+    KEYWORD("waka", 'w', 'a', TOKEN_WAKA),
+    KEYWORD("comot", 'c', 't', TOKEN_COMOT),
+    KEYWORD("abi", 'a', 'i', TOKEN_ABI),
+    KEYWORD("naso", 'n', 'o', TOKEN_NASO),
+    KEYWORD("true", 't', 'e', TOKEN_TRUE),
+    KEYWORD("false", 'f', 'e', TOKEN_FALSE),
+    KEYWORD("and", 'a', 'd', TOKEN_AND),
+    KEYWORD("or", 'o', 'r', TOKEN_OR),
+    KEYWORD("orelse", 'o', 'e', TOKEN_OR_ELSE),
+
+    KEYWORD("int", 'i', 't', TOKEN_TYPE),
+    KEYWORD("float", 'f', 't', TOKEN_TYPE),
+    KEYWORD("string", 's', 'g', TOKEN_TYPE),
+    KEYWORD("bool", 'b', 'l', TOKEN_TYPE),
+    KEYWORD("void", 'v', 'd', TOKEN_TYPE),
+    KEYWORD("any", 'a', 'y', TOKEN_TYPE),
+    KEYWORD("error", 'e', 'r', TOKEN_TYPE),
+    KEYWORD("interface", 'i', 'e', TOKEN_TYPE),
+};
 
+Token* token_create(TokenType type, const char* value, SourceFile* source, uint64_t offset,
+                    uint32_t length, uint32_t line, uint32_t column) {
     Token* token = malloc(sizeof(Token));
     if(!token)
         return NULL;
 
     token->type = type;
-    token->value = strdup(value);  // Duplicate!
+    token->value = strdup(value);
+    token->symbol = (type == TOKEN_IDENT || type == TOKEN_TYPE) ? symbol_intern_cstr(value)
+                                                               : SYMBOL_NONE;
+    token->source = source_file_retain(source);
+    token->offset = offset;
+    token->length = length;
     token->line = line;
     token->column = column;
-    token->file_name = strdup(file_name);            // Duplicate!
-    token->file_directory = strdup(file_directory);  // Duplicate!
+    token->number.int_val = 0;
+    token_decode_number(token, value);
     return token;
 }
 
@@ -67,12 +144,123 @@ void token_free(Token* token) {
     if(!token)
         return;
 
-    free(token->value);
-    free(token->file_name);
-    free(token->file_directory);
+    free((char*)token->value);
+    source_file_release(token->source);
     free(token);
 }
 
+const char* token_text(const Token* token) {
+    return token->source->text + token->offset;
+}
+
+const char* token_lexeme(TokenType type) {
+    if(type >= 0 && type < sizeof(token_lexemes) / sizeof(token_lexemes[0])) {
+        return token_lexemes[type];
+    }
+    return NULL;
+}
+
+const char* token_value_from_slice(Arena* arena, TokenType type, const char* text, size_t len) {
+    const char* lexeme = token_lexeme(type);
+    if(lexeme) {
+        return lexeme;
+    }
+
+    switch(type) {
+        case TOKEN_STRING: {
+            size_t body_len;
+            const char* body = token_string_body(arena, text, len, &body_len);
+            // A body still pointing into text is an undecoded slice and needs a terminator
+            if(body == text + 1) {
+                return arena_strndup(arena, body, body_len);
+            }
+            return body;
+        }
+        case TOKEN_COMMENT:
+            // "// body" or "/* body */"
+            return arena_strndup(arena, text + 2, text[1] == '/' ? len - 2 : len - 4);
+        default:
+            return arena_strndup(arena, text, len);
+    }
+}
+
+const char* token_string_body(Arena* arena, const char* text, size_t len, size_t* body_len) {
+    // Strip the quotes; only strings with escapes need decoding
+    const char* body = text + 1;
+    size_t raw_len = len - 2;
+    const char* end = body + raw_len;
+    const char* escape = memchr(body, '\\', raw_len);
+    if(!escape) {
+        *body_len = raw_len;
+        return body;
+    }
+
+    // Every escape is two bytes that decode to one, so hopping between
+    // backslashes sizes the output exactly
+    size_t escapes = 0;
+    for(const char* p = escape; p; p = memchr(p, '\\', (size_t)(end - p))) {
+        escapes++;
+        p += 2;
+        if(p >= end)
+            break;
+    }
+
+    size_t decoded_len = raw_len - escapes;
+    char* value = arena_alloc(arena, decoded_len + 1);
+    if(!value)
+        return NULL;
+
+    size_t out = (size_t)(escape - body);
+    memcpy(value, body, out);
+    for(const char* p = escape; p < end; p++) {
+        value[out++] = *p == '\\' ? token_unescape(*++p) : *p;
+    }
+    value[out] = '\0';
+    *body_len = decoded_len;
+    return value;
+}
+
+bool token_materialize(Token* token, Arena* arena, const char* text) {
+    if(token->type == TOKEN_IDENT || token->type == TOKEN_TYPE) {
+        token->symbol = symbol_intern(text, token->length);
+        token->value = token->symbol != SYMBOL_NONE ? symbol_name(token->symbol) : NULL;
+    } else {
+        token->symbol = SYMBOL_NONE;
+        token->value = token_value_from_slice(arena, token->type, text, token->length);
+    }
+    return token->value != NULL;
+}
+
+NumberStatus token_decode_number(Token* token, const char* text) {
+    switch(token->type) {
+        case TOKEN_INTEGER:
+            return number_parse_int(text, token->length, &token->number.int_val);
+        case TOKEN_FLOAT:
+            return number_parse_float(text, token->length, &token->number.float_val);
+        default:
+            return NUMBER_OK;
+    }
+}
+
+char token_unescape(char escaped) {
+    switch(escaped) {
+        case 'n':
+            return '\n';
+        case 't':
+            return '\t';
+        case 'r':
+            return '\r';
+        case '\\':
+            return '\\';
+        case '"':
+            return '"';
+        case '\'':
+            return '\'';
+        default:
+            return '\0';
+    }
+}
+
 const char* token_type_to_string(TokenType type) {
     if(type >= 0 && type < sizeof(token_type_strings) / sizeof(token_type_strings[0])) {
         return token_type_strings[type];
@@ -80,36 +268,24 @@ const char* token_type_to_string(TokenType type) {
     return "UNKNOWN";
 }
 
-TokenType token_lookup_keyword(const char* ident) {
-    if(strcmp(ident, "abeg") == 0)
-        return TOKEN_ABEG;
-    if(strcmp(ident, "oya") == 0)
-        return TOKEN_OYA;
-    if(strcmp(ident, "waka") == 0)
-        return TOKEN_WAKA;
-    if(strcmp(ident, "comot") == 0)
-        return TOKEN_COMOT;
-    if(strcmp(ident, "abi") == 0)
-        return TOKEN_ABI;
-    if(strcmp(ident, "naso") == 0)
-        return TOKEN_NASO;
-    if(strcmp(ident, "true") == 0)
-        return TOKEN_TRUE;
-    if(strcmp(ident, "false") == 0)
-        return TOKEN_FALSE;
-    if(strcmp(ident, "and") == 0)
-        return TOKEN_AND;
-    if(strcmp(ident, "or") == 0)
-        return TOKEN_OR;
-    if(strcmp(ident, "orelse") == 0)
-        return TOKEN_OR_ELSE;
+TokenType token_classify_ident(const char* ident, size_t len) {
+    if(len < 2 || len > KEYWORD_MAX_LEN) {
+        return TOKEN_IDENT;
+    }
 
+    const KeywordEntry* entry = &keyword_table[KEYWORD_HASH(len, (unsigned char)ident[0],
+                                                            (unsigned char)ident[len - 1])];
+    if(entry->len == len && memcmp(entry->word, ident, len) == 0) {
+        return (TokenType)entry->type;
+    }
     return TOKEN_IDENT;
 }
 
+TokenType token_lookup_keyword(const char* ident) {
+    TokenType type = token_classify_ident(ident, strlen(ident));
+    return type == TOKEN_TYPE ? TOKEN_IDENT : type;
+}
+
 int token_is_type_keyword(const char* ident) {
-    return (strcmp(ident, "int") == 0 || strcmp(ident, "float") == 0 ||
-            strcmp(ident, "string") == 0 || strcmp(ident, "bool") == 0 ||
-            strcmp(ident, "void") == 0 || strcmp(ident, "any") == 0 ||
-            strcmp(ident, "error") == 0 || strcmp(ident, "interface") == 0);
+    return token_classify_ident(ident, strlen(ident)) == TOKEN_TYPE;
 }
@@ -0,0 +1,85 @@
+#include "../../include/token_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUFFER_CAPACITY 1024
+
+void token_buffer_init(TokenBuffer* buffer) {
+    buffer->types = NULL;
+    buffer->starts = NULL;
+    buffer->lens = NULL;
+    buffer->lines = NULL;
+    buffer->columns = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+}
+
+void token_buffer_free(TokenBuffer* buffer) {
+    free(buffer->types);
+    free(buffer->starts);
+    free(buffer->lens);
+    free(buffer->lines);
+    free(buffer->columns);
+    token_buffer_init(buffer);
+}
+
+static bool grow(void** array, size_t elem_size, size_t capacity) {
+    void* grown = realloc(*array, elem_size * capacity);
+    if(!grown)
+        return false;
+    *array = grown;
+    return true;
+}
+
+bool token_buffer_reserve(TokenBuffer* buffer, size_t capacity) {
+    if(capacity <= buffer->capacity)
+        return true;
+
+    if(!grow((void**)&buffer->types, sizeof(uint8_t), capacity) ||
+       !grow((void**)&buffer->starts, sizeof(uint64_t), capacity) ||
+       !grow((void**)&buffer->lens, sizeof(uint32_t), capacity) ||
+       !grow((void**)&buffer->lines, sizeof(uint32_t), capacity) ||
+       !grow((void**)&buffer->columns, sizeof(uint32_t), capacity)) {
+        return false;
+    }
+    buffer->capacity = capacity;
+    return true;
+}
+
+bool token_buffer_push(TokenBuffer* buffer, TokenType type, uint64_t start, uint32_t len,
+                       uint32_t line, uint32_t column) {
+    if(buffer->count >= buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : INITIAL_BUFFER_CAPACITY;
+        if(!token_buffer_reserve(buffer, capacity))
+            return false;
+    }
+
+    size_t i = buffer->count++;
+    buffer->types[i] = (uint8_t)type;
+    buffer->starts[i] = start;
+    buffer->lens[i] = len;
+    buffer->lines[i] = line;
+    buffer->columns[i] = column;
+    return true;
+}
+
+bool token_buffer_append(TokenBuffer* buffer, const TokenBuffer* from, size_t first,
+                         uint32_t line_delta) {
+    size_t n = from->count - first;
+    if(n == 0)
+        return true;
+    if(!token_buffer_reserve(buffer, buffer->count + n))
+        return false;
+
+    size_t at = buffer->count;
+    memcpy(buffer->types + at, from->types + first, n * sizeof(uint8_t));
+    memcpy(buffer->starts + at, from->starts + first, n * sizeof(uint64_t));
+    memcpy(buffer->lens + at, from->lens + first, n * sizeof(uint32_t));
+    memcpy(buffer->columns + at, from->columns + first, n * sizeof(uint32_t));
+    for(size_t i = 0; i < n; i++) {
+        buffer->lines[at + i] = from->lines[first + i] + line_delta;
+    }
+    buffer->count += n;
+    return true;
+}
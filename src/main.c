@@ -1,7 +1,111 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/parser/ast_cache.h"
+#include "../include/parser/resolver.h"
+#include "../include/source.h"
+
+// Directory for cache entries unless --cache-dir or SORO_CACHE_DIR says
+// otherwise: soro under the user's cache directory, $XDG_CACHE_HOME or else
+// ~/.cache. NULL, for no caching, when neither is set. Never the working
+// directory, so running soro leaves nothing behind where it is run.
+static char* default_cache_dir(void) {
+    const char* base = getenv("XDG_CACHE_HOME");
+    const char* suffix = "/soro";
+    if(!base || base[0] != '/') {
+        base = getenv("HOME");
+        suffix = "/.cache/soro";
+    }
+    if(!base || !*base)
+        return NULL;
+
+    size_t size = strlen(base) + strlen(suffix) + 1;
+    char* path = malloc(size);
+    if(path) {
+        snprintf(path, size, "%s%s", base, suffix);
+    }
+    return path;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: soro [--cache-dir DIR | --no-cache] [--print-ast] FILE...\n");
+}
+
+// Parse one file, through the cache when there is one, and resolve its names;
+// returns false on error
+static bool run_file(const char* path, const char* cache_dir, bool print_ast) {
+    SourceFile* source = source_file_map(path);
+    if(!source) {
+        fprintf(stderr, "soro: cannot open %s\n", path);
+        return false;
+    }
+
+    bool hit;
+    FlatAst* flat = ast_cache_parse(cache_dir, source, &hit);
+    if(!flat) {
+        source_file_release(source);
+        return false;
+    }
+
+    ASTNode* ast = flat_ast_to_tree(flat);
+    flat_ast_free(flat);
+
+    // Undefined and redeclared names are compile errors
+    Resolver resolver;
+    resolver_init(&resolver);
+    bool resolved = resolver_resolve(&resolver, ast);
+    resolver_report(&resolver, ast, source->name, stderr);
+    resolver_free(&resolver);
+    source_file_release(source);
+
+    if(resolved && print_ast) {
+        ast_print_node(ast);
+    }
+    ast_free_node(ast);
+    return resolved;
+}
+
 int main(int argc, char* argv[]) {
-    printf("Welcome to soro\n");
-    return 0;
+    char* default_dir = NULL;
+    const char* cache_dir = getenv("SORO_CACHE_DIR");
+    if(!cache_dir || !*cache_dir) {
+        cache_dir = default_dir = default_cache_dir();
+    }
+    bool print_ast = false;
+    int first_file = argc;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if(strcmp(argv[i], "--no-cache") == 0) {
+            cache_dir = NULL;
+        } else if(strcmp(argv[i], "--print-ast") == 0) {
+            print_ast = true;
+        } else if(argv[i][0] == '-') {
+            usage();
+            free(default_dir);
+            return 2;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+
+    if(first_file == argc) {
+        usage();
+        free(default_dir);
+        return 2;
+    }
+
+    int status = 0;
+    for(int i = first_file; i < argc; i++) {
+        if(!run_file(argv[i], cache_dir, print_ast)) {
+            status = 1;
+        }
+    }
+    free(default_dir);
+    return status;
 }
@@ -1,143 +1,112 @@
 
 #include "../../include/parser/ast.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // ===== Memory Management =====
 
-void ast_free_expr(Expr* expr) {
-    if(!expr)
+void ast_free_node(ASTNode* node) {
+    if(!node)
         return;
 
-    switch(expr->type) {
-        case EXPR_LITERAL:
-            if(expr->as.literal.type == LITERAL_STRING) {
-                free(expr->as.literal.value.string_val);
-            }
-            break;
-
-        case EXPR_VARIABLE:
-            free(expr->as.variable.name);
-            break;
-
-        case EXPR_BINARY:
-            ast_free_expr(expr->as.binary.left);
-            ast_free_expr(expr->as.binary.right);
-            break;
-
-        case EXPR_UNARY:
-            ast_free_expr(expr->as.unary.right);
-            break;
+    arena_free(&node->arena);
+    line_index_free(&node->lines);
+    free(node);
+}
 
-        case EXPR_CALL:
-            ast_free_expr(expr->as.call.callee);
-            for(size_t i = 0; i < expr->as.call.arg_count; i++) {
-                ast_free_expr(expr->as.call.args[i]);
-            }
-            free(expr->as.call.args);
-            break;
+// ===== Locations =====
 
-        case EXPR_INDEX:
-            ast_free_expr(expr->as.index.object);
-            ast_free_expr(expr->as.index.index);
-            break;
+void ast_resolve_loc(const ASTNode* node, SourceLoc loc, uint32_t* line, uint32_t* column) {
+    line_index_lookup(&node->lines, loc, line, column);
+}
 
-        case EXPR_ARRAY:
-            for(size_t i = 0; i < expr->as.array.count; i++) {
-                ast_free_expr(expr->as.array.elements[i]);
-            }
-            free(expr->as.array.elements);
-            break;
+// Shifts wrap around rather than saturate: parse_incremental moves a pending
+// shift back over statements by shifting them the other way
+static bool shift_expr(void* context, Expr* expr, int depth) {
+    (void)depth;
+    expr->loc += (SourceLoc)(*(const int64_t*)context);
+    return true;
+}
 
-        case EXPR_ASSIGN:
-            free(expr->as.assign.name);
-            ast_free_expr(expr->as.assign.value);
-            break;
-    }
+static bool shift_stmt(void* context, Stmt* stmt, int depth) {
+    (void)depth;
+    stmt->loc += (SourceLoc)(*(const int64_t*)context);
+    return true;
+}
 
-    free(expr);
+void ast_shift_locs(Stmt* stmt, int64_t delta) {
+    AstVisitor visitor = {shift_expr, shift_stmt};
+    ast_walk_stmt(stmt, &visitor, &delta);
 }
 
-void ast_free_stmt(Stmt* stmt) {
-    if(!stmt)
+void ast_settle_locs(ASTNode* node) {
+    if(!node)
         return;
 
-    switch(stmt->type) {
-        case STMT_EXPR:
-            ast_free_expr(stmt->as.expr_stmt.expression);
-            break;
-
-        case STMT_VAR_DECL:
-            free(stmt->as.var_decl.name);
-            if(stmt->as.var_decl.type_annotation) {
-                free(stmt->as.var_decl.type_annotation);
-            }
-            if(stmt->as.var_decl.initializer) {
-                ast_free_expr(stmt->as.var_decl.initializer);
-            }
-            break;
-
-        case STMT_FUNCTION_DECL:
-            free(stmt->as.function_decl.name);
-            for(size_t i = 0; i < stmt->as.function_decl.param_count; i++) {
-                free(stmt->as.function_decl.param_names[i]);
-                free(stmt->as.function_decl.param_types[i]);
-            }
-            free(stmt->as.function_decl.param_names);
-            free(stmt->as.function_decl.param_types);
-            if(stmt->as.function_decl.return_type) {
-                free(stmt->as.function_decl.return_type);
-            }
-            ast_free_stmt(stmt->as.function_decl.body);
-            break;
-
-        case STMT_IF:
-            ast_free_expr(stmt->as.if_stmt.condition);
-            ast_free_stmt(stmt->as.if_stmt.then_branch);
-            if(stmt->as.if_stmt.else_branch) {
-                ast_free_stmt(stmt->as.if_stmt.else_branch);
-            }
-            break;
-
-        case STMT_WHILE:
-            ast_free_expr(stmt->as.while_stmt.condition);
-            ast_free_stmt(stmt->as.while_stmt.body);
-            break;
-
-        case STMT_RETURN:
-            if(stmt->as.return_stmt.value) {
-                ast_free_expr(stmt->as.return_stmt.value);
-            }
-            break;
-
-        case STMT_BLOCK:
-            for(size_t i = 0; i < stmt->as.block.count; i++) {
-                ast_free_stmt(stmt->as.block.statements[i]);
-            }
-            free(stmt->as.block.statements);
-            break;
+    Program* program = &node->as.program;
+    if(program->shift != 0) {
+        for(size_t i = program->shift_from; i < program->count; i++) {
+            ast_shift_locs(program->statements[i], program->shift);
+        }
     }
-
-    free(stmt);
+    program->shift_from = 0;
+    program->shift = 0;
 }
 
-void ast_free_node(ASTNode* node) {
-    if(!node)
-        return;
+// ===== Printing (for debugging) =====
 
-    if(node->type == NODE_PROGRAM) {
-        for(size_t i = 0; i < node->as.program.count; i++) {
-            ast_free_stmt(node->as.program.statements[i]);
-        }
-        free(node->as.program.statements);
+// The printer walks the tree with an explicit stack instead of recursing, so
+// arbitrarily deep trees print without exhausting the C stack. Items are
+// pushed in reverse so they pop in source order; a label that has to appear
+// between two children ("Then:", "Args(2):") is an item of its own.
+
+typedef enum { PRINT_EXPR, PRINT_STMT, PRINT_LABEL } PrintKind;
+
+typedef struct {
+    PrintKind kind;
+    int indent;
+    union {
+        const Expr* expr;
+        const Stmt* stmt;
+        const char* label;
+    } as;
+    size_t count;  // Shown after a label as "label(count):" unless SIZE_MAX
+} PrintItem;
+
+typedef struct {
+    PrintItem* items;
+    size_t count;
+    size_t capacity;
+} PrintStack;
+
+static PrintItem* print_push(PrintStack* stack, PrintKind kind, int indent) {
+    if(stack->count >= stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 64;
+        stack->items = realloc(stack->items, sizeof(PrintItem) * stack->capacity);
     }
+    PrintItem* item = &stack->items[stack->count++];
+    item->kind = kind;
+    item->indent = indent;
+    item->count = SIZE_MAX;
+    return item;
+}
 
-    free(node);
+static void push_expr(PrintStack* stack, const Expr* expr, int indent) {
+    print_push(stack, PRINT_EXPR, indent)->as.expr = expr;
 }
 
-// ===== Printing (for debugging) =====
+static void push_stmt(PrintStack* stack, const Stmt* stmt, int indent) {
+    print_push(stack, PRINT_STMT, indent)->as.stmt = stmt;
+}
+
+static void push_label(PrintStack* stack, const char* label, size_t count, int indent) {
+    PrintItem* item = print_push(stack, PRINT_LABEL, indent);
+    item->as.label = label;
+    item->count = count;
+}
 
 static void print_indent(int indent) {
     for(int i = 0; i < indent; i++) {
@@ -145,27 +114,26 @@ static void print_indent(int indent) {
     }
 }
 
-void ast_print_expr(Expr* expr, int indent) {
+// Print one expression line and push its children
+static void print_expr_item(PrintStack* stack, const Expr* expr, int indent) {
+    print_indent(indent);
     if(!expr) {
-        print_indent(indent);
         printf("<null>\n");
         return;
     }
 
-    print_indent(indent);
-
     switch(expr->type) {
         case EXPR_LITERAL:
             printf("Literal(");
             switch(expr->as.literal.type) {
                 case LITERAL_INT:
-                    printf("%d", expr->as.literal.value.int_val);
+                    printf("%" PRId64, expr->as.literal.value.int_val);
                     break;
                 case LITERAL_FLOAT:
                     printf("%f", expr->as.literal.value.float_val);
                     break;
                 case LITERAL_STRING:
-                    printf("\"%s\"", expr->as.literal.value.string_val);
+                    printf("\"%s\"", symbol_name(expr->as.literal.value.string_val));
                     break;
                 case LITERAL_BOOL:
                     printf("%s", expr->as.literal.value.bool_val ? "true" : "false");
@@ -175,149 +143,179 @@ void ast_print_expr(Expr* expr, int indent) {
             break;
 
         case EXPR_VARIABLE:
-            printf("Variable(%s)\n", expr->as.variable.name);
+            printf("Variable(%s)\n", symbol_name(expr->as.variable.name));
             break;
 
         case EXPR_BINARY:
             printf("Binary(%s)\n", token_type_to_string(expr->as.binary.op));
-            ast_print_expr(expr->as.binary.left, indent + 1);
-            ast_print_expr(expr->as.binary.right, indent + 1);
+            push_expr(stack, expr->as.binary.right, indent + 1);
+            push_expr(stack, expr->as.binary.left, indent + 1);
             break;
 
         case EXPR_UNARY:
             printf("Unary(%s)\n", token_type_to_string(expr->as.unary.op));
-            ast_print_expr(expr->as.unary.right, indent + 1);
+            push_expr(stack, expr->as.unary.right, indent + 1);
             break;
 
         case EXPR_CALL:
             printf("Call\n");
             print_indent(indent + 1);
             printf("Callee:\n");
-            ast_print_expr(expr->as.call.callee, indent + 2);
-            print_indent(indent + 1);
-            printf("Args(%zu):\n", expr->as.call.arg_count);
-            for(size_t i = 0; i < expr->as.call.arg_count; i++) {
-                ast_print_expr(expr->as.call.args[i], indent + 2);
+            for(size_t i = expr->as.call.arg_count; i > 0; i--) {
+                push_expr(stack, expr->as.call.args[i - 1], indent + 2);
             }
+            push_label(stack, "Args", expr->as.call.arg_count, indent + 1);
+            push_expr(stack, expr->as.call.callee, indent + 2);
             break;
 
         case EXPR_INDEX:
             printf("Index\n");
             print_indent(indent + 1);
             printf("Object:\n");
-            ast_print_expr(expr->as.index.object, indent + 2);
-            print_indent(indent + 1);
-            printf("Index:\n");
-            ast_print_expr(expr->as.index.index, indent + 2);
+            push_expr(stack, expr->as.index.index, indent + 2);
+            push_label(stack, "Index", SIZE_MAX, indent + 1);
+            push_expr(stack, expr->as.index.object, indent + 2);
             break;
 
         case EXPR_ARRAY:
             printf("Array(%zu elements)\n", expr->as.array.count);
-            for(size_t i = 0; i < expr->as.array.count; i++) {
-                ast_print_expr(expr->as.array.elements[i], indent + 1);
+            for(size_t i = expr->as.array.count; i > 0; i--) {
+                push_expr(stack, expr->as.array.elements[i - 1], indent + 1);
             }
             break;
 
         case EXPR_ASSIGN:
-            printf("Assign(%s)\n", expr->as.assign.name);
-            ast_print_expr(expr->as.assign.value, indent + 1);
+            printf("Assign(%s)\n", symbol_name(expr->as.assign.name));
+            push_expr(stack, expr->as.assign.value, indent + 1);
             break;
     }
 }
 
-void ast_print_stmt(Stmt* stmt, int indent) {
+// Print one statement's header lines and push its children
+static void print_stmt_item(PrintStack* stack, const Stmt* stmt, int indent) {
+    print_indent(indent);
     if(!stmt) {
-        print_indent(indent);
         printf("<null>\n");
         return;
     }
 
-    print_indent(indent);
-
     switch(stmt->type) {
         case STMT_EXPR:
             printf("ExprStmt\n");
-            ast_print_expr(stmt->as.expr_stmt.expression, indent + 1);
+            push_expr(stack, stmt->as.expr_stmt.expression, indent + 1);
             break;
 
         case STMT_VAR_DECL:
-            printf("VarDecl(%s", stmt->as.var_decl.name);
-            if(stmt->as.var_decl.type_annotation) {
-                printf(": %s", stmt->as.var_decl.type_annotation);
+            printf("VarDecl(%s", symbol_name(stmt->as.var_decl.name));
+            if(stmt->as.var_decl.type_annotation != SYMBOL_NONE) {
+                printf(": %s", symbol_name(stmt->as.var_decl.type_annotation));
             }
             printf(")\n");
             if(stmt->as.var_decl.initializer) {
                 print_indent(indent + 1);
                 printf("Initializer:\n");
-                ast_print_expr(stmt->as.var_decl.initializer, indent + 2);
+                push_expr(stack, stmt->as.var_decl.initializer, indent + 2);
             }
             break;
 
         case STMT_FUNCTION_DECL:
-            printf("FunctionDecl(%s)\n", stmt->as.function_decl.name);
+            printf("FunctionDecl(%s)\n", symbol_name(stmt->as.function_decl.name));
             print_indent(indent + 1);
             printf("Params(%zu):\n", stmt->as.function_decl.param_count);
             for(size_t i = 0; i < stmt->as.function_decl.param_count; i++) {
                 print_indent(indent + 2);
-                printf("%s: %s\n", stmt->as.function_decl.param_names[i],
-                       stmt->as.function_decl.param_types[i]);
+                printf("%s: %s\n", symbol_name(stmt->as.function_decl.param_names[i]),
+                       symbol_name(stmt->as.function_decl.param_types[i]));
             }
-            if(stmt->as.function_decl.return_type) {
+            if(stmt->as.function_decl.return_type != SYMBOL_NONE) {
                 print_indent(indent + 1);
-                printf("Returns: %s\n", stmt->as.function_decl.return_type);
+                printf("Returns: %s\n", symbol_name(stmt->as.function_decl.return_type));
             }
             print_indent(indent + 1);
             printf("Body:\n");
-            ast_print_stmt(stmt->as.function_decl.body, indent + 2);
+            push_stmt(stack, stmt->as.function_decl.body, indent + 2);
             break;
 
         case STMT_IF:
             printf("IfStmt\n");
             print_indent(indent + 1);
             printf("Condition:\n");
-            ast_print_expr(stmt->as.if_stmt.condition, indent + 2);
-            print_indent(indent + 1);
-            printf("Then:\n");
-            ast_print_stmt(stmt->as.if_stmt.then_branch, indent + 2);
             if(stmt->as.if_stmt.else_branch) {
-                print_indent(indent + 1);
-                printf("Else:\n");
-                ast_print_stmt(stmt->as.if_stmt.else_branch, indent + 2);
+                push_stmt(stack, stmt->as.if_stmt.else_branch, indent + 2);
+                push_label(stack, "Else", SIZE_MAX, indent + 1);
             }
+            push_stmt(stack, stmt->as.if_stmt.then_branch, indent + 2);
+            push_label(stack, "Then", SIZE_MAX, indent + 1);
+            push_expr(stack, stmt->as.if_stmt.condition, indent + 2);
             break;
 
         case STMT_WHILE:
             printf("WhileStmt\n");
             print_indent(indent + 1);
             printf("Condition:\n");
-            ast_print_expr(stmt->as.while_stmt.condition, indent + 2);
-            print_indent(indent + 1);
-            printf("Body:\n");
-            ast_print_stmt(stmt->as.while_stmt.body, indent + 2);
+            push_stmt(stack, stmt->as.while_stmt.body, indent + 2);
+            push_label(stack, "Body", SIZE_MAX, indent + 1);
+            push_expr(stack, stmt->as.while_stmt.condition, indent + 2);
             break;
 
         case STMT_RETURN:
             printf("ReturnStmt\n");
             if(stmt->as.return_stmt.value) {
-                ast_print_expr(stmt->as.return_stmt.value, indent + 1);
+                push_expr(stack, stmt->as.return_stmt.value, indent + 1);
             }
             break;
 
         case STMT_BLOCK:
             printf("Block(%zu statements)\n", stmt->as.block.count);
-            for(size_t i = 0; i < stmt->as.block.count; i++) {
-                ast_print_stmt(stmt->as.block.statements[i], indent + 1);
+            for(size_t i = stmt->as.block.count; i > 0; i--) {
+                push_stmt(stack, stmt->as.block.statements[i - 1], indent + 1);
             }
             break;
     }
 }
 
+static void print_drain(PrintStack* stack) {
+    while(stack->count > 0) {
+        PrintItem item = stack->items[--stack->count];
+        switch(item.kind) {
+            case PRINT_EXPR:
+                print_expr_item(stack, item.as.expr, item.indent);
+                break;
+            case PRINT_STMT:
+                print_stmt_item(stack, item.as.stmt, item.indent);
+                break;
+            case PRINT_LABEL:
+                print_indent(item.indent);
+                if(item.count != SIZE_MAX) {
+                    printf("%s(%zu):\n", item.as.label, item.count);
+                } else {
+                    printf("%s:\n", item.as.label);
+                }
+                break;
+        }
+    }
+    free(stack->items);
+}
+
+void ast_print_expr(Expr* expr, int indent) {
+    PrintStack stack = {NULL, 0, 0};
+    push_expr(&stack, expr, indent);
+    print_drain(&stack);
+}
+
+void ast_print_stmt(Stmt* stmt, int indent) {
+    PrintStack stack = {NULL, 0, 0};
+    push_stmt(&stack, stmt, indent);
+    print_drain(&stack);
+}
+
 void ast_print_node(ASTNode* node) {
     if(!node) {
         printf("<null>\n");
         return;
     }
 
+    ast_settle_locs(node);
     if(node->type == NODE_PROGRAM) {
         printf("Program(%zu statements)\n", node->as.program.count);
         for(size_t i = 0; i < node->as.program.count; i++) {
@@ -325,3 +323,141 @@ void ast_print_node(ASTNode* node) {
         }
     }
 }
+
+// ===== Walking =====
+
+// Nodes still to be entered, pushed last child first so they pop in source order
+
+typedef struct {
+    bool is_stmt;
+    int depth;
+    union {
+        Expr* expr;
+        Stmt* stmt;
+    } as;
+} WalkItem;
+
+typedef struct {
+    WalkItem* items;
+    size_t count;
+    size_t capacity;
+} WalkStack;
+
+static WalkItem* walk_push(WalkStack* stack, bool is_stmt, int depth) {
+    if(stack->count >= stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 64;
+        stack->items = realloc(stack->items, sizeof(WalkItem) * stack->capacity);
+    }
+    WalkItem* item = &stack->items[stack->count++];
+    item->is_stmt = is_stmt;
+    item->depth = depth;
+    return item;
+}
+
+static void walk_push_expr(WalkStack* stack, Expr* expr, int depth) {
+    if(expr) {
+        walk_push(stack, false, depth)->as.expr = expr;
+    }
+}
+
+static void walk_push_stmt(WalkStack* stack, Stmt* stmt, int depth) {
+    if(stmt) {
+        walk_push(stack, true, depth)->as.stmt = stmt;
+    }
+}
+
+static void walk_expr_children(WalkStack* stack, Expr* expr, int depth) {
+    switch(expr->type) {
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            break;
+        case EXPR_BINARY:
+            walk_push_expr(stack, expr->as.binary.right, depth);
+            walk_push_expr(stack, expr->as.binary.left, depth);
+            break;
+        case EXPR_UNARY:
+            walk_push_expr(stack, expr->as.unary.right, depth);
+            break;
+        case EXPR_CALL:
+            for(size_t i = expr->as.call.arg_count; i > 0; i--) {
+                walk_push_expr(stack, expr->as.call.args[i - 1], depth);
+            }
+            walk_push_expr(stack, expr->as.call.callee, depth);
+            break;
+        case EXPR_INDEX:
+            walk_push_expr(stack, expr->as.index.index, depth);
+            walk_push_expr(stack, expr->as.index.object, depth);
+            break;
+        case EXPR_ARRAY:
+            for(size_t i = expr->as.array.count; i > 0; i--) {
+                walk_push_expr(stack, expr->as.array.elements[i - 1], depth);
+            }
+            break;
+        case EXPR_ASSIGN:
+            walk_push_expr(stack, expr->as.assign.value, depth);
+            break;
+    }
+}
+
+static void walk_stmt_children(WalkStack* stack, Stmt* stmt, int depth) {
+    switch(stmt->type) {
+        case STMT_EXPR:
+            walk_push_expr(stack, stmt->as.expr_stmt.expression, depth);
+            break;
+        case STMT_VAR_DECL:
+            walk_push_expr(stack, stmt->as.var_decl.initializer, depth);
+            break;
+        case STMT_FUNCTION_DECL:
+            walk_push_stmt(stack, stmt->as.function_decl.body, depth);
+            break;
+        case STMT_IF:
+            walk_push_stmt(stack, stmt->as.if_stmt.else_branch, depth);
+            walk_push_stmt(stack, stmt->as.if_stmt.then_branch, depth);
+            walk_push_expr(stack, stmt->as.if_stmt.condition, depth);
+            break;
+        case STMT_WHILE:
+            walk_push_stmt(stack, stmt->as.while_stmt.body, depth);
+            walk_push_expr(stack, stmt->as.while_stmt.condition, depth);
+            break;
+        case STMT_RETURN:
+            walk_push_expr(stack, stmt->as.return_stmt.value, depth);
+            break;
+        case STMT_BLOCK:
+            for(size_t i = stmt->as.block.count; i > 0; i--) {
+                walk_push_stmt(stack, stmt->as.block.statements[i - 1], depth);
+            }
+            break;
+    }
+}
+
+static void walk_drain(WalkStack* stack, const AstVisitor* visitor, void* context) {
+    while(stack->count > 0) {
+        WalkItem item = stack->items[--stack->count];
+        if(item.is_stmt) {
+            if(!visitor->enter_stmt || visitor->enter_stmt(context, item.as.stmt, item.depth)) {
+                walk_stmt_children(stack, item.as.stmt, item.depth + 1);
+            }
+        } else if(!visitor->enter_expr || visitor->enter_expr(context, item.as.expr, item.depth)) {
+            walk_expr_children(stack, item.as.expr, item.depth + 1);
+        }
+    }
+    free(stack->items);
+}
+
+void ast_walk_stmt(Stmt* stmt, const AstVisitor* visitor, void* context) {
+    WalkStack stack = {NULL, 0, 0};
+    walk_push_stmt(&stack, stmt, 0);
+    walk_drain(&stack, visitor, context);
+}
+
+void ast_walk_node(ASTNode* node, const AstVisitor* visitor, void* context) {
+    if(!node)
+        return;
+
+    ast_settle_locs(node);
+    WalkStack stack = {NULL, 0, 0};
+    for(size_t i = node->as.program.count; i > 0; i--) {
+        walk_push_stmt(&stack, node->as.program.statements[i - 1], 0);
+    }
+    walk_drain(&stack, visitor, context);
+}
@@ -0,0 +1,527 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/parser/ast_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/hash.h"
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/symbol.h"
+#include "../../include/version.h"
+
+#define CACHE_MAGIC "SOROAST"
+#define CACHE_BYTE_ORDER 0x01020304u
+
+// Fixed-size entry header. The sections follow in this order, each starting
+// on an 8-byte boundary: exprs, expr_locs, stmts, stmt_locs, extra, line
+// starts, name lengths (one per local symbol, 0 for SYMBOL_NONE), name bytes.
+typedef struct {
+    char magic[8];
+    uint32_t format;      // AST_CACHE_FORMAT
+    uint32_t byte_order;  // CACHE_BYTE_ORDER as written; rejects foreign-endian entries
+    uint64_t key;
+    char version[16];     // SORO_VERSION, NUL-padded
+    uint32_t expr_count;
+    uint32_t stmt_count;
+    uint32_t extra_count;
+    uint32_t program;
+    uint64_t line_count;
+    uint32_t symbol_count;  // Local symbols, including SYMBOL_NONE at 0
+    uint32_t name_bytes;
+} CacheHeader;
+
+// Byte offsets of the sections of an entry, and its total size
+typedef struct {
+    size_t exprs, expr_locs, stmts, stmt_locs, extra, lines, name_lengths, names, size;
+} CacheLayout;
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static CacheLayout cache_layout(const CacheHeader* header) {
+    CacheLayout layout;
+    size_t at = align8(sizeof(CacheHeader));
+    layout.exprs = at;
+    at = align8(at + sizeof(FlatExprNode) * header->expr_count);
+    layout.expr_locs = at;
+    at = align8(at + sizeof(SourceLoc) * header->expr_count);
+    layout.stmts = at;
+    at = align8(at + sizeof(FlatStmtNode) * header->stmt_count);
+    layout.stmt_locs = at;
+    at = align8(at + sizeof(SourceLoc) * header->stmt_count);
+    layout.extra = at;
+    at = align8(at + sizeof(uint32_t) * header->extra_count);
+    layout.lines = at;
+    at = align8(at + sizeof(uint64_t) * header->line_count);
+    layout.name_lengths = at;
+    at = align8(at + sizeof(uint32_t) * header->symbol_count);
+    layout.names = at;
+    layout.size = at + header->name_bytes;
+    return layout;
+}
+
+uint64_t ast_cache_key(const char* text, uint64_t length) {
+    uint64_t seed = hash_bytes(SORO_VERSION, strlen(SORO_VERSION), AST_CACHE_FORMAT);
+    return hash_bytes(text, (size_t)length, seed);
+}
+
+// directory/<key>.ast, or for temp a name private to this process next to it
+static char* entry_path(const char* directory, uint64_t key, bool temp) {
+    size_t size = strlen(directory) + 64;
+    char* path = malloc(size);
+    if(path && temp) {
+        snprintf(path, size, "%s/%016" PRIx64 ".ast.%ld.tmp", directory, key, (long)getpid());
+    } else if(path) {
+        snprintf(path, size, "%s/%016" PRIx64 ".ast", directory, key);
+    }
+    return path;
+}
+
+// ===== Symbols =====
+
+// Apply map to every symbol operand of the nodes: names of variables,
+// assignments and declarations, string literals, type annotations, and the
+// symbols of parameter lists. Lists must have been validated.
+typedef Symbol (*SymbolMapFn)(void* context, Symbol symbol);
+
+static void map_symbols(FlatExprNode* exprs, uint32_t expr_count, FlatStmtNode* stmts,
+                        uint32_t stmt_count, uint32_t* extra, SymbolMapFn map, void* context) {
+    for(uint32_t i = 0; i < expr_count; i++) {
+        FlatExprNode* node = &exprs[i];
+        if(node->type == EXPR_VARIABLE || node->type == EXPR_ASSIGN ||
+           (node->type == EXPR_LITERAL && node->op == LITERAL_STRING)) {
+            node->a = map(context, node->a);
+        }
+    }
+
+    for(uint32_t i = 0; i < stmt_count; i++) {
+        FlatStmtNode* node = &stmts[i];
+        if(node->type == STMT_VAR_DECL) {
+            node->a = map(context, node->a);
+            node->b = map(context, node->b);
+        } else if(node->type == STMT_FUNCTION_DECL) {
+            node->a = map(context, node->a);
+            uint32_t count = extra[node->b];
+            for(uint32_t k = 0; k < count; k++) {
+                extra[node->b + 1 + k] = map(context, extra[node->b + 1 + k]);
+            }
+        }
+    }
+}
+
+// Process symbols to entry-local indices, assigned in order of first use
+typedef struct {
+    uint32_t* local;  // By process symbol; 0 until assigned
+    Symbol* names;    // By local index
+    uint32_t count;
+    size_t capacity;
+    uint64_t name_bytes;
+} LocalSymbols;
+
+static Symbol to_local(void* context, Symbol symbol) {
+    LocalSymbols* symbols = context;
+    if(symbol == SYMBOL_NONE)
+        return 0;
+    if(symbols->local[symbol] == 0) {
+        if(symbols->count == symbols->capacity) {
+            symbols->capacity *= 2;
+            symbols->names = realloc(symbols->names, sizeof(Symbol) * symbols->capacity);
+        }
+        symbols->local[symbol] = symbols->count;
+        symbols->names[symbols->count++] = symbol;
+        symbols->name_bytes += symbol_length(symbol);
+    }
+    return symbols->local[symbol];
+}
+
+// Entry-local indices back to process symbols; out-of-range indices are
+// flagged rather than followed
+typedef struct {
+    Symbol* symbols;
+    uint32_t count;
+    bool bad;
+} LoadedSymbols;
+
+static Symbol from_local(void* context, Symbol local) {
+    LoadedSymbols* loaded = context;
+    if(local >= loaded->count) {
+        loaded->bad = true;
+        return SYMBOL_NONE;
+    }
+    return loaded->symbols[local];
+}
+
+// ===== Storing =====
+
+static bool write_section(FILE* file, const void* data, size_t bytes) {
+    static const char padding[8] = {0};
+    if(bytes > 0 && fwrite(data, 1, bytes, file) != bytes)
+        return false;
+    size_t pad = align8(bytes) - bytes;
+    return pad == 0 || fwrite(padding, 1, pad, file) == pad;
+}
+
+// Write the entry with its symbols already made local
+static bool write_entry(FILE* file, const CacheHeader* header, const FlatAst* ast,
+                        const FlatExprNode* exprs, const FlatStmtNode* stmts,
+                        const uint32_t* extra, const LocalSymbols* symbols) {
+    if(!write_section(file, header, sizeof(CacheHeader)) ||
+       !write_section(file, exprs, sizeof(FlatExprNode) * ast->expr_count) ||
+       !write_section(file, ast->expr_locs, sizeof(SourceLoc) * ast->expr_count) ||
+       !write_section(file, stmts, sizeof(FlatStmtNode) * ast->stmt_count) ||
+       !write_section(file, ast->stmt_locs, sizeof(SourceLoc) * ast->stmt_count) ||
+       !write_section(file, extra, sizeof(uint32_t) * ast->extra_count) ||
+       !write_section(file, ast->lines.starts, sizeof(uint64_t) * ast->lines.count))
+        return false;
+
+    uint32_t* lengths = malloc(sizeof(uint32_t) * symbols->count);
+    if(!lengths)
+        return false;
+    lengths[0] = 0;
+    for(uint32_t i = 1; i < symbols->count; i++) {
+        lengths[i] = symbol_length(symbols->names[i]);
+    }
+    bool ok = write_section(file, lengths, sizeof(uint32_t) * symbols->count);
+    free(lengths);
+    if(!ok)
+        return false;
+
+    for(uint32_t i = 1; i < symbols->count; i++) {
+        uint32_t length = symbol_length(symbols->names[i]);
+        if(fwrite(symbol_name(symbols->names[i]), 1, length, file) != length)
+            return false;
+    }
+    return true;
+}
+
+// mkdir -p: create directory and any missing parents
+static bool make_directories(const char* directory) {
+    if(mkdir(directory, 0777) == 0 || errno == EEXIST)
+        return true;
+    if(errno != ENOENT)
+        return false;
+
+    size_t length = strlen(directory);
+    char* path = malloc(length + 1);
+    if(!path)
+        return false;
+    memcpy(path, directory, length + 1);
+    bool ok = true;
+    for(size_t i = 1; ok && i < length; i++) {
+        if(path[i] == '/') {
+            path[i] = '\0';
+            ok = mkdir(path, 0777) == 0 || errno == EEXIST;
+            path[i] = '/';
+        }
+    }
+    free(path);
+    return ok && (mkdir(directory, 0777) == 0 || errno == EEXIST);
+}
+
+bool ast_cache_store(const char* directory, uint64_t key, const FlatAst* ast) {
+    if(!make_directories(directory))
+        return false;
+
+    // Node copies whose symbols are rewritten to local indices
+    FlatExprNode* exprs = malloc(sizeof(FlatExprNode) * (ast->expr_count + 1));
+    FlatStmtNode* stmts = malloc(sizeof(FlatStmtNode) * (ast->stmt_count + 1));
+    uint32_t* extra = malloc(sizeof(uint32_t) * (ast->extra_count + 1));
+    LocalSymbols symbols = {calloc(symbol_count() + 1, sizeof(uint32_t)),
+                            malloc(sizeof(Symbol) * 64), 1, 64, 0};
+    char* path = entry_path(directory, key, false);
+    char* temp = entry_path(directory, key, true);
+    bool ok = exprs && stmts && extra && symbols.local && symbols.names && path && temp;
+
+    if(ok) {
+        memcpy(exprs, ast->exprs, sizeof(FlatExprNode) * ast->expr_count);
+        memcpy(stmts, ast->stmts, sizeof(FlatStmtNode) * ast->stmt_count);
+        memcpy(extra, ast->extra, sizeof(uint32_t) * ast->extra_count);
+        symbols.names[0] = SYMBOL_NONE;
+        map_symbols(exprs, ast->expr_count, stmts, ast->stmt_count, extra, to_local, &symbols);
+        ok = symbols.name_bytes <= UINT32_MAX;
+    }
+
+    if(ok) {
+        CacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.format = AST_CACHE_FORMAT;
+        header.byte_order = CACHE_BYTE_ORDER;
+        header.key = key;
+        strncpy(header.version, SORO_VERSION, sizeof(header.version) - 1);
+        header.expr_count = ast->expr_count;
+        header.stmt_count = ast->stmt_count;
+        header.extra_count = ast->extra_count;
+        header.program = ast->program;
+        header.line_count = ast->lines.count;
+        header.symbol_count = symbols.count;
+        header.name_bytes = (uint32_t)symbols.name_bytes;
+
+        // Written aside and renamed so no reader ever maps a partial entry
+        FILE* file = fopen(temp, "wb");
+        ok = file != NULL;
+        if(file) {
+            ok = write_entry(file, &header, ast, exprs, stmts, extra, &symbols);
+            ok = fclose(file) == 0 && ok;
+            ok = ok && rename(temp, path) == 0;
+            if(!ok) {
+                remove(temp);
+            }
+        }
+    }
+
+    free(exprs);
+    free(stmts);
+    free(extra);
+    free(symbols.local);
+    free(symbols.names);
+    free(path);
+    free(temp);
+    return ok;
+}
+
+// ===== Loading =====
+
+static bool valid_list(const FlatAst* ast, FlatList list) {
+    return list < ast->extra_count && ast->extra[list] < ast->extra_count - list;
+}
+
+// Every child index of a node has to refer to an earlier node (or to any
+// expression, for statements), as parse_flat builds them
+static bool valid_children(const FlatAst* ast, FlatList list, uint32_t limit) {
+    if(!valid_list(ast, list))
+        return false;
+    uint32_t count;
+    const uint32_t* items = flat_list(ast, list, &count);
+    for(uint32_t k = 0; k < count; k++) {
+        if(items[k] >= limit)
+            return false;
+    }
+    return true;
+}
+
+static bool valid_nodes(const FlatAst* ast) {
+    for(FlatExpr i = 0; i < ast->expr_count; i++) {
+        const FlatExprNode* node = &ast->exprs[i];
+        bool ok;
+        switch(node->type) {
+            case EXPR_LITERAL:
+                ok = node->op <= LITERAL_BOOL;
+                break;
+            case EXPR_VARIABLE:
+                ok = true;
+                break;
+            case EXPR_BINARY:
+            case EXPR_INDEX:
+                ok = node->a < i && node->b < i;
+                break;
+            case EXPR_UNARY:
+                ok = node->a < i;
+                break;
+            case EXPR_CALL:
+                ok = node->a < i && valid_children(ast, node->b, i);
+                break;
+            case EXPR_ARRAY:
+                ok = valid_children(ast, node->a, i);
+                break;
+            case EXPR_ASSIGN:
+                ok = node->b < i;
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if(!ok)
+            return false;
+    }
+
+    uint32_t exprs = ast->expr_count;
+    for(FlatStmt i = 0; i < ast->stmt_count; i++) {
+        const FlatStmtNode* node = &ast->stmts[i];
+        bool ok;
+        switch(node->type) {
+            case STMT_EXPR:
+                ok = node->a < exprs;
+                break;
+            case STMT_VAR_DECL:
+                ok = node->c == FLAT_NONE || node->c < exprs;
+                break;
+            case STMT_FUNCTION_DECL:
+                // Parameter lists hold symbols, checked when they are mapped
+                ok = valid_list(ast, node->b) && ast->extra[node->b] % 2 == 1 && node->c < i;
+                break;
+            case STMT_IF:
+                ok = node->a < exprs && node->b < i && (node->c == FLAT_NONE || node->c < i);
+                break;
+            case STMT_WHILE:
+                ok = node->a < exprs && node->b < i;
+                break;
+            case STMT_RETURN:
+                ok = node->a == FLAT_NONE || node->a < exprs;
+                break;
+            case STMT_BLOCK:
+                ok = valid_children(ast, node->a, i);
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if(!ok)
+            return false;
+    }
+
+    return valid_children(ast, ast->program, ast->stmt_count);
+}
+
+// Copy of bytes [offset, offset + bytes) of the entry; never NULL for bytes == 0
+static void* copy_section(const unsigned char* data, size_t offset, size_t bytes) {
+    void* copy = malloc(bytes ? bytes : 1);
+    if(copy && bytes) {
+        memcpy(copy, data + offset, bytes);
+    }
+    return copy;
+}
+
+// Intern the entry's names; symbols[0] is SYMBOL_NONE
+static Symbol* intern_names(const unsigned char* data, const CacheHeader* header,
+                            const CacheLayout* layout) {
+    Symbol* symbols = malloc(sizeof(Symbol) * (header->symbol_count + 1));
+    if(!symbols)
+        return NULL;
+
+    symbols[0] = SYMBOL_NONE;
+    const char* names = (const char*)data + layout->names;
+    uint64_t used = 0;
+    for(uint32_t i = 1; i < header->symbol_count; i++) {
+        uint32_t length;
+        memcpy(&length, data + layout->name_lengths + sizeof(uint32_t) * i, sizeof(length));
+        if(length > header->name_bytes - used) {
+            free(symbols);
+            return NULL;
+        }
+        symbols[i] = symbol_intern(names + used, length);
+        used += length;
+    }
+    return symbols;
+}
+
+// Build the FlatAst held by a mapped entry, or NULL if it is not one
+static FlatAst* load_entry(const unsigned char* data, size_t size, uint64_t key) {
+    CacheHeader header;
+    if(size < sizeof(header))
+        return NULL;
+    memcpy(&header, data, sizeof(header));
+
+    char version[sizeof(header.version)] = {0};
+    strncpy(version, SORO_VERSION, sizeof(version) - 1);
+    if(memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+       header.format != AST_CACHE_FORMAT || header.byte_order != CACHE_BYTE_ORDER ||
+       header.key != key || memcmp(header.version, version, sizeof(version)) != 0 ||
+       header.line_count == 0 || header.line_count > size || header.symbol_count == 0 ||
+       header.extra_count == 0)
+        return NULL;
+
+    CacheLayout layout = cache_layout(&header);
+    if(layout.size != size)
+        return NULL;
+
+    FlatAst* ast = calloc(1, sizeof(FlatAst));
+    if(!ast)
+        return NULL;
+    ast->exprs = copy_section(data, layout.exprs, sizeof(FlatExprNode) * header.expr_count);
+    ast->expr_locs = copy_section(data, layout.expr_locs, sizeof(SourceLoc) * header.expr_count);
+    ast->expr_count = ast->expr_capacity = header.expr_count;
+    ast->stmts = copy_section(data, layout.stmts, sizeof(FlatStmtNode) * header.stmt_count);
+    ast->stmt_locs = copy_section(data, layout.stmt_locs, sizeof(SourceLoc) * header.stmt_count);
+    ast->stmt_count = ast->stmt_capacity = header.stmt_count;
+    ast->extra = copy_section(data, layout.extra, sizeof(uint32_t) * header.extra_count);
+    ast->extra_count = ast->extra_capacity = header.extra_count;
+    ast->program = header.program;
+    ast->lines.starts = copy_section(data, layout.lines, sizeof(uint64_t) * header.line_count);
+    ast->lines.count = ast->lines.capacity = (size_t)header.line_count;
+
+    if(!ast->exprs || !ast->expr_locs || !ast->stmts || !ast->stmt_locs || !ast->extra ||
+       !ast->lines.starts || !valid_nodes(ast)) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+
+    LoadedSymbols loaded = {intern_names(data, &header, &layout), header.symbol_count, false};
+    if(!loaded.symbols) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+    map_symbols(ast->exprs, ast->expr_count, ast->stmts, ast->stmt_count, ast->extra, from_local,
+                &loaded);
+    free(loaded.symbols);
+    if(loaded.bad) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+    return ast;
+}
+
+FlatAst* ast_cache_load(const char* directory, uint64_t key) {
+    char* path = entry_path(directory, key, false);
+    if(!path)
+        return NULL;
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return NULL;
+
+    FlatAst* ast = load_entry(data, (size_t)st.st_size, key);
+    munmap(data, (size_t)st.st_size);
+    return ast;
+}
+
+// ===== Parsing Through the Cache =====
+
+FlatAst* ast_cache_parse(const char* directory, SourceFile* source, bool* hit) {
+    uint64_t key = ast_cache_key(source->text, source->length);
+    FlatAst* ast = directory ? ast_cache_load(directory, key) : NULL;
+    *hit = ast != NULL;
+    if(ast)
+        return ast;
+
+    Lexer* lexer = lexer_init_source(source);
+    if(!lexer)
+        return NULL;
+    lexer->flags |= LEXER_SKIP_COMMENTS;
+
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    if(lexer_tokenize_soa(lexer, &buffer)) {
+        Parser* parser = parser_init_soa(&buffer, source, source->name);
+        ast = parse_flat(parser);
+        parser_free(parser);
+    }
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+
+    // A failed store only costs the next start a parse
+    if(ast && directory) {
+        ast_cache_store(directory, key, ast);
+    }
+    return ast;
+}
@@ -0,0 +1,371 @@
+#include "../../include/parser/ast_fold.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ===== Literals =====
+
+static bool is_literal(const Expr* expr, LiteralType type) {
+    return expr->type == EXPR_LITERAL && expr->as.literal.type == type;
+}
+
+static bool is_int(const Expr* expr, int64_t value) {
+    return is_literal(expr, LITERAL_INT) && expr->as.literal.value.int_val == value;
+}
+
+// Turn the operator node into a literal in place; it keeps its location
+static void set_int(Expr* expr, int64_t value) {
+    expr->type = EXPR_LITERAL;
+    expr->as.literal.type = LITERAL_INT;
+    expr->as.literal.value.int_val = value;
+}
+
+static void set_float(Expr* expr, double value) {
+    expr->type = EXPR_LITERAL;
+    expr->as.literal.type = LITERAL_FLOAT;
+    expr->as.literal.value.float_val = value;
+}
+
+static void set_bool(Expr* expr, bool value) {
+    expr->type = EXPR_LITERAL;
+    expr->as.literal.type = LITERAL_BOOL;
+    expr->as.literal.value.bool_val = value;
+}
+
+static void set_string(Expr* expr, Symbol value) {
+    expr->type = EXPR_LITERAL;
+    expr->as.literal.type = LITERAL_STRING;
+    expr->as.literal.value.string_val = value;
+}
+
+// ===== Operators =====
+
+static bool fold_int(Expr* expr, TokenType op, int64_t a, int64_t b) {
+    int64_t result;
+    switch(op) {
+        case TOKEN_PLUS:
+            if(__builtin_add_overflow(a, b, &result))
+                return false;
+            set_int(expr, result);
+            return true;
+        case TOKEN_MINUS:
+            if(__builtin_sub_overflow(a, b, &result))
+                return false;
+            set_int(expr, result);
+            return true;
+        case TOKEN_ASTERISK:
+            if(__builtin_mul_overflow(a, b, &result))
+                return false;
+            set_int(expr, result);
+            return true;
+        case TOKEN_SLASH:
+            if(b == 0 || (a == INT64_MIN && b == -1))
+                return false;
+            set_int(expr, a / b);
+            return true;
+        case TOKEN_EQUAL:
+            set_bool(expr, a == b);
+            return true;
+        case TOKEN_NOT_EQUAL:
+            set_bool(expr, a != b);
+            return true;
+        case TOKEN_LESS_THAN:
+            set_bool(expr, a < b);
+            return true;
+        case TOKEN_GREATER_THAN:
+            set_bool(expr, a > b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_float(Expr* expr, TokenType op, double a, double b) {
+    switch(op) {
+        case TOKEN_PLUS:
+            set_float(expr, a + b);
+            return true;
+        case TOKEN_MINUS:
+            set_float(expr, a - b);
+            return true;
+        case TOKEN_ASTERISK:
+            set_float(expr, a * b);
+            return true;
+        case TOKEN_SLASH:
+            if(b == 0)
+                return false;
+            set_float(expr, a / b);
+            return true;
+        case TOKEN_EQUAL:
+            set_bool(expr, a == b);
+            return true;
+        case TOKEN_NOT_EQUAL:
+            set_bool(expr, a != b);
+            return true;
+        case TOKEN_LESS_THAN:
+            set_bool(expr, a < b);
+            return true;
+        case TOKEN_GREATER_THAN:
+            set_bool(expr, a > b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_bool(Expr* expr, TokenType op, bool a, bool b) {
+    switch(op) {
+        case TOKEN_AND:
+            set_bool(expr, a && b);
+            return true;
+        case TOKEN_OR:
+            set_bool(expr, a || b);
+            return true;
+        case TOKEN_EQUAL:
+            set_bool(expr, a == b);
+            return true;
+        case TOKEN_NOT_EQUAL:
+            set_bool(expr, a != b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Interned text compares by symbol
+static bool fold_string(Expr* expr, TokenType op, Symbol a, Symbol b) {
+    switch(op) {
+        case TOKEN_PLUS: {
+            uint32_t a_len = symbol_length(a);
+            uint32_t b_len = symbol_length(b);
+            char* text = malloc((size_t)a_len + b_len);
+            memcpy(text, symbol_name(a), a_len);
+            memcpy(text + a_len, symbol_name(b), b_len);
+            set_string(expr, symbol_intern(text, (size_t)a_len + b_len));
+            free(text);
+            return true;
+        }
+        case TOKEN_EQUAL:
+            set_bool(expr, a == b);
+            return true;
+        case TOKEN_NOT_EQUAL:
+            set_bool(expr, a != b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_literals(Expr* expr, const Literal* a, const Literal* b) {
+    if(a->type != b->type)
+        return false;
+    TokenType op = expr->as.binary.op;
+    switch(a->type) {
+        case LITERAL_INT:
+            return fold_int(expr, op, a->value.int_val, b->value.int_val);
+        case LITERAL_FLOAT:
+            return fold_float(expr, op, a->value.float_val, b->value.float_val);
+        case LITERAL_BOOL:
+            return fold_bool(expr, op, a->value.bool_val, b->value.bool_val);
+        case LITERAL_STRING:
+            return fold_string(expr, op, a->value.string_val, b->value.string_val);
+    }
+    return false;
+}
+
+// Deepest operand tree is_int_valued looks into; deeper ones count as unknown
+#define INT_VALUED_DEPTH 32
+
+// Whether expr is sure to be an int: an int literal, or negation or
+// arithmetic over ints that folding had to leave alone (an overflow, a
+// division by zero). Without a type checker nothing else is known.
+static bool is_int_valued(const Expr* expr, int depth) {
+    if(depth > INT_VALUED_DEPTH)
+        return false;
+    switch(expr->type) {
+        case EXPR_LITERAL:
+            return expr->as.literal.type == LITERAL_INT;
+        case EXPR_UNARY:
+            return expr->as.unary.op == TOKEN_MINUS &&
+                   is_int_valued(expr->as.unary.right, depth + 1);
+        case EXPR_BINARY:
+            switch(expr->as.binary.op) {
+                case TOKEN_PLUS:
+                case TOKEN_MINUS:
+                case TOKEN_ASTERISK:
+                case TOKEN_SLASH:
+                    return is_int_valued(expr->as.binary.left, depth + 1) &&
+                           is_int_valued(expr->as.binary.right, depth + 1);
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+// The operand a binary node reduces to without computing anything, or NULL.
+// x + 0 and friends are identities only for an int x (a string x would
+// concatenate or fail), so x must be known to be one.
+static Expr* identity_operand(const Expr* expr) {
+    Expr* left = expr->as.binary.left;
+    Expr* right = expr->as.binary.right;
+    switch(expr->as.binary.op) {
+        case TOKEN_AND:
+            return is_literal(left, LITERAL_BOOL) && !left->as.literal.value.bool_val ? left : NULL;
+        case TOKEN_OR:
+            return is_literal(left, LITERAL_BOOL) && left->as.literal.value.bool_val ? left : NULL;
+        case TOKEN_PLUS:
+            if(is_int(right, 0) && is_int_valued(left, 0))
+                return left;
+            return is_int(left, 0) && is_int_valued(right, 0) ? right : NULL;
+        case TOKEN_MINUS:
+            return is_int(right, 0) && is_int_valued(left, 0) ? left : NULL;
+        case TOKEN_ASTERISK:
+            if(is_int(right, 1) && is_int_valued(left, 0))
+                return left;
+            return is_int(left, 1) && is_int_valued(right, 0) ? right : NULL;
+        case TOKEN_SLASH:
+            return is_int(right, 1) && is_int_valued(left, 0) ? left : NULL;
+        default:
+            return NULL;
+    }
+}
+
+static void fold_binary(void* state, Expr** slot, int depth) {
+    (void)depth;
+    AstFoldStats* stats = state;
+    Expr* expr = *slot;
+    Expr* left = expr->as.binary.left;
+    Expr* right = expr->as.binary.right;
+
+    if(left->type == EXPR_LITERAL && right->type == EXPR_LITERAL &&
+       fold_literals(expr, &left->as.literal, &right->as.literal)) {
+        stats->folded++;
+        return;
+    }
+
+    Expr* operand = identity_operand(expr);
+    if(operand) {
+        *slot = operand;
+        stats->simplified++;
+    }
+}
+
+static void fold_unary(void* state, Expr** slot, int depth) {
+    (void)depth;
+    AstFoldStats* stats = state;
+    Expr* expr = *slot;
+    Expr* right = expr->as.unary.right;
+    if(right->type != EXPR_LITERAL)
+        return;
+
+    const Literal* value = &right->as.literal;
+    if(expr->as.unary.op == TOKEN_MINUS && value->type == LITERAL_INT) {
+        if(value->value.int_val == INT64_MIN)
+            return;
+        set_int(expr, -value->value.int_val);
+    } else if(expr->as.unary.op == TOKEN_MINUS && value->type == LITERAL_FLOAT) {
+        set_float(expr, -value->value.float_val);
+    } else if(expr->as.unary.op == TOKEN_BANG && value->type == LITERAL_BOOL) {
+        set_bool(expr, !value->value.bool_val);
+    } else {
+        return;
+    }
+    stats->folded++;
+}
+
+// ===== Statements =====
+
+// A statement that does nothing: what pruning leaves behind, and what blocks
+// drop from their lists
+static bool is_empty_block(const Stmt* stmt) {
+    return stmt->type == STMT_BLOCK && stmt->as.block.count == 0;
+}
+
+static void make_empty_block(Stmt* stmt) {
+    stmt->type = STMT_BLOCK;
+    stmt->as.block.statements = NULL;
+    stmt->as.block.count = 0;
+}
+
+static void prune_if(void* state, Stmt** slot, int depth) {
+    (void)depth;
+    AstFoldStats* stats = state;
+    Stmt* stmt = *slot;
+    const Expr* condition = stmt->as.if_stmt.condition;
+    if(!is_literal(condition, LITERAL_BOOL))
+        return;
+
+    Stmt* live = condition->as.literal.value.bool_val ? stmt->as.if_stmt.then_branch
+                                                      : stmt->as.if_stmt.else_branch;
+    if(live) {
+        *slot = live;
+    } else {
+        make_empty_block(stmt);
+    }
+    stats->pruned++;
+}
+
+static void prune_while(void* state, Stmt** slot, int depth) {
+    (void)depth;
+    AstFoldStats* stats = state;
+    const Expr* condition = (*slot)->as.while_stmt.condition;
+    if(is_literal(condition, LITERAL_BOOL) && !condition->as.literal.value.bool_val) {
+        make_empty_block(*slot);
+        stats->pruned++;
+    }
+}
+
+// Drop empty blocks from a statement list, in place
+static size_t compact(Stmt** statements, size_t count) {
+    size_t kept = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(!is_empty_block(statements[i])) {
+            statements[kept++] = statements[i];
+        }
+    }
+    return kept;
+}
+
+static void compact_block(void* state, Stmt** slot, int depth) {
+    (void)state;
+    (void)depth;
+    Block* block = &(*slot)->as.block;
+    block->count = compact(block->statements, block->count);
+}
+
+// Top-level statements have no enclosing block, so the program list is
+// compacted once the walk is done
+static void compact_program(void* state, ASTNode* node) {
+    (void)state;
+    if(node) {
+        node->as.program.count = compact(node->as.program.statements, node->as.program.count);
+    }
+}
+
+// ===== Pass =====
+
+void ast_fold_pass(AstPass* pass, AstFoldStats* stats) {
+    *stats = (AstFoldStats){0, 0, 0};
+    memset(pass, 0, sizeof(*pass));
+    pass->name = "fold";
+    pass->flags = AST_PASS_REWRITES;
+    pass->state = stats;
+    pass->end = compact_program;
+    pass->post_expr[EXPR_BINARY] = fold_binary;
+    pass->post_expr[EXPR_UNARY] = fold_unary;
+    pass->post_stmt[STMT_IF] = prune_if;
+    pass->post_stmt[STMT_WHILE] = prune_while;
+    pass->post_stmt[STMT_BLOCK] = compact_block;
+}
+
+void ast_fold(ASTNode* node, AstFoldStats* stats) {
+    AstPass pass;
+    ast_fold_pass(&pass, stats);
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, &pass);
+    ast_pass_manager_run(&manager, node);
+    ast_pass_manager_free(&manager);
+}
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/parser/ast_pass.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+
+// ===== Lifecycle =====
+
+void ast_pass_manager_init(AstPassManager* manager) {
+    manager->count = 0;
+    manager->timing = false;
+    manager->walks = 0;
+    manager->nodes = 0;
+    manager->walk_nanos = 0;
+    manager->items = NULL;
+    manager->item_count = 0;
+    manager->item_capacity = 0;
+}
+
+void ast_pass_manager_free(AstPassManager* manager) {
+    free(manager->items);
+    manager->items = NULL;
+    manager->item_capacity = 0;
+}
+
+bool ast_pass_manager_add(AstPassManager* manager, const AstPass* pass) {
+    if(manager->count >= AST_PASS_MAX)
+        return false;
+    manager->stats[manager->count] = (AstPassStats){0, 0};
+    manager->passes[manager->count++] = pass;
+    return true;
+}
+
+// ===== Fused Walk =====
+
+// A node to enter (pre) or leave (post), by the slot that holds it. active has
+// a bit per pass of the current group still visiting this subtree.
+struct PassItem {
+    bool is_stmt;
+    bool post;
+    int depth;
+    uint32_t active;
+    union {
+        Expr** expr;
+        Stmt** stmt;
+    } slot;
+};
+
+static inline uint64_t now_nanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static PassItem* pass_push(AstPassManager* manager, bool is_stmt, bool post, int depth,
+                           uint32_t active) {
+    if(manager->item_count >= manager->item_capacity) {
+        manager->item_capacity = manager->item_capacity ? manager->item_capacity * 2 : 64;
+        manager->items = realloc(manager->items, sizeof(PassItem) * manager->item_capacity);
+    }
+    PassItem* item = &manager->items[manager->item_count++];
+    item->is_stmt = is_stmt;
+    item->post = post;
+    item->depth = depth;
+    item->active = active;
+    return item;
+}
+
+static void push_expr(AstPassManager* manager, Expr** slot, int depth, uint32_t active) {
+    if(*slot) {
+        pass_push(manager, false, false, depth, active)->slot.expr = slot;
+    }
+}
+
+static void push_stmt(AstPassManager* manager, Stmt** slot, int depth, uint32_t active) {
+    if(*slot) {
+        pass_push(manager, true, false, depth, active)->slot.stmt = slot;
+    }
+}
+
+// Children go on the stack last first so they are entered in source order
+static void push_expr_children(AstPassManager* manager, Expr* expr, int depth, uint32_t active) {
+    switch(expr->type) {
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            break;
+        case EXPR_BINARY:
+            push_expr(manager, &expr->as.binary.right, depth, active);
+            push_expr(manager, &expr->as.binary.left, depth, active);
+            break;
+        case EXPR_UNARY:
+            push_expr(manager, &expr->as.unary.right, depth, active);
+            break;
+        case EXPR_CALL:
+            for(size_t i = expr->as.call.arg_count; i > 0; i--) {
+                push_expr(manager, &expr->as.call.args[i - 1], depth, active);
+            }
+            push_expr(manager, &expr->as.call.callee, depth, active);
+            break;
+        case EXPR_INDEX:
+            push_expr(manager, &expr->as.index.index, depth, active);
+            push_expr(manager, &expr->as.index.object, depth, active);
+            break;
+        case EXPR_ARRAY:
+            for(size_t i = expr->as.array.count; i > 0; i--) {
+                push_expr(manager, &expr->as.array.elements[i - 1], depth, active);
+            }
+            break;
+        case EXPR_ASSIGN:
+            push_expr(manager, &expr->as.assign.value, depth, active);
+            break;
+    }
+}
+
+static void push_stmt_children(AstPassManager* manager, Stmt* stmt, int depth, uint32_t active) {
+    switch(stmt->type) {
+        case STMT_EXPR:
+            push_expr(manager, &stmt->as.expr_stmt.expression, depth, active);
+            break;
+        case STMT_VAR_DECL:
+            push_expr(manager, &stmt->as.var_decl.initializer, depth, active);
+            break;
+        case STMT_FUNCTION_DECL:
+            push_stmt(manager, &stmt->as.function_decl.body, depth, active);
+            break;
+        case STMT_IF:
+            push_stmt(manager, &stmt->as.if_stmt.else_branch, depth, active);
+            push_stmt(manager, &stmt->as.if_stmt.then_branch, depth, active);
+            push_expr(manager, &stmt->as.if_stmt.condition, depth, active);
+            break;
+        case STMT_WHILE:
+            push_stmt(manager, &stmt->as.while_stmt.body, depth, active);
+            push_expr(manager, &stmt->as.while_stmt.condition, depth, active);
+            break;
+        case STMT_RETURN:
+            push_expr(manager, &stmt->as.return_stmt.value, depth, active);
+            break;
+        case STMT_BLOCK:
+            for(size_t i = stmt->as.block.count; i > 0; i--) {
+                push_stmt(manager, &stmt->as.block.statements[i - 1], depth, active);
+            }
+            break;
+    }
+}
+
+// Pre-order callbacks of the active passes of group [first, first + n) for
+// one node; returns the passes that go on into its children
+static uint32_t enter(AstPassManager* manager, size_t first, const PassItem* item) {
+    uint32_t children = item->active;
+    for(uint32_t bits = item->active; bits; bits &= bits - 1) {
+        size_t p = first + (size_t)__builtin_ctz(bits);
+        const AstPass* pass = manager->passes[p];
+        bool descend;
+        if(item->is_stmt) {
+            AstPreStmt pre = pass->pre_stmt[(*item->slot.stmt)->type];
+            if(!pre)
+                continue;
+            uint64_t start = manager->timing ? now_nanos() : 0;
+            descend = pre(pass->state, *item->slot.stmt, item->depth);
+            manager->stats[p].nanos += manager->timing ? now_nanos() - start : 0;
+        } else {
+            AstPreExpr pre = pass->pre_expr[(*item->slot.expr)->type];
+            if(!pre)
+                continue;
+            uint64_t start = manager->timing ? now_nanos() : 0;
+            descend = pre(pass->state, *item->slot.expr, item->depth);
+            manager->stats[p].nanos += manager->timing ? now_nanos() - start : 0;
+        }
+        manager->stats[p].calls++;
+        if(!descend) {
+            children &= ~(1u << (p - first));
+        }
+    }
+    return children;
+}
+
+// Post-order callbacks; each pass sees the node as left by the ones before it
+static void leave(AstPassManager* manager, size_t first, const PassItem* item) {
+    for(uint32_t bits = item->active; bits; bits &= bits - 1) {
+        size_t p = first + (size_t)__builtin_ctz(bits);
+        const AstPass* pass = manager->passes[p];
+        uint64_t start;
+        if(item->is_stmt) {
+            AstPostStmt post = *item->slot.stmt ? pass->post_stmt[(*item->slot.stmt)->type] : NULL;
+            if(!post)
+                continue;
+            start = manager->timing ? now_nanos() : 0;
+            post(pass->state, item->slot.stmt, item->depth);
+        } else {
+            AstPostExpr post = *item->slot.expr ? pass->post_expr[(*item->slot.expr)->type] : NULL;
+            if(!post)
+                continue;
+            start = manager->timing ? now_nanos() : 0;
+            post(pass->state, item->slot.expr, item->depth);
+        }
+        manager->stats[p].nanos += manager->timing ? now_nanos() - start : 0;
+        manager->stats[p].calls++;
+    }
+}
+
+// One traversal running passes [first, first + n) side by side
+static void walk_group(AstPassManager* manager, ASTNode* node, size_t first, size_t n) {
+    uint32_t all = n == 32 ? UINT32_MAX : (1u << n) - 1;
+    for(size_t i = node->as.program.count; i > 0; i--) {
+        push_stmt(manager, &node->as.program.statements[i - 1], 0, all);
+    }
+
+    while(manager->item_count > 0) {
+        PassItem item = manager->items[--manager->item_count];
+        if(item.post) {
+            leave(manager, first, &item);
+            continue;
+        }
+
+        manager->nodes++;
+        uint32_t children = enter(manager, first, &item);
+
+        // The post item goes under the children so it pops after them
+        pass_push(manager, item.is_stmt, true, item.depth, item.active)->slot = item.slot;
+        if(!children)
+            continue;
+        if(item.is_stmt) {
+            push_stmt_children(manager, *item.slot.stmt, item.depth + 1, children);
+        } else {
+            push_expr_children(manager, *item.slot.expr, item.depth + 1, children);
+        }
+    }
+}
+
+static bool has_post_callbacks(const AstPass* pass) {
+    for(size_t k = 0; k < AST_EXPR_KINDS; k++) {
+        if(pass->post_expr[k])
+            return true;
+    }
+    for(size_t k = 0; k < AST_STMT_KINDS; k++) {
+        if(pass->post_stmt[k])
+            return true;
+    }
+    return false;
+}
+
+void ast_pass_manager_run(AstPassManager* manager, ASTNode* node) {
+    ast_settle_locs(node);
+    for(size_t p = 0; p < manager->count; p++) {
+        manager->stats[p] = (AstPassStats){0, 0};
+    }
+    manager->walks = 0;
+    manager->nodes = 0;
+    uint64_t start = now_nanos();
+
+    size_t first = 0;
+    while(first < manager->count) {
+        // Extend the group while the next pass can share its walk. A rewriter
+        // ends the group, and joins it only if no pass in it has post-order
+        // callbacks: those would see the children it already replaced.
+        size_t end = first + 1;
+        bool posts = has_post_callbacks(manager->passes[first]);
+        while(end < manager->count && !(manager->passes[end - 1]->flags & AST_PASS_REWRITES)) {
+            const AstPass* pass = manager->passes[end];
+            if((pass->flags & AST_PASS_NEW_WALK) || ((pass->flags & AST_PASS_REWRITES) && posts))
+                break;
+            posts = posts || has_post_callbacks(pass);
+            end++;
+        }
+
+        for(size_t p = first; p < end; p++) {
+            if(manager->passes[p]->begin) {
+                manager->passes[p]->begin(manager->passes[p]->state, node);
+            }
+        }
+        if(node) {
+            walk_group(manager, node, first, end - first);
+        }
+        for(size_t p = first; p < end; p++) {
+            if(manager->passes[p]->end) {
+                manager->passes[p]->end(manager->passes[p]->state, node);
+            }
+        }
+
+        manager->walks++;
+        first = end;
+    }
+
+    manager->walk_nanos = now_nanos() - start;
+}
+
+void ast_pass_manager_report(const AstPassManager* manager, FILE* out) {
+    fprintf(out, "%zu passes, %zu walks, %" PRIu64 " node visits, %.3f ms\n", manager->count,
+            manager->walks, manager->nodes, (double)manager->walk_nanos / 1e6);
+    for(size_t p = 0; p < manager->count; p++) {
+        const AstPassStats* stats = &manager->stats[p];
+        if(manager->timing) {
+            fprintf(out, "  %-24s %10" PRIu64 " calls %10.3f ms\n", manager->passes[p]->name,
+                    stats->calls, (double)stats->nanos / 1e6);
+        } else {
+            fprintf(out, "  %-24s %10" PRIu64 " calls\n", manager->passes[p]->name, stats->calls);
+        }
+    }
+}
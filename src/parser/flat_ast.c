@@ -0,0 +1,412 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/parser/flat_ast.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FLAT_INITIAL_CAPACITY 256
+
+// ===== Lifecycle =====
+
+FlatAst* flat_ast_create(void) {
+    FlatAst* ast = calloc(1, sizeof(FlatAst));
+    line_index_init(&ast->lines);
+    ast->program = flat_ast_add_list(ast, NULL, 0);
+    return ast;
+}
+
+void flat_ast_free(FlatAst* ast) {
+    if(!ast)
+        return;
+
+    free(ast->exprs);
+    free(ast->expr_locs);
+    free(ast->stmts);
+    free(ast->stmt_locs);
+    free(ast->extra);
+    line_index_free(&ast->lines);
+    free(ast);
+}
+
+// ===== Building =====
+
+static uint32_t grow(uint32_t capacity, uint32_t needed) {
+    uint32_t result = capacity ? capacity : FLAT_INITIAL_CAPACITY;
+    while(result < needed) {
+        result *= 2;
+    }
+    return result;
+}
+
+void flat_ast_reserve(FlatAst* ast, uint32_t exprs, uint32_t stmts, uint32_t extra) {
+    if(exprs > ast->expr_capacity) {
+        ast->expr_capacity = exprs;
+        ast->exprs = realloc(ast->exprs, sizeof(FlatExprNode) * exprs);
+        ast->expr_locs = realloc(ast->expr_locs, sizeof(SourceLoc) * exprs);
+    }
+    if(stmts > ast->stmt_capacity) {
+        ast->stmt_capacity = stmts;
+        ast->stmts = realloc(ast->stmts, sizeof(FlatStmtNode) * stmts);
+        ast->stmt_locs = realloc(ast->stmt_locs, sizeof(SourceLoc) * stmts);
+    }
+    if(extra > ast->extra_capacity) {
+        ast->extra_capacity = extra;
+        ast->extra = realloc(ast->extra, sizeof(uint32_t) * extra);
+    }
+}
+
+FlatExpr flat_ast_add_expr(FlatAst* ast, ExprType type, uint8_t op, uint32_t a, uint32_t b,
+                           SourceLoc loc) {
+    if(ast->expr_count == ast->expr_capacity) {
+        ast->expr_capacity = grow(ast->expr_capacity, ast->expr_count + 1);
+        ast->exprs = realloc(ast->exprs, sizeof(FlatExprNode) * ast->expr_capacity);
+        ast->expr_locs = realloc(ast->expr_locs, sizeof(SourceLoc) * ast->expr_capacity);
+    }
+
+    FlatExpr index = ast->expr_count++;
+    ast->exprs[index] = (FlatExprNode){(uint8_t)type, op, a, b};
+    ast->expr_locs[index] = loc;
+    return index;
+}
+
+FlatStmt flat_ast_add_stmt(FlatAst* ast, StmtType type, uint32_t a, uint32_t b, uint32_t c,
+                           SourceLoc loc) {
+    if(ast->stmt_count == ast->stmt_capacity) {
+        ast->stmt_capacity = grow(ast->stmt_capacity, ast->stmt_count + 1);
+        ast->stmts = realloc(ast->stmts, sizeof(FlatStmtNode) * ast->stmt_capacity);
+        ast->stmt_locs = realloc(ast->stmt_locs, sizeof(SourceLoc) * ast->stmt_capacity);
+    }
+
+    FlatStmt index = ast->stmt_count++;
+    ast->stmts[index] = (FlatStmtNode){(uint8_t)type, a, b, c};
+    ast->stmt_locs[index] = loc;
+    return index;
+}
+
+FlatList flat_ast_add_list(FlatAst* ast, const uint32_t* items, uint32_t count) {
+    uint32_t needed = ast->extra_count + 1 + count;
+    if(needed > ast->extra_capacity) {
+        ast->extra_capacity = grow(ast->extra_capacity, needed);
+        ast->extra = realloc(ast->extra, sizeof(uint32_t) * ast->extra_capacity);
+    }
+
+    FlatList list = ast->extra_count;
+    ast->extra[list] = count;
+    if(count > 0) {
+        memcpy(&ast->extra[list + 1], items, sizeof(uint32_t) * count);
+    }
+    ast->extra_count = needed;
+    return list;
+}
+
+// 64-bit payloads (int and float) are split across both operands, low half in a
+void flat_literal_bits(Literal literal, uint32_t* a, uint32_t* b) {
+    uint64_t bits = 0;
+    switch(literal.type) {
+        case LITERAL_INT:
+            bits = (uint64_t)literal.value.int_val;
+            break;
+        case LITERAL_FLOAT:
+            memcpy(&bits, &literal.value.float_val, sizeof(bits));
+            break;
+        case LITERAL_STRING:
+            bits = literal.value.string_val;
+            break;
+        case LITERAL_BOOL:
+            bits = literal.value.bool_val;
+            break;
+    }
+    *a = (uint32_t)bits;
+    *b = (uint32_t)(bits >> 32);
+}
+
+Literal flat_literal(const FlatAst* ast, FlatExpr expr) {
+    const FlatExprNode* node = &ast->exprs[expr];
+    uint64_t bits = (uint64_t)node->b << 32 | node->a;
+
+    Literal literal;
+    literal.type = (LiteralType)node->op;
+    switch(literal.type) {
+        case LITERAL_INT:
+            literal.value.int_val = (int64_t)bits;
+            break;
+        case LITERAL_FLOAT:
+            memcpy(&literal.value.float_val, &bits, sizeof(bits));
+            break;
+        case LITERAL_STRING:
+            literal.value.string_val = (Symbol)bits;
+            break;
+        case LITERAL_BOOL:
+            literal.value.bool_val = bits != 0;
+            break;
+    }
+    return literal;
+}
+
+// ===== Locations =====
+
+void flat_ast_resolve_loc(const FlatAst* ast, SourceLoc loc, uint32_t* line, uint32_t* column) {
+    line_index_lookup(&ast->lines, loc, line, column);
+}
+
+// ===== Conversion to the Pointer Tree =====
+
+// Copy a list of already converted nodes into the tree's arena
+static void** convert_list(Arena* arena, const FlatAst* ast, FlatList list, void** converted,
+                           size_t* count) {
+    uint32_t n;
+    const uint32_t* items = flat_list(ast, list, &n);
+    *count = n;
+    if(n == 0)
+        return NULL;
+
+    void** result = arena_alloc(arena, sizeof(void*) * n);
+    for(uint32_t i = 0; i < n; i++) {
+        result[i] = converted[items[i]];
+    }
+    return result;
+}
+
+static Expr** convert_exprs(Arena* arena, const FlatAst* ast, Arena* scratch) {
+    Expr** converted = arena_alloc(scratch, sizeof(Expr*) * (ast->expr_count + 1));
+
+    for(FlatExpr i = 0; i < ast->expr_count; i++) {
+        const FlatExprNode* node = &ast->exprs[i];
+        Expr* expr = arena_alloc(arena, sizeof(Expr));
+        expr->type = (ExprType)node->type;
+        expr->loc = ast->expr_locs[i];
+
+        switch(expr->type) {
+            case EXPR_LITERAL:
+                expr->as.literal = flat_literal(ast, i);
+                break;
+            case EXPR_VARIABLE:
+                expr->as.variable.name = node->a;
+                expr->as.variable.binding = (Binding){BINDING_UNRESOLVED, 0, 0};
+                break;
+            case EXPR_BINARY:
+                expr->as.binary.left = converted[node->a];
+                expr->as.binary.op = (TokenType)node->op;
+                expr->as.binary.right = converted[node->b];
+                break;
+            case EXPR_UNARY:
+                expr->as.unary.op = (TokenType)node->op;
+                expr->as.unary.right = converted[node->a];
+                break;
+            case EXPR_CALL:
+                expr->as.call.callee = converted[node->a];
+                expr->as.call.args = (Expr**)convert_list(arena, ast, node->b, (void**)converted,
+                                                          &expr->as.call.arg_count);
+                break;
+            case EXPR_INDEX:
+                expr->as.index.object = converted[node->a];
+                expr->as.index.index = converted[node->b];
+                break;
+            case EXPR_ARRAY:
+                expr->as.array.elements = (Expr**)convert_list(
+                    arena, ast, node->a, (void**)converted, &expr->as.array.count);
+                break;
+            case EXPR_ASSIGN:
+                expr->as.assign.name = node->a;
+                expr->as.assign.binding = (Binding){BINDING_UNRESOLVED, 0, 0};
+                expr->as.assign.value = converted[node->b];
+                break;
+        }
+        converted[i] = expr;
+    }
+    return converted;
+}
+
+ASTNode* flat_ast_to_tree(const FlatAst* ast) {
+    ASTNode* root = malloc(sizeof(ASTNode));
+    root->type = NODE_PROGRAM;
+    arena_init(&root->arena, AST_ARENA_CHUNK_SIZE);
+    line_index_init(&root->lines);
+    for(size_t i = 1; i < ast->lines.count; i++) {
+        line_index_note(&root->lines, (uint32_t)(i + 1), ast->lines.starts[i]);
+    }
+
+    // Index-to-pointer maps, dropped once the tree is built
+    Arena scratch;
+    arena_init(&scratch, AST_ARENA_CHUNK_SIZE);
+    Expr** exprs = convert_exprs(&root->arena, ast, &scratch);
+    Stmt** converted = arena_alloc(&scratch, sizeof(Stmt*) * (ast->stmt_count + 1));
+
+    for(FlatStmt i = 0; i < ast->stmt_count; i++) {
+        const FlatStmtNode* node = &ast->stmts[i];
+        Stmt* stmt = arena_alloc(&root->arena, sizeof(Stmt));
+        stmt->type = (StmtType)node->type;
+        stmt->loc = ast->stmt_locs[i];
+
+        switch(stmt->type) {
+            case STMT_EXPR:
+                stmt->as.expr_stmt.expression = exprs[node->a];
+                break;
+            case STMT_VAR_DECL:
+                stmt->as.var_decl.name = node->a;
+                stmt->as.var_decl.type_annotation = node->b;
+                stmt->as.var_decl.initializer = node->c == FLAT_NONE ? NULL : exprs[node->c];
+                break;
+            case STMT_FUNCTION_DECL: {
+                uint32_t n;
+                const uint32_t* params = flat_list(ast, node->b, &n);
+                size_t count = (n - 1) / 2;
+                FunctionDecl* decl = &stmt->as.function_decl;
+                decl->name = node->a;
+                decl->param_count = count;
+                decl->return_type = params[0];
+                decl->param_names = NULL;
+                decl->param_types = NULL;
+                if(count > 0) {
+                    decl->param_names = arena_alloc(&root->arena, sizeof(Symbol) * count * 2);
+                    decl->param_types = decl->param_names + count;
+                    for(size_t p = 0; p < count; p++) {
+                        decl->param_names[p] = params[1 + 2 * p];
+                        decl->param_types[p] = params[2 + 2 * p];
+                    }
+                }
+                decl->body = converted[node->c];
+                break;
+            }
+            case STMT_IF:
+                stmt->as.if_stmt.condition = exprs[node->a];
+                stmt->as.if_stmt.then_branch = converted[node->b];
+                stmt->as.if_stmt.else_branch = node->c == FLAT_NONE ? NULL : converted[node->c];
+                break;
+            case STMT_WHILE:
+                stmt->as.while_stmt.condition = exprs[node->a];
+                stmt->as.while_stmt.body = converted[node->b];
+                break;
+            case STMT_RETURN:
+                stmt->as.return_stmt.value = node->a == FLAT_NONE ? NULL : exprs[node->a];
+                break;
+            case STMT_BLOCK:
+                stmt->as.block.statements = (Stmt**)convert_list(
+                    &root->arena, ast, node->a, (void**)converted, &stmt->as.block.count);
+                break;
+        }
+        converted[i] = stmt;
+    }
+
+    root->as.program.statements = (Stmt**)convert_list(&root->arena, ast, ast->program,
+                                                       (void**)converted, &root->as.program.count);
+    root->as.program.shift_from = 0;
+    root->as.program.shift = 0;
+    arena_free(&scratch);
+    return root;
+}
+
+// ===== Visiting =====
+
+// The walk keeps the nodes still to be entered on a heap stack rather than
+// recursing, so nesting depth is bounded by memory. Children are pushed last
+// to first so they are entered in source order.
+
+typedef struct {
+    uint32_t index;
+    bool is_stmt;
+    int depth;
+} VisitItem;
+
+typedef struct {
+    VisitItem* items;
+    size_t count;
+    size_t capacity;
+} VisitStack;
+
+static void visit_push(VisitStack* stack, uint32_t index, bool is_stmt, int depth) {
+    if(index == FLAT_NONE)
+        return;
+    if(stack->count >= stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 64;
+        stack->items = realloc(stack->items, sizeof(VisitItem) * stack->capacity);
+    }
+    stack->items[stack->count++] = (VisitItem){index, is_stmt, depth};
+}
+
+static void visit_push_list(VisitStack* stack, const FlatAst* ast, FlatList list, bool is_stmt,
+                            int depth) {
+    uint32_t count;
+    const uint32_t* items = flat_list(ast, list, &count);
+    for(uint32_t i = count; i > 0; i--) {
+        visit_push(stack, items[i - 1], is_stmt, depth);
+    }
+}
+
+static void visit_expr(VisitStack* stack, const FlatAst* ast, FlatExpr expr, int depth) {
+    const FlatExprNode* node = &ast->exprs[expr];
+
+    switch((ExprType)node->type) {
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            break;
+        case EXPR_BINARY:
+        case EXPR_INDEX:
+            visit_push(stack, node->b, false, depth + 1);
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case EXPR_UNARY:
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case EXPR_CALL:
+            visit_push_list(stack, ast, node->b, false, depth + 1);
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case EXPR_ARRAY:
+            visit_push_list(stack, ast, node->a, false, depth + 1);
+            break;
+        case EXPR_ASSIGN:
+            visit_push(stack, node->b, false, depth + 1);
+            break;
+    }
+}
+
+static void visit_stmt(VisitStack* stack, const FlatAst* ast, FlatStmt stmt, int depth) {
+    const FlatStmtNode* node = &ast->stmts[stmt];
+
+    switch((StmtType)node->type) {
+        case STMT_EXPR:
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case STMT_VAR_DECL:
+            visit_push(stack, node->c, false, depth + 1);
+            break;
+        case STMT_FUNCTION_DECL:
+            visit_push(stack, node->c, true, depth + 1);
+            break;
+        case STMT_IF:
+            visit_push(stack, node->c, true, depth + 1);
+            visit_push(stack, node->b, true, depth + 1);
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case STMT_WHILE:
+            visit_push(stack, node->b, true, depth + 1);
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case STMT_RETURN:
+            visit_push(stack, node->a, false, depth + 1);
+            break;
+        case STMT_BLOCK:
+            visit_push_list(stack, ast, node->a, true, depth + 1);
+            break;
+    }
+}
+
+void flat_ast_visit(const FlatAst* ast, const FlatVisitor* visitor, void* context) {
+    VisitStack stack = {NULL, 0, 0};
+    visit_push_list(&stack, ast, ast->program, true, 0);
+
+    while(stack.count > 0) {
+        VisitItem item = stack.items[--stack.count];
+        if(item.is_stmt) {
+            if(!visitor->enter_stmt || visitor->enter_stmt(context, ast, item.index, item.depth)) {
+                visit_stmt(&stack, ast, item.index, item.depth);
+            }
+        } else if(!visitor->enter_expr ||
+                  visitor->enter_expr(context, ast, item.index, item.depth)) {
+            visit_expr(&stack, ast, item.index, item.depth);
+        }
+    }
+
+    free(stack.items);
+}
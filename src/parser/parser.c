@@ -1,24 +1,105 @@
 #define _POSIX_C_SOURCE 200809L
 #include "../../include/parser/parser.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define PARSER_ARENA_CHUNK_SIZE (16 * 1024)
+#define PARSER_SLOT_ARENA_CHUNK_SIZE 256
+
+// Fewest tokens worth handing to a parse_parallel worker
+#define PARALLEL_MIN_TOKENS (16 * 1024)
+
 // ===== Parser Lifecycle =====
 
+// A token list cut short by a lexer error has no TOKEN_EOF, and the parser
+// relies on one to stop. Such a list is refused: the parser reads a lone EOF
+// instead and has already failed, so every parse entry point returns NULL.
+static void refuse_truncated(Parser* parser) {
+    Token* end = arena_alloc(&parser->token_arena, sizeof(Token));
+    memset(end, 0, sizeof(*end));
+    end->type = TOKEN_EOF;
+    end->value = "";
+    Token** tokens = arena_alloc(&parser->token_arena, sizeof(Token*));
+    tokens[0] = end;
+
+    parser->tokens = tokens;
+    parser->token_count = 1;
+    parser->buffer = NULL;
+    parser->source = NULL;
+    parser->had_error = true;
+}
+
 Parser* parser_init(Token** tokens, size_t count, const char* filename) {
     Parser* parser = malloc(sizeof(Parser));
     parser->tokens = tokens;
     parser->current = 0;
     parser->token_count = count;
+    parser->buffer = NULL;
+    parser->lexer = NULL;
+    parser->source = NULL;
+    arena_init(&parser->token_arena, PARSER_ARENA_CHUNK_SIZE);
+    for(size_t i = 0; i < PARSER_TOKEN_WINDOW; i++) {
+        parser->window_index[i] = SIZE_MAX;
+        arena_init(&parser->window_arena[i], PARSER_SLOT_ARENA_CHUNK_SIZE);
+    }
+    parser->pulled = 0;
+    arena_init(&parser->ast_arena, AST_ARENA_CHUNK_SIZE);
+    line_index_init(&parser->lines);
+    parser->note_lines = true;
+    parser->staged = NULL;
+    parser->staged_count = 0;
+    parser->staged_capacity = 0;
+    parser->staged_symbols = NULL;
+    parser->staged_symbol_count = 0;
+    parser->staged_symbol_capacity = 0;
+    parser->operands = NULL;
+    parser->operand_count = 0;
+    parser->operand_capacity = 0;
+    parser->pending = NULL;
+    parser->pending_count = 0;
+    parser->pending_capacity = 0;
     parser->had_error = false;
     parser->panic_mode = false;
+    parser->quiet = false;
     parser->filename = filename;
+    if(tokens && (count == 0 || tokens[count - 1]->type != TOKEN_EOF)) {
+        refuse_truncated(parser);
+    }
+    return parser;
+}
+
+Parser* parser_init_soa(const TokenBuffer* buffer, SourceFile* source, const char* filename) {
+    Parser* parser = parser_init(NULL, buffer->count, filename);
+    parser->buffer = buffer;
+    parser->source = source;
+    if(buffer->count == 0 || buffer->types[buffer->count - 1] != TOKEN_EOF) {
+        refuse_truncated(parser);
+    }
+    return parser;
+}
+
+Parser* parser_init_streaming(Lexer* lexer, const char* filename) {
+    // The count is unknown until EOF is pulled; until then no index is clamped
+    Parser* parser = parser_init(NULL, SIZE_MAX, filename);
+    parser->lexer = lexer;
+    parser->source = lexer->source;
     return parser;
 }
 
 void parser_free(Parser* parser) {
+    arena_free(&parser->token_arena);
+    arena_free(&parser->ast_arena);  // Nodes not handed to a tree by parse()
+    line_index_free(&parser->lines);
+    free(parser->staged);
+    free(parser->staged_symbols);
+    free(parser->operands);
+    free(parser->pending);
+    for(size_t i = 0; i < PARSER_TOKEN_WINDOW; i++) {
+        arena_free(&parser->window_arena[i]);
+    }
     free(parser);
 }
 
@@ -26,41 +107,134 @@ void parser_free(Parser* parser) {
 
 // ===== Token Utilities =====
 
-Token* peek(Parser* parser) {
-    if(parser->current >= parser->token_count) {
-        return parser->tokens[parser->token_count - 1];  // EOF
+// Pull tokens from the lexer into the ring until token i is in it
+static void pull_to(Parser* parser, size_t i) {
+    while(parser->pulled <= i && parser->pulled < parser->token_count) {
+        size_t slot = parser->pulled % PARSER_TOKEN_WINDOW;
+        Token* token = &parser->window[slot];
+        Arena* arena = &parser->window_arena[slot];
+
+        do {
+            arena_reset(arena);
+            if(!lexer_scan_token(parser->lexer, token, arena)) {
+                // The lexer has reported the error; treat it as the end of input
+                parser->had_error = true;
+                token->type = TOKEN_EOF;
+                token->value = token_lexeme(TOKEN_EOF);
+                token->symbol = SYMBOL_NONE;
+                token->length = 0;
+            }
+        } while(token->type == TOKEN_COMMENT);
+
+        parser->window_index[slot] = parser->pulled;
+        if(token->type == TOKEN_EOF) {
+            parser->token_count = parser->pulled + 1;
+        }
+        parser->pulled++;
     }
-    return parser->tokens[parser->current];
 }
 
-Token* peek_next(Parser* parser) {
-    if(parser->current + 1 >= parser->token_count) {
-        return parser->tokens[parser->token_count - 1];  // EOF
+// Token object for position i in the ring, built from the struct-of-arrays
+// buffer on first use
+static Token* window_at(Parser* parser, size_t i) {
+    size_t slot = i % PARSER_TOKEN_WINDOW;
+    Token* token = &parser->window[slot];
+    if(parser->window_index[slot] == i) {
+        return token;
     }
-    return parser->tokens[parser->current + 1];
+
+    const TokenBuffer* buffer = parser->buffer;
+    Arena* arena = &parser->window_arena[slot];
+    arena_reset(arena);
+    token->type = (TokenType)buffer->types[i];
+    token->source = parser->source;
+    token->offset = buffer->starts[i];
+    token->length = buffer->lens[i];
+    token->line = buffer->lines[i];
+    token->column = buffer->columns[i];
+    if(token->type == TOKEN_STRING) {
+        // parse_literal interns strings straight from the slice, so no value is built
+        token->value = NULL;
+        token->symbol = SYMBOL_NONE;
+    } else {
+        token_materialize(token, arena, token_text(token));
+        token_decode_number(token, token_text(token));  // The buffer keeps no payload
+    }
+
+    parser->window_index[slot] = i;
+    return token;
+}
+
+// Map position i to a token that exists; positions past the end read EOF. A
+// streaming parser first pulls up to i, which is also how it finds the end.
+static inline size_t resolve_index(Parser* parser, size_t i) {
+    if(parser->lexer) {
+        if(i == SIZE_MAX) {
+            i = 0;  // previous() before anything was consumed
+        }
+        pull_to(parser, i);
+    }
+    return i < parser->token_count ? i : parser->token_count - 1;
+}
+
+// Type of token i, read straight from the type array in struct-of-arrays mode
+static inline TokenType type_at(Parser* parser, size_t i) {
+    i = resolve_index(parser, i);
+    if(parser->tokens) {
+        return parser->tokens[i]->type;
+    }
+    if(parser->lexer) {
+        return parser->window[i % PARSER_TOKEN_WINDOW].type;
+    }
+    return (TokenType)parser->buffer->types[i];
+}
+
+// Token object for position i; see Parser for how long it stays valid
+static Token* token_at(Parser* parser, size_t i) {
+    i = resolve_index(parser, i);
+    if(parser->tokens) {
+        return parser->tokens[i];
+    }
+    if(parser->lexer) {
+        return &parser->window[i % PARSER_TOKEN_WINDOW];
+    }
+    return window_at(parser, i);
+}
+
+Token* peek(Parser* parser) {
+    return token_at(parser, parser->current);
+}
+
+Token* peek_next(Parser* parser) {
+    return token_at(parser, parser->current + 1);
 }
 
 Token* previous(Parser* parser) {
-    return parser->tokens[parser->current - 1];
+    return token_at(parser, parser->current - 1);
 }
 
-Token* advance(Parser* parser) {
+// Move past the current token without materializing it
+static void skip(Parser* parser) {
     if(!is_at_end(parser)) {
         parser->current++;
     }
+}
+
+Token* advance(Parser* parser) {
+    skip(parser);
     return previous(parser);
 }
 
 bool check(Parser* parser, TokenType type) {
     if(is_at_end(parser))
         return false;
-    return peek(parser)->type == type;
+    return type_at(parser, parser->current) == type;
 }
 
 bool match(Parser* parser, TokenType type) {
     if(!check(parser, type))
         return false;
-    advance(parser);
+    skip(parser);
     return true;
 }
 
@@ -73,11 +247,24 @@ Token* consume(Parser* parser, TokenType type, const char* message) {
 }
 
 bool is_at_end(Parser* parser) {
-    return peek(parser)->type == TOKEN_EOF;
+    return type_at(parser, parser->current) == TOKEN_EOF;
 }
 
 // ===== Error Handling =====
 
+// String tokens in struct-of-arrays mode have no value; show their source text
+static void report_at(Parser* parser, const Token* token, const char* message) {
+    if(parser->quiet)
+        return;
+    if(token->value) {
+        fprintf(stderr, "[%s:%u] Error at '%s': %s\n", parser->filename, token->line,
+                token->value, message);
+    } else {
+        fprintf(stderr, "[%s:%u] Error at '%.*s': %s\n", parser->filename, token->line,
+                (int)token->length, token_text(token), message);
+    }
+}
+
 void parser_error(Parser* parser, const char* message) {
     if(parser->panic_mode)
         return;
@@ -85,8 +272,7 @@ void parser_error(Parser* parser, const char* message) {
     parser->had_error = true;
 
     Token* token = previous(parser);
-    fprintf(stderr, "[%s:%u] Error at '%s': %s\n", parser->filename, token->line, token->value,
-            message);
+    report_at(parser, token, message);
 }
 
 void parser_error_at_current(Parser* parser, const char* message) {
@@ -96,18 +282,17 @@ void parser_error_at_current(Parser* parser, const char* message) {
     parser->had_error = true;
 
     Token* token = peek(parser);
-    fprintf(stderr, "[%s:%u] Error at '%s': %s\n", parser->filename, token->line, token->value,
-            message);
+    report_at(parser, token, message);
 }
 
 void synchronize(Parser* parser) {
     parser->panic_mode = false;
 
     while(!is_at_end(parser)) {
-        if(previous(parser)->type == TOKEN_SEMICOLON)
+        if(type_at(parser, parser->current - 1) == TOKEN_SEMICOLON)
             return;
 
-        switch(peek(parser)->type) {
+        switch(type_at(parser, parser->current)) {
             case TOKEN_ABEG:   // let/var
             case TOKEN_WAKA:   // loop
             case TOKEN_ABI:    // if
@@ -117,279 +302,668 @@ void synchronize(Parser* parser) {
             default:
                 break;
         }
-        advance(parser);
+        skip(parser);
     }
 }
 
+// ===== Node Allocation =====
+
+// Location of a node starting at token. The token's line start goes into the
+// parser's line table so the tree can still resolve the location once the
+// tokens are gone.
+static SourceLoc location_of(Parser* parser, const Token* token) {
+    if(token->column > 0 && parser->note_lines) {
+        line_index_note(&parser->lines, token->line, token->offset - (token->column - 1));
+    }
+    return source_loc(token->offset);
+}
+
+static Expr* new_expr(Parser* parser, ExprType type, SourceLoc loc) {
+    Expr* expr = arena_alloc(&parser->ast_arena, sizeof(Expr));
+    expr->type = type;
+    expr->loc = loc;
+    return expr;
+}
+
+static Stmt* new_stmt(Parser* parser, StmtType type, SourceLoc loc) {
+    Stmt* stmt = arena_alloc(&parser->ast_arena, sizeof(Stmt));
+    stmt->type = type;
+    stmt->loc = loc;
+    return stmt;
+}
+
+static void stage(Parser* parser, void* child) {
+    if(parser->staged_count >= parser->staged_capacity) {
+        parser->staged_capacity = parser->staged_capacity ? parser->staged_capacity * 2 : 64;
+        parser->staged = realloc(parser->staged, sizeof(void*) * parser->staged_capacity);
+    }
+    parser->staged[parser->staged_count++] = child;
+}
+
+// Move the children staged since mark into an arena array
+static Expr** finish_exprs(Parser* parser, size_t mark, size_t* count) {
+    size_t n = parser->staged_count - mark;
+    Expr** items = n ? arena_alloc(&parser->ast_arena, sizeof(Expr*) * n) : NULL;
+    for(size_t i = 0; i < n; i++) {
+        items[i] = parser->staged[mark + i];
+    }
+    parser->staged_count = mark;
+    *count = n;
+    return items;
+}
+
+static Stmt** finish_stmts(Parser* parser, size_t mark, size_t* count) {
+    size_t n = parser->staged_count - mark;
+    Stmt** items = n ? arena_alloc(&parser->ast_arena, sizeof(Stmt*) * n) : NULL;
+    for(size_t i = 0; i < n; i++) {
+        items[i] = parser->staged[mark + i];
+    }
+    parser->staged_count = mark;
+    *count = n;
+    return items;
+}
+
+static void stage_symbol(Parser* parser, Symbol symbol) {
+    if(parser->staged_symbol_count >= parser->staged_symbol_capacity) {
+        parser->staged_symbol_capacity =
+            parser->staged_symbol_capacity ? parser->staged_symbol_capacity * 2 : 16;
+        parser->staged_symbols =
+            realloc(parser->staged_symbols, sizeof(Symbol) * parser->staged_symbol_capacity);
+    }
+    parser->staged_symbols[parser->staged_symbol_count++] = symbol;
+}
+
+// ===== Flat AST Staging =====
+
+// parse_flat emits into a FlatAst instead of allocating Expr/Stmt nodes (see
+// Flat AST Emission below). The expression engine serves both, so the
+// emitter's list staging is declared here.
+
+typedef struct {
+    Parser* parser;
+    FlatAst* ast;
+
+    // Children of the lists under construction, as in Parser.staged
+    uint32_t* staged;
+    uint32_t staged_count;
+    uint32_t staged_capacity;
+} FlatEmitter;
+
+static void flat_stage(FlatEmitter* emitter, uint32_t item) {
+    if(emitter->staged_count >= emitter->staged_capacity) {
+        emitter->staged_capacity = emitter->staged_capacity ? emitter->staged_capacity * 2 : 64;
+        emitter->staged = realloc(emitter->staged, sizeof(uint32_t) * emitter->staged_capacity);
+    }
+    emitter->staged[emitter->staged_count++] = item;
+}
+
+// Move the items staged since mark into the extra array
+static FlatList flat_finish_list(FlatEmitter* emitter, uint32_t mark) {
+    FlatList list =
+        flat_ast_add_list(emitter->ast, emitter->staged + mark, emitter->staged_count - mark);
+    emitter->staged_count = mark;
+    return list;
+}
+
 // ===== Pratt Parsing - Expressions =====
 
-// Forward declarations
-
-// Prefix parse functions
-static Expr* parse_grouping(Parser* parser);  // ( expr )
-static Expr* parse_literal(Parser* parser);   // 42, 3.14, "hello", true
-static Expr* parse_variable(Parser* parser);  // identifier
-static Expr* parse_unary(Parser* parser);     // -expr, !expr
-static Expr* parse_array(Parser* parser);     // [1, 2, 3]
-
-// Infix parse functions
-static Expr* parse_binary(Parser* parser, Expr* left);  // left + right
-static Expr* parse_call(Parser* parser, Expr* left);    // func(args)
-static Expr* parse_index(Parser* parser, Expr* left);   // arr[index]
-static Expr* parse_assign(Parser* parser, Expr* left);
-
-// Parse rule table - maps token types to parsing functions
-ParseRule rules[] = {
-    [TOKEN_LPAREN] = {parse_grouping, parse_call, PREC_CALL},
-    [TOKEN_RPAREN] = {NULL, NULL, PREC_NONE},
-    [TOKEN_LBRACE] = {NULL, NULL, PREC_NONE},
-    [TOKEN_RBRACE] = {NULL, NULL, PREC_NONE},
-    [TOKEN_LBRACKET] = {parse_array, parse_index, PREC_CALL},
-    [TOKEN_RBRACKET] = {NULL, NULL, PREC_NONE},
-    [TOKEN_COMMA] = {NULL, NULL, PREC_NONE},
-    [TOKEN_SEMICOLON] = {NULL, NULL, PREC_NONE},
-    [TOKEN_COLON] = {NULL, NULL, PREC_NONE},
+// Parse rule table - maps token types to what they do in an expression. Every
+// token type has a row, so get_rule never reads past the table.
+static const ParseRule rules[TOKEN_TYPE + 1] = {
+    [TOKEN_ILLEGAL] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_COMMENT] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_LPAREN] = {PREFIX_GROUPING, INFIX_CALL, PREC_CALL},
+    [TOKEN_RPAREN] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_LBRACE] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_RBRACE] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_LBRACKET] = {PREFIX_ARRAY, INFIX_INDEX, PREC_CALL},
+    [TOKEN_RBRACKET] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_COMMA] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_SEMICOLON] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_COLON] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
 
     // Operators
-    [TOKEN_PLUS] = {NULL, parse_binary, PREC_TERM},
-    [TOKEN_MINUS] = {parse_unary, parse_binary, PREC_TERM},
-    [TOKEN_ASTERISK] = {NULL, parse_binary, PREC_FACTOR},
-    [TOKEN_SLASH] = {NULL, parse_binary, PREC_FACTOR},
-    [TOKEN_BANG] = {parse_unary, NULL, PREC_NONE},
-    [TOKEN_ASSIGN] = {NULL, parse_assign, PREC_ASSIGNMENT},
-    [TOKEN_EQUAL] = {NULL, parse_binary, PREC_EQUALITY},
-    [TOKEN_NOT_EQUAL] = {NULL, parse_binary, PREC_EQUALITY},
-    [TOKEN_LESS_THAN] = {NULL, parse_binary, PREC_COMPARISON},
-    [TOKEN_GREATER_THAN] = {NULL, parse_binary, PREC_COMPARISON},
+    [TOKEN_PLUS] = {PREFIX_NONE, INFIX_BINARY, PREC_TERM},
+    [TOKEN_MINUS] = {PREFIX_UNARY, INFIX_BINARY, PREC_TERM},
+    [TOKEN_ASTERISK] = {PREFIX_NONE, INFIX_BINARY, PREC_FACTOR},
+    [TOKEN_SLASH] = {PREFIX_NONE, INFIX_BINARY, PREC_FACTOR},
+    [TOKEN_BANG] = {PREFIX_UNARY, INFIX_NONE, PREC_NONE},
+    [TOKEN_ASSIGN] = {PREFIX_NONE, INFIX_ASSIGN, PREC_ASSIGNMENT},
+    [TOKEN_EQUAL] = {PREFIX_NONE, INFIX_BINARY, PREC_EQUALITY},
+    [TOKEN_NOT_EQUAL] = {PREFIX_NONE, INFIX_BINARY, PREC_EQUALITY},
+    [TOKEN_LESS_THAN] = {PREFIX_NONE, INFIX_BINARY, PREC_COMPARISON},
+    [TOKEN_GREATER_THAN] = {PREFIX_NONE, INFIX_BINARY, PREC_COMPARISON},
 
     // Literals
-    [TOKEN_INTEGER] = {parse_literal, NULL, PREC_NONE},
-    [TOKEN_FLOAT] = {parse_literal, NULL, PREC_NONE},
-    [TOKEN_STRING] = {parse_literal, NULL, PREC_NONE},
-    [TOKEN_TRUE] = {parse_literal, NULL, PREC_NONE},
-    [TOKEN_FALSE] = {parse_literal, NULL, PREC_NONE},
+    [TOKEN_INTEGER] = {PREFIX_LITERAL, INFIX_NONE, PREC_NONE},
+    [TOKEN_FLOAT] = {PREFIX_LITERAL, INFIX_NONE, PREC_NONE},
+    [TOKEN_STRING] = {PREFIX_LITERAL, INFIX_NONE, PREC_NONE},
+    [TOKEN_TRUE] = {PREFIX_LITERAL, INFIX_NONE, PREC_NONE},
+    [TOKEN_FALSE] = {PREFIX_LITERAL, INFIX_NONE, PREC_NONE},
 
     // Keywords
-    [TOKEN_AND] = {NULL, parse_binary, PREC_AND},
-    [TOKEN_OR] = {NULL, parse_binary, PREC_OR},
-    [TOKEN_OR_ELSE] = {NULL, parse_binary, PREC_OR},
-
-    // Identifier
-    [TOKEN_IDENT] = {parse_variable, NULL, PREC_NONE},
-
-    [TOKEN_EOF] = {NULL, NULL, PREC_NONE},
+    [TOKEN_ABEG] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_OYA] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_WAKA] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_COMOT] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_ABI] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_NASO] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+    [TOKEN_AND] = {PREFIX_NONE, INFIX_BINARY, PREC_AND},
+    [TOKEN_OR] = {PREFIX_NONE, INFIX_BINARY, PREC_OR},
+    [TOKEN_OR_ELSE] = {PREFIX_NONE, INFIX_BINARY, PREC_OR},
+
+    // Identifier and type names
+    [TOKEN_IDENT] = {PREFIX_VARIABLE, INFIX_NONE, PREC_NONE},
+    [TOKEN_TYPE] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
+
+    [TOKEN_EOF] = {PREFIX_NONE, INFIX_NONE, PREC_NONE},
 };
 
-ParseRule* get_rule(TokenType type) {
+const ParseRule* get_rule(TokenType type) {
+    static const ParseRule none = {PREFIX_NONE, INFIX_NONE, PREC_NONE};
+    if((size_t)type >= sizeof(rules) / sizeof(rules[0]))
+        return &none;
     return &rules[type];
 }
 
-Expr* parse_expression(Parser* parser) {
-    return parse_precedence(parser, PREC_ASSIGNMENT);
-}
-
-Expr* parse_precedence(Parser* parser, Precedence precedence) {
-    advance(parser);
+// A finished operand: a node of the tree parse builds, or of the flat one
+union ExprRef {
+    Expr* expr;
+    FlatExpr flat;
+};
 
-    ParseRule* rule = get_rule(previous(parser)->type);
-    PrefixParseFn prefix = rule->prefix;
+// What an operator still has to do once the operand it waits for is complete
+typedef enum {
+    PENDING_UNARY,     // -x, !x: wrap it
+    PENDING_BINARY,    // Combine it with the left operand
+    PENDING_ASSIGN,    // Assign it to the target name
+    PENDING_GROUPING,  // Expect ')'
+    PENDING_INDEX,     // Expect ']', then combine it with the object
+    PENDING_CALL,      // Stage it as an argument; another one follows a ','
+    PENDING_ARRAY      // Stage it as an element; another one follows a ','
+} PendingKind;
+
+struct PendingExpr {
+    PendingKind kind;
+    TokenType op;
+    Precedence precedence;  // Of the operator loop to resume afterwards
+    SourceLoc loc;
+    union {
+        size_t mark;  // Staged count before the first item (call, array)
+        Symbol name;  // Assignment target
+    } as;
+};
 
-    if(prefix == NULL) {
-        parser_error(parser, "Expected expression");
-        return NULL;
+static void push_operand(Parser* parser, ExprRef operand) {
+    if(parser->operand_count >= parser->operand_capacity) {
+        parser->operand_capacity = parser->operand_capacity ? parser->operand_capacity * 2 : 64;
+        parser->operands = realloc(parser->operands, sizeof(ExprRef) * parser->operand_capacity);
     }
+    parser->operands[parser->operand_count++] = operand;
+}
 
-    Expr* left = prefix(parser);
+static ExprRef pop_operand(Parser* parser) {
+    return parser->operands[--parser->operand_count];
+}
 
-    while(precedence <= get_rule(peek(parser)->type)->precedence) {
-        advance(parser);
-        InfixParseFn infix = get_rule(previous(parser)->type)->infix;
-        left = infix(parser, left);
+static PendingExpr* push_pending(Parser* parser, PendingKind kind, Precedence precedence,
+                                 SourceLoc loc) {
+    if(parser->pending_count >= parser->pending_capacity) {
+        parser->pending_capacity = parser->pending_capacity ? parser->pending_capacity * 2 : 64;
+        parser->pending = realloc(parser->pending, sizeof(PendingExpr) * parser->pending_capacity);
     }
-
-    return left;
+    PendingExpr* pending = &parser->pending[parser->pending_count++];
+    pending->kind = kind;
+    pending->precedence = precedence;
+    pending->loc = loc;
+    return pending;
 }
 
-// ===== Prefix Parse Functions =====
+// ===== Expression Nodes =====
 
-static Expr* parse_grouping(Parser* parser) {
-    Expr* expr = parse_expression(parser);
-    consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
-    return expr;
+// Each builder makes an Expr when emitter is NULL (parse) and a flat node
+// otherwise (parse_flat); children always exist before their parent.
+
+static ExprRef no_expr(FlatEmitter* emitter) {
+    ExprRef ref;
+    if(emitter) {
+        ref.flat = FLAT_NONE;
+    } else {
+        ref.expr = NULL;
+    }
+    return ref;
 }
 
-static Expr* parse_literal(Parser* parser) {
-    Token* token = previous(parser);
+// Intern the body of a string literal. Materialized tokens already carry the
+// decoded value; otherwise the body is taken from the source slice, which
+// copies nothing unless the literal has escapes.
+static Symbol intern_string(Parser* parser, const Token* token) {
+    if(token->value) {
+        return symbol_intern_cstr(token->value);
+    }
 
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_LITERAL;
-    expr->token = token;
+    size_t len;
+    const char* body = token_string_body(&parser->token_arena, token_text(token), token->length,
+                                         &len);
+    Symbol symbol = body ? symbol_intern(body, len) : SYMBOL_NONE;
+    arena_reset(&parser->token_arena);  // The symbol table has its own copy
+    return symbol;
+}
 
+static bool decode_literal(Parser* parser, const Token* token, Literal* literal) {
     switch(token->type) {
         case TOKEN_INTEGER:
-            expr->as.literal.type = LITERAL_INT;
-            expr->as.literal.value.int_val = atoi(token->value);
-            break;
+            literal->type = LITERAL_INT;
+            literal->value.int_val = token->number.int_val;
+            return true;
         case TOKEN_FLOAT:
-            expr->as.literal.type = LITERAL_FLOAT;
-            expr->as.literal.value.float_val = atof(token->value);
-            break;
+            literal->type = LITERAL_FLOAT;
+            literal->value.float_val = token->number.float_val;
+            return true;
         case TOKEN_STRING:
-            expr->as.literal.type = LITERAL_STRING;
-            expr->as.literal.value.string_val = strdup(token->value);
-            break;
+            literal->type = LITERAL_STRING;
+            literal->value.string_val = intern_string(parser, token);
+            return true;
         case TOKEN_TRUE:
-            expr->as.literal.type = LITERAL_BOOL;
-            expr->as.literal.value.bool_val = true;
-            break;
         case TOKEN_FALSE:
-            expr->as.literal.type = LITERAL_BOOL;
-            expr->as.literal.value.bool_val = false;
-            break;
+            literal->type = LITERAL_BOOL;
+            literal->value.bool_val = token->type == TOKEN_TRUE;
+            return true;
         default:
             parser_error(parser, "Unknown literal type");
-            free(expr);
-            return NULL;
+            return false;
     }
-
-    return expr;
 }
 
-static Expr* parse_variable(Parser* parser) {
-    Token* name = previous(parser);
+// Literal or variable for the token just consumed
+static ExprRef build_leaf(Parser* parser, FlatEmitter* emitter) {
+    Token* token = previous(parser);
+    SourceLoc loc = location_of(parser, token);
+    ExprRef ref;
+
+    if(token->type == TOKEN_IDENT) {
+        if(emitter) {
+            ref.flat = flat_ast_add_expr(emitter->ast, EXPR_VARIABLE, 0, token->symbol, 0, loc);
+        } else {
+            ref.expr = new_expr(parser, EXPR_VARIABLE, loc);
+            ref.expr->as.variable.name = token->symbol;
+            ref.expr->as.variable.binding = (Binding){BINDING_UNRESOLVED, 0, 0};
+        }
+        return ref;
+    }
 
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_VARIABLE;
-    expr->token = name;
-    expr->as.variable.name = strdup(name->value);
+    Literal literal;
+    if(!decode_literal(parser, token, &literal)) {
+        return no_expr(emitter);
+    }
 
-    return expr;
+    if(emitter) {
+        uint32_t a, b;
+        flat_literal_bits(literal, &a, &b);
+        ref.flat = flat_ast_add_expr(emitter->ast, EXPR_LITERAL, (uint8_t)literal.type, a, b, loc);
+    } else {
+        ref.expr = new_expr(parser, EXPR_LITERAL, loc);
+        ref.expr->as.literal = literal;
+    }
+    return ref;
 }
 
-static Expr* parse_unary(Parser* parser) {
-    Token* op = previous(parser);
-    Expr* right = parse_precedence(parser, PREC_UNARY);
+static ExprRef build_unary(Parser* parser, FlatEmitter* emitter, const PendingExpr* op,
+                           ExprRef right) {
+    ExprRef ref;
+    if(emitter) {
+        ref.flat =
+            flat_ast_add_expr(emitter->ast, EXPR_UNARY, (uint8_t)op->op, right.flat, 0, op->loc);
+    } else {
+        ref.expr = new_expr(parser, EXPR_UNARY, op->loc);
+        ref.expr->as.unary.op = op->op;
+        ref.expr->as.unary.right = right.expr;
+    }
+    return ref;
+}
 
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_UNARY;
-    expr->token = op;
-    expr->as.unary.op = op->type;
-    expr->as.unary.right = right;
+static ExprRef build_binary(Parser* parser, FlatEmitter* emitter, const PendingExpr* op,
+                            ExprRef left, ExprRef right) {
+    ExprRef ref;
+    if(emitter) {
+        ref.flat = flat_ast_add_expr(emitter->ast, EXPR_BINARY, (uint8_t)op->op, left.flat,
+                                     right.flat, op->loc);
+    } else {
+        ref.expr = new_expr(parser, EXPR_BINARY, op->loc);
+        ref.expr->as.binary.left = left.expr;
+        ref.expr->as.binary.op = op->op;
+        ref.expr->as.binary.right = right.expr;
+    }
+    return ref;
+}
 
-    return expr;
+static ExprRef build_index(Parser* parser, FlatEmitter* emitter, const PendingExpr* op,
+                           ExprRef object, ExprRef index) {
+    ExprRef ref;
+    if(emitter) {
+        ref.flat =
+            flat_ast_add_expr(emitter->ast, EXPR_INDEX, 0, object.flat, index.flat, op->loc);
+    } else {
+        ref.expr = new_expr(parser, EXPR_INDEX, op->loc);
+        ref.expr->as.index.object = object.expr;
+        ref.expr->as.index.index = index.expr;
+    }
+    return ref;
 }
 
-static Expr* parse_array(Parser* parser) {
-    // [1, 2, 3]
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_ARRAY;
-    expr->token = previous(parser);
-    expr->as.array.elements = NULL;
-    expr->as.array.count = 0;
+// Name assigned to by left; false if left is not a variable. In the flat
+// form the target was the last node emitted and is dropped again; in the tree
+// it stays in the arena unused and goes with the tree.
+static bool assign_target(FlatEmitter* emitter, ExprRef left, Symbol* name) {
+    if(!emitter) {
+        if(!left.expr || left.expr->type != EXPR_VARIABLE)
+            return false;
+        *name = left.expr->as.variable.name;
+        return true;
+    }
 
-    if(!check(parser, TOKEN_RBRACKET)) {
-        size_t capacity = 8;
-        expr->as.array.elements = malloc(sizeof(Expr*) * capacity);
+    FlatAst* ast = emitter->ast;
+    if(left.flat == FLAT_NONE || ast->exprs[left.flat].type != EXPR_VARIABLE)
+        return false;
+    *name = ast->exprs[left.flat].a;
+    if(left.flat == ast->expr_count - 1) {
+        ast->expr_count--;
+    }
+    return true;
+}
 
-        do {
-            if(expr->as.array.count >= capacity) {
-                capacity *= 2;
-                expr->as.array.elements =
-                    realloc(expr->as.array.elements, sizeof(Expr*) * capacity);
-            }
-            expr->as.array.elements[expr->as.array.count++] = parse_expression(parser);
-        } while(match(parser, TOKEN_COMMA));
+static ExprRef build_assign(Parser* parser, FlatEmitter* emitter, const PendingExpr* op,
+                            ExprRef value) {
+    ExprRef ref;
+    if(emitter) {
+        ref.flat =
+            flat_ast_add_expr(emitter->ast, EXPR_ASSIGN, 0, op->as.name, value.flat, op->loc);
+    } else {
+        ref.expr = new_expr(parser, EXPR_ASSIGN, op->loc);
+        ref.expr->as.assign.name = op->as.name;
+        ref.expr->as.assign.binding = (Binding){BINDING_UNRESOLVED, 0, 0};
+        ref.expr->as.assign.value = value.expr;
     }
+    return ref;
+}
 
-    consume(parser, TOKEN_RBRACKET, "Expected ']' after array elements");
-    return expr;
+static size_t staged_mark(Parser* parser, FlatEmitter* emitter) {
+    return emitter ? emitter->staged_count : parser->staged_count;
 }
 
-// ===== Infix Parse Functions =====
+static void stage_operand(Parser* parser, FlatEmitter* emitter, ExprRef item) {
+    if(emitter) {
+        flat_stage(emitter, item.flat);
+    } else {
+        stage(parser, item.expr);
+    }
+}
 
-static Expr* parse_binary(Parser* parser, Expr* left) {
-    Token* op = previous(parser);
-    ParseRule* rule = get_rule(op->type);
+// Call of callee (PENDING_CALL) or array literal (PENDING_ARRAY) holding the
+// items staged since mark
+static ExprRef build_list(Parser* parser, FlatEmitter* emitter, PendingKind kind, ExprRef callee,
+                          size_t mark, SourceLoc loc) {
+    ExprRef ref;
+    if(emitter) {
+        FlatList items = flat_finish_list(emitter, (uint32_t)mark);
+        if(kind == PENDING_CALL) {
+            ref.flat = flat_ast_add_expr(emitter->ast, EXPR_CALL, 0, callee.flat, items, loc);
+        } else {
+            ref.flat = flat_ast_add_expr(emitter->ast, EXPR_ARRAY, 0, items, 0, loc);
+        }
+    } else if(kind == PENDING_CALL) {
+        ref.expr = new_expr(parser, EXPR_CALL, loc);
+        ref.expr->as.call.callee = callee.expr;
+        ref.expr->as.call.args = finish_exprs(parser, mark, &ref.expr->as.call.arg_count);
+    } else {
+        ref.expr = new_expr(parser, EXPR_ARRAY, loc);
+        ref.expr->as.array.elements = finish_exprs(parser, mark, &ref.expr->as.array.count);
+    }
+    return ref;
+}
 
-    // Parse right side with higher precedence (left-associative)
-    Expr* right = parse_precedence(parser, (Precedence)(rule->precedence + 1));
+// ===== Expression Engine =====
+
+// Pratt parsing without recursion. Where the recursive formulation would call
+// itself for an operand (the right side of a binary operator, the inside of
+// parentheses, each argument), the operator is pushed on parser->pending
+// together with the precedence its loop runs at, its left operand goes on
+// parser->operands, and parsing continues at the operand's start. Once an
+// operand is complete, the topmost pending operator takes it and the loop it
+// came from resumes. Tokens are consumed, nodes built and errors reported in
+// the same order as the recursive version.
+static ExprRef parse_operators(Parser* parser, FlatEmitter* emitter, Precedence precedence) {
+    size_t base = parser->pending_count;
+    Precedence current = precedence;
+    ExprRef result;
+
+    for(;;) {
+        // Prefix position: the next token starts an operand
+        skip(parser);
+        TokenType type = type_at(parser, parser->current - 1);
+        bool complete = true;  // False when an error cut the operand short
+
+        switch(get_rule(type)->prefix) {
+            case PREFIX_NONE:
+            default:
+                parser_error(parser, "Expected expression");
+                result = no_expr(emitter);
+                complete = false;
+                break;
 
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_BINARY;
-    expr->token = op;
-    expr->as.binary.left = left;
-    expr->as.binary.op = op->type;
-    expr->as.binary.right = right;
+            case PREFIX_LITERAL:
+            case PREFIX_VARIABLE:
+                result = build_leaf(parser, emitter);
+                break;
 
-    return expr;
-}
+            case PREFIX_UNARY:
+                push_pending(parser, PENDING_UNARY, current, location_of(parser, previous(parser)))
+                    ->op = type;
+                current = PREC_UNARY;
+                continue;
+
+            case PREFIX_GROUPING:
+                push_pending(parser, PENDING_GROUPING, current,
+                             location_of(parser, previous(parser)));
+                current = PREC_ASSIGNMENT;
+                continue;
+
+            case PREFIX_ARRAY: {
+                SourceLoc loc = location_of(parser, previous(parser));
+                size_t mark = staged_mark(parser, emitter);
+                if(!check(parser, TOKEN_RBRACKET)) {
+                    push_pending(parser, PENDING_ARRAY, current, loc)->as.mark = mark;
+                    current = PREC_ASSIGNMENT;
+                    continue;
+                }
+                consume(parser, TOKEN_RBRACKET, "Expected ']' after array elements");
+                result = build_list(parser, emitter, PENDING_ARRAY, no_expr(emitter), mark, loc);
+                break;
+            }
+        }
 
-static Expr* parse_call(Parser* parser, Expr* left) {
-    // func(arg1, arg2)
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_CALL;
-    expr->token = previous(parser);
-    expr->as.call.callee = left;
-    expr->as.call.args = NULL;
-    expr->as.call.arg_count = 0;
+        // Infix position: operators binding at least as tightly as current
+        // extend result, until one needs an operand of its own (descend) or
+        // none is left and result completes the topmost pending operator
+        bool descend = false;
+        while(!descend) {
+            while(complete && current <= get_rule(type_at(parser, parser->current))->precedence) {
+                skip(parser);
+                TokenType op = type_at(parser, parser->current - 1);
+                SourceLoc loc = location_of(parser, previous(parser));
+                const ParseRule* rule = get_rule(op);
+                Symbol name;
+
+                switch(rule->infix) {
+                    case INFIX_BINARY:
+                        // Left-associative: the right side binds one level tighter
+                        push_operand(parser, result);
+                        push_pending(parser, PENDING_BINARY, current, loc)->op = op;
+                        current = (Precedence)(rule->precedence + 1);
+                        descend = true;
+                        break;
+
+                    case INFIX_CALL: {
+                        size_t mark = staged_mark(parser, emitter);
+                        if(!check(parser, TOKEN_RPAREN)) {
+                            push_operand(parser, result);
+                            push_pending(parser, PENDING_CALL, current, loc)->as.mark = mark;
+                            current = PREC_ASSIGNMENT;
+                            descend = true;
+                            break;
+                        }
+                        consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
+                        result = build_list(parser, emitter, PENDING_CALL, result, mark, loc);
+                        break;
+                    }
+
+                    case INFIX_INDEX:
+                        push_operand(parser, result);
+                        push_pending(parser, PENDING_INDEX, current, loc);
+                        current = PREC_ASSIGNMENT;
+                        descend = true;
+                        break;
+
+                    case INFIX_ASSIGN:
+                        if(!assign_target(emitter, result, &name)) {
+                            parser_error(parser, "Invalid assignment target");
+                            break;
+                        }
+                        // Right-associative: the value parses at the same precedence
+                        push_pending(parser, PENDING_ASSIGN, current, loc)->as.name = name;
+                        current = PREC_ASSIGNMENT;
+                        descend = true;
+                        break;
+
+                    case INFIX_NONE:
+                        break;  // Tokens without an infix rule have PREC_NONE
+                }
+
+                if(descend)
+                    break;
+            }
+            if(descend)
+                break;
 
-    if(!check(parser, TOKEN_RPAREN)) {
-        size_t capacity = 8;
-        expr->as.call.args = malloc(sizeof(Expr*) * capacity);
+            if(parser->pending_count == base) {
+                return result;
+            }
 
-        do {
-            if(expr->as.call.arg_count >= capacity) {
-                capacity *= 2;
-                expr->as.call.args = realloc(expr->as.call.args, sizeof(Expr*) * capacity);
+            PendingExpr pending = parser->pending[--parser->pending_count];
+            current = pending.precedence;
+            complete = true;
+
+            switch(pending.kind) {
+                case PENDING_UNARY:
+                    result = build_unary(parser, emitter, &pending, result);
+                    break;
+
+                case PENDING_BINARY: {
+                    ExprRef left = pop_operand(parser);
+                    result = build_binary(parser, emitter, &pending, left, result);
+                    break;
+                }
+
+                case PENDING_ASSIGN:
+                    result = build_assign(parser, emitter, &pending, result);
+                    break;
+
+                case PENDING_GROUPING:
+                    consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
+                    break;
+
+                case PENDING_INDEX: {
+                    consume(parser, TOKEN_RBRACKET, "Expected ']' after index");
+                    ExprRef object = pop_operand(parser);
+                    result = build_index(parser, emitter, &pending, object, result);
+                    break;
+                }
+
+                case PENDING_CALL:
+                case PENDING_ARRAY:
+                    stage_operand(parser, emitter, result);
+                    if(match(parser, TOKEN_COMMA)) {
+                        // The frame stays for the next item
+                        parser->pending_count++;
+                        current = PREC_ASSIGNMENT;
+                        descend = true;
+                        break;
+                    }
+
+                    if(pending.kind == PENDING_CALL) {
+                        consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
+                        ExprRef callee = pop_operand(parser);
+                        result = build_list(parser, emitter, PENDING_CALL, callee, pending.as.mark,
+                                            pending.loc);
+                    } else {
+                        consume(parser, TOKEN_RBRACKET, "Expected ']' after array elements");
+                        result = build_list(parser, emitter, PENDING_ARRAY, no_expr(emitter),
+                                            pending.as.mark, pending.loc);
+                    }
+                    break;
             }
-            expr->as.call.args[expr->as.call.arg_count++] = parse_expression(parser);
-        } while(match(parser, TOKEN_COMMA));
+        }
     }
-
-    consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
-    return expr;
 }
 
-static Expr* parse_index(Parser* parser, Expr* left) {
-    // arr[index]
-    Expr* index = parse_expression(parser);
-    consume(parser, TOKEN_RBRACKET, "Expected ']' after index");
-
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_INDEX;
-    expr->token = previous(parser);
-    expr->as.index.object = left;
-    expr->as.index.index = index;
+Expr* parse_expression(Parser* parser) {
+    return parse_precedence(parser, PREC_ASSIGNMENT);
+}
 
-    return expr;
+Expr* parse_precedence(Parser* parser, Precedence precedence) {
+    return parse_operators(parser, NULL, precedence).expr;
 }
 
-static Expr* parse_assign(Parser* parser, Expr* left) {
-    Token* equals = previous(parser);
+// ===== Recursive Descent - Statements =====
 
-    // Check if left side is a valid assignment target
-    if(left->type != EXPR_VARIABLE) {
-        parser_error(parser, "Invalid assignment target");
-        return left;
+// int or int[] after a ':'
+static Symbol parse_type_annotation(Parser* parser) {
+    Token* type = consume(parser, TOKEN_TYPE, "Expected type after ':'");
+    if(!type)
+        return SYMBOL_NONE;
+
+    char buffer[64];
+    size_t len = symbol_length(type->symbol);
+    memcpy(buffer, type->value, len);
+
+    // Support array types like int[]
+    while(match(parser, TOKEN_LBRACKET)) {
+        consume(parser, TOKEN_RBRACKET, "Expected ']' after '[' in type annotation");
+        if(len + 2 <= sizeof(buffer)) {
+            memcpy(buffer + len, "[]", 2);
+            len += 2;
+        }
     }
 
-    // Right-associative: parse with same precedence
-    Expr* value = parse_precedence(parser, PREC_ASSIGNMENT);
+    return symbol_intern(buffer, len);
+}
 
-    Expr* expr = malloc(sizeof(Expr));
-    expr->type = EXPR_ASSIGN;
-    expr->token = equals;
-    expr->as.assign.name = strdup(left->as.variable.name);
-    expr->as.assign.value = value;
+// name: type pairs up to and including ')', staged interleaved in
+// parser->staged_symbols; returns the number of pairs. Functions do not nest
+// inside a parameter list, so the symbol stack starts out empty.
+static size_t parse_parameters(Parser* parser) {
+    parser->staged_symbol_count = 0;
 
-    // Free the old variable expression since we don't need it
-    free(left->as.variable.name);
-    free(left);
+    if(!check(parser, TOKEN_RPAREN)) {
+        do {
+            Token* param_name = consume(parser, TOKEN_IDENT, "Expected parameter name");
+            if(!param_name)
+                break;
+            Symbol name_symbol = param_name->symbol;
 
-    return expr;
-}
+            consume(parser, TOKEN_COLON, "Expected ':' after parameter name");
+            Token* param_type = consume(parser, TOKEN_TYPE, "Expected parameter type");
+            if(!param_type)
+                break;
 
-// ===== Recursive Descent - Statements =====
+            stage_symbol(parser, name_symbol);
+            stage_symbol(parser, param_type->symbol);
+        } while(match(parser, TOKEN_COMMA));
+    }
+
+    consume(parser, TOKEN_RPAREN, "Expected ')' after parameters");
+    return parser->staged_symbol_count / 2;
+}
 
 Stmt* parse_statement(Parser* parser) {
     if(match(parser, TOKEN_ABI)) {
@@ -423,31 +997,19 @@ Stmt* parse_var_declaration(Parser* parser) {
     // abeg x = 5;
     // abeg x: int = 5;
 
+    SourceLoc loc = location_of(parser, previous(parser));
     Token* name = consume(parser, TOKEN_IDENT, "Expected variable name");
     if(!name)
         return NULL;
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_VAR_DECL;
-    stmt->as.var_decl.name = strdup(name->value);
-    stmt->as.var_decl.type_annotation = NULL;
+    Stmt* stmt = new_stmt(parser, STMT_VAR_DECL, loc);
+    stmt->as.var_decl.name = name->symbol;
+    stmt->as.var_decl.type_annotation = SYMBOL_NONE;
     stmt->as.var_decl.initializer = NULL;
 
     // Optional type annotation: abeg x: int
     if(match(parser, TOKEN_COLON)) {
-        Token* type = consume(parser, TOKEN_TYPE, "Expected type after ':'");
-        if(type) {
-            char buffer[64];
-            strcpy(buffer, type->value);
-
-            // Support array types like int[]
-            while(match(parser, TOKEN_LBRACKET)) {
-                consume(parser, TOKEN_RBRACKET, "Expected ']' after '[' in type annotation");
-                strcat(buffer, "[]");
-            }
-
-            stmt->as.var_decl.type_annotation = strdup(buffer);
-        }
+        stmt->as.var_decl.type_annotation = parse_type_annotation(parser);
     }
 
     // Optional initializer: = expr
@@ -462,50 +1024,32 @@ Stmt* parse_var_declaration(Parser* parser) {
 Stmt* parse_function_declaration(Parser* parser) {
     // oya greet(name: string, age: int): void { ... }
 
-    Token* name = consume(parser, TOKEN_IDENT, "Expected function name after 'oya'");
-    if(!name)
+    SourceLoc loc = location_of(parser, previous(parser));
+    Token* name_token = consume(parser, TOKEN_IDENT, "Expected function name after 'oya'");
+    if(!name_token)
         return NULL;
+    Symbol name = name_token->symbol;
 
     consume(parser, TOKEN_LPAREN, "Expected '(' after function name");
 
-    // Parse parameters
-    size_t param_capacity = 4;
-    char** param_names = malloc(sizeof(char*) * param_capacity);
-    char** param_types = malloc(sizeof(char*) * param_capacity);
-    size_t param_count = 0;
-
-    if(!check(parser, TOKEN_RPAREN)) {
-        do {
-            if(param_count >= param_capacity) {
-                param_capacity *= 2;
-                param_names = realloc(param_names, sizeof(char*) * param_capacity);
-                param_types = realloc(param_types, sizeof(char*) * param_capacity);
-            }
-
-            Token* param_name = consume(parser, TOKEN_IDENT, "Expected parameter name");
-            if(!param_name)
-                break;
-
-            consume(parser, TOKEN_COLON, "Expected ':' after parameter name");
-            Token* param_type = consume(parser, TOKEN_TYPE, "Expected parameter type");
-            if(!param_type)
-                break;
-
-            param_names[param_count] = strdup(param_name->value);
-            param_types[param_count] = strdup(param_type->value);
-            param_count++;
-
-        } while(match(parser, TOKEN_COMMA));
+    size_t param_count = parse_parameters(parser);
+    Symbol* param_names = NULL;
+    Symbol* param_types = NULL;
+    if(param_count > 0) {
+        param_names = arena_alloc(&parser->ast_arena, sizeof(Symbol) * param_count * 2);
+        param_types = param_names + param_count;
+        for(size_t i = 0; i < param_count; i++) {
+            param_names[i] = parser->staged_symbols[2 * i];
+            param_types[i] = parser->staged_symbols[2 * i + 1];
+        }
     }
 
-    consume(parser, TOKEN_RPAREN, "Expected ')' after parameters");
-
     // Optional return type
-    char* return_type = NULL;
+    Symbol return_type = SYMBOL_NONE;
     if(match(parser, TOKEN_COLON)) {
         Token* ret = consume(parser, TOKEN_TYPE, "Expected return type");
         if(ret) {
-            return_type = strdup(ret->value);
+            return_type = ret->symbol;
         }
     }
 
@@ -514,9 +1058,8 @@ Stmt* parse_function_declaration(Parser* parser) {
     // Parse body
     Stmt* body = parse_block_statement(parser);
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_FUNCTION_DECL;
-    stmt->as.function_decl.name = strdup(name->value);
+    Stmt* stmt = new_stmt(parser, STMT_FUNCTION_DECL, loc);
+    stmt->as.function_decl.name = name;
     stmt->as.function_decl.param_names = param_names;
     stmt->as.function_decl.param_types = param_types;
     stmt->as.function_decl.param_count = param_count;
@@ -529,6 +1072,7 @@ Stmt* parse_function_declaration(Parser* parser) {
 Stmt* parse_if_statement(Parser* parser) {
     // abi (condition) { ... } naso { ... }
 
+    SourceLoc loc = location_of(parser, previous(parser));
     consume(parser, TOKEN_LPAREN, "Expected '(' after 'abi'");
     Expr* condition = parse_expression(parser);
     consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
@@ -540,8 +1084,7 @@ Stmt* parse_if_statement(Parser* parser) {
         else_branch = parse_statement(parser);
     }
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_IF;
+    Stmt* stmt = new_stmt(parser, STMT_IF, loc);
     stmt->as.if_stmt.condition = condition;
     stmt->as.if_stmt.then_branch = then_branch;
     stmt->as.if_stmt.else_branch = else_branch;
@@ -552,14 +1095,14 @@ Stmt* parse_if_statement(Parser* parser) {
 Stmt* parse_while_statement(Parser* parser) {
     // oya (condition) { ... }
 
+    SourceLoc loc = location_of(parser, previous(parser));
     consume(parser, TOKEN_LPAREN, "Expected '(' after 'oya'");
     Expr* condition = parse_expression(parser);
     consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
 
     Stmt* body = parse_statement(parser);
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_WHILE;
+    Stmt* stmt = new_stmt(parser, STMT_WHILE, loc);
     stmt->as.while_stmt.condition = condition;
     stmt->as.while_stmt.body = body;
 
@@ -569,6 +1112,7 @@ Stmt* parse_while_statement(Parser* parser) {
 Stmt* parse_return_statement(Parser* parser) {
     // comot; or comot expr;
 
+    SourceLoc loc = location_of(parser, previous(parser));
     Expr* value = NULL;
     if(!check(parser, TOKEN_SEMICOLON)) {
         value = parse_expression(parser);
@@ -576,8 +1120,7 @@ Stmt* parse_return_statement(Parser* parser) {
 
     consume(parser, TOKEN_SEMICOLON, "Expected ';' after return statement");
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_RETURN;
+    Stmt* stmt = new_stmt(parser, STMT_RETURN, loc);
     stmt->as.return_stmt.value = value;
 
     return stmt;
@@ -586,65 +1129,814 @@ Stmt* parse_return_statement(Parser* parser) {
 Stmt* parse_block_statement(Parser* parser) {
     // { stmt1; stmt2; ... }
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_BLOCK;
-    stmt->as.block.statements = NULL;
-    stmt->as.block.count = 0;
-
-    size_t capacity = 8;
-    stmt->as.block.statements = malloc(sizeof(Stmt*) * capacity);
+    SourceLoc loc = location_of(parser, previous(parser));
+    size_t mark = parser->staged_count;
 
     while(!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
-        if(stmt->as.block.count >= capacity) {
-            capacity *= 2;
-            stmt->as.block.statements =
-                realloc(stmt->as.block.statements, sizeof(Stmt*) * capacity);
-        }
-        stmt->as.block.statements[stmt->as.block.count++] = parse_declaration(parser);
+        stage(parser, parse_declaration(parser));
     }
 
     consume(parser, TOKEN_RBRACE, "Expected '}' after block");
+
+    Stmt* stmt = new_stmt(parser, STMT_BLOCK, loc);
+    stmt->as.block.statements = finish_stmts(parser, mark, &stmt->as.block.count);
     return stmt;
 }
 
 Stmt* parse_expression_statement(Parser* parser) {
+    SourceLoc loc = location_of(parser, peek(parser));
     Expr* expr = parse_expression(parser);
     consume(parser, TOKEN_SEMICOLON, "Expected ';' after expression");
 
-    Stmt* stmt = malloc(sizeof(Stmt));
-    stmt->type = STMT_EXPR;
+    Stmt* stmt = new_stmt(parser, STMT_EXPR, loc);
     stmt->as.expr_stmt.expression = expr;
 
     return stmt;
 }
 
+// ===== Flat AST Emission =====
+
+// The grammar above, emitting into a FlatAst instead of allocating Expr/Stmt
+// nodes. Token handling, the expression engine, error reporting and recovery
+// are shared, so both emitters accept and reject exactly the same input. It
+// lives in this file so the token accessors stay inlinable.
+
+// ===== Flat AST Emission - Expressions =====
+
+static FlatExpr emit_expression(FlatEmitter* emitter) {
+    return parse_operators(emitter->parser, emitter, PREC_ASSIGNMENT).flat;
+}
+
+// ===== Flat AST Emission - Statements =====
+
+static FlatStmt emit_declaration(FlatEmitter* emitter);
+static FlatStmt emit_statement(FlatEmitter* emitter);
+
+static FlatStmt emit_block(FlatEmitter* emitter) {
+    // { stmt1; stmt2; ... }
+    Parser* parser = emitter->parser;
+    SourceLoc loc = location_of(parser, previous(parser));
+    uint32_t mark = emitter->staged_count;
+
+    while(!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
+        flat_stage(emitter, emit_declaration(emitter));
+    }
+
+    consume(parser, TOKEN_RBRACE, "Expected '}' after block");
+    FlatList statements = flat_finish_list(emitter, mark);
+    return flat_ast_add_stmt(emitter->ast, STMT_BLOCK, statements, 0, 0, loc);
+}
+
+static FlatStmt emit_var_declaration(FlatEmitter* emitter) {
+    // abeg x = 5;
+    // abeg x: int = 5;
+    Parser* parser = emitter->parser;
+    SourceLoc loc = location_of(parser, previous(parser));
+    Token* name_token = consume(parser, TOKEN_IDENT, "Expected variable name");
+    if(!name_token)
+        return FLAT_NONE;
+    Symbol name = name_token->symbol;
+
+    Symbol type_annotation = SYMBOL_NONE;
+    if(match(parser, TOKEN_COLON)) {
+        type_annotation = parse_type_annotation(parser);
+    }
+
+    FlatExpr initializer = FLAT_NONE;
+    if(match(parser, TOKEN_ASSIGN)) {
+        initializer = emit_expression(emitter);
+    }
+
+    consume(parser, TOKEN_SEMICOLON, "Expected ';' after variable declaration");
+    return flat_ast_add_stmt(emitter->ast, STMT_VAR_DECL, name, type_annotation, initializer,
+                             loc);
+}
+
+static FlatStmt emit_function_declaration(FlatEmitter* emitter) {
+    // oya greet(name: string, age: int): void { ... }
+    Parser* parser = emitter->parser;
+    SourceLoc loc = location_of(parser, previous(parser));
+    Token* name_token = consume(parser, TOKEN_IDENT, "Expected function name after 'oya'");
+    if(!name_token)
+        return FLAT_NONE;
+    Symbol name = name_token->symbol;
+
+    consume(parser, TOKEN_LPAREN, "Expected '(' after function name");
+    size_t param_count = parse_parameters(parser);
+
+    Symbol return_type = SYMBOL_NONE;
+    if(match(parser, TOKEN_COLON)) {
+        Token* ret = consume(parser, TOKEN_TYPE, "Expected return type");
+        if(ret) {
+            return_type = ret->symbol;
+        }
+    }
+
+    // The body may declare functions of its own, which reuse the parser's
+    // parameter stack, so the list is stored first
+    uint32_t mark = emitter->staged_count;
+    flat_stage(emitter, return_type);
+    for(size_t i = 0; i < param_count * 2; i++) {
+        flat_stage(emitter, parser->staged_symbols[i]);
+    }
+    FlatList params = flat_finish_list(emitter, mark);
+
+    consume(parser, TOKEN_LBRACE, "Expected '{' before function body");
+    FlatStmt body = emit_block(emitter);
+
+    return flat_ast_add_stmt(emitter->ast, STMT_FUNCTION_DECL, name, params, body, loc);
+}
+
+static FlatStmt emit_if_statement(FlatEmitter* emitter) {
+    // abi (condition) { ... } naso { ... }
+    Parser* parser = emitter->parser;
+    SourceLoc loc = location_of(parser, previous(parser));
+    consume(parser, TOKEN_LPAREN, "Expected '(' after 'abi'");
+    FlatExpr condition = emit_expression(emitter);
+    consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
+
+    FlatStmt then_branch = emit_statement(emitter);
+    FlatStmt else_branch = FLAT_NONE;
+    if(match(parser, TOKEN_NASO)) {
+        else_branch = emit_statement(emitter);
+    }
+
+    return flat_ast_add_stmt(emitter->ast, STMT_IF, condition, then_branch, else_branch, loc);
+}
+
+static FlatStmt emit_while_statement(FlatEmitter* emitter) {
+    Parser* parser = emitter->parser;
+    SourceLoc loc = location_of(parser, previous(parser));
+    consume(parser, TOKEN_LPAREN, "Expected '(' after 'oya'");
+    FlatExpr condition = emit_expression(emitter);
+    consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
+
+    FlatStmt body = emit_statement(emitter);
+    return flat_ast_add_stmt(emitter->ast, STMT_WHILE, condition, body, 0, loc);
+}
+
+static FlatStmt emit_return_statement(FlatEmitter* emitter) {
+    // comot; or comot expr;
+    Parser* parser = emitter->parser;
+    SourceLoc loc = location_of(parser, previous(parser));
+    FlatExpr value = FLAT_NONE;
+    if(!check(parser, TOKEN_SEMICOLON)) {
+        value = emit_expression(emitter);
+    }
+
+    consume(parser, TOKEN_SEMICOLON, "Expected ';' after return statement");
+    return flat_ast_add_stmt(emitter->ast, STMT_RETURN, value, 0, 0, loc);
+}
+
+static FlatStmt emit_statement(FlatEmitter* emitter) {
+    Parser* parser = emitter->parser;
+    if(match(parser, TOKEN_ABI)) {
+        return emit_if_statement(emitter);
+    }
+    if(match(parser, TOKEN_WAKA)) {
+        return emit_while_statement(emitter);
+    }
+    if(match(parser, TOKEN_COMOT)) {
+        return emit_return_statement(emitter);
+    }
+    if(match(parser, TOKEN_LBRACE)) {
+        return emit_block(emitter);
+    }
+
+    SourceLoc loc = location_of(parser, peek(parser));
+    FlatExpr expr = emit_expression(emitter);
+    consume(parser, TOKEN_SEMICOLON, "Expected ';' after expression");
+    return flat_ast_add_stmt(emitter->ast, STMT_EXPR, expr, 0, 0, loc);
+}
+
+static FlatStmt emit_declaration(FlatEmitter* emitter) {
+    if(match(emitter->parser, TOKEN_ABEG)) {
+        return emit_var_declaration(emitter);
+    }
+    if(match(emitter->parser, TOKEN_OYA)) {
+        return emit_function_declaration(emitter);
+    }
+
+    return emit_statement(emitter);
+}
+
 // ===== Main Parse Entry Point =====
 
 ASTNode* parse(Parser* parser) {
+    size_t mark = parser->staged_count;
+
+    while(!is_at_end(parser)) {
+        Stmt* stmt = parse_declaration(parser);
+        if(stmt) {
+            stage(parser, stmt);
+        }
+
+        if(parser->panic_mode) {
+            synchronize(parser);
+        }
+    }
+
+    if(parser->had_error) {
+        // Drop everything parsed; the staged pointers go with it
+        parser->staged_count = mark;
+        arena_free(&parser->ast_arena);
+        return NULL;
+    }
+
     ASTNode* root = malloc(sizeof(ASTNode));
     root->type = NODE_PROGRAM;
-    root->as.program.statements = NULL;
-    root->as.program.count = 0;
+    root->as.program.statements = finish_stmts(parser, mark, &root->as.program.count);
+    root->as.program.shift_from = 0;
+    root->as.program.shift = 0;
+
+    // The tree takes the arena and line table; the parser starts fresh ones
+    root->arena = parser->ast_arena;
+    root->lines = parser->lines;
+    arena_init(&parser->ast_arena, AST_ARENA_CHUNK_SIZE);
+    line_index_init(&parser->lines);
+    return root;
+}
 
-    size_t capacity = 16;
-    root->as.program.statements = malloc(sizeof(Stmt*) * capacity);
+FlatAst* parse_flat(Parser* parser) {
+    FlatEmitter emitter = {parser, flat_ast_create(), NULL, 0, 0};
+
+    // Node counts follow token counts closely; sizing the arrays from the
+    // token count, when it is known, saves regrowing them as parsing goes
+    if(parser->token_count != SIZE_MAX && parser->token_count < UINT32_MAX) {
+        uint32_t tokens = (uint32_t)parser->token_count;
+        flat_ast_reserve(emitter.ast, tokens / 2, tokens / 8, tokens / 4);
+    }
 
     while(!is_at_end(parser)) {
-        if(root->as.program.count >= capacity) {
-            capacity *= 2;
-            root->as.program.statements =
-                realloc(root->as.program.statements, sizeof(Stmt*) * capacity);
+        FlatStmt stmt = emit_declaration(&emitter);
+        if(stmt != FLAT_NONE) {
+            flat_stage(&emitter, stmt);
+        }
+
+        if(parser->panic_mode) {
+            synchronize(parser);
         }
+    }
 
+    if(parser->had_error) {
+        free(emitter.staged);
+        flat_ast_free(emitter.ast);
+        return NULL;
+    }
+
+    emitter.ast->program = flat_finish_list(&emitter, 0);
+    free(emitter.staged);
+    line_index_free(&emitter.ast->lines);
+    emitter.ast->lines = parser->lines;
+    line_index_init(&parser->lines);
+    return emitter.ast;
+}
+
+// ===== Parallel Parse =====
+
+// A run of whole top-level statements parsed by one worker (see parse_parallel)
+typedef struct {
+    const Parser* parent;
+    size_t start;    // Token index of the run's first statement
+    size_t end;      // Token index just past its last statement
+    Parser* parser;  // The worker's own; its staged array holds the statements
+    bool ok;
+    pthread_t thread;
+    bool spawned;
+} ParseRun;
+
+// Parse the statements of a run into a private parser and arena. The run's
+// bounds are a guess, so errors are not reported and simply fail the run.
+static void* parse_run(void* arg) {
+    ParseRun* run = arg;
+    const Parser* parent = run->parent;
+    Parser* parser = parser_init(parent->tokens, parent->token_count, parent->filename);
+    parser->buffer = parent->buffer;
+    parser->source = parent->source;
+    parser->quiet = true;
+    parser->current = run->start;
+    run->parser = parser;
+
+    while(parser->current < run->end && !is_at_end(parser)) {
         Stmt* stmt = parse_declaration(parser);
-        if(stmt) {
-            root->as.program.statements[root->as.program.count++] = stmt;
+        if(parser->had_error)
+            break;
+        stage(parser, stmt);
+    }
+
+    // Running past the end means the pre-pass split a statement
+    run->ok = !parser->had_error && parser->current == run->end;
+    return NULL;
+}
+
+// Cut the tokens into at most max_runs runs of roughly target tokens each,
+// writing the start of every run to starts; returns the number of runs. Cuts
+// go only where a top-level statement must begin, judged from token types
+// alone: at nesting depth 0, after a ';' that no 'naso' continues, and before
+// 'oya' or 'abeg'.
+static size_t split_runs(Parser* parser, size_t target, size_t* starts, size_t max_runs) {
+    size_t end = parser->token_count - 1;  // EOF
+    size_t runs = 1;
+    long depth = 0;
+    starts[0] = 0;
+
+    for(size_t i = 0; i < end && runs < max_runs; i++) {
+        TokenType type = type_at(parser, i);
+        size_t cut;
+
+        switch(type) {
+            case TOKEN_LBRACE:
+            case TOKEN_LPAREN:
+            case TOKEN_LBRACKET:
+                depth++;
+                continue;
+            case TOKEN_RBRACE:
+            case TOKEN_RPAREN:
+            case TOKEN_RBRACKET:
+                depth--;
+                continue;
+            case TOKEN_SEMICOLON:
+                if(depth != 0 || type_at(parser, i + 1) == TOKEN_NASO)
+                    continue;
+                cut = i + 1;
+                break;
+            case TOKEN_OYA:
+            case TOKEN_ABEG:
+                if(depth != 0)
+                    continue;
+                cut = i;
+                break;
+            default:
+                continue;
         }
 
-        if(parser->panic_mode) {
-            synchronize(parser);
+        if(cut < end && cut - starts[runs - 1] >= target) {
+            starts[runs++] = cut;
         }
     }
+    return runs;
+}
+
+ASTNode* parse_parallel(Parser* parser, unsigned thread_count) {
+    size_t count = thread_count;
+    if(count > parser->token_count / PARALLEL_MIN_TOKENS) {
+        count = parser->token_count / PARALLEL_MIN_TOKENS;
+    }
+    if(parser->lexer || parser->current != 0 || count < 2) {
+        return parse(parser);
+    }
+
+    size_t* starts = malloc(sizeof(size_t) * count);
+    ParseRun* runs = calloc(count, sizeof(ParseRun));
+    if(!starts || !runs) {
+        free(starts);
+        free(runs);
+        return parse(parser);
+    }
+
+    size_t used = split_runs(parser, parser->token_count / count, starts, count);
+    for(size_t i = 0; i < used; i++) {
+        runs[i].parent = parser;
+        runs[i].start = starts[i];
+        runs[i].end = i + 1 < used ? starts[i + 1] : parser->token_count - 1;
+    }
+
+    // Run 0 is parsed on the calling thread; any run whose thread cannot be
+    // started is parsed there too
+    for(size_t i = 1; i < used; i++) {
+        runs[i].spawned = pthread_create(&runs[i].thread, NULL, parse_run, &runs[i]) == 0;
+    }
+    parse_run(&runs[0]);
+    for(size_t i = 1; i < used; i++) {
+        if(runs[i].spawned) {
+            pthread_join(runs[i].thread, NULL);
+        } else {
+            parse_run(&runs[i]);
+        }
+    }
+
+    bool ok = true;
+    size_t total = 0;
+    for(size_t i = 0; i < used; i++) {
+        ok = ok && runs[i].ok;
+        total += runs[i].parser->staged_count;
+    }
+
+    ASTNode* root = NULL;
+    if(ok) {
+        root = malloc(sizeof(ASTNode));
+        root->type = NODE_PROGRAM;
+        root->as.program.count = total;
+        root->as.program.statements =
+            total ? arena_alloc(&parser->ast_arena, sizeof(Stmt*) * total) : NULL;
+        root->as.program.shift_from = 0;
+        root->as.program.shift = 0;
+
+        size_t next = 0;
+        for(size_t i = 0; i < used; i++) {
+            Parser* worker = runs[i].parser;
+            memcpy(root->as.program.statements + next, worker->staged,
+                   sizeof(Stmt*) * worker->staged_count);
+            next += worker->staged_count;
+            arena_adopt(&parser->ast_arena, &worker->ast_arena);
+
+            // Each worker's table covers the file up to its run's last line
+            // (the lines before its run as placeholders); later runs extend it
+            const LineIndex* lines = &worker->lines;
+            for(size_t k = parser->lines.count; k < lines->count; k++) {
+                line_index_note(&parser->lines, (uint32_t)(k + 1), lines->starts[k]);
+            }
+        }
+
+        // As in parse: the tree takes the arena and line table, and the
+        // parser is at EOF
+        root->arena = parser->ast_arena;
+        root->lines = parser->lines;
+        arena_init(&parser->ast_arena, AST_ARENA_CHUNK_SIZE);
+        line_index_init(&parser->lines);
+        parser->current = parser->token_count - 1;
+    }
+
+    for(size_t i = 0; i < used; i++) {
+        parser_free(runs[i].parser);
+    }
+    free(starts);
+    free(runs);
+
+    // Parse serially so the errors, and the recovery between them, are exactly parse's
+    return root ? root : parse(parser);
+}
+
+// ===== Incremental Reparse =====
+
+// First token of the buffer starting at or after offset
+static size_t token_at_or_after(const TokenBuffer* buffer, uint64_t offset) {
+    size_t low = 0;
+    size_t high = buffer->count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(buffer->starts[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Index of the token starting exactly at offset, or SIZE_MAX
+static size_t token_starting_at(const TokenBuffer* buffer, uint64_t offset) {
+    size_t index = token_at_or_after(buffer, offset);
+    return index < buffer->count && buffer->starts[index] == offset ? index : SIZE_MAX;
+}
+
+// A statement list on the way from the program down to the edit
+typedef struct {
+    Stmt*** statements;  // The list's array and count, inside a Program or Block
+    size_t* count;
+    size_t after;  // First statement past the edit
+} ReparseLevel;
+
+// Where statement i of a list starts. In the program's list the statements
+// from shift_from on still have a shift pending; nested lists pass SIZE_MAX.
+static uint64_t stmt_start(Stmt** items, size_t i, size_t shift_from, int64_t shift) {
+    return i < shift_from ? items[i]->loc : (SourceLoc)(items[i]->loc + (SourceLoc)shift);
+}
+
+// Start of statement i of a list, or end (the old offset of the token closing
+// the list) past its last statement. A statement's span runs up to the next one.
+static uint64_t statement_start(Stmt** items, size_t count, size_t i, uint64_t end,
+                                size_t shift_from, int64_t shift) {
+    return i < count ? stmt_start(items, i, shift_from, shift) : end;
+}
+
+// Make the program's pending shift start at statement at. The statements it
+// passes over are shifted now, forwards or back, so the cost is in the
+// statements between consecutive edits rather than in the rest of the file.
+static void move_pending_shift(Program* program, size_t at) {
+    if(program->shift != 0) {
+        size_t end = program->count;
+        if(at > program->shift_from) {
+            for(size_t i = program->shift_from; i < at && i < end; i++) {
+                ast_shift_locs(program->statements[i], program->shift);
+            }
+        } else {
+            for(size_t i = at; i < program->shift_from && i < end; i++) {
+                ast_shift_locs(program->statements[i], -program->shift);
+            }
+        }
+    }
+    program->shift_from = at;
+}
+
+// Body of a statement whose own statement list the edit may fall into
+static Stmt* nested_block(Stmt* stmt) {
+    if(stmt->type == STMT_BLOCK)
+        return stmt;
+    if(stmt->type == STMT_FUNCTION_DECL && stmt->as.function_decl.body &&
+       stmt->as.function_decl.body->type == STMT_BLOCK)
+        return stmt->as.function_decl.body;
+    return NULL;
+}
+
+// Line starts noted from every located token, as parsing a tree notes them
+static bool rebuild_lines(LineIndex* lines, const TokenBuffer* buffer) {
+    LineIndex rebuilt;
+    if(!line_index_init(&rebuilt))
+        return false;
+    for(size_t i = 0; i < buffer->count; i++) {
+        if(buffer->columns[i] > 0) {
+            line_index_note(&rebuilt, buffer->lines[i],
+                            buffer->starts[i] - (buffer->columns[i] - 1));
+        }
+    }
+    line_index_free(lines);
+    *lines = rebuilt;
+    return true;
+}
+
+// Bring the tree's line starts up to date after a reparse. Entries before
+// from (the earlier of the damage and the reparsed statements) still hold;
+// the lines from there to token through are noted again from the tokens, and
+// the entries after that token's line move with it. Only a table that does
+// not fit the tokens fails.
+static bool update_lines(LineIndex* lines, const TokenBuffer* buffer,
+                         const LexerRelexSpan* relexed, uint64_t from, size_t through,
+                         int64_t delta) {
+    size_t low = 1;
+    size_t high = lines->count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(lines->starts[mid] < from) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    size_t keep = low;  // Entries [0, keep) are kept: lines 1 to keep
+
+    // Old entries [keep, replaced) give way to the new ones. through is an old
+    // token moved by the edit unless the relex ran to the end, and then every
+    // later entry goes.
+    size_t replaced = lines->count;
+    if(relexed->first + relexed->count < buffer->count) {
+        int64_t old_line = (int64_t)buffer->lines[through] - relexed->line_delta;
+        if(old_line < (int64_t)keep || buffer->columns[through] == 0)
+            return false;
+        replaced = (size_t)old_line < lines->count ? (size_t)old_line : lines->count;
+    }
+
+    // First token past the kept lines
+    low = 0;
+    high = through;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(buffer->lines[mid] <= keep) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    uint64_t* starts = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    for(size_t i = low; i <= through; i++) {
+        if(buffer->columns[i] == 0)
+            continue;
+        uint64_t start = buffer->starts[i] - (buffer->columns[i] - 1);
+        while(keep + count < buffer->lines[i]) {
+            if(count >= capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                uint64_t* grown = realloc(starts, sizeof(uint64_t) * capacity);
+                if(!grown) {
+                    free(starts);
+                    return false;
+                }
+                starts = grown;
+            }
+            starts[count++] = start;
+        }
+    }
+
+    bool ok = line_index_splice(lines, keep, replaced, starts, count, delta);
+    free(starts);
+    return ok;
+}
+
+static ASTNode* reparse_all(Parser* parser, ASTNode* previous) {
+    ast_free_node(previous);
+    parser->current = 0;
+    parser->had_error = false;
+    parser->panic_mode = false;
+    parser->staged_count = 0;
+    arena_free(&parser->ast_arena);
+    return parse(parser);
+}
+
+ASTNode* parse_incremental(Parser* parser, ASTNode* previous, const LexerEdit* edit,
+                           const LexerRelexSpan* relexed) {
+    const TokenBuffer* buffer = parser->buffer;
+    if(!previous || !buffer || parser->current != 0 || buffer->count == 0) {
+        return reparse_all(parser, previous);
+    }
+
+    // The relex rewrote old offsets [damage_start, damage_end); everything
+    // before is as it was and everything after moved by delta
+    int64_t delta = (int64_t)edit->inserted - (int64_t)edit->removed;
+    size_t kept = relexed->first + relexed->count;  // First moved token
+    uint64_t damage_start = 0;
+    if(relexed->first > 0) {
+        damage_start = buffer->starts[relexed->first - 1] + buffer->lens[relexed->first - 1];
+    }
+    uint64_t damage_end = UINT64_MAX;
+    if(kept < buffer->count) {
+        damage_end = (uint64_t)((int64_t)buffer->starts[kept] - delta);
+    }
+
+    ReparseLevel* levels = NULL;
+    size_t level_count = 0;
+    size_t level_capacity = 0;
+
+    // Walk down while the damage lies inside the statement list of a single
+    // block or function body; the list reached last is where reparsing happens
+    Program* program = &previous->as.program;
+    Stmt*** list = &program->statements;
+    size_t* list_count = &program->count;
+    uint64_t list_start = 0;        // Just past the token opening the list
+    uint64_t list_end = UINT64_MAX;  // Old offset of the token closing it
+    size_t end_index = buffer->count - 1;  // New index of that token (EOF or '}')
+    size_t shift_from = program->shift_from;  // Pending shift of the list
+    int64_t shift = program->shift;
+    size_t first, last;  // Statements [first, last) of the list are reparsed
+
+    while(1) {
+        Stmt** items = *list;
+        size_t count = *list_count;
+
+        // A statement is touched if the damage reaches from its start up to
+        // the next one's, boundaries included
+        size_t low = 0, high = count;
+        while(low < high) {
+            size_t mid = low + (high - low) / 2;
+            if(statement_start(items, count, mid + 1, list_end, shift_from, shift) <
+               damage_start) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        first = low;
+        high = count;
+        while(low < high) {
+            size_t mid = low + (high - low) / 2;
+            if(stmt_start(items, mid, shift_from, shift) <= damage_end) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        last = low;
+
+        if(last != first + 1)
+            break;
+        Stmt* block = nested_block(items[first]);
+        if(!block)
+            break;
+
+        // Going into a top-level statement settles it: the pending shift
+        // moves to the statement after it
+        if(level_count == 0) {
+            move_pending_shift(program, first + 1);
+            shift_from = first + 1;
+        }
+        if(block->loc + 1 > damage_start)
+            break;
+
+        // The block's '}' is the last token before the next statement (or
+        // before the token closing this list) and has to be an old one
+        size_t next;
+        if(first + 1 < count) {
+            next = token_starting_at(
+                buffer, (uint64_t)((int64_t)stmt_start(items, first + 1, shift_from, shift) +
+                                   delta));
+        } else {
+            next = end_index;
+        }
+        if(next == SIZE_MAX || next == 0 || next - 1 < kept ||
+           buffer->types[next - 1] != TOKEN_RBRACE)
+            break;
+
+        if(level_count >= level_capacity) {
+            level_capacity = level_capacity ? level_capacity * 2 : 8;
+            levels = realloc(levels, sizeof(ReparseLevel) * level_capacity);
+        }
+        levels[level_count++] = (ReparseLevel){list, list_count, first + 1};
+
+        list = &block->as.block.statements;
+        list_count = &block->as.block.count;
+        list_start = block->loc + 1;
+        end_index = next - 1;
+        list_end = (uint64_t)((int64_t)buffer->starts[end_index] - delta);
+        shift_from = SIZE_MAX;
+        shift = 0;
+    }
+
+    // Reparse the touched statements, which must end exactly where the first
+    // untouched one (or the list's closing token) now starts
+    Stmt** items = *list;
+    size_t count = *list_count;
+    size_t start_index = token_at_or_after(
+        buffer, first > 0 ? statement_start(items, count, first, list_end, shift_from, shift)
+                          : list_start);
+    size_t stop_index = end_index;
+    if(last < count) {
+        stop_index = token_starting_at(
+            buffer, (uint64_t)((int64_t)stmt_start(items, last, shift_from, shift) + delta));
+    }
+
+    bool ok = stop_index != SIZE_MAX && start_index <= stop_index;
+    size_t mark = parser->staged_count;
+    if(ok) {
+        bool quiet = parser->quiet;
+        parser->quiet = true;  // A failure is reported by the full parse below
+        parser->note_lines = false;
+        parser->current = start_index;
+        while(parser->current < stop_index && !is_at_end(parser)) {
+            Stmt* stmt = parse_declaration(parser);
+            if(parser->had_error)
+                break;
+            stage(parser, stmt);
+        }
+        parser->quiet = quiet;
+        parser->note_lines = true;
+        ok = !parser->had_error && parser->current == stop_index;
+    }
+    if(!ok) {
+        free(levels);
+        return reparse_all(parser, previous);
+    }
+
+    // Reparsed in the program's own list, the statements before the touched
+    // ones are settled and the pending shift starts right after them
+    size_t reparsed = parser->staged_count - mark;
+    if(level_count == 0) {
+        move_pending_shift(program, last);
+    }
+
+    // Splice the new statements in place of the touched ones; the list only
+    // needs a new array when it grows
+    size_t total = count - (last - first) + reparsed;
+    Stmt** spliced = items;
+    if(total > count) {
+        spliced = arena_alloc(&parser->ast_arena, sizeof(Stmt*) * total);
+        if(first > 0) {
+            memcpy(spliced, items, sizeof(Stmt*) * first);
+        }
+    }
+    if(last < count) {
+        memmove(spliced + first + reparsed, items + last, sizeof(Stmt*) * (count - last));
+    }
+    if(reparsed > 0) {
+        memcpy(spliced + first, parser->staged + mark, sizeof(Stmt*) * reparsed);
+    }
+    parser->staged_count = mark;
+    *list = spliced;
+    *list_count = total;
+
+    // Statements after the edit keep their subtrees. Inside the top-level
+    // statement holding the edit they are moved now; the top-level ones after
+    // it take the edit's delta as part of the program's pending shift.
+    if(level_count == 0) {
+        program->shift_from = first + reparsed;
+    } else if(delta != 0) {
+        for(size_t i = first + reparsed; i < total; i++) {
+            ast_shift_locs(spliced[i], delta);
+        }
+        for(size_t i = level_count; i > 1; i--) {
+            ReparseLevel* level = &levels[i - 1];
+            for(size_t k = level->after; k < *level->count; k++) {
+                ast_shift_locs((*level->statements)[k], delta);
+            }
+        }
+    }
+    program->shift += delta;
+
+    // The line starts are updated around the edit; only a table that does not
+    // fit the tokens any more is rebuilt from all of them
+    uint64_t from = buffer->starts[start_index] < damage_start ? buffer->starts[start_index]
+                                                               : damage_start;
+    size_t through = kept > stop_index ? kept : stop_index;
+    if(through >= buffer->count) {
+        through = buffer->count - 1;
+    }
+    if(!update_lines(&previous->lines, buffer, relexed, from, through, delta)) {
+        rebuild_lines(&previous->lines, buffer);
+    }
 
-    return parser->had_error ? NULL : root;
+    // The tree keeps its arena and takes the new nodes' chunks too
+    arena_adopt(&previous->arena, &parser->ast_arena);
+    parser->current = buffer->count - 1;
+    free(levels);
+    return previous;
 }
@@ -0,0 +1,332 @@
+#include "../../include/parser/resolver.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct ResolverGlobal {
+    Symbol name;
+    bool declared;  // Its declaration has been walked (or it is predefined)
+    bool hoisted;   // Top-level function: visible before its declaration
+};
+
+struct ResolverLocal {
+    Symbol name;
+    uint32_t scope;
+    uint32_t slot;
+    uint32_t shadowed;  // local_of entry of the name before this declaration
+};
+
+struct ResolverScope {
+    const Stmt* body;  // Block whose end closes the scope
+    uint32_t first_local;
+    bool function;
+};
+
+// ===== Lifecycle =====
+
+void resolver_init(Resolver* resolver) {
+    memset(resolver, 0, sizeof(*resolver));
+}
+
+void resolver_free(Resolver* resolver) {
+    free(resolver->globals);
+    free(resolver->locals);
+    free(resolver->scopes);
+    free(resolver->global_of);
+    free(resolver->local_of);
+    free(resolver->errors);
+    memset(resolver, 0, sizeof(*resolver));
+}
+
+// Grow the per-symbol tables to cover symbol; new entries are 0
+static void cover_symbol(Resolver* resolver, Symbol symbol) {
+    if(symbol < resolver->symbol_capacity)
+        return;
+    size_t capacity = resolver->symbol_capacity ? resolver->symbol_capacity : 256;
+    while(capacity <= symbol) {
+        capacity *= 2;
+    }
+    resolver->global_of = realloc(resolver->global_of, sizeof(uint32_t) * capacity);
+    resolver->local_of = realloc(resolver->local_of, sizeof(uint32_t) * capacity);
+    size_t added = capacity - resolver->symbol_capacity;
+    memset(resolver->global_of + resolver->symbol_capacity, 0, sizeof(uint32_t) * added);
+    memset(resolver->local_of + resolver->symbol_capacity, 0, sizeof(uint32_t) * added);
+    resolver->symbol_capacity = capacity;
+}
+
+static void add_error(Resolver* resolver, ResolveErrorType type, Symbol name, SourceLoc loc) {
+    if(resolver->error_count >= resolver->error_capacity) {
+        resolver->error_capacity = resolver->error_capacity ? resolver->error_capacity * 2 : 16;
+        resolver->errors =
+            realloc(resolver->errors, sizeof(ResolveError) * resolver->error_capacity);
+    }
+    resolver->errors[resolver->error_count++] = (ResolveError){type, name, loc};
+}
+
+// ===== Globals =====
+
+static uint32_t add_global(Resolver* resolver, Symbol name, bool declared, bool hoisted) {
+    if(resolver->global_count >= resolver->global_capacity) {
+        resolver->global_capacity = resolver->global_capacity ? resolver->global_capacity * 2 : 64;
+        resolver->globals =
+            realloc(resolver->globals, sizeof(ResolverGlobal) * resolver->global_capacity);
+    }
+    cover_symbol(resolver, name);
+    uint32_t index = (uint32_t)resolver->global_count++;
+    resolver->globals[index] = (ResolverGlobal){name, declared, hoisted};
+    resolver->global_of[name] = index + 1;
+    return index;
+}
+
+// Forget the globals of the last run, keeping the predefined ones
+static void reset_globals(Resolver* resolver) {
+    for(size_t i = resolver->predefined_count; i < resolver->global_count; i++) {
+        resolver->global_of[resolver->globals[i].name] = 0;
+    }
+    resolver->global_count = resolver->predefined_count;
+}
+
+uint32_t resolver_define_global(Resolver* resolver, Symbol name) {
+    reset_globals(resolver);
+    cover_symbol(resolver, name);
+    if(resolver->global_of[name])
+        return resolver->global_of[name] - 1;
+    uint32_t index = add_global(resolver, name, true, false);
+    resolver->predefined_count = resolver->global_count;
+    return index;
+}
+
+Symbol resolver_global_name(const Resolver* resolver, uint32_t index) {
+    return index < resolver->global_count ? resolver->globals[index].name : SYMBOL_NONE;
+}
+
+static void declare_global(Resolver* resolver, Symbol name, SourceLoc loc) {
+    cover_symbol(resolver, name);
+    uint32_t entry = resolver->global_of[name];
+    if(!entry) {
+        add_global(resolver, name, true, false);
+    } else if(resolver->globals[entry - 1].declared) {
+        add_error(resolver, RESOLVE_REDECLARED, name, loc);
+    } else {
+        resolver->globals[entry - 1].declared = true;
+    }
+}
+
+// ===== Scopes =====
+
+static void push_scope(Resolver* resolver, const Stmt* body, bool function) {
+    if(resolver->scope_count >= resolver->scope_capacity) {
+        resolver->scope_capacity = resolver->scope_capacity ? resolver->scope_capacity * 2 : 16;
+        resolver->scopes =
+            realloc(resolver->scopes, sizeof(ResolverScope) * resolver->scope_capacity);
+    }
+    resolver->scopes[resolver->scope_count++] =
+        (ResolverScope){body, (uint32_t)resolver->local_count, function};
+    if(function) {
+        resolver->function_depth++;
+    }
+}
+
+// Drop the innermost scope, uncovering the names its locals shadowed
+static void pop_scope(Resolver* resolver) {
+    const ResolverScope* scope = &resolver->scopes[--resolver->scope_count];
+    while(resolver->local_count > scope->first_local) {
+        const ResolverLocal* local = &resolver->locals[--resolver->local_count];
+        resolver->local_of[local->name] = local->shadowed;
+    }
+    if(scope->function) {
+        resolver->function_depth--;
+    }
+}
+
+static bool closes_scope(const Resolver* resolver, const Stmt* stmt) {
+    return resolver->scope_count > 0 && resolver->scopes[resolver->scope_count - 1].body == stmt;
+}
+
+static void declare_local(Resolver* resolver, Symbol name, SourceLoc loc) {
+    cover_symbol(resolver, name);
+    uint32_t scope = (uint32_t)resolver->scope_count - 1;
+    uint32_t shadowed = resolver->local_of[name];
+    if(shadowed && resolver->locals[shadowed - 1].scope == scope) {
+        add_error(resolver, RESOLVE_REDECLARED, name, loc);
+        return;
+    }
+
+    if(resolver->local_count >= resolver->local_capacity) {
+        resolver->local_capacity = resolver->local_capacity ? resolver->local_capacity * 2 : 64;
+        resolver->locals =
+            realloc(resolver->locals, sizeof(ResolverLocal) * resolver->local_capacity);
+    }
+    uint32_t slot = (uint32_t)resolver->local_count - resolver->scopes[scope].first_local;
+    resolver->locals[resolver->local_count++] = (ResolverLocal){name, scope, slot, shadowed};
+    resolver->local_of[name] = (uint32_t)resolver->local_count;
+}
+
+static void declare(Resolver* resolver, Symbol name, SourceLoc loc) {
+    if(resolver->scope_count) {
+        declare_local(resolver, name, loc);
+    } else {
+        declare_global(resolver, name, loc);
+    }
+}
+
+// Innermost local of that name, else a global in reach
+static Binding resolve(Resolver* resolver, Symbol name, SourceLoc loc) {
+    cover_symbol(resolver, name);
+    uint32_t local = resolver->local_of[name];
+    if(local) {
+        const ResolverLocal* found = &resolver->locals[local - 1];
+        return (Binding){BINDING_LOCAL, (uint32_t)resolver->scope_count - 1 - found->scope,
+                         found->slot};
+    }
+
+    uint32_t global = resolver->global_of[name];
+    if(global) {
+        const ResolverGlobal* found = &resolver->globals[global - 1];
+        if(resolver->function_depth > 0 || found->declared || found->hoisted)
+            return (Binding){BINDING_GLOBAL, 0, global - 1};
+    }
+
+    add_error(resolver, RESOLVE_UNDEFINED, name, loc);
+    return (Binding){BINDING_UNRESOLVED, 0, 0};
+}
+
+// ===== Pass Callbacks =====
+
+// Number the top-level declarations up front, so function bodies can refer to
+// globals declared after them
+static void begin_program(void* state, ASTNode* node) {
+    Resolver* resolver = state;
+    while(resolver->scope_count) {
+        pop_scope(resolver);
+    }
+    reset_globals(resolver);
+    resolver->function_depth = 0;
+    resolver->error_count = 0;
+    if(!node)
+        return;
+
+    for(size_t i = 0; i < node->as.program.count; i++) {
+        const Stmt* stmt = node->as.program.statements[i];
+        Symbol name;
+        if(stmt->type == STMT_FUNCTION_DECL) {
+            name = stmt->as.function_decl.name;
+        } else if(stmt->type == STMT_VAR_DECL) {
+            name = stmt->as.var_decl.name;
+        } else {
+            continue;
+        }
+        cover_symbol(resolver, name);
+        if(!resolver->global_of[name]) {
+            add_global(resolver, name, false, stmt->type == STMT_FUNCTION_DECL);
+        }
+    }
+}
+
+static bool enter_function(void* state, Stmt* stmt, int depth) {
+    (void)depth;
+    Resolver* resolver = state;
+    const FunctionDecl* function = &stmt->as.function_decl;
+    declare(resolver, function->name, stmt->loc);
+
+    push_scope(resolver, function->body, true);
+    for(size_t i = 0; i < function->param_count; i++) {
+        declare_local(resolver, function->param_names[i], stmt->loc);
+    }
+    return true;
+}
+
+// A body that is not a block never closes its scope itself
+static void leave_function(void* state, Stmt** slot, int depth) {
+    (void)depth;
+    Resolver* resolver = state;
+    if(closes_scope(resolver, (*slot)->as.function_decl.body)) {
+        pop_scope(resolver);
+    }
+}
+
+// A function body already has its scope, shared with the parameters
+static bool enter_block(void* state, Stmt* stmt, int depth) {
+    (void)depth;
+    Resolver* resolver = state;
+    if(!closes_scope(resolver, stmt)) {
+        push_scope(resolver, stmt, false);
+    }
+    return true;
+}
+
+static void leave_block(void* state, Stmt** slot, int depth) {
+    (void)depth;
+    Resolver* resolver = state;
+    if(closes_scope(resolver, *slot)) {
+        pop_scope(resolver);
+    }
+}
+
+// Declared once the initializer, which cannot see it, is resolved
+static void leave_var_decl(void* state, Stmt** slot, int depth) {
+    (void)depth;
+    declare(state, (*slot)->as.var_decl.name, (*slot)->loc);
+}
+
+static bool enter_variable(void* state, Expr* expr, int depth) {
+    (void)depth;
+    expr->as.variable.binding = resolve(state, expr->as.variable.name, expr->loc);
+    return true;
+}
+
+static bool enter_assign(void* state, Expr* expr, int depth) {
+    (void)depth;
+    expr->as.assign.binding = resolve(state, expr->as.assign.name, expr->loc);
+    return true;
+}
+
+// ===== Pass =====
+
+void resolver_pass(Resolver* resolver, AstPass* pass) {
+    memset(pass, 0, sizeof(*pass));
+    pass->name = "resolve";
+    pass->state = resolver;
+    pass->begin = begin_program;
+    pass->pre_stmt[STMT_FUNCTION_DECL] = enter_function;
+    pass->post_stmt[STMT_FUNCTION_DECL] = leave_function;
+    pass->pre_stmt[STMT_BLOCK] = enter_block;
+    pass->post_stmt[STMT_BLOCK] = leave_block;
+    pass->post_stmt[STMT_VAR_DECL] = leave_var_decl;
+    pass->pre_expr[EXPR_VARIABLE] = enter_variable;
+    pass->pre_expr[EXPR_ASSIGN] = enter_assign;
+}
+
+bool resolver_resolve(Resolver* resolver, ASTNode* node) {
+    AstPass pass;
+    resolver_pass(resolver, &pass);
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, &pass);
+    ast_pass_manager_run(&manager, node);
+    ast_pass_manager_free(&manager);
+    return resolver->error_count == 0;
+}
+
+// ===== Errors =====
+
+const char* resolve_error_message(ResolveErrorType type) {
+    switch(type) {
+        case RESOLVE_UNDEFINED:
+            return "Undefined name";
+        case RESOLVE_REDECLARED:
+            return "Already declared in this scope";
+    }
+    return "Unknown error";
+}
+
+void resolver_report(const Resolver* resolver, const ASTNode* node, const char* filename,
+                     FILE* out) {
+    for(size_t i = 0; i < resolver->error_count; i++) {
+        const ResolveError* error = &resolver->errors[i];
+        uint32_t line, column;
+        ast_resolve_loc(node, error->loc, &line, &column);
+        fprintf(out, "[%s:%u] Error at '%s': %s\n", filename, line, symbol_name(error->name),
+                resolve_error_message(error->type));
+    }
+}
@@ -0,0 +1,126 @@
+#include "../../include/arena.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    alignas(max_align_t) unsigned char data[];
+};
+
+static ArenaChunk* chunk_create(size_t capacity, ArenaChunk* next) {
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + capacity);
+    if(!chunk)
+        return NULL;
+
+    chunk->next = next;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    return chunk;
+}
+
+static void* arena_bump(Arena* arena, size_t size, size_t align) {
+    ArenaChunk* chunk = arena->head;
+    if(chunk) {
+        size_t offset = (chunk->used + align - 1) & ~(align - 1);
+        if(offset <= chunk->capacity && chunk->capacity - offset >= size) {
+            chunk->used = offset + size;
+            return chunk->data + offset;
+        }
+
+        // Oversized requests get a dedicated chunk behind the current one so the
+        // free space left in the head chunk is not wasted
+        if(size > arena->chunk_size / 4) {
+            ArenaChunk* big = chunk_create(size, chunk->next);
+            if(!big)
+                return NULL;
+            chunk->next = big;
+            big->used = size;
+            return big->data;
+        }
+    }
+
+    size_t capacity = size > arena->chunk_size ? size : arena->chunk_size;
+    chunk = chunk_create(capacity, arena->head);
+    if(!chunk)
+        return NULL;
+    arena->head = chunk;
+
+    chunk->used = size;
+    return chunk->data;
+}
+
+void arena_init(Arena* arena, size_t chunk_size) {
+    arena->head = NULL;
+    arena->chunk_size = chunk_size;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    return arena_bump(arena, size, alignof(max_align_t));
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* copy = arena_bump(arena, len + 1, 1);
+    if(!copy)
+        return NULL;
+
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_reset(Arena* arena) {
+    ArenaChunk* keep = arena->head;
+    if(keep && keep->capacity != arena->chunk_size) {
+        keep = NULL;  // Oversized; do not hold on to it
+    }
+
+    ArenaChunk* chunk = arena->head;
+    while(chunk) {
+        ArenaChunk* next = chunk->next;
+        if(chunk != keep) {
+            free(chunk);
+        }
+        chunk = next;
+    }
+
+    if(keep) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    arena->head = keep;
+}
+
+void arena_free(Arena* arena) {
+    ArenaChunk* chunk = arena->head;
+    while(chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+}
+
+void arena_adopt(Arena* arena, Arena* other) {
+    ArenaChunk* first = other->head;
+    if(!first)
+        return;
+    other->head = NULL;
+
+    if(!arena->head) {
+        arena->head = first;
+        return;
+    }
+
+    // Splice behind the head so its free space keeps being used
+    ArenaChunk* last = first;
+    while(last->next) {
+        last = last->next;
+    }
+    last->next = arena->head->next;
+    arena->head->next = first;
+}
@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/symbol.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/arena.h"
+
+// Entries live in fixed-size pages that never move, so symbol_name can read
+// them without taking the lock while other threads intern new names
+#define SYMBOL_PAGE_BITS 12
+#define SYMBOL_PAGE_SIZE (1u << SYMBOL_PAGE_BITS)
+#define SYMBOL_MAX_PAGES (1u << 16)
+#define SYMBOL_ARENA_CHUNK_SIZE (64 * 1024)
+#define INITIAL_SLOT_CAPACITY 1024
+
+typedef struct {
+    const char* text;
+    uint32_t length;
+    uint32_t hash;
+} SymbolEntry;
+
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static SymbolEntry* pages[SYMBOL_MAX_PAGES];
+static uint32_t entry_count;  // Including SYMBOL_NONE once initialized
+static Arena strings;
+
+// Open-addressing hash table of symbols; 0 marks an empty slot
+static Symbol* slots;
+static size_t slot_capacity;
+
+static SymbolEntry* entry(Symbol symbol) {
+    return &pages[symbol >> SYMBOL_PAGE_BITS][symbol & (SYMBOL_PAGE_SIZE - 1)];
+}
+
+// FNV-1a
+static uint32_t hash_text(const char* text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool grow_slots(void) {
+    size_t capacity = slot_capacity ? slot_capacity * 2 : INITIAL_SLOT_CAPACITY;
+    Symbol* grown = calloc(capacity, sizeof(Symbol));
+    if(!grown)
+        return false;
+
+    for(size_t i = 0; i < slot_capacity; i++) {
+        Symbol symbol = slots[i];
+        if(symbol == SYMBOL_NONE)
+            continue;
+        size_t slot = entry(symbol)->hash & (capacity - 1);
+        while(grown[slot] != SYMBOL_NONE) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        grown[slot] = symbol;
+    }
+
+    free(slots);
+    slots = grown;
+    slot_capacity = capacity;
+    return true;
+}
+
+// Append an entry and return its symbol, or SYMBOL_NONE if the table is full
+static Symbol add_entry(const char* text, uint32_t length, uint32_t hash) {
+    Symbol symbol = entry_count;
+    uint32_t page = symbol >> SYMBOL_PAGE_BITS;
+    if(page >= SYMBOL_MAX_PAGES)
+        return SYMBOL_NONE;
+    if(!pages[page]) {
+        pages[page] = malloc(sizeof(SymbolEntry) * SYMBOL_PAGE_SIZE);
+        if(!pages[page])
+            return SYMBOL_NONE;
+    }
+
+    SymbolEntry* added = entry(symbol);
+    added->text = text;
+    added->length = length;
+    added->hash = hash;
+    entry_count++;
+    return symbol;
+}
+
+Symbol symbol_intern(const char* text, size_t length) {
+    uint32_t hash = hash_text(text, length);
+
+    pthread_mutex_lock(&table_lock);
+
+    if(entry_count == 0) {
+        arena_init(&strings, SYMBOL_ARENA_CHUNK_SIZE);
+        add_entry("", 0, 0);
+    }
+
+    // Keep the load factor at or below one half
+    if((entry_count + 1) * 2 > slot_capacity && !grow_slots()) {
+        pthread_mutex_unlock(&table_lock);
+        return SYMBOL_NONE;
+    }
+
+    size_t slot = hash & (slot_capacity - 1);
+    Symbol found = SYMBOL_NONE;
+    while(slots[slot] != SYMBOL_NONE) {
+        const SymbolEntry* candidate = entry(slots[slot]);
+        if(candidate->hash == hash && candidate->length == length &&
+           memcmp(candidate->text, text, length) == 0) {
+            found = slots[slot];
+            break;
+        }
+        slot = (slot + 1) & (slot_capacity - 1);
+    }
+
+    if(found == SYMBOL_NONE) {
+        char* copy = arena_strndup(&strings, text, length);
+        if(copy) {
+            found = add_entry(copy, (uint32_t)length, hash);
+            slots[slot] = found;
+        }
+    }
+
+    pthread_mutex_unlock(&table_lock);
+    return found;
+}
+
+Symbol symbol_intern_cstr(const char* text) {
+    return symbol_intern(text, strlen(text));
+}
+
+const char* symbol_name(Symbol symbol) {
+    return symbol == SYMBOL_NONE ? "" : entry(symbol)->text;
+}
+
+uint32_t symbol_length(Symbol symbol) {
+    return symbol == SYMBOL_NONE ? 0 : entry(symbol)->length;
+}
+
+size_t symbol_count(void) {
+    pthread_mutex_lock(&table_lock);
+    size_t count = entry_count > 0 ? entry_count - 1 : 0;
+    pthread_mutex_unlock(&table_lock);
+    return count;
+}
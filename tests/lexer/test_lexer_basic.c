@@ -532,6 +532,40 @@ UTEST(lexer_strings, empty_string) {
     lexer_free(lexer);
 }
 
+UTEST(lexer_strings, long_string_with_late_escape) {
+    // Long enough that the quote and backslash search spans several vector blocks
+    const char* input = "'0123456789abcdefghijklmnopqrstuvwxyz0123456789\\'x\\\\' ;";
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(3, count);
+    ASSERT_EQ(TOKEN_STRING, tokens[0]->type);
+    ASSERT_STREQ("0123456789abcdefghijklmnopqrstuvwxyz0123456789'x\\", tokens[0]->value);
+    ASSERT_EQ(TOKEN_SEMICOLON, tokens[1]->type);
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_strings, body_is_a_slice_without_escapes) {
+    Arena arena;
+    arena_init(&arena, 256);
+
+    const char* plain = "\"no escapes here\"";
+    size_t len = 0;
+    const char* body = token_string_body(&arena, plain, strlen(plain), &len);
+    ASSERT_TRUE(body == plain + 1);
+    ASSERT_EQ(15, len);
+
+    const char* escaped = "\"a\\tb\\\\\"";
+    body = token_string_body(&arena, escaped, strlen(escaped), &len);
+    ASSERT_EQ(4, len);
+    ASSERT_STREQ("a\tb\\", body);
+
+    arena_free(&arena);
+}
+
 UTEST(lexer_strings, string_in_assignment) {
     const char* input = "abeg name string = \"John\"";
     Lexer* lexer = lexer_init(input, "test.soro", ".");
@@ -0,0 +1,70 @@
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+static const char* commented_input =
+    "// leading\n"
+    "abeg x = 1; /* inline */ abeg y = 2;\n"
+    "/* block\n   spanning lines */\n"
+    "oya f() { comot x; } // trailing";
+
+UTEST(lexer_comments, skip_emits_no_comment_tokens) {
+    Lexer* plain = lexer_init(commented_input, "test.soro", ".");
+    size_t plain_count = 0;
+    Token** plain_tokens = lexer_tokenize(plain, &plain_count);
+
+    Lexer* skipping = lexer_init(commented_input, "test.soro", ".");
+    skipping->flags |= LEXER_SKIP_COMMENTS;
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(skipping, &count);
+
+    // Same tokens minus the four comments, with the same positions
+    ASSERT_EQ(plain_count - 4, count);
+    size_t j = 0;
+    for(size_t i = 0; i < plain_count; i++) {
+        if(plain_tokens[i]->type == TOKEN_COMMENT)
+            continue;
+        ASSERT_EQ(plain_tokens[i]->type, tokens[j]->type);
+        ASSERT_EQ(plain_tokens[i]->offset, tokens[j]->offset);
+        ASSERT_EQ(plain_tokens[i]->line, tokens[j]->line);
+        ASSERT_EQ(plain_tokens[i]->column, tokens[j]->column);
+        j++;
+    }
+    ASSERT_EQ(0, skipping->comments.count);
+
+    lexer_free(skipping);
+    lexer_free(plain);
+}
+
+UTEST(lexer_comments, collect_records_ranges) {
+    Lexer* lexer = lexer_init(commented_input, "test.soro", ".");
+    lexer->flags |= LEXER_SKIP_COMMENTS | LEXER_COLLECT_COMMENTS;
+    size_t count = 0;
+    lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(4, lexer->comments.count);
+    const char* expected[] = {"// leading", "/* inline */", "/* block\n   spanning lines */",
+                              "// trailing"};
+    for(size_t i = 0; i < 4; i++) {
+        const CommentRange* range = &lexer->comments.ranges[i];
+        ASSERT_EQ(strlen(expected[i]), range->length);
+        ASSERT_EQ(0, memcmp(expected[i], commented_input + range->offset, range->length));
+    }
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_comments, collect_without_skip_keeps_tokens) {
+    Lexer* lexer = lexer_init(commented_input, "test.soro", ".");
+    lexer->flags |= LEXER_COLLECT_COMMENTS;
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(4, lexer->comments.count);
+    ASSERT_EQ(TOKEN_COMMENT, tokens[0]->type);
+    ASSERT_EQ(tokens[0]->offset, lexer->comments.ranges[0].offset);
+
+    lexer_free(lexer);
+}
@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+// Lex input with both cores and require identical token streams
+static int cores_agree(const char* input, size_t len) {
+    SourceFile* source = source_file_create(input, len, "test.soro", ".");
+    Lexer* dfa = lexer_init_source(source);
+    Lexer* sw = lexer_init_source(source);
+    sw->flags |= LEXER_SWITCH_CORE;
+    source_file_release(source);
+
+    size_t dfa_count = 0, sw_count = 0;
+    Token** dfa_tokens = lexer_tokenize(dfa, &dfa_count);
+    Token** sw_tokens = lexer_tokenize(sw, &sw_count);
+
+    int same = (dfa_tokens == NULL) == (sw_tokens == NULL) && dfa_count == sw_count;
+    for(size_t i = 0; same && dfa_tokens && i < dfa_count; i++) {
+        const Token* a = dfa_tokens[i];
+        const Token* b = sw_tokens[i];
+        same = a->type == b->type && strcmp(a->value, b->value) == 0 && a->offset == b->offset &&
+               a->length == b->length && a->line == b->line && a->column == b->column;
+    }
+
+    lexer_free(dfa);
+    lexer_free(sw);
+    return same;
+}
+
+UTEST(lexer_dfa, matches_switch_core_on_tricky_input) {
+    const char* inputs[] = {
+        "1.2.3",     "12abc",    "==!=",          "= = =",     "!!=",       "/",
+        "a/b",       "1.",       "1.x",           "x.5",       ".5",        "a1_b2 _c",
+        "// c\nx",   "/* c */x", "/*\n*\n*/ y",   "'a' \"b\"", "\"\\n\\t\"", "&|#@$%^~`?",
+        "\xc3\xa9t\xc3\xa9", "abeg oya waka comot abi naso true false and or orelse int",
+        "0x1F_ff",   "0x",       "0xg",           "0x_1",      "0b1010",    "0b2",
+        "0B_1",      "1_000",    "1__0",          "1_",        "_1",        "1_.5",
+        "1.5_0",     "1.5_",     "0.0",           "007",       "0b1.5",     "0xab.c",
+    };
+    for(size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        ASSERT_TRUE(cores_agree(inputs[i], strlen(inputs[i])));
+    }
+}
+
+UTEST(lexer_dfa, matches_switch_core_with_embedded_nul) {
+    const char input[] = "abeg x\0= 1;";
+    ASSERT_TRUE(cores_agree(input, sizeof(input) - 1));
+}
+
+UTEST(lexer_dfa, matches_switch_core_on_program) {
+    const char* input =
+        "abeg greeting: string = \"hello\";\n"
+        "oya add(a: int, b: int): int {\n"
+        "    comot a + b * 2 - 3 / 4;\n"
+        "}\n"
+        "abi (x == 1.5 and !done) {\n"
+        "    waka(\"yes\");  // call\n"
+        "} naso {\n"
+        "    /* nothing */ list[0] = y != z < w > v;\n"
+        "}\n";
+    ASSERT_TRUE(cores_agree(input, strlen(input)));
+}
+
+UTEST(lexer_dfa, falls_back_to_last_accepting_state) {
+    Lexer* lexer = lexer_init("7.;", "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(count, 4);
+    ASSERT_EQ(tokens[0]->type, TOKEN_INTEGER);
+    ASSERT_STREQ(tokens[0]->value, "7");
+    ASSERT_EQ(tokens[1]->type, TOKEN_ILLEGAL);
+    ASSERT_EQ(tokens[1]->column, 2);
+    ASSERT_EQ(tokens[2]->type, TOKEN_SEMICOLON);
+    ASSERT_EQ(tokens[3]->type, TOKEN_EOF);
+
+    lexer_free(lexer);
+}
@@ -0,0 +1,86 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../include/lexer.h"
+#include "../../include/source.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+// Write contents to a fresh temporary file; the caller unlinks path
+static void write_temp_file(char* path, const char* contents, size_t len) {
+    int fd = mkstemp(path);
+    if(fd < 0)
+        return;
+    if(len > 0 && write(fd, contents, len) != (ssize_t)len) {
+        len = 0;
+    }
+    close(fd);
+}
+
+UTEST(lexer_mmap, tokenizes_mapped_file) {
+    char path[] = "/tmp/soro_mmap_XXXXXX";
+    const char* contents = "abeg x = 42;\nx + 1;";
+    write_temp_file(path, contents, strlen(contents));
+
+    Lexer* lexer = lexer_init_from_path(path);
+    ASSERT_TRUE(lexer != NULL);
+    ASSERT_TRUE(lexer->source->mapped);
+    ASSERT_STREQ(strrchr(path, '/') + 1, lexer->source->name);
+    ASSERT_STREQ("/tmp", lexer->source->directory);
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(10, count);
+    ASSERT_EQ(TOKEN_ABEG, tokens[0]->type);
+    ASSERT_STREQ("42", tokens[3]->value);
+    ASSERT_EQ(2, tokens[5]->line);
+    ASSERT_EQ(TOKEN_EOF, tokens[9]->type);
+
+    lexer_free(lexer);
+    unlink(path);
+}
+
+UTEST(lexer_mmap, empty_file) {
+    char path[] = "/tmp/soro_mmap_XXXXXX";
+    write_temp_file(path, "", 0);
+
+    Lexer* lexer = lexer_init_from_path(path);
+    ASSERT_TRUE(lexer != NULL);
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(1, count);
+    ASSERT_EQ(TOKEN_EOF, tokens[0]->type);
+
+    lexer_free(lexer);
+    unlink(path);
+}
+
+UTEST(lexer_mmap, missing_file) {
+    ASSERT_TRUE(lexer_init_from_path("/tmp/soro_does_not_exist.soro") == NULL);
+}
+
+UTEST(lexer_mmap, explicit_length_ignores_trailing_bytes) {
+    // Only the first 6 bytes belong to the source; no NUL terminator is needed
+    const char text[] = {'a', 'b', 'e', 'g', ' ', 'x', '+', '+'};
+    SourceFile* source = source_file_create(text, 6, "slice.soro", ".");
+    Lexer* lexer = lexer_init_source(source);
+    source_file_release(source);
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(3, count);
+    ASSERT_EQ(TOKEN_ABEG, tokens[0]->type);
+    ASSERT_STREQ("x", tokens[1]->value);
+    ASSERT_EQ(TOKEN_EOF, tokens[2]->type);
+    ASSERT_EQ(6, tokens[2]->offset);
+
+    lexer_free(lexer);
+}
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+
+// Lines whose newlines sit inside comments and strings, so that many split
+// points land where a fresh lexer would guess the state wrong
+static const char* parallel_unit =
+    "abeg name: string = \"first line\n// not a comment\n/* nor this\";\n"
+    "/* a block comment\n   abeg x = \"not a string\n   // still comment\n*/\n"
+    "oya add(x: int, y: int): int { comot x + y * 2.5; } // trailing \"quote\n"
+    "abi (a == b) { c = !d; } naso { e != f; }\n";
+
+static char* repeat_text(const char* unit, size_t size) {
+    size_t unit_len = strlen(unit);
+    size_t copies = size / unit_len + 1;
+    char* text = malloc(copies * unit_len + 1);
+    for(size_t i = 0; i < copies; i++) {
+        memcpy(text + i * unit_len, unit, unit_len);
+    }
+    text[copies * unit_len] = '\0';
+    return text;
+}
+
+// Tokenize text serially and with thread_count threads; report whether the
+// results (including success) agree
+static int parallel_agrees(const char* text, unsigned thread_count) {
+    Lexer* serial = lexer_init(text, "test.soro", ".");
+    Lexer* parallel = lexer_init(text, "test.soro", ".");
+    serial->flags |= LEXER_QUIET;
+    parallel->flags |= LEXER_QUIET;
+
+    TokenBuffer expected, actual;
+    token_buffer_init(&expected);
+    token_buffer_init(&actual);
+    bool expected_ok = lexer_tokenize_soa(serial, &expected);
+    bool actual_ok = lexer_tokenize_parallel(parallel, &actual, thread_count);
+
+    int same = expected_ok == actual_ok && expected.count == actual.count;
+    for(size_t i = 0; same && i < expected.count; i++) {
+        same = expected.types[i] == actual.types[i] && expected.starts[i] == actual.starts[i] &&
+               expected.lens[i] == actual.lens[i] && expected.lines[i] == actual.lines[i] &&
+               expected.columns[i] == actual.columns[i];
+    }
+
+    token_buffer_free(&expected);
+    token_buffer_free(&actual);
+    lexer_free(serial);
+    lexer_free(parallel);
+    return same;
+}
+
+UTEST(lexer_parallel, matches_serial_lexer) {
+    char* text = repeat_text(parallel_unit, 256 * 1024);
+    for(unsigned threads = 1; threads <= 8; threads++) {
+        ASSERT_TRUE(parallel_agrees(text, threads));
+    }
+    free(text);
+}
+
+UTEST(lexer_parallel, comment_spanning_chunks) {
+    // One block comment covering most of the file
+    char* body = repeat_text("abeg x = 1; \"q\n", 128 * 1024);
+    size_t len = strlen(body);
+    char* text = malloc(len + 32);
+    strcpy(text, "abeg a = 1;\n/*\n");
+    strcat(text, body);
+    strcat(text, "*/\nabeg b = 2;\n");
+
+    ASSERT_TRUE(parallel_agrees(text, 4));
+
+    free(body);
+    free(text);
+}
+
+UTEST(lexer_parallel, reports_same_error) {
+    char* body = repeat_text(parallel_unit, 128 * 1024);
+    size_t len = strlen(body);
+    char* text = malloc(len + 32);
+    strcpy(text, body);
+    strcat(text, "abeg s = \"unterminated\n");
+
+    ASSERT_TRUE(parallel_agrees(text, 4));
+
+    free(body);
+    free(text);
+}
+
+UTEST(lexer_parallel, small_input_falls_back) {
+    ASSERT_TRUE(parallel_agrees("abeg x = 1;\n", 8));
+    ASSERT_TRUE(parallel_agrees("", 8));
+}
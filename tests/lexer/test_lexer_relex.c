@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+
+static bool lex_all(SourceFile* source, TokenBuffer* buffer) {
+    Lexer* lexer = lexer_init_source(source);
+    lexer->flags |= LEXER_QUIET;
+    token_buffer_init(buffer);
+    bool ok = lexer_tokenize_soa(lexer, buffer);
+    lexer_free(lexer);
+    return ok;
+}
+
+// Apply an edit to text, relex incrementally and compare with a full lex of
+// the edited text. Returns the number of tokens relexed, or -1 on mismatch.
+static long relex_matches(const char* text, uint64_t offset, uint64_t removed,
+                          const char* inserted) {
+    size_t len = strlen(text);
+    size_t ins = strlen(inserted);
+    char* edited = malloc(len - removed + ins + 1);
+    memcpy(edited, text, offset);
+    memcpy(edited + offset, inserted, ins);
+    strcpy(edited + offset + ins, text + offset + removed);
+
+    SourceFile* before = source_file_create(text, len, "test.soro", ".");
+    SourceFile* after = source_file_create(edited, strlen(edited), "test.soro", ".");
+
+    TokenBuffer tokens, expected;
+    long result = -1;
+    size_t relexed = 0;
+    bool before_ok = lex_all(before, &tokens);
+    bool after_ok = lex_all(after, &expected);
+    LexerEdit edit = {offset, removed, ins};
+    if(before_ok && !after_ok) {
+        // An edit that introduces an error must fail the same way
+        result = lexer_relex(after, &tokens, &edit, LEXER_QUIET, &relexed) ? -1 : 0;
+    } else if(before_ok) {
+        if(lexer_relex(after, &tokens, &edit, LEXER_QUIET, &relexed) &&
+           tokens.count == expected.count) {
+            result = (long)relexed;
+            for(size_t i = 0; i < tokens.count; i++) {
+                if(tokens.types[i] != expected.types[i] || tokens.starts[i] != expected.starts[i] ||
+                   tokens.lens[i] != expected.lens[i] || tokens.lines[i] != expected.lines[i] ||
+                   tokens.columns[i] != expected.columns[i]) {
+                    result = -1;
+                    break;
+                }
+            }
+        }
+    }
+
+    token_buffer_free(&tokens);
+    token_buffer_free(&expected);
+    source_file_release(before);
+    source_file_release(after);
+    free(edited);
+    return result;
+}
+
+static const char* relex_input =
+    "abeg x = 1;\n"
+    "oya add(a: int, b: int): int {\n"
+    "    comot a + b; // sum\n"
+    "}\n"
+    "/* block\n   comment */ abeg s = \"str\";\n"
+    "abeg y = 2. ;\n";
+
+UTEST(lexer_relex, matches_full_lex) {
+    struct {
+        uint64_t offset;
+        uint64_t removed;
+        const char* inserted;
+    } edits[] = {
+        {6, 0, "yz"},        // Grow an identifier
+        {5, 1, ""},          // Delete an identifier
+        {0, 0, "\n\n"},      // Shift every line
+        {24, 0, "\n  "},     // Split a type keyword across lines
+        {11, 1, ""},         // Join two lines
+        {40, 0, "/*"},       // Open an unterminated comment
+        {40, 0, "/* x */"},  // Add a whole comment
+        {47, 3, "\""},       // Unbalanced quote
+        {63, 0, "\n"},       // End a line comment early
+        {81, 0, "*/ abeg z;"},  // Close a block comment early
+        {119, 0, "5"},       // "2." becomes a float
+        {strlen(relex_input), 0, "abeg tail;"},
+        {0, strlen(relex_input), ""},
+    };
+    for(size_t i = 0; i < sizeof(edits) / sizeof(edits[0]); i++) {
+        ASSERT_NE(-1, relex_matches(relex_input, edits[i].offset, edits[i].removed,
+                                    edits[i].inserted));
+    }
+}
+
+UTEST(lexer_relex, cost_follows_edit_size) {
+    const char* line = "abeg value = other + 42; // note\n";
+    size_t line_len = strlen(line);
+    size_t lines = 2000;
+    char* text = malloc(line_len * lines + 1);
+    for(size_t i = 0; i < lines; i++) {
+        memcpy(text + i * line_len, line, line_len);
+    }
+    text[line_len * lines] = '\0';
+
+    // Rename one identifier in the middle of the file
+    long relexed = relex_matches(text, line_len * (lines / 2) + 5, 5, "renamed");
+    ASSERT_NE(-1, relexed);
+    ASSERT_LT(relexed, 5);
+
+    free(text);
+}
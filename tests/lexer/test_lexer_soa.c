@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/token.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+
+static const char* soa_input =
+    "// greeting\n"
+    "abeg name: string = \"Ada\\n\";\n"
+    "oya add(x: int, y: int): int {\n"
+    "    comot x + y * 2.5;\n"
+    "}\n"
+    "abi (a == b) { c = !d; } naso { e != f; }\n";
+
+UTEST(lexer_soa, matches_token_stream) {
+    Lexer* lexer = lexer_init(soa_input, "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    Lexer* soa_lexer = lexer_init(soa_input, "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(soa_lexer, &buffer));
+
+    ASSERT_EQ(count, buffer.count);
+    for(size_t i = 0; i < count; i++) {
+        ASSERT_EQ(tokens[i]->type, (TokenType)buffer.types[i]);
+        ASSERT_EQ(tokens[i]->offset, buffer.starts[i]);
+        ASSERT_EQ(tokens[i]->length, buffer.lens[i]);
+        ASSERT_EQ(tokens[i]->line, buffer.lines[i]);
+        ASSERT_EQ(tokens[i]->column, buffer.columns[i]);
+    }
+
+    token_buffer_free(&buffer);
+    lexer_free(soa_lexer);
+    lexer_free(lexer);
+}
+
+UTEST(lexer_soa, values_rebuilt_from_slices) {
+    Lexer* lexer = lexer_init("foo \"a\\tb\" /* note */ 42", "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+    ASSERT_EQ(5, buffer.count);
+
+    Arena arena;
+    arena_init(&arena, 256);
+
+    const char* text = lexer->source->text;
+    ASSERT_STREQ("foo", token_value_from_slice(&arena, (TokenType)buffer.types[0],
+                                               text + buffer.starts[0], buffer.lens[0]));
+    ASSERT_STREQ("a\tb", token_value_from_slice(&arena, (TokenType)buffer.types[1],
+                                                text + buffer.starts[1], buffer.lens[1]));
+    ASSERT_STREQ(" note ", token_value_from_slice(&arena, (TokenType)buffer.types[2],
+                                                  text + buffer.starts[2], buffer.lens[2]));
+    ASSERT_STREQ("42", token_value_from_slice(&arena, (TokenType)buffer.types[3],
+                                              text + buffer.starts[3], buffer.lens[3]));
+    ASSERT_EQ(TOKEN_EOF, (TokenType)buffer.types[4]);
+
+    arena_free(&arena);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
+
+UTEST(lexer_soa, error_returns_false) {
+    Lexer* lexer = lexer_init("abeg s = \"open", "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+
+    ASSERT_FALSE(lexer_tokenize_soa(lexer, &buffer));
+
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/source.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+UTEST(lexer_source, tokens_share_source_file) {
+    Lexer* lexer = lexer_init("abeg x = 5;", "main.soro", "src");
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(6, count);
+    for(size_t i = 0; i < count; i++) {
+        ASSERT_TRUE(tokens[i]->source == lexer->source);
+    }
+    ASSERT_STREQ("main.soro", lexer->source->name);
+    ASSERT_STREQ("src", lexer->source->directory);
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_source, token_slices_cover_source_text) {
+    const char* input = "abeg total = price * 12;";
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(8, count);
+
+    ASSERT_EQ(5, tokens[1]->offset);
+    ASSERT_EQ(5, tokens[1]->length);
+    ASSERT_EQ(0, strncmp("total", token_text(tokens[1]), tokens[1]->length));
+
+    ASSERT_EQ(21, tokens[5]->offset);
+    ASSERT_EQ(2, tokens[5]->length);
+    ASSERT_EQ(0, strncmp("12", token_text(tokens[5]), tokens[5]->length));
+
+    ASSERT_EQ(TOKEN_EOF, tokens[7]->type);
+    ASSERT_EQ(strlen(input), tokens[7]->offset);
+    ASSERT_EQ(0, tokens[7]->length);
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_source, string_slice_includes_quotes) {
+    Lexer* lexer = lexer_init("\"a\\tb\" 'plain'", "test.soro", ".");
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(3, count);
+
+    // The slice is the raw literal; value is the decoded text
+    ASSERT_EQ(0, tokens[0]->offset);
+    ASSERT_EQ(6, tokens[0]->length);
+    ASSERT_STREQ("a\tb", tokens[0]->value);
+
+    ASSERT_EQ(7, tokens[1]->offset);
+    ASSERT_EQ(7, tokens[1]->length);
+    ASSERT_STREQ("plain", tokens[1]->value);
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_source, standalone_token_keeps_source_alive) {
+    SourceFile* source = source_file_create("hello", 5, "a.soro", ".");
+    Token* token = token_create(TOKEN_IDENT, "hello", source, 0, 5, 1, 1);
+    ASSERT_EQ(2, source->refcount);
+
+    source_file_release(source);
+    ASSERT_EQ(1, token->source->refcount);
+    ASSERT_EQ(0, strncmp("hello", token_text(token), token->length));
+
+    token_free(token);
+}
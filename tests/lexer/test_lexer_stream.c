@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+// Serves a string a few bytes at a time, like a slow pipe
+typedef struct {
+    const char* data;
+    size_t len;
+    size_t pos;
+    size_t max_read;
+} StringReader;
+
+static size_t read_string_chunks(void* context, char* buffer, size_t size) {
+    StringReader* reader = context;
+    size_t n = reader->len - reader->pos;
+    if(n > size)
+        n = size;
+    if(n > reader->max_read)
+        n = reader->max_read;
+    memcpy(buffer, reader->data + reader->pos, n);
+    reader->pos += n;
+    return n;
+}
+
+static const char* stream_input =
+    "/* a block comment that is much longer\n   than one chunk */\n"
+    "abeg greeting: string = \"hello, \\\"streaming\\\" world\";\n"
+    "oya a_rather_long_function_name(x: int): int {\n"
+    "    comot x == 10 != false; // trailing\n"
+    "}\n"
+    "abeg pi = 3.14159;\n";
+
+UTEST(lexer_stream, matches_resident_lexer) {
+    Lexer* lexer = lexer_init(stream_input, "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    size_t chunk_sizes[] = {1, 3, 7, 64, 4096};
+    for(size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+        StringReader reader = {stream_input, strlen(stream_input), 0, 5};
+        Lexer* stream = lexer_init_stream(read_string_chunks, &reader, chunk_sizes[c],
+                                          "test.soro", ".");
+        size_t stream_count = 0;
+        Token** stream_tokens = lexer_tokenize(stream, &stream_count);
+
+        ASSERT_EQ(count, stream_count);
+        for(size_t i = 0; i < count; i++) {
+            ASSERT_EQ(tokens[i]->type, stream_tokens[i]->type);
+            ASSERT_STREQ(tokens[i]->value, stream_tokens[i]->value);
+            ASSERT_EQ(tokens[i]->offset, stream_tokens[i]->offset);
+            ASSERT_EQ(tokens[i]->length, stream_tokens[i]->length);
+            ASSERT_EQ(tokens[i]->line, stream_tokens[i]->line);
+            ASSERT_EQ(tokens[i]->column, stream_tokens[i]->column);
+        }
+
+        lexer_free(stream);
+    }
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_stream, window_bounded_by_chunk_and_longest_token) {
+    // Many short tokens: the window never needs more than a chunk plus one token
+    char input[4096];
+    size_t len = 0;
+    while(len + 12 < sizeof(input)) {
+        memcpy(input + len, "abeg x = 1;\n", 12);
+        len += 12;
+    }
+    input[len] = '\0';
+
+    StringReader reader = {input, len, 0, 64};
+    Lexer* lexer = lexer_init_stream(read_string_chunks, &reader, 64, "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(len / 12 * 5 + 1, count);
+    ASSERT_EQ(TOKEN_EOF, tokens[count - 1]->type);
+    ASSERT_LE(lexer->stream->capacity, (size_t)(64 + 4));
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_stream, unterminated_comment_across_chunks) {
+    const char* input = "abeg x; /* never closed";
+    StringReader reader = {input, strlen(input), 0, 4};
+    Lexer* lexer = lexer_init_stream(read_string_chunks, &reader, 4, "test.soro", ".");
+
+    size_t count = 0;
+    lexer_tokenize(lexer, &count);
+
+    // abeg x ; and then the error stops tokenization
+    ASSERT_EQ(3, count);
+
+    lexer_free(lexer);
+}
+
+UTEST(lexer_stream, reads_from_file) {
+    FILE* file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    fputs("waka (true) { x = x + 1; }", file);
+    rewind(file);
+
+    Lexer* lexer = lexer_init_stream(lexer_read_file, file, 8, "stdin", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(13, count);
+    ASSERT_EQ(TOKEN_WAKA, tokens[0]->type);
+    ASSERT_EQ(TOKEN_RBRACE, tokens[11]->type);
+
+    lexer_free(lexer);
+    fclose(file);
+}
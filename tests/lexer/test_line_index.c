@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/line_index.h"
+#include "../utest.h"
+
+UTEST(line_index, resolves_offsets) {
+    const char* text = "ab\n\ncde\nf";
+    LineIndex index;
+    ASSERT_TRUE(line_index_init(&index));
+    ASSERT_TRUE(line_index_scan(&index, text, strlen(text)));
+    ASSERT_EQ(4, index.count);
+
+    uint32_t line, column;
+    line_index_lookup(&index, 0, &line, &column);
+    ASSERT_EQ(1, line);
+    ASSERT_EQ(1, column);
+    line_index_lookup(&index, 2, &line, &column);  // The newline ends its own line
+    ASSERT_EQ(1, line);
+    ASSERT_EQ(3, column);
+    line_index_lookup(&index, 3, &line, &column);
+    ASSERT_EQ(2, line);
+    ASSERT_EQ(1, column);
+    line_index_lookup(&index, 6, &line, &column);
+    ASSERT_EQ(3, line);
+    ASSERT_EQ(3, column);
+    line_index_lookup(&index, 8, &line, &column);
+    ASSERT_EQ(4, line);
+    ASSERT_EQ(1, column);
+
+    line_index_free(&index);
+}
+
+UTEST(line_index, scans_incrementally) {
+    // Enough lines to outgrow the initial table, fed in uneven pieces
+    char text[4000];
+    for(size_t i = 0; i < sizeof(text); i++) {
+        text[i] = (i % 7 == 6) ? '\n' : 'x';
+    }
+
+    LineIndex whole, pieces;
+    ASSERT_TRUE(line_index_init(&whole));
+    ASSERT_TRUE(line_index_init(&pieces));
+    ASSERT_TRUE(line_index_scan(&whole, text, sizeof(text)));
+    for(uint64_t at = 0; at < sizeof(text); at += 13) {
+        uint64_t end = at + 13 < sizeof(text) ? at + 13 : sizeof(text);
+        ASSERT_TRUE(line_index_scan(&pieces, text + at, end));
+    }
+
+    ASSERT_EQ(sizeof(text) / 7 + 1, whole.count);
+    ASSERT_EQ(whole.count, pieces.count);
+    ASSERT_EQ(0, memcmp(whole.starts, pieces.starts, whole.count * sizeof(uint64_t)));
+
+    line_index_free(&whole);
+    line_index_free(&pieces);
+}
+
+UTEST(line_index, notes_lines_from_token_positions) {
+    // Tokens on lines 1, 2 and 5 of "ab\ncd\n\n\n  ef"
+    LineIndex index;
+    ASSERT_TRUE(line_index_init(&index));
+    ASSERT_TRUE(line_index_note(&index, 1, 0));
+    ASSERT_TRUE(line_index_note(&index, 2, 3));
+    ASSERT_TRUE(line_index_note(&index, 5, 8));
+    ASSERT_TRUE(line_index_note(&index, 5, 8));  // Noting a line again changes nothing
+    ASSERT_EQ(5, index.count);
+
+    uint32_t line, column;
+    line_index_lookup(&index, 1, &line, &column);
+    ASSERT_EQ(1, line);
+    ASSERT_EQ(2, column);
+    line_index_lookup(&index, 4, &line, &column);
+    ASSERT_EQ(2, line);
+    ASSERT_EQ(2, column);
+    line_index_lookup(&index, 10, &line, &column);  // Skipped lines resolve past
+    ASSERT_EQ(5, line);
+    ASSERT_EQ(3, column);
+
+    line_index_free(&index);
+}
+
+UTEST(line_index, lexer_location_matches_tokens) {
+    const char* input = "abeg x = 1;\n\n  oya f() {\n\tcomot \"a\nb\" ;\n}\n";
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    for(size_t i = 0; i < count; i++) {
+        uint32_t line, column;
+        lexer_location(lexer, tokens[i]->offset, &line, &column);
+        ASSERT_EQ(tokens[i]->line, line);
+        ASSERT_EQ(tokens[i]->column, column);
+    }
+
+    // The token after a multi-line string
+    ASSERT_EQ(TOKEN_SEMICOLON, tokens[count - 3]->type);
+    ASSERT_EQ(5, tokens[count - 3]->line);
+    ASSERT_EQ(4, tokens[count - 3]->column);
+
+    lexer_free(lexer);
+}
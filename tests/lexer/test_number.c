@@ -0,0 +1,131 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/number.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+static NumberStatus parse_int(const char* text, int64_t* value) {
+    return number_parse_int(text, strlen(text), value);
+}
+
+static NumberStatus parse_float(const char* text, double* value) {
+    return number_parse_float(text, strlen(text), value);
+}
+
+UTEST(number, parses_integers_in_every_base) {
+    int64_t value = 0;
+    ASSERT_EQ(parse_int("0", &value), NUMBER_OK);
+    ASSERT_EQ(value, 0);
+    ASSERT_EQ(parse_int("1234567890", &value), NUMBER_OK);
+    ASSERT_EQ(value, 1234567890);
+    ASSERT_EQ(parse_int("0x7fFF", &value), NUMBER_OK);
+    ASSERT_EQ(value, 0x7fff);
+    ASSERT_EQ(parse_int("0b1011", &value), NUMBER_OK);
+    ASSERT_EQ(value, 11);
+    ASSERT_EQ(parse_int("1_000_000", &value), NUMBER_OK);
+    ASSERT_EQ(value, 1000000);
+    ASSERT_EQ(parse_int("0xdead_beef", &value), NUMBER_OK);
+    ASSERT_EQ(value, 0xdeadbeef);
+}
+
+UTEST(number, detects_integer_overflow) {
+    int64_t value = 0;
+    ASSERT_EQ(parse_int("9223372036854775807", &value), NUMBER_OK);
+    ASSERT_EQ(value, INT64_MAX);
+    ASSERT_EQ(parse_int("9223372036854775808", &value), NUMBER_OVERFLOW);
+    ASSERT_EQ(parse_int("99999999999999999999", &value), NUMBER_OVERFLOW);
+    ASSERT_EQ(parse_int("0x7fffffffffffffff", &value), NUMBER_OK);
+    ASSERT_EQ(parse_int("0x8000000000000000", &value), NUMBER_OVERFLOW);
+    ASSERT_EQ(parse_int("0b1", &value), NUMBER_OK);
+    ASSERT_EQ(parse_int("12a", &value), NUMBER_INVALID);
+    ASSERT_EQ(parse_int("0b2", &value), NUMBER_INVALID);
+}
+
+UTEST(number, floats_match_strtod) {
+    const char* inputs[] = {
+        "0.0",
+        "1.5",
+        "0.1",
+        "3.141592653589793",
+        "123456.789",
+        "0.000001",
+        "9007199254740993.0",            // Halfway between two doubles
+        "1.7976931348623157",            // Mantissa needing every bit
+        "12345678901234567890.123",      // More digits than fit a uint64
+        "0.000000000000000000000000001", // Below the fast exponent range
+        "4.9406564584124654",
+        "2.2250738585072014",
+    };
+    for(size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        double value = -1.0;
+        ASSERT_EQ(parse_float(inputs[i], &value), NUMBER_OK);
+        ASSERT_EQ(value, strtod(inputs[i], NULL));
+    }
+}
+
+UTEST(number, random_floats_round_like_strtod) {
+    srand(42);
+    char text[64];
+    for(int i = 0; i < 20000; i++) {
+        int int_digits = 1 + rand() % 12;
+        int frac_digits = 1 + rand() % 12;
+        int n = 0;
+        for(int d = 0; d < int_digits; d++) {
+            text[n++] = (char)('0' + rand() % 10);
+        }
+        text[n++] = '.';
+        for(int d = 0; d < frac_digits; d++) {
+            text[n++] = (char)('0' + rand() % 10);
+        }
+        text[n] = '\0';
+
+        double value = 0.0;
+        ASSERT_EQ(parse_float(text, &value), NUMBER_OK);
+        ASSERT_EQ(value, strtod(text, NULL));
+    }
+}
+
+UTEST(number, float_separators_and_overflow) {
+    double value = 0.0;
+    ASSERT_EQ(parse_float("1_000.000_5", &value), NUMBER_OK);
+    ASSERT_EQ(value, 1000.0005);
+
+    char huge[400];
+    memset(huge, '9', 350);
+    strcpy(huge + 350, ".0");
+    ASSERT_EQ(parse_float(huge, &value), NUMBER_OVERFLOW);
+}
+
+UTEST(number, lexer_decodes_literals) {
+    Lexer* lexer = lexer_init("0x10 0b11 1_000 2.5 0x", "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(count, 7);
+    ASSERT_EQ(tokens[0]->type, TOKEN_INTEGER);
+    ASSERT_EQ(tokens[0]->number.int_val, 16);
+    ASSERT_EQ(tokens[1]->number.int_val, 3);
+    ASSERT_EQ(tokens[2]->number.int_val, 1000);
+    ASSERT_STREQ(tokens[2]->value, "1_000");
+    ASSERT_EQ(tokens[3]->type, TOKEN_FLOAT);
+    ASSERT_EQ(tokens[3]->number.float_val, 2.5);
+    ASSERT_EQ(tokens[4]->type, TOKEN_INTEGER);  // "0x" without digits is 0 then x
+    ASSERT_EQ(tokens[4]->number.int_val, 0);
+    ASSERT_EQ(tokens[5]->type, TOKEN_IDENT);
+
+    lexer_free(lexer);
+}
+
+UTEST(number, lexer_reports_overflow) {
+    Lexer* lexer = lexer_init("abeg x = 9223372036854775808;", "test.soro", ".");
+    lexer->flags |= LEXER_QUIET;
+    size_t count = 0;
+    lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(count, 3);  // Lexing stops at the literal
+
+    lexer_free(lexer);
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/scan.h"
+#include "../utest.h"
+
+#define SCAN_BUFFER_SIZE 300
+
+// Deterministic mix of whitespace, identifier chars, punctuation and high bytes
+static void fill_buffer(char* buffer, size_t len, unsigned seed) {
+    static const char alphabet[] = "  \t\n\rabcXYZ_09/*\n+;\"\\\x80\xff";
+    for(size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+}
+
+// Compare every kernel of level against the scalar ones on many offsets
+static int kernels_agree(ScanLevel level) {
+    if(!scan_select(SCAN_SCALAR))
+        return 0;
+    const ScanKernels* scalar = scan_kernels();
+    if(!scan_select(level))
+        return 1;  // Not supported on this CPU; nothing to compare
+    const ScanKernels* vector = scan_kernels();
+
+    char buffer[SCAN_BUFFER_SIZE];
+    for(unsigned seed = 0; seed < 20; seed++) {
+        fill_buffer(buffer, sizeof(buffer), seed);
+
+        for(size_t start = 0; start < 40; start++) {
+            const char* p = buffer + start;
+            const char* end = buffer + sizeof(buffer) - (seed % 7);
+
+            if(scalar->skip_whitespace(p, end) != vector->skip_whitespace(p, end))
+                return 0;
+            if(scalar->skip_identifier(p, end) != vector->skip_identifier(p, end))
+                return 0;
+            if(scalar->find_byte(p, end, '*') != vector->find_byte(p, end, '*'))
+                return 0;
+            if(scalar->find_either(p, end, '"', '\\') != vector->find_either(p, end, '"', '\\'))
+                return 0;
+
+            const char* scalar_last = NULL;
+            const char* vector_last = NULL;
+            if(scalar->count_newlines(p, end, &scalar_last) !=
+               vector->count_newlines(p, end, &vector_last))
+                return 0;
+            if(scalar_last != vector_last)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// Put back the best level so later tests run with the default kernels
+static void restore_default_kernels(void) {
+    if(!scan_select(SCAN_AVX2) && !scan_select(SCAN_SSE2)) {
+        scan_select(SCAN_SCALAR);
+    }
+}
+
+UTEST(scan, sse2_matches_scalar) {
+    int agree = kernels_agree(SCAN_SSE2);
+    restore_default_kernels();
+    ASSERT_TRUE(agree);
+}
+
+UTEST(scan, avx2_matches_scalar) {
+    int agree = kernels_agree(SCAN_AVX2);
+    restore_default_kernels();
+    ASSERT_TRUE(agree);
+}
+
+UTEST(scan, long_runs_keep_line_and_column) {
+    // Runs longer than a vector so the bulk paths are exercised
+    const char* input =
+        "                                        \n\n\n"
+        "   abcdefghijklmnopqrstuvwxyz_0123456789ABCDEFGHIJKLMNOP\n"
+        "/* comment spanning\n\n several lines ********** with stars */ x\n"
+        "// line comment running well past thirty-two bytes\n"
+        "y";
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    ASSERT_EQ(6, count);
+    ASSERT_EQ(TOKEN_IDENT, tokens[0]->type);
+    ASSERT_EQ(4, tokens[0]->line);
+    ASSERT_EQ(4, tokens[0]->column);
+    ASSERT_EQ(TOKEN_COMMENT, tokens[1]->type);
+    ASSERT_EQ(5, tokens[1]->line);
+    ASSERT_EQ(TOKEN_IDENT, tokens[2]->type);
+    ASSERT_EQ(7, tokens[2]->line);
+    ASSERT_EQ(41, tokens[2]->column);
+    ASSERT_EQ(TOKEN_COMMENT, tokens[3]->type);
+    ASSERT_EQ(8, tokens[3]->line);
+    ASSERT_EQ(TOKEN_IDENT, tokens[4]->type);
+    ASSERT_EQ(9, tokens[4]->line);
+    ASSERT_EQ(1, tokens[4]->column);
+
+    lexer_free(lexer);
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/token.h"
+#include "../utest.h"
+
+UTEST(token_keywords, every_keyword_classifies) {
+    struct {
+        const char* word;
+        TokenType type;
+    } cases[] = {
+        {"abeg", TOKEN_ABEG},   {"oya", TOKEN_OYA},     {"waka", TOKEN_WAKA},
+        {"comot", TOKEN_COMOT}, {"abi", TOKEN_ABI},     {"naso", TOKEN_NASO},
+        {"true", TOKEN_TRUE},   {"false", TOKEN_FALSE}, {"and", TOKEN_AND},
+        {"or", TOKEN_OR},       {"orelse", TOKEN_OR_ELSE}, {"int", TOKEN_TYPE},
+        {"float", TOKEN_TYPE},  {"string", TOKEN_TYPE}, {"bool", TOKEN_TYPE},
+        {"void", TOKEN_TYPE},   {"any", TOKEN_TYPE},    {"error", TOKEN_TYPE},
+        {"interface", TOKEN_TYPE},
+    };
+
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ASSERT_EQ(cases[i].type, token_classify_ident(cases[i].word, strlen(cases[i].word)));
+    }
+}
+
+UTEST(token_keywords, near_misses_are_identifiers) {
+    const char* words[] = {"a",      "ab",     "abe",   "abegg", "Abeg",  "oyaa",
+                           "orels",  "orelsee", "in",   "ints",  "strings", "interfac",
+                           "interfaces", "x",   "_",    "ang",   "ant",   "tru"};
+
+    for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        ASSERT_EQ(TOKEN_IDENT, token_classify_ident(words[i], strlen(words[i])));
+    }
+}
+
+UTEST(token_keywords, reads_from_unterminated_slice) {
+    // Only the first len bytes count; the rest of the buffer must be ignored
+    const char* text = "abegin";
+    ASSERT_EQ(TOKEN_ABEG, token_classify_ident(text, 4));
+    ASSERT_EQ(TOKEN_IDENT, token_classify_ident(text, 5));
+    ASSERT_EQ(TOKEN_IDENT, token_classify_ident(text, 6));
+}
+
+UTEST(token_keywords, legacy_lookups_agree) {
+    ASSERT_EQ(TOKEN_COMOT, token_lookup_keyword("comot"));
+    ASSERT_EQ(TOKEN_IDENT, token_lookup_keyword("string"));
+    ASSERT_TRUE(token_is_type_keyword("string"));
+    ASSERT_FALSE(token_is_type_keyword("comot"));
+}
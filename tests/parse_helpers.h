@@ -0,0 +1,18 @@
+#ifndef PARSE_HELPERS_H
+#define PARSE_HELPERS_H
+
+#include "../include/lexer.h"
+#include "../include/parser/parser.h"
+
+// Lex and parse input in streaming mode, freeing the parser and lexer; the
+// tree outlives both. NULL on a syntax error (reported on stderr).
+static inline ASTNode* parse_source(const char* input) {
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+    return ast;
+}
+
+#endif  // PARSE_HELPERS_H
@@ -0,0 +1,115 @@
+#ifndef AST_EQUAL_H
+#define AST_EQUAL_H
+
+#include <stdbool.h>
+
+#include "../../include/parser/ast.h"
+
+// Structural equality of two trees, source locations included, for tests that
+// check one way of parsing against another
+
+static inline bool same_expr(const Expr* a, const Expr* b) {
+    if(!a || !b)
+        return a == b;
+    if(a->type != b->type || a->loc != b->loc)
+        return false;
+
+    switch(a->type) {
+        case EXPR_LITERAL:
+            if(a->as.literal.type != b->as.literal.type)
+                return false;
+            switch(a->as.literal.type) {
+                case LITERAL_INT:
+                    return a->as.literal.value.int_val == b->as.literal.value.int_val;
+                case LITERAL_FLOAT:
+                    return a->as.literal.value.float_val == b->as.literal.value.float_val;
+                case LITERAL_STRING:
+                    return a->as.literal.value.string_val == b->as.literal.value.string_val;
+                case LITERAL_BOOL:
+                    return a->as.literal.value.bool_val == b->as.literal.value.bool_val;
+            }
+            return false;
+        case EXPR_VARIABLE:
+            return a->as.variable.name == b->as.variable.name;
+        case EXPR_BINARY:
+            return a->as.binary.op == b->as.binary.op &&
+                   same_expr(a->as.binary.left, b->as.binary.left) &&
+                   same_expr(a->as.binary.right, b->as.binary.right);
+        case EXPR_UNARY:
+            return a->as.unary.op == b->as.unary.op &&
+                   same_expr(a->as.unary.right, b->as.unary.right);
+        case EXPR_CALL:
+            if(a->as.call.arg_count != b->as.call.arg_count ||
+               !same_expr(a->as.call.callee, b->as.call.callee))
+                return false;
+            for(size_t i = 0; i < a->as.call.arg_count; i++) {
+                if(!same_expr(a->as.call.args[i], b->as.call.args[i]))
+                    return false;
+            }
+            return true;
+        case EXPR_INDEX:
+            return same_expr(a->as.index.object, b->as.index.object) &&
+                   same_expr(a->as.index.index, b->as.index.index);
+        case EXPR_ARRAY:
+            if(a->as.array.count != b->as.array.count)
+                return false;
+            for(size_t i = 0; i < a->as.array.count; i++) {
+                if(!same_expr(a->as.array.elements[i], b->as.array.elements[i]))
+                    return false;
+            }
+            return true;
+        case EXPR_ASSIGN:
+            return a->as.assign.name == b->as.assign.name &&
+                   same_expr(a->as.assign.value, b->as.assign.value);
+    }
+    return false;
+}
+
+static inline bool same_stmt(const Stmt* a, const Stmt* b) {
+    if(!a || !b)
+        return a == b;
+    if(a->type != b->type || a->loc != b->loc)
+        return false;
+
+    switch(a->type) {
+        case STMT_EXPR:
+            return same_expr(a->as.expr_stmt.expression, b->as.expr_stmt.expression);
+        case STMT_VAR_DECL:
+            return a->as.var_decl.name == b->as.var_decl.name &&
+                   a->as.var_decl.type_annotation == b->as.var_decl.type_annotation &&
+                   same_expr(a->as.var_decl.initializer, b->as.var_decl.initializer);
+        case STMT_FUNCTION_DECL: {
+            const FunctionDecl* fa = &a->as.function_decl;
+            const FunctionDecl* fb = &b->as.function_decl;
+            if(fa->name != fb->name || fa->param_count != fb->param_count ||
+               fa->return_type != fb->return_type)
+                return false;
+            for(size_t i = 0; i < fa->param_count; i++) {
+                if(fa->param_names[i] != fb->param_names[i] ||
+                   fa->param_types[i] != fb->param_types[i])
+                    return false;
+            }
+            return same_stmt(fa->body, fb->body);
+        }
+        case STMT_IF:
+            return same_expr(a->as.if_stmt.condition, b->as.if_stmt.condition) &&
+                   same_stmt(a->as.if_stmt.then_branch, b->as.if_stmt.then_branch) &&
+                   same_stmt(a->as.if_stmt.else_branch, b->as.if_stmt.else_branch);
+        case STMT_WHILE:
+            return same_expr(a->as.while_stmt.condition, b->as.while_stmt.condition) &&
+                   same_stmt(a->as.while_stmt.body, b->as.while_stmt.body);
+        case STMT_RETURN:
+            return same_expr(a->as.return_stmt.value, b->as.return_stmt.value);
+        case STMT_BLOCK:
+            if(a->as.block.count != b->as.block.count)
+                return false;
+            for(size_t i = 0; i < a->as.block.count; i++) {
+                if(!same_stmt(a->as.block.statements[i], b->as.block.statements[i]))
+                    return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+#endif  // AST_EQUAL_H
@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../include/parser/ast_cache.h"
+#include "../../include/parser/parser.h"
+#include "../utest.h"
+#include "ast_equal.h"
+
+static const char* cached_program =
+    "// cached\n"
+    "oya area(w: int, h: int): int { abi (w > 0 and h > 0) { comot w * h; } naso { comot -1; } }\n"
+    "abeg sizes: int[] = [1, 2.5, \"three\\n\", area(4, 5), true];\n"
+    "abeg plain;\n"
+    "waka (!done) { total = total + sizes[i]; { nested(); } }\n"
+    "oya nothing() { comot; }\n";
+
+struct ast_cache {
+    char directory[32];
+};
+
+UTEST_F_SETUP(ast_cache) {
+    strcpy(utest_fixture->directory, "/tmp/soro_cache_XXXXXX");
+    ASSERT_TRUE(mkdtemp(utest_fixture->directory) != NULL);
+}
+
+UTEST_F_TEARDOWN(ast_cache) {
+    DIR* dir = opendir(utest_fixture->directory);
+    ASSERT_TRUE(dir != NULL);
+    struct dirent* file;
+    while((file = readdir(dir)) != NULL) {
+        if(file->d_name[0] != '.') {
+            char path[128];
+            snprintf(path, sizeof(path), "%s/%s", utest_fixture->directory, file->d_name);
+            remove(path);
+        }
+    }
+    closedir(dir);
+    ASSERT_EQ(0, rmdir(utest_fixture->directory));
+}
+
+static char* entry_file(const char* directory, uint64_t key) {
+    static char path[128];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 ".ast", directory, key);
+    return path;
+}
+
+static SourceFile* source_of(const char* text) {
+    return source_file_create(text, strlen(text), "cached.soro", ".");
+}
+
+static bool same_trees(const FlatAst* a, const FlatAst* b) {
+    ASTNode* x = flat_ast_to_tree(a);
+    ASTNode* y = flat_ast_to_tree(b);
+    bool same = x->as.program.count == y->as.program.count;
+    for(size_t i = 0; same && i < x->as.program.count; i++) {
+        same = same_stmt(x->as.program.statements[i], y->as.program.statements[i]);
+    }
+    ast_free_node(x);
+    ast_free_node(y);
+    return same;
+}
+
+UTEST_F(ast_cache, second_parse_loads_the_entry) {
+    SourceFile* source = source_of(cached_program);
+    bool hit;
+    FlatAst* parsed = ast_cache_parse(utest_fixture->directory, source, &hit);
+    ASSERT_TRUE(parsed != NULL);
+    ASSERT_FALSE(hit);
+
+    FlatAst* loaded = ast_cache_parse(utest_fixture->directory, source, &hit);
+    ASSERT_TRUE(loaded != NULL);
+    ASSERT_TRUE(hit);
+    ASSERT_TRUE(same_trees(parsed, loaded));
+
+    // Locations resolve through the stored line table
+    ASSERT_EQ(parsed->stmt_count, loaded->stmt_count);
+    for(FlatStmt i = 0; i < loaded->stmt_count; i++) {
+        uint32_t line_a, column_a, line_b, column_b;
+        flat_ast_resolve_loc(parsed, parsed->stmt_locs[i], &line_a, &column_a);
+        flat_ast_resolve_loc(loaded, loaded->stmt_locs[i], &line_b, &column_b);
+        ASSERT_EQ(line_a, line_b);
+        ASSERT_EQ(column_a, column_b);
+    }
+
+    flat_ast_free(parsed);
+    flat_ast_free(loaded);
+    source_file_release(source);
+}
+
+UTEST_F(ast_cache, edited_source_misses) {
+    SourceFile* source = source_of(cached_program);
+    bool hit;
+    flat_ast_free(ast_cache_parse(utest_fixture->directory, source, &hit));
+    source_file_release(source);
+
+    // The same program with different text
+    size_t len = strlen(cached_program);
+    char* edited = malloc(len + 2);
+    memcpy(edited, cached_program, len);
+    strcpy(edited + len, "\n");
+    source = source_of(edited);
+    FlatAst* ast = ast_cache_parse(utest_fixture->directory, source, &hit);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_FALSE(hit);
+
+    flat_ast_free(ast);
+    source_file_release(source);
+    free(edited);
+}
+
+UTEST_F(ast_cache, store_creates_missing_directories) {
+    char nested[64];
+    snprintf(nested, sizeof(nested), "%s/a/b", utest_fixture->directory);
+    SourceFile* source = source_of(cached_program);
+    bool hit;
+    flat_ast_free(ast_cache_parse(nested, source, &hit));
+    ASSERT_FALSE(hit);
+    FlatAst* ast = ast_cache_parse(nested, source, &hit);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_TRUE(hit);
+
+    // The teardown only empties the top directory
+    ASSERT_EQ(0, remove(entry_file(nested, ast_cache_key(cached_program, strlen(cached_program)))));
+    ASSERT_EQ(0, rmdir(nested));
+    nested[strlen(nested) - 2] = '\0';
+    ASSERT_EQ(0, rmdir(nested));
+
+    flat_ast_free(ast);
+    source_file_release(source);
+}
+
+UTEST_F(ast_cache, errors_are_not_cached) {
+    SourceFile* source = source_of("abeg = 1;\n");
+    bool hit;
+    ASSERT_TRUE(ast_cache_parse(utest_fixture->directory, source, &hit) == NULL);
+    ASSERT_EQ(-1, access(entry_file(utest_fixture->directory, ast_cache_key("abeg = 1;\n", 10)),
+                         F_OK));
+    source_file_release(source);
+}
+
+UTEST_F(ast_cache, damaged_entries_are_rejected) {
+    SourceFile* source = source_of(cached_program);
+    uint64_t key = ast_cache_key(source->text, source->length);
+    bool hit;
+    FlatAst* parsed = ast_cache_parse(utest_fixture->directory, source, &hit);
+    ASSERT_TRUE(parsed != NULL);
+    const char* path = entry_file(utest_fixture->directory, key);
+
+    FILE* file = fopen(path, "rb");
+    ASSERT_TRUE(file != NULL);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    unsigned char* entry = malloc((size_t)size);
+    rewind(file);
+    ASSERT_EQ((size_t)size, fread(entry, 1, (size_t)size, file));
+    fclose(file);
+
+    // Another key does not find it
+    ASSERT_TRUE(ast_cache_load(utest_fixture->directory, key + 1) == NULL);
+
+    // Truncated
+    file = fopen(path, "wb");
+    fwrite(entry, 1, (size_t)size - 1, file);
+    fclose(file);
+    ASSERT_TRUE(ast_cache_load(utest_fixture->directory, key) == NULL);
+
+    // A child index pointing past its parent (the first expression's
+    // operands are at bytes 4..11 of the first section, which starts after
+    // the 72-byte header)
+    unsigned char* damaged = malloc((size_t)size);
+    memcpy(damaged, entry, (size_t)size);
+    uint32_t far = UINT32_MAX - 1;
+    for(size_t at = 72; at + 12 <= 72 + 12 * parsed->expr_count; at += 12) {
+        if(damaged[at] == EXPR_BINARY) {
+            memcpy(damaged + at + 4, &far, sizeof(far));
+            break;
+        }
+    }
+    file = fopen(path, "wb");
+    fwrite(damaged, 1, (size_t)size, file);
+    fclose(file);
+    ASSERT_TRUE(ast_cache_load(utest_fixture->directory, key) == NULL);
+
+    // The intact entry still loads
+    file = fopen(path, "wb");
+    fwrite(entry, 1, (size_t)size, file);
+    fclose(file);
+    FlatAst* loaded = ast_cache_load(utest_fixture->directory, key);
+    ASSERT_TRUE(loaded != NULL);
+    ASSERT_TRUE(same_trees(parsed, loaded));
+
+    flat_ast_free(loaded);
+    flat_ast_free(parsed);
+    free(damaged);
+    free(entry);
+    source_file_release(source);
+}
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/ast_fold.h"
+#include "../../include/parser/parser.h"
+#include "../parse_helpers.h"
+#include "../utest.h"
+
+static ASTNode* parse_and_fold(const char* input, AstFoldStats* stats) {
+    ASTNode* ast = parse_source(input);
+    if(ast) {
+        ast_fold(ast, stats);
+    }
+    return ast;
+}
+
+static Expr* statement_expr(ASTNode* ast, size_t i) {
+    return ast->as.program.statements[i]->as.expr_stmt.expression;
+}
+
+static bool is_int(const Expr* expr, int64_t value) {
+    return expr->type == EXPR_LITERAL && expr->as.literal.type == LITERAL_INT &&
+           expr->as.literal.value.int_val == value;
+}
+
+static bool is_bool(const Expr* expr, bool value) {
+    return expr->type == EXPR_LITERAL && expr->as.literal.type == LITERAL_BOOL &&
+           expr->as.literal.value.bool_val == value;
+}
+
+static bool is_variable(const Expr* expr, const char* name) {
+    return expr->type == EXPR_VARIABLE && expr->as.variable.name == symbol_intern_cstr(name);
+}
+
+// ===== Folding =====
+
+UTEST(ast_fold, folds_arithmetic_and_comparisons) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "1 + 2 * 3 - 8 / 2;\n"
+        "-7 / 2;\n"
+        "10 == 10;\n"
+        "5 < 10;\n"
+        "1.5 * 2.0 > 2.5;\n"
+        "-0.5;\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    ASSERT_TRUE(is_int(statement_expr(ast, 0), 3));
+    ASSERT_TRUE(is_int(statement_expr(ast, 1), -3));  // Truncated, as at run time
+    ASSERT_TRUE(is_bool(statement_expr(ast, 2), true));
+    ASSERT_TRUE(is_bool(statement_expr(ast, 3), true));
+    ASSERT_TRUE(is_bool(statement_expr(ast, 4), true));
+    Expr* half = statement_expr(ast, 5);
+    ASSERT_EQ(EXPR_LITERAL, half->type);
+    ASSERT_EQ(LITERAL_FLOAT, half->as.literal.type);
+    ASSERT_EQ(-0.5, half->as.literal.value.float_val);
+    ASSERT_EQ(11, stats.folded);
+
+    // The result keeps the location of the operator it replaced
+    ASSERT_EQ(10, statement_expr(ast, 0)->loc);
+
+    ast_free_node(ast);
+}
+
+UTEST(ast_fold, folds_bools_and_strings) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "!true or false;\n"
+        "true and !false;\n"
+        "\"ab\" + \"cd\" + \"\";\n"
+        "\"ab\" == \"a\" + \"b\";\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    ASSERT_TRUE(is_bool(statement_expr(ast, 0), false));
+    ASSERT_TRUE(is_bool(statement_expr(ast, 1), true));
+    Expr* joined = statement_expr(ast, 2);
+    ASSERT_EQ(EXPR_LITERAL, joined->type);
+    ASSERT_EQ(LITERAL_STRING, joined->as.literal.type);
+    ASSERT_EQ(symbol_intern_cstr("abcd"), joined->as.literal.value.string_val);
+    ASSERT_TRUE(is_bool(statement_expr(ast, 3), true));
+
+    ast_free_node(ast);
+}
+
+UTEST(ast_fold, leaves_run_time_errors_alone) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "9223372036854775807 + 1;\n"
+        "(-9223372036854775807 - 1) / -1;\n"
+        "1 / 0;\n"
+        "1.0 / 0.0;\n"
+        "1 + 2.0;\n"
+        "\"a\" + 1;\n"
+        "-true;\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    for(size_t i = 0; i < 6; i++) {
+        ASSERT_EQ(EXPR_BINARY, statement_expr(ast, i)->type);
+    }
+    ASSERT_EQ(EXPR_UNARY, statement_expr(ast, 6)->type);
+
+    // The operands still fold
+    Expr* min = statement_expr(ast, 1);
+    ASSERT_TRUE(is_int(min->as.binary.left, INT64_MIN));
+    ASSERT_TRUE(is_int(min->as.binary.right, -1));
+    ASSERT_EQ(3, stats.folded);
+
+    ast_free_node(ast);
+}
+
+// ===== Identities =====
+
+UTEST(ast_fold, simplifies_identities) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "(1 / 0) * 1 + 0;\n"
+        "0 + (9223372036854775807 + 1) / 1;\n"
+        "1 * -(5 / (2 - 2));\n"
+        "false and f();\n"
+        "true or f();\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    // What is left is the int arithmetic that could not be folded
+    Expr* first = statement_expr(ast, 0);
+    ASSERT_EQ(EXPR_BINARY, first->type);
+    ASSERT_EQ(TOKEN_SLASH, first->as.binary.op);
+    Expr* second = statement_expr(ast, 1);
+    ASSERT_EQ(EXPR_BINARY, second->type);
+    ASSERT_EQ(TOKEN_PLUS, second->as.binary.op);
+    ASSERT_TRUE(is_int(second->as.binary.right, 1));
+    ASSERT_EQ(EXPR_UNARY, statement_expr(ast, 2)->type);
+    ASSERT_TRUE(is_bool(statement_expr(ast, 3), false));
+    ASSERT_TRUE(is_bool(statement_expr(ast, 4), true));
+    ASSERT_EQ(1, stats.folded);
+    ASSERT_EQ(7, stats.simplified);
+
+    ast_free_node(ast);
+}
+
+UTEST(ast_fold, keeps_identities_of_unknown_type) {
+    // s may be a string, where s + 0 concatenates or fails; nothing here is
+    // known to be an int, so every operator stays
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "abeg s = \"a\";\n"
+        "abeg y = s + 0;\n"
+        "x * 1;\n"
+        "0 + f();\n"
+        "x - 0;\n"
+        "x / 1;\n"
+        "1.5 * 1;\n"
+        "x * 0;\n"
+        "true and x;\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    ASSERT_EQ(EXPR_BINARY, ast->as.program.statements[1]->as.var_decl.initializer->type);
+    for(size_t i = 2; i < 9; i++) {
+        ASSERT_EQ(EXPR_BINARY, statement_expr(ast, i)->type);
+    }
+    ASSERT_EQ(0, stats.simplified);
+
+    ast_free_node(ast);
+}
+
+// ===== Pruning =====
+
+UTEST(ast_fold, prunes_constant_abi) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "abi (5 < 10) {\n"
+        "    comot true;\n"
+        "} naso {\n"
+        "    comot false;\n"
+        "}\n"
+        "abi (1 > 2) { a; }\n"
+        "abi (10 != 10) { a; } naso abi (true) { b; } naso { c; }\n"
+        "abi (x) { d; }\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    // The dead abi without naso is gone, the others are their live branches
+    ASSERT_EQ(3, ast->as.program.count);
+    Stmt* then = ast->as.program.statements[0];
+    ASSERT_EQ(STMT_BLOCK, then->type);
+    ASSERT_EQ(1, then->as.block.count);
+    ASSERT_EQ(STMT_RETURN, then->as.block.statements[0]->type);
+    ASSERT_TRUE(is_bool(then->as.block.statements[0]->as.return_stmt.value, true));
+
+    Stmt* chained = ast->as.program.statements[1];
+    ASSERT_EQ(STMT_BLOCK, chained->type);
+    ASSERT_TRUE(is_variable(chained->as.block.statements[0]->as.expr_stmt.expression, "b"));
+
+    ASSERT_EQ(STMT_IF, ast->as.program.statements[2]->type);
+    ASSERT_EQ(4, stats.pruned);
+
+    ast_free_node(ast);
+}
+
+UTEST(ast_fold, prunes_inside_functions) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold(
+        "oya f() {\n"
+        "    waka (1 > 2) { a; }\n"
+        "    abi (false) { b; }\n"
+        "    {}\n"
+        "    waka (true) { c; }\n"
+        "}\n",
+        &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    Stmt* body = ast->as.program.statements[0]->as.function_decl.body;
+    ASSERT_EQ(1, body->as.block.count);
+    ASSERT_EQ(STMT_WHILE, body->as.block.statements[0]->type);
+    ASSERT_EQ(2, stats.pruned);
+
+    ast_free_node(ast);
+}
+
+UTEST(ast_fold, passes_after_it_walk_again) {
+    AstFoldStats stats;
+    ASTNode* ast = parse_and_fold("abeg n = 2 + 2;", &stats);
+    ASSERT_TRUE(ast != NULL);
+
+    AstPass fold;
+    ast_fold_pass(&fold, &stats);
+
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, &fold);
+    ast_pass_manager_add(&manager, &fold);
+    ast_pass_manager_run(&manager, ast);
+    ASSERT_EQ(2, manager.walks);
+    ASSERT_EQ(0, stats.folded);  // The first fold already did everything
+
+    Expr* init = ast->as.program.statements[0]->as.var_decl.initializer;
+    ASSERT_TRUE(is_int(init, 4));
+
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+}
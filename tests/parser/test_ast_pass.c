@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/ast_fold.h"
+#include "../../include/parser/ast_pass.h"
+#include "../../include/parser/parser.h"
+#include "../parse_helpers.h"
+#include "../utest.h"
+
+static const char* pass_program =
+    "oya area(w: int, h: int): int { abi (w > 0) { comot w * h; } naso { comot -1; } }\n"
+    "abeg sizes = [1, area(2, x), x];\n"
+    "waka (x < 3) { x = x + 1; }\n";
+
+// ===== Counting =====
+
+typedef struct {
+    size_t exprs;
+    size_t stmts;
+    size_t posts;
+} Counts;
+
+static bool count_expr(void* state, Expr* expr, int depth) {
+    (void)expr;
+    (void)depth;
+    ((Counts*)state)->exprs++;
+    return true;
+}
+
+static bool count_stmt(void* state, Stmt* stmt, int depth) {
+    (void)stmt;
+    (void)depth;
+    ((Counts*)state)->stmts++;
+    return true;
+}
+
+static void count_post_expr(void* state, Expr** slot, int depth) {
+    (void)slot;
+    (void)depth;
+    ((Counts*)state)->posts++;
+}
+
+static void count_post_stmt(void* state, Stmt** slot, int depth) {
+    (void)slot;
+    (void)depth;
+    ((Counts*)state)->posts++;
+}
+
+static AstPass counting_pass(const char* name, Counts* counts) {
+    AstPass pass = {name, 0, counts, NULL, NULL, {0}, {0}, {0}, {0}};
+    for(size_t k = 0; k < AST_EXPR_KINDS; k++) {
+        pass.pre_expr[k] = count_expr;
+        pass.post_expr[k] = count_post_expr;
+    }
+    for(size_t k = 0; k < AST_STMT_KINDS; k++) {
+        pass.pre_stmt[k] = count_stmt;
+        pass.post_stmt[k] = count_post_stmt;
+    }
+    return pass;
+}
+
+UTEST(ast_pass, compatible_passes_share_one_walk) {
+    ASTNode* ast = parse_source(pass_program);
+    ASSERT_TRUE(ast != NULL);
+
+    // The plain walker's counts, for comparison
+    Counts expected = {0, 0, 0};
+    AstVisitor visitor = {count_expr, count_stmt};
+    ast_walk_node(ast, &visitor, &expected);
+
+    Counts counts[3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    AstPass passes[3] = {counting_pass("one", &counts[0]), counting_pass("two", &counts[1]),
+                         counting_pass("three", &counts[2])};
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    for(size_t i = 0; i < 3; i++) {
+        ASSERT_TRUE(ast_pass_manager_add(&manager, &passes[i]));
+    }
+    ast_pass_manager_run(&manager, ast);
+
+    ASSERT_EQ(1, manager.walks);
+    ASSERT_EQ(expected.exprs + expected.stmts, manager.nodes);
+    for(size_t i = 0; i < 3; i++) {
+        ASSERT_EQ(expected.exprs, counts[i].exprs);
+        ASSERT_EQ(expected.stmts, counts[i].stmts);
+        ASSERT_EQ(expected.exprs + expected.stmts, counts[i].posts);
+        ASSERT_EQ(2 * manager.nodes, manager.stats[i].calls);
+    }
+
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+}
+
+// ===== Order =====
+
+typedef struct {
+    char trace[256];
+} Trace;
+
+static void trace_append(Trace* trace, const char* text) {
+    strncat(trace->trace, text, sizeof(trace->trace) - strlen(trace->trace) - 1);
+}
+
+static const char* expr_label(const Expr* expr) {
+    switch(expr->type) {
+        case EXPR_BINARY:
+            return expr->as.binary.op == TOKEN_PLUS ? "+" : "*";
+        case EXPR_VARIABLE:
+            return symbol_name(expr->as.variable.name);
+        default:
+            return "?";
+    }
+}
+
+static bool trace_pre(void* state, Expr* expr, int depth) {
+    char item[16];
+    snprintf(item, sizeof(item), "<%s%d", expr_label(expr), depth);
+    trace_append(state, item);
+    return true;
+}
+
+static void trace_post(void* state, Expr** slot, int depth) {
+    char item[16];
+    snprintf(item, sizeof(item), "%s%d>", expr_label(*slot), depth);
+    trace_append(state, item);
+}
+
+UTEST(ast_pass, callbacks_run_pre_and_post_order) {
+    ASTNode* ast = parse_source("a + b * c;");
+    ASSERT_TRUE(ast != NULL);
+
+    Trace trace = {""};
+    AstPass pass = {"trace", 0, &trace, NULL, NULL, {0}, {0}, {0}, {0}};
+    pass.pre_expr[EXPR_BINARY] = trace_pre;
+    pass.pre_expr[EXPR_VARIABLE] = trace_pre;
+    pass.post_expr[EXPR_BINARY] = trace_post;
+    pass.post_expr[EXPR_VARIABLE] = trace_post;
+
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, &pass);
+    ast_pass_manager_run(&manager, ast);
+    ASSERT_STREQ("<+1<a2a2><*2<b3b3><c3c3>*2>+1>", trace.trace);
+
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+}
+
+// ===== Skipping =====
+
+static bool skip_functions(void* state, Stmt* stmt, int depth) {
+    (void)depth;
+    ((Counts*)state)->stmts++;
+    return stmt->type != STMT_FUNCTION_DECL;
+}
+
+UTEST(ast_pass, skipping_children_is_per_pass) {
+    ASTNode* ast = parse_source(pass_program);
+    ASSERT_TRUE(ast != NULL);
+
+    Counts skipping = {0, 0, 0};
+    AstPass skipper = counting_pass("skipper", &skipping);
+    for(size_t k = 0; k < AST_STMT_KINDS; k++) {
+        skipper.pre_stmt[k] = skip_functions;
+    }
+    Counts all = {0, 0, 0};
+    AstPass counter = counting_pass("counter", &all);
+
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, &skipper);
+    ast_pass_manager_add(&manager, &counter);
+    ast_pass_manager_run(&manager, ast);
+
+    // The skipper sees the function but nothing inside it; the other pass
+    // walks the body as usual
+    ASSERT_EQ(1, manager.walks);
+    ASSERT_EQ(manager.nodes, all.exprs + all.stmts);
+    ASSERT_EQ(5, skipping.stmts);  // area, sizes, the loop, its block, x = x + 1
+    ASSERT_TRUE(all.stmts > skipping.stmts);
+    ASSERT_EQ(skipping.exprs + skipping.stmts, skipping.posts);
+
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+}
+
+// ===== Rewriting =====
+
+typedef struct {
+    ASTNode* ast;
+    size_t replaced;
+} Rewriter;
+
+// Replace every variable named x with the literal 7
+static void replace_x(void* state, Expr** slot, int depth) {
+    (void)depth;
+    Rewriter* rewriter = state;
+    if(strcmp(symbol_name((*slot)->as.variable.name), "x") != 0)
+        return;
+    Expr* literal = arena_alloc(&rewriter->ast->arena, sizeof(Expr));
+    literal->type = EXPR_LITERAL;
+    literal->loc = (*slot)->loc;
+    literal->as.literal.type = LITERAL_INT;
+    literal->as.literal.value.int_val = 7;
+    *slot = literal;
+    rewriter->replaced++;
+}
+
+static bool count_variables(void* state, Expr* expr, int depth) {
+    (void)expr;
+    (void)depth;
+    ((Counts*)state)->exprs++;
+    return true;
+}
+
+static void count_literals(void* state, Expr** slot, int depth) {
+    (void)slot;
+    (void)depth;
+    ((Counts*)state)->posts++;
+}
+
+UTEST(ast_pass, rewrites_split_walks_only_when_needed) {
+    ASTNode* ast = parse_source(pass_program);
+    ASSERT_TRUE(ast != NULL);
+
+    // Pre-order only: fused, and sees every x before it is replaced
+    Counts variables = {0, 0, 0};
+    AstPass reader = {"variables", 0, &variables, NULL, NULL, {0}, {0}, {0}, {0}};
+    reader.pre_expr[EXPR_VARIABLE] = count_variables;
+
+    Rewriter rewriter = {ast, 0};
+    AstPass rewrite = {"rewrite", AST_PASS_REWRITES, &rewriter, NULL, NULL, {0}, {0}, {0}, {0}};
+    rewrite.post_expr[EXPR_VARIABLE] = replace_x;
+
+    // After the rewriter: a walk of its own, over the replacement literals
+    Counts literals = {0, 0, 0};
+    AstPass after = {"literals", 0, &literals, NULL, NULL, {0}, {0}, {0}, {0}};
+    after.post_expr[EXPR_LITERAL] = count_literals;
+
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, &reader);
+    ast_pass_manager_add(&manager, &rewrite);
+    ast_pass_manager_add(&manager, &after);
+    ast_pass_manager_run(&manager, ast);
+
+    ASSERT_EQ(2, manager.walks);
+    ASSERT_EQ(4 + 4, variables.exprs);  // w, w, h, area and each x
+    ASSERT_EQ(4, rewriter.replaced);    // Two in sizes, two in the loop
+    ASSERT_EQ(4 + 6, literals.posts);   // Plus 0, 1, 1, 2, 3, 1
+
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+}
+
+// Binary nodes whose operands are both literals by the time the node is left
+static void count_literal_operands(void* state, Expr** slot, int depth) {
+    (void)depth;
+    const Expr* expr = *slot;
+    if(expr->as.binary.left->type == EXPR_LITERAL && expr->as.binary.right->type == EXPR_LITERAL) {
+        ((Counts*)state)->posts++;
+    }
+}
+
+// Run the observer and the fold, observer first or last, in as few walks as
+// the manager allows or one walk each; returns what the observer counted
+static size_t observe_fold(AstPass observer, bool observer_first, bool walk_each) {
+    ASTNode* ast = parse_source("abeg y = 1 + 2 * 3;\nabeg z = (4 - 4) * w + 2 * 2;\n");
+    if(!ast)
+        return SIZE_MAX;
+    AstFoldStats stats;
+    AstPass fold;
+    ast_fold_pass(&fold, &stats);
+    AstPass* second = observer_first ? &fold : &observer;
+    if(walk_each) {
+        second->flags |= AST_PASS_NEW_WALK;
+    }
+
+    *(Counts*)observer.state = (Counts){0, 0, 0};
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    ast_pass_manager_add(&manager, observer_first ? &observer : &fold);
+    ast_pass_manager_add(&manager, second);
+    ast_pass_manager_run(&manager, ast);
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+    return ((Counts*)observer.state)->posts;
+}
+
+UTEST(ast_pass, fusing_with_a_fold_matches_walking_each) {
+    // After the fold: only the literals it leaves, 7, 0 and 4
+    Counts literals = {0, 0, 0};
+    AstPass after = {"literals", 0, &literals, NULL, NULL, {0}, {0}, {0}, {0}};
+    after.post_expr[EXPR_LITERAL] = count_literals;
+    ASSERT_EQ(3, observe_fold(after, false, true));
+    ASSERT_EQ(3, observe_fold(after, false, false));
+
+    // Before the fold: 2 * 3, 4 - 4 and 2 * 2, not the operators they fold into
+    Counts operands = {0, 0, 0};
+    AstPass before = {"operands", 0, &operands, NULL, NULL, {0}, {0}, {0}, {0}};
+    before.post_expr[EXPR_BINARY] = count_literal_operands;
+    ASSERT_EQ(3, observe_fold(before, true, true));
+    ASSERT_EQ(3, observe_fold(before, true, false));
+}
+
+// ===== Separate Walks and Hooks =====
+
+typedef struct {
+    char order[32];
+} Hooks;
+
+static void hook_begin(void* state, ASTNode* node) {
+    (void)node;
+    strcat(((Hooks*)state)->order, "b");
+}
+
+static void hook_end(void* state, ASTNode* node) {
+    (void)node;
+    strcat(((Hooks*)state)->order, "e");
+}
+
+UTEST(ast_pass, new_walk_passes_run_after_the_rest) {
+    ASTNode* ast = parse_source(pass_program);
+    ASSERT_TRUE(ast != NULL);
+
+    Hooks hooks = {""};
+    AstPass first = {"first", 0, &hooks, hook_begin, hook_end, {0}, {0}, {0}, {0}};
+    AstPass second = {"second", AST_PASS_NEW_WALK, &hooks, hook_begin, hook_end,
+                      {0}, {0}, {0}, {0}};
+
+    AstPassManager manager;
+    ast_pass_manager_init(&manager);
+    manager.timing = true;
+    ast_pass_manager_add(&manager, &first);
+    ast_pass_manager_add(&manager, &first);
+    ast_pass_manager_add(&manager, &second);
+    ast_pass_manager_run(&manager, ast);
+
+    ASSERT_EQ(2, manager.walks);
+    ASSERT_STREQ("bbeebe", hooks.order);
+
+    // One line for the run and one per pass
+    char report[512] = {0};
+    FILE* out = fmemopen(report, sizeof(report) - 1, "w");
+    ASSERT_TRUE(out != NULL);
+    ast_pass_manager_report(&manager, out);
+    fclose(out);
+    ASSERT_TRUE(strstr(report, "3 passes, 2 walks") == report);
+    ASSERT_TRUE(strstr(report, "  second ") != NULL);
+
+    ast_pass_manager_free(&manager);
+    ast_free_node(ast);
+}
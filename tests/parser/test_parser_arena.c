@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token.h"
+#include "../parse_helpers.h"
+#include "../utest.h"
+
+UTEST(parser_arena, nested_lists_finish_in_order) {
+    const char* input =
+        "f(1, [2, 3, g(4, [5]), 6], 7);\n"
+        "oya h(a: int, b: float, c: string) { { x; } y; }\n";
+    ASTNode* ast = parse_source(input);
+
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(2, ast->as.program.count);
+
+    Expr* call = ast->as.program.statements[0]->as.expr_stmt.expression;
+    ASSERT_EQ(EXPR_CALL, call->type);
+    ASSERT_EQ(3, call->as.call.arg_count);
+    ASSERT_EQ(7, call->as.call.args[2]->as.literal.value.int_val);
+
+    Expr* array = call->as.call.args[1];
+    ASSERT_EQ(EXPR_ARRAY, array->type);
+    ASSERT_EQ(4, array->as.array.count);
+    ASSERT_EQ(6, array->as.array.elements[3]->as.literal.value.int_val);
+
+    Expr* inner = array->as.array.elements[2];
+    ASSERT_EQ(EXPR_CALL, inner->type);
+    ASSERT_EQ(2, inner->as.call.arg_count);
+    ASSERT_EQ(1, inner->as.call.args[1]->as.array.count);
+
+    Stmt* fn = ast->as.program.statements[1];
+    ASSERT_EQ(3, fn->as.function_decl.param_count);
+    ASSERT_STREQ("c", symbol_name(fn->as.function_decl.param_names[2]));
+    ASSERT_STREQ("float", symbol_name(fn->as.function_decl.param_types[1]));
+    Stmt* body = fn->as.function_decl.body;
+    ASSERT_EQ(2, body->as.block.count);
+    ASSERT_EQ(STMT_BLOCK, body->as.block.statements[0]->type);
+    ASSERT_EQ(1, body->as.block.statements[0]->as.block.count);
+
+    ast_free_node(ast);
+}
+
+UTEST(parser_arena, empty_lists_have_no_storage) {
+    ASTNode* ast = parse_source("oya f() { } f([]);");
+
+    ASSERT_TRUE(ast != NULL);
+    Stmt* fn = ast->as.program.statements[0];
+    ASSERT_EQ(0, fn->as.function_decl.param_count);
+    ASSERT_TRUE(fn->as.function_decl.param_names == NULL);
+    ASSERT_EQ(0, fn->as.function_decl.body->as.block.count);
+
+    Expr* call = ast->as.program.statements[1]->as.expr_stmt.expression;
+    ASSERT_EQ(1, call->as.call.arg_count);
+    ASSERT_EQ(0, call->as.call.args[0]->as.array.count);
+    ASSERT_TRUE(call->as.call.args[0]->as.array.elements == NULL);
+
+    ast_free_node(ast);
+}
+
+UTEST(parser_arena, tree_outlives_parser) {
+    // parse_source has freed the parser and lexer by the time it returns
+    ASTNode* ast = parse_source("abeg x = [1, 2]; abeg y = x;");
+
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(2, ast->as.program.count);
+    Expr* init = ast->as.program.statements[0]->as.var_decl.initializer;
+    ASSERT_EQ(2, init->as.array.elements[1]->as.literal.value.int_val);
+
+    ast_free_node(ast);
+}
+
+UTEST(parser_arena, failed_parse_releases_nodes) {
+    // The parser is needed afterwards, so this one is not parse_source
+    Lexer* lexer = lexer_init("abeg x = f(1, [2, 3; abeg y = 4;", "test.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+    ASSERT_TRUE(parse(parser) == NULL);
+    ASSERT_TRUE(parser->ast_arena.head == NULL);
+    ASSERT_EQ(0, parser->staged_count);
+
+    parser_free(parser);
+    lexer_free(lexer);
+}
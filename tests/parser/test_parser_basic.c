@@ -88,8 +88,8 @@ UTEST(parser, variable_declaration) {
 
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, stmt->type);
-    ASSERT_STREQ("x", stmt->as.var_decl.name);
-    ASSERT_STREQ("int", stmt->as.var_decl.type_annotation);
+    ASSERT_STREQ("x", symbol_name(stmt->as.var_decl.name));
+    ASSERT_STREQ("int", symbol_name(stmt->as.var_decl.type_annotation));
 
     // Check initializer
     ASSERT_TRUE(stmt->as.var_decl.initializer != NULL);
@@ -158,7 +158,7 @@ UTEST(parser, simple_if_statement) {
 
     Stmt* inner = then_branch->as.block.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, inner->type);
-    ASSERT_STREQ("x", inner->as.var_decl.name);
+    ASSERT_STREQ("x", symbol_name(inner->as.var_decl.name));
 
     ast_free_node(ast);
     parser_free(parser);
@@ -189,7 +189,7 @@ UTEST(parser, if_else_statement) {
 
     Stmt* else_inner = else_branch->as.block.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, else_inner->type);
-    ASSERT_STREQ("y", else_inner->as.var_decl.name);
+    ASSERT_STREQ("y", symbol_name(else_inner->as.var_decl.name));
 
     ast_free_node(ast);
     parser_free(parser);
@@ -242,14 +242,14 @@ UTEST(parser, function_declaration) {
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_FUNCTION_DECL, stmt->type);
 
-    ASSERT_STREQ("add", stmt->as.function_decl.name);
+    ASSERT_STREQ("add", symbol_name(stmt->as.function_decl.name));
     ASSERT_EQ(2, stmt->as.function_decl.param_count);
-    ASSERT_STREQ("a", stmt->as.function_decl.param_names[0]);
-    ASSERT_STREQ("b", stmt->as.function_decl.param_names[1]);
-    ASSERT_STREQ("int", stmt->as.function_decl.param_types[0]);
-    ASSERT_STREQ("int", stmt->as.function_decl.param_types[1]);
+    ASSERT_STREQ("a", symbol_name(stmt->as.function_decl.param_names[0]));
+    ASSERT_STREQ("b", symbol_name(stmt->as.function_decl.param_names[1]));
+    ASSERT_STREQ("int", symbol_name(stmt->as.function_decl.param_types[0]));
+    ASSERT_STREQ("int", symbol_name(stmt->as.function_decl.param_types[1]));
 
-    ASSERT_STREQ("int", stmt->as.function_decl.return_type);
+    ASSERT_STREQ("int", symbol_name(stmt->as.function_decl.return_type));
     ASSERT_EQ(STMT_BLOCK, stmt->as.function_decl.body->type);
 
     ast_free_node(ast);
@@ -306,7 +306,7 @@ UTEST(parser, assignment_expression) {
 
     Expr* expr = stmt->as.expr_stmt.expression;
     ASSERT_EQ(EXPR_ASSIGN, expr->type);
-    ASSERT_STREQ("x", expr->as.assign.name);
+    ASSERT_STREQ("x", symbol_name(expr->as.assign.name));
     ASSERT_EQ(EXPR_LITERAL, expr->as.assign.value->type);
     ASSERT_EQ(10, expr->as.assign.value->as.literal.value.int_val);
 
@@ -455,7 +455,7 @@ UTEST(parser, index_expression) {
     Expr* expr = ast->as.program.statements[0]->as.expr_stmt.expression;
     ASSERT_EQ(EXPR_INDEX, expr->type);
     ASSERT_EQ(EXPR_VARIABLE, expr->as.index.object->type);
-    ASSERT_STREQ("arr", expr->as.index.object->as.variable.name);
+    ASSERT_STREQ("arr", symbol_name(expr->as.index.object->as.variable.name));
 
     ASSERT_EQ(EXPR_BINARY, expr->as.index.index->type);
 
@@ -478,7 +478,7 @@ UTEST(parser, array_in_var_decl) {
     ASSERT_TRUE(ast != NULL);
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, stmt->type);
-    ASSERT_STREQ("nums", stmt->as.var_decl.name);
+    ASSERT_STREQ("nums", symbol_name(stmt->as.var_decl.name));
     ASSERT_TRUE(stmt->as.var_decl.initializer != NULL);
     ASSERT_EQ(EXPR_ARRAY, stmt->as.var_decl.initializer->type);
 
@@ -500,8 +500,8 @@ UTEST(parser, int_array_in_var_decl) {
     ASSERT_TRUE(ast != NULL);
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, stmt->type);
-    ASSERT_STREQ("nums", stmt->as.var_decl.name);
-    ASSERT_STREQ("int[]", stmt->as.var_decl.type_annotation);
+    ASSERT_STREQ("nums", symbol_name(stmt->as.var_decl.name));
+    ASSERT_STREQ("int[]", symbol_name(stmt->as.var_decl.type_annotation));
     ASSERT_TRUE(stmt->as.var_decl.initializer != NULL);
     ASSERT_EQ(EXPR_ARRAY, stmt->as.var_decl.initializer->type);
 
@@ -523,8 +523,8 @@ UTEST(parser, string_array_in_var_decl) {
     ASSERT_TRUE(ast != NULL);
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, stmt->type);
-    ASSERT_STREQ("names", stmt->as.var_decl.name);
-    ASSERT_STREQ("string[]", stmt->as.var_decl.type_annotation);
+    ASSERT_STREQ("names", symbol_name(stmt->as.var_decl.name));
+    ASSERT_STREQ("string[]", symbol_name(stmt->as.var_decl.type_annotation));
     ASSERT_TRUE(stmt->as.var_decl.initializer != NULL);
     ASSERT_EQ(EXPR_ARRAY, stmt->as.var_decl.initializer->type);
 
@@ -546,8 +546,8 @@ UTEST(parser, float_array_in_var_decl) {
     ASSERT_TRUE(ast != NULL);
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, stmt->type);
-    ASSERT_STREQ("values", stmt->as.var_decl.name);
-    ASSERT_STREQ("float[]", stmt->as.var_decl.type_annotation);
+    ASSERT_STREQ("values", symbol_name(stmt->as.var_decl.name));
+    ASSERT_STREQ("float[]", symbol_name(stmt->as.var_decl.type_annotation));
     ASSERT_TRUE(stmt->as.var_decl.initializer != NULL);
     ASSERT_EQ(EXPR_ARRAY, stmt->as.var_decl.initializer->type);
 
@@ -569,8 +569,8 @@ UTEST(parser, bool_array_in_var_decl) {
     ASSERT_TRUE(ast != NULL);
     Stmt* stmt = ast->as.program.statements[0];
     ASSERT_EQ(STMT_VAR_DECL, stmt->type);
-    ASSERT_STREQ("flags", stmt->as.var_decl.name);
-    ASSERT_STREQ("bool[]", stmt->as.var_decl.type_annotation);
+    ASSERT_STREQ("flags", symbol_name(stmt->as.var_decl.name));
+    ASSERT_STREQ("bool[]", symbol_name(stmt->as.var_decl.type_annotation));
     ASSERT_TRUE(stmt->as.var_decl.initializer != NULL);
     ASSERT_EQ(EXPR_ARRAY, stmt->as.var_decl.initializer->type);
 
@@ -591,8 +591,8 @@ UTEST(parser, two_dimensional_array_type) {
 
     ASSERT_TRUE(ast != NULL);
     Stmt* stmt = ast->as.program.statements[0];
-    ASSERT_STREQ("grid", stmt->as.var_decl.name);
-    ASSERT_STREQ("int[][]", stmt->as.var_decl.type_annotation);
+    ASSERT_STREQ("grid", symbol_name(stmt->as.var_decl.name));
+    ASSERT_STREQ("int[][]", symbol_name(stmt->as.var_decl.type_annotation));
 
     ast_free_node(ast);
     parser_free(parser);
@@ -637,7 +637,7 @@ UTEST(parser, call_expression) {
     Expr* expr = ast->as.program.statements[0]->as.expr_stmt.expression;
     ASSERT_EQ(EXPR_CALL, expr->type);
     ASSERT_EQ(3, expr->as.call.arg_count);
-    ASSERT_STREQ("add", expr->as.call.callee->as.variable.name);
+    ASSERT_STREQ("add", symbol_name(expr->as.call.callee->as.variable.name));
 
     ast_free_node(ast);
     parser_free(parser);
@@ -685,3 +685,51 @@ UTEST(parser, empty_program) {
     parser_free(parser);
     lexer_free(lexer);
 }
+
+// === 19. Keywords Where an Expression Belongs ===
+UTEST(parser, keyword_is_not_an_expression) {
+    // Every keyword and type name has a parse rule; none starts an expression
+    const char* inputs[] = {"abeg x = int;", "abeg x = abeg;", "1 + oya;", "-naso;", "(comot);"};
+
+    for(size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        Lexer* lexer = lexer_init(inputs[i], "test.soro", ".");
+        size_t token_count = 0;
+        Token** tokens = lexer_tokenize(lexer, &token_count);
+
+        Parser* parser = parser_init(tokens, token_count, "test.soro");
+        parser->quiet = true;
+        ASTNode* ast = parse(parser);
+        ASSERT_TRUE(ast == NULL);
+        ASSERT_TRUE(parser->had_error);
+
+        parser_free(parser);
+        lexer_free(lexer);
+    }
+}
+
+// === 20. Token List Cut Short by a Lexer Error ===
+UTEST(parser, refuses_tokens_without_eof) {
+    // The lexer stops at the error, so the list has no TOKEN_EOF to stop at
+    const char* inputs[] = {"99999999999999999999", "abeg q = -99999999999999999999;",
+                            "abeg s = \"never closed", "x; /* never closed"};
+
+    for(size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        Lexer* lexer = lexer_init(inputs[i], "test.soro", ".");
+        lexer->flags |= LEXER_QUIET;
+        size_t token_count = 0;
+        Token** tokens = lexer_tokenize(lexer, &token_count);
+        ASSERT_TRUE(token_count == 0 || tokens[token_count - 1]->type != TOKEN_EOF);
+
+        Parser* parser = parser_init(tokens, token_count, "test.soro");
+        parser->quiet = true;
+        ASSERT_TRUE(parse(parser) == NULL);
+        ASSERT_TRUE(parser->had_error);
+        parser_free(parser);
+
+        parser = parser_init(tokens, token_count, "test.soro");
+        ASSERT_TRUE(parse_flat(parser) == NULL);
+        parser_free(parser);
+
+        lexer_free(lexer);
+    }
+}
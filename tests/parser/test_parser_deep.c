@@ -0,0 +1,218 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/flat_ast.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token.h"
+#include "../parse_helpers.h"
+#include "../utest.h"
+
+// Deep enough that a frame per nesting level would overflow a default stack
+#define DEEP 200000
+
+static FlatAst* parse_flat_source(const char* input) {
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+    FlatAst* ast = parse_flat(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+    return ast;
+}
+
+// prefix repeated count times, then middle, then suffix repeated count times;
+// the buffer has room to append one more character
+static char* repeat_around(const char* prefix, const char* middle, const char* suffix,
+                           size_t count) {
+    size_t p = strlen(prefix), m = strlen(middle), s = strlen(suffix);
+    char* text = malloc((p + s) * count + m + 2);
+    char* out = text;
+    for(size_t i = 0; i < count; i++, out += p) {
+        memcpy(out, prefix, p);
+    }
+    memcpy(out, middle, m);
+    out += m;
+    for(size_t i = 0; i < count; i++, out += s) {
+        memcpy(out, suffix, s);
+    }
+    *out = '\0';
+    return text;
+}
+
+// Run print with stdout sent to path, then restore it
+static void print_to(const char* path, void (*print)(ASTNode*), ASTNode* ast) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    FILE* file = freopen(path, "w", stdout);
+    if(file) {
+        print(ast);
+    }
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+UTEST(parser_deep, nested_groups) {
+    char* input = repeat_around("(", "-x", ")", DEEP);
+    strcat(input, ";");
+    ASTNode* ast = parse_source(input);
+    ASSERT_TRUE(ast != NULL);
+
+    Expr* expr = ast->as.program.statements[0]->as.expr_stmt.expression;
+    ASSERT_EQ(EXPR_UNARY, expr->type);
+    ASSERT_EQ(EXPR_VARIABLE, expr->as.unary.right->type);
+
+    ast_free_node(ast);
+    free(input);
+}
+
+UTEST(parser_deep, long_binary_chain) {
+    char* input = repeat_around("", "1", " + 1", DEEP);
+    strcat(input, ";");
+    ASTNode* ast = parse_source(input);
+    ASSERT_TRUE(ast != NULL);
+
+    // Left-associative: the spine runs down the left operands
+    size_t depth = 0;
+    Expr* expr = ast->as.program.statements[0]->as.expr_stmt.expression;
+    while(expr->type == EXPR_BINARY) {
+        ASSERT_EQ(EXPR_LITERAL, expr->as.binary.right->type);
+        expr = expr->as.binary.left;
+        depth++;
+    }
+    ASSERT_EQ(DEEP, depth);
+
+    ast_free_node(ast);
+    free(input);
+}
+
+UTEST(parser_deep, right_nested_operators) {
+    // a = -(b * f([c[a = -(b * f([c[ ... 0]])) ... ]]))
+    char* input = repeat_around("a = -(b * f([c[", "0", "]]))", DEEP / 8);
+    strcat(input, ";");
+    ASTNode* ast = parse_source(input);
+    ASSERT_TRUE(ast != NULL);
+
+    size_t depth = 0;
+    Expr* expr = ast->as.program.statements[0]->as.expr_stmt.expression;
+    while(expr->type == EXPR_ASSIGN) {
+        Expr* unary = expr->as.assign.value;
+        ASSERT_EQ(EXPR_UNARY, unary->type);
+        Expr* product = unary->as.unary.right;
+        ASSERT_EQ(EXPR_BINARY, product->type);
+        ASSERT_EQ(TOKEN_ASTERISK, product->as.binary.op);
+        Expr* call = product->as.binary.right;
+        ASSERT_EQ(EXPR_CALL, call->type);
+        ASSERT_EQ(1, call->as.call.arg_count);
+        Expr* array = call->as.call.args[0];
+        ASSERT_EQ(EXPR_ARRAY, array->type);
+        ASSERT_EQ(1, array->as.array.count);
+        Expr* index = array->as.array.elements[0];
+        ASSERT_EQ(EXPR_INDEX, index->type);
+        expr = index->as.index.index;
+        depth++;
+    }
+    ASSERT_EQ(DEEP / 8, depth);
+    ASSERT_EQ(EXPR_LITERAL, expr->type);
+
+    ast_free_node(ast);
+    free(input);
+}
+
+UTEST(parser_deep, errors_inside_nesting) {
+    char* input = repeat_around("(", "1 +", ")", DEEP);
+    ASSERT_TRUE(parse_source(input) == NULL);
+    ASSERT_TRUE(parse_flat_source(input) == NULL);
+    free(input);
+}
+
+static bool count_expr(void* context, const FlatAst* ast, FlatExpr expr, int depth) {
+    (void)ast;
+    (void)expr;
+    int* deepest = context;
+    if(depth > *deepest) {
+        *deepest = depth;
+    }
+    return true;
+}
+
+UTEST(parser_deep, flat_emitter_and_visitor) {
+    char* input = repeat_around("[", "1", "]", DEEP);
+    strcat(input, ";");
+    FlatAst* flat = parse_flat_source(input);
+    ASSERT_TRUE(flat != NULL);
+    ASSERT_EQ(DEEP + 1, flat->expr_count);
+
+    int deepest = 0;
+    FlatVisitor visitor = {count_expr, NULL};
+    flat_ast_visit(flat, &visitor, &deepest);
+    ASSERT_EQ(DEEP + 1, deepest);  // The statement is depth 0
+
+    flat_ast_free(flat);
+    free(input);
+}
+
+UTEST(parser_deep, printing_matches_tree_shape) {
+    char path[] = "/tmp/soro_print_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    ASTNode* ast = parse_source(
+        "abi (f(1, x[2])) { comot -a; } naso waka (b) { c = 1 + 2; }\n"
+        "oya g(n: int): int { }\n");
+    ASSERT_TRUE(ast != NULL);
+    print_to(path, ast_print_node, ast);
+    ast_free_node(ast);
+
+    const char* expected =
+        "Program(2 statements)\n"
+        "  IfStmt\n"
+        "    Condition:\n"
+        "      Call\n"
+        "        Callee:\n"
+        "          Variable(f)\n"
+        "        Args(2):\n"
+        "          Literal(1)\n"
+        "          Index\n"
+        "            Object:\n"
+        "              Variable(x)\n"
+        "            Index:\n"
+        "              Literal(2)\n"
+        "    Then:\n"
+        "      Block(1 statements)\n"
+        "        ReturnStmt\n"
+        "          Unary(MINUS)\n"
+        "            Variable(a)\n"
+        "    Else:\n"
+        "      WhileStmt\n"
+        "        Condition:\n"
+        "          Variable(b)\n"
+        "        Body:\n"
+        "          Block(1 statements)\n"
+        "            ExprStmt\n"
+        "              Assign(c)\n"
+        "                Binary(PLUS)\n"
+        "                  Literal(1)\n"
+        "                  Literal(2)\n"
+        "  FunctionDecl(g)\n"
+        "    Params(1):\n"
+        "      n: int\n"
+        "    Returns: int\n"
+        "    Body:\n"
+        "      Block(0 statements)\n";
+
+    char printed[1024] = {0};
+    FILE* file = fopen(path, "r");
+    ASSERT_TRUE(file != NULL);
+    size_t len = fread(printed, 1, sizeof(printed) - 1, file);
+    printed[len] = '\0';
+    fclose(file);
+    ASSERT_STREQ(expected, printed);
+
+    unlink(path);
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/flat_ast.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token.h"
+#include "../parse_helpers.h"
+#include "../utest.h"
+#include "ast_equal.h"
+
+static const char* flat_program =
+    "oya area(w: int, h: int): int { abi (w > 0 and h > 0) { comot w * h; } naso { comot; } }\n"
+    "abeg sizes: int[] = [1, 2.5, \"three\", area(4, 5)];\n"
+    "abeg empty = [];\n"
+    "waka (!done) { total = total + sizes[i] - -1; { nested(); } }\n"
+    "abeg plain;\n";
+
+static FlatAst* parse_flat_source(const char* input) {
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+    FlatAst* ast = parse_flat(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+    return ast;
+}
+
+UTEST(parser_flat, converts_to_same_tree_as_parse) {
+    ASTNode* expected = parse_source(flat_program);
+    FlatAst* flat = parse_flat_source(flat_program);
+    ASSERT_TRUE(expected != NULL);
+    ASSERT_TRUE(flat != NULL);
+
+    ASTNode* converted = flat_ast_to_tree(flat);
+    ASSERT_EQ(expected->as.program.count, converted->as.program.count);
+    for(size_t i = 0; i < expected->as.program.count; i++) {
+        EXPECT_TRUE(
+            same_stmt(expected->as.program.statements[i], converted->as.program.statements[i]));
+    }
+
+    ast_free_node(expected);
+    ast_free_node(converted);
+    flat_ast_free(flat);
+}
+
+UTEST(parser_flat, children_come_before_parents) {
+    FlatAst* flat = parse_flat_source(flat_program);
+    ASSERT_TRUE(flat != NULL);
+
+    for(FlatExpr i = 0; i < flat->expr_count; i++) {
+        const FlatExprNode* node = &flat->exprs[i];
+        if(node->type == EXPR_BINARY || node->type == EXPR_INDEX) {
+            EXPECT_LT(node->a, i);
+            EXPECT_LT(node->b, i);
+        } else if(node->type == EXPR_UNARY || node->type == EXPR_CALL) {
+            EXPECT_LT(node->a, i);
+        }
+    }
+    for(FlatStmt i = 0; i < flat->stmt_count; i++) {
+        const FlatStmtNode* node = &flat->stmts[i];
+        if(node->type == STMT_FUNCTION_DECL) {
+            EXPECT_LT(node->c, i);
+        } else if(node->type == STMT_IF || node->type == STMT_WHILE) {
+            EXPECT_LT(node->b, i);
+        }
+    }
+
+    flat_ast_free(flat);
+}
+
+UTEST(parser_flat, linear_pass_evaluates_bottom_up) {
+    FlatAst* flat = parse_flat_source("(1 + 2) * 3 - -4;");
+    ASSERT_TRUE(flat != NULL);
+
+    // No recursion: every operand is already evaluated when its parent is seen
+    int64_t values[16];
+    ASSERT_LE(flat->expr_count, 16u);
+    for(FlatExpr i = 0; i < flat->expr_count; i++) {
+        const FlatExprNode* node = &flat->exprs[i];
+        if(node->type == EXPR_LITERAL) {
+            values[i] = flat_literal(flat, i).value.int_val;
+        } else if(node->type == EXPR_UNARY) {
+            values[i] = -values[node->a];
+        } else if(node->op == TOKEN_PLUS) {
+            values[i] = values[node->a] + values[node->b];
+        } else if(node->op == TOKEN_MINUS) {
+            values[i] = values[node->a] - values[node->b];
+        } else {
+            values[i] = values[node->a] * values[node->b];
+        }
+    }
+
+    uint32_t count;
+    const uint32_t* program = flat_list(flat, flat->program, &count);
+    ASSERT_EQ(1u, count);
+    ASSERT_EQ(13, values[flat->stmts[program[0]].a]);
+
+    flat_ast_free(flat);
+}
+
+UTEST(parser_flat, literals_round_trip) {
+    FlatAst* flat = parse_flat_source("f(9223372036854775807, 0.1, \"s\", true, false);");
+    ASSERT_TRUE(flat != NULL);
+
+    uint32_t count;
+    const uint32_t* args = flat_list(flat, flat->exprs[flat->expr_count - 1].b, &count);
+    ASSERT_EQ(5u, count);
+    ASSERT_EQ(INT64_MAX, flat_literal(flat, args[0]).value.int_val);
+    ASSERT_EQ(0.1, flat_literal(flat, args[1]).value.float_val);
+    ASSERT_STREQ("s", symbol_name(flat_literal(flat, args[2]).value.string_val));
+    ASSERT_TRUE(flat_literal(flat, args[3]).value.bool_val);
+    ASSERT_FALSE(flat_literal(flat, args[4]).value.bool_val);
+
+    flat_ast_free(flat);
+}
+
+UTEST(parser_flat, assignment_drops_target_node) {
+    FlatAst* flat = parse_flat_source("x = y = 1;");
+    ASSERT_TRUE(flat != NULL);
+
+    // Only the literal and the two assignments remain
+    ASSERT_EQ(3u, flat->expr_count);
+    ASSERT_EQ(EXPR_ASSIGN, flat->exprs[2].type);
+    ASSERT_STREQ("x", symbol_name(flat->exprs[2].a));
+
+    flat_ast_free(flat);
+}
+
+typedef struct {
+    char trace[128];
+    size_t len;
+} VisitTrace;
+
+static bool trace_expr(void* context, const FlatAst* ast, FlatExpr expr, int depth) {
+    VisitTrace* trace = context;
+    trace->len += snprintf(trace->trace + trace->len, sizeof(trace->trace) - trace->len, "e%d%d ",
+                           ast->exprs[expr].type, depth);
+    return true;
+}
+
+static bool trace_stmt(void* context, const FlatAst* ast, FlatStmt stmt, int depth) {
+    VisitTrace* trace = context;
+    trace->len += snprintf(trace->trace + trace->len, sizeof(trace->trace) - trace->len, "s%d%d ",
+                           ast->stmts[stmt].type, depth);
+    return ast->stmts[stmt].type != STMT_FUNCTION_DECL;  // Skip function bodies
+}
+
+UTEST(parser_flat, visitor_walks_in_source_order) {
+    FlatAst* flat = parse_flat_source("oya f() { g(); } abi (a) { b; } naso c;");
+    ASSERT_TRUE(flat != NULL);
+
+    VisitTrace trace = {{0}, 0};
+    FlatVisitor visitor = {trace_expr, trace_stmt};
+    flat_ast_visit(flat, &visitor, &trace);
+
+    // FunctionDecl without its body, then If(condition, Block(ExprStmt), ExprStmt)
+    ASSERT_STREQ("s20 s30 e11 s61 s02 e13 s01 e12 ", trace.trace);
+
+    flat_ast_free(flat);
+}
+
+UTEST(parser_flat, errors_match_parse) {
+    ASSERT_TRUE(parse_flat_source("abeg = 1;") == NULL);
+    ASSERT_TRUE(parse_flat_source("f(1, 2;") == NULL);
+    ASSERT_TRUE(parse_flat_source("1 = 2;") == NULL);
+    ASSERT_TRUE(parse_flat_source("(+) = 2;") == NULL);
+}
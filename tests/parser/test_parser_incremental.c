@@ -0,0 +1,378 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+#include "ast_equal.h"
+
+#define LEX_FLAGS (LEXER_QUIET | LEXER_SKIP_COMMENTS)
+
+static const char* program =
+    "abeg x = 1;\n"
+    "oya add(a: int, b: int): int {\n"
+    "    abeg sum = a + b;\n"
+    "    abi (sum > 10) { comot sum; }\n"
+    "    comot sum * 2; // doubled\n"
+    "}\n"
+    "{ inner(1); { deeper(x); } }\n"
+    "waka (x < 3) x = x + 1;\n"
+    "oya last(): int { comot [x, add(1, 2)]; }\n";
+
+static ASTNode* parse_buffer(SourceFile* source, const TokenBuffer* buffer) {
+    Parser* parser = parser_init_soa(buffer, source, "test.soro");
+    parser->quiet = true;
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    return ast;
+}
+
+typedef struct {
+    ASTNode* incremental;  // previous brought up to date
+    ASTNode* expected;     // Full parse of the edited text
+    Stmt* untouched;       // Function "last" of the old tree, to check reuse
+    Stmt* nested;          // The if statement inside "add"
+} EditResult;
+
+// Parse text, apply the edit, relex and reparse incrementally, and parse the
+// edited text from scratch for comparison
+static EditResult apply_edit(const char* text, const char* at, uint64_t removed,
+                             const char* inserted) {
+    size_t len = strlen(text);
+    size_t offset = (size_t)(strstr(text, at) - text);
+    size_t ins = strlen(inserted);
+    char* edited = malloc(len - removed + ins + 1);
+    memcpy(edited, text, offset);
+    memcpy(edited + offset, inserted, ins);
+    strcpy(edited + offset + ins, text + offset + removed);
+
+    SourceFile* before = source_file_create(text, len, "test.soro", ".");
+    SourceFile* after = source_file_create(edited, strlen(edited), "test.soro", ".");
+    EditResult result = {NULL, NULL, NULL, NULL};
+
+    Lexer* lexer = lexer_init_source(before);
+    lexer->flags = LEX_FLAGS;
+    TokenBuffer tokens;
+    token_buffer_init(&tokens);
+    lexer_tokenize_soa(lexer, &tokens);
+    lexer_free(lexer);
+
+    ASTNode* previous = parse_buffer(before, &tokens);
+    for(size_t i = 0; previous && i < previous->as.program.count; i++) {
+        Stmt* stmt = previous->as.program.statements[i];
+        if(stmt->type == STMT_FUNCTION_DECL &&
+           strcmp(symbol_name(stmt->as.function_decl.name), "last") == 0) {
+            result.untouched = stmt;
+        }
+        if(stmt->type == STMT_FUNCTION_DECL &&
+           strcmp(symbol_name(stmt->as.function_decl.name), "add") == 0) {
+            result.nested = stmt->as.function_decl.body->as.block.statements[1];
+        }
+    }
+
+    LexerEdit edit = {offset, removed, ins};
+    LexerRelexSpan span;
+    if(previous && lexer_relex_span(after, &tokens, &edit, LEX_FLAGS, &span)) {
+        Parser* parser = parser_init_soa(&tokens, after, "test.soro");
+        parser->quiet = true;
+        result.incremental = parse_incremental(parser, previous, &edit, &span);
+        ast_settle_locs(result.incremental);
+        parser_free(parser);
+        result.expected = parse_buffer(after, &tokens);
+    } else {
+        ast_free_node(previous);
+    }
+
+    token_buffer_free(&tokens);
+    source_file_release(before);
+    source_file_release(after);
+    free(edited);
+    return result;
+}
+
+// Nodes of one tree resolved through both trees' line tables
+typedef struct {
+    const ASTNode* a;
+    const ASTNode* b;
+    bool same;
+} LineCheck;
+
+static void check_lines(LineCheck* check, SourceLoc loc) {
+    uint32_t line_a, column_a, line_b, column_b;
+    ast_resolve_loc(check->a, loc, &line_a, &column_a);
+    ast_resolve_loc(check->b, loc, &line_b, &column_b);
+    check->same = check->same && line_a == line_b && column_a == column_b;
+}
+
+static bool check_expr_lines(void* context, Expr* expr, int depth) {
+    (void)depth;
+    check_lines(context, expr->loc);
+    return true;
+}
+
+static bool check_stmt_lines(void* context, Stmt* stmt, int depth) {
+    (void)depth;
+    check_lines(context, stmt->loc);
+    return true;
+}
+
+static bool same_tree(const ASTNode* a, const ASTNode* b) {
+    if(!a || !b || a->as.program.count != b->as.program.count)
+        return false;
+    for(size_t i = 0; i < a->as.program.count; i++) {
+        if(!same_stmt(a->as.program.statements[i], b->as.program.statements[i]))
+            return false;
+    }
+
+    // The line table was brought up to date too
+    LineCheck check = {a, b, true};
+    AstVisitor visitor = {check_expr_lines, check_stmt_lines};
+    ast_walk_node((ASTNode*)a, &visitor, &check);
+    return check.same;
+}
+
+static Stmt* find_last(const ASTNode* ast) {
+    return ast->as.program.statements[ast->as.program.count - 1];
+}
+
+static Stmt* find_nested(const ASTNode* ast) {
+    return ast->as.program.statements[1]->as.function_decl.body->as.block.statements[1];
+}
+
+static void free_result(EditResult* result) {
+    ast_free_node(result->incremental);
+    ast_free_node(result->expected);
+}
+
+UTEST(parser_incremental, edit_inside_function_body) {
+    EditResult r = apply_edit(program, "a + b", 5, "a * b - 1");
+    ASSERT_TRUE(same_tree(r.expected, r.incremental));
+    // Only the edited statement of the body was parsed again
+    ASSERT_TRUE(r.untouched == find_last(r.incremental));
+    ASSERT_TRUE(r.nested == find_nested(r.incremental));
+    free_result(&r);
+}
+
+UTEST(parser_incremental, lines_added_in_nested_block) {
+    EditResult r = apply_edit(program, "deeper(x);", 0, "one();\n\n  two(\"2\");\n");
+    ASSERT_TRUE(same_tree(r.expected, r.incremental));
+    ASSERT_TRUE(r.untouched == find_last(r.incremental));
+    free_result(&r);
+}
+
+UTEST(parser_incremental, statements_added_and_removed_at_top_level) {
+    EditResult r = apply_edit(program, "waka", 0, "abeg fresh = 2; oya f() { } ");
+    ASSERT_TRUE(same_tree(r.expected, r.incremental));
+    free_result(&r);
+
+    r = apply_edit(program, "{ inner", strlen("{ inner(1); { deeper(x); } }\n"), "");
+    ASSERT_TRUE(same_tree(r.expected, r.incremental));
+    ASSERT_TRUE(r.untouched == find_last(r.incremental));
+    free_result(&r);
+}
+
+UTEST(parser_incremental, edit_changing_statement_boundaries) {
+    // Closing the function early makes the rest of its body top-level code
+    EditResult r = apply_edit(program, "    abi (sum", 0, "}\n");
+    ASSERT_TRUE(r.expected == NULL || same_tree(r.expected, r.incremental));
+    ASSERT_TRUE(r.expected != NULL || r.incremental == NULL);
+    free_result(&r);
+
+    // An else branch attached after an if statement
+    r = apply_edit(program, "\n    comot sum * 2", 0, " naso { comot 0; }");
+    ASSERT_TRUE(same_tree(r.expected, r.incremental));
+    free_result(&r);
+
+    // An unterminated comment swallows the rest of the input
+    r = apply_edit(program, "// doubled", 2, "/*");
+    ASSERT_TRUE(r.incremental == NULL);
+    free_result(&r);
+}
+
+UTEST(parser_incremental, syntax_error_matches_full_parse) {
+    EditResult r = apply_edit(program, "abeg sum", 4, "beg");
+    ASSERT_TRUE(r.expected == NULL);
+    ASSERT_TRUE(r.incremental == NULL);
+    free_result(&r);
+}
+
+UTEST(parser_incremental, every_single_character_edit) {
+    // Deleting any one character, or inserting a line break anywhere, must
+    // give the same result as parsing the edited text from scratch, whichever
+    // path the reparse takes
+    size_t len = strlen(program);
+    for(size_t i = 0; i < len; i++) {
+        EditResult r = apply_edit(program, program + i, 1, "");
+        ASSERT_TRUE((r.expected == NULL) == (r.incremental == NULL));
+        ASSERT_TRUE(r.expected == NULL || same_tree(r.expected, r.incremental));
+        free_result(&r);
+
+        r = apply_edit(program, program + i, 0, "\n ");
+        ASSERT_TRUE((r.expected == NULL) == (r.incremental == NULL));
+        ASSERT_TRUE(r.expected == NULL || same_tree(r.expected, r.incremental));
+        free_result(&r);
+    }
+}
+
+// ===== Edits In A Row =====
+
+// A document brought up to date edit after edit, as an editor would, without
+// settling the tree's locations in between
+typedef struct {
+    char* text;
+    TokenBuffer tokens;
+    ASTNode* ast;
+} Document;
+
+static void document_open(Document* doc, const char* text) {
+    doc->text = strdup(text);
+    SourceFile* source = source_file_create(text, strlen(text), "test.soro", ".");
+    Lexer* lexer = lexer_init_source(source);
+    lexer->flags = LEX_FLAGS;
+    token_buffer_init(&doc->tokens);
+    lexer_tokenize_soa(lexer, &doc->tokens);
+    lexer_free(lexer);
+    doc->ast = parse_buffer(source, &doc->tokens);
+    source_file_release(source);
+}
+
+// Replace removed bytes at offset with inserted; false if the relex failed
+static bool document_edit(Document* doc, size_t offset, size_t removed, const char* inserted) {
+    size_t len = strlen(doc->text);
+    size_t ins = strlen(inserted);
+    char* edited = malloc(len - removed + ins + 1);
+    memcpy(edited, doc->text, offset);
+    memcpy(edited + offset, inserted, ins);
+    strcpy(edited + offset + ins, doc->text + offset + removed);
+    free(doc->text);
+    doc->text = edited;
+
+    SourceFile* source = source_file_create(edited, strlen(edited), "test.soro", ".");
+    LexerEdit edit = {offset, removed, ins};
+    LexerRelexSpan span;
+    bool ok = lexer_relex_span(source, &doc->tokens, &edit, LEX_FLAGS, &span);
+    if(ok) {
+        Parser* parser = parser_init_soa(&doc->tokens, source, "test.soro");
+        parser->quiet = true;
+        doc->ast = parse_incremental(parser, doc->ast, &edit, &span);
+        parser_free(parser);
+    }
+    source_file_release(source);
+    return ok;
+}
+
+// Whether the document's tree, once settled, matches a parse from scratch
+static bool document_matches(Document* doc) {
+    SourceFile* source = source_file_create(doc->text, strlen(doc->text), "test.soro", ".");
+    ASTNode* expected = parse_buffer(source, &doc->tokens);
+    source_file_release(source);
+
+    ast_settle_locs(doc->ast);
+    bool same = (expected == NULL) == (doc->ast == NULL) &&
+                (expected == NULL || same_tree(expected, doc->ast));
+    ast_free_node(expected);
+    return same;
+}
+
+static void document_close(Document* doc) {
+    ast_free_node(doc->ast);
+    token_buffer_free(&doc->tokens);
+    free(doc->text);
+}
+
+static size_t offset_of(const Document* doc, const char* at) {
+    return (size_t)(strstr(doc->text, at) - doc->text);
+}
+
+UTEST(parser_incremental, shift_is_left_pending) {
+    Document doc;
+    document_open(&doc, program);
+    Stmt* last = find_last(doc.ast);
+    SourceLoc loc = last->loc;
+
+    // The statements after the edited function are not visited: they keep
+    // their locations, and the program notes how far they moved
+    ASSERT_TRUE(document_edit(&doc, offset_of(&doc, "a + b"), 5, "a * b - 1"));
+    ASSERT_TRUE(last == find_last(doc.ast));
+    ASSERT_EQ(loc, last->loc);
+    ASSERT_EQ(2, doc.ast->as.program.shift_from);
+    ASSERT_EQ(4, doc.ast->as.program.shift);
+
+    // A second edit further on takes the shift along with it
+    ASSERT_TRUE(document_edit(&doc, offset_of(&doc, "deeper"), 0, "d();\n"));
+    ASSERT_EQ(loc, last->loc);
+    ASSERT_EQ(3, doc.ast->as.program.shift_from);
+    ASSERT_EQ(9, doc.ast->as.program.shift);
+
+    ASSERT_TRUE(document_matches(&doc));
+    ASSERT_EQ(loc + 9, last->loc);
+    ASSERT_EQ(0, doc.ast->as.program.shift);
+    document_close(&doc);
+}
+
+UTEST(parser_incremental, edits_in_a_row) {
+    // Edits after, before and inside statements still waiting for a shift
+    static const struct {
+        const char* at;
+        size_t removed;
+        const char* inserted;
+    } edits[] = {
+        {"abeg sum", 0, "abeg pre = 0;\n    "},
+        {"waka", 0, "abeg fresh = 2;\n"},
+        {"abeg x = 1", 10, "abeg x = 100"},
+        {"comot [x", 0, "log(x);\n    "},
+        {"{ inner(1);", 11, "{ inner(1, 2);\n"},
+        {"abeg fresh = 2;\n", 16, ""},
+        {"oya last", 0, "\n\n"},
+        {"abeg pre = 0;\n    ", 18, ""},
+    };
+    Document doc;
+    document_open(&doc, program);
+    for(size_t i = 0; i < sizeof(edits) / sizeof(edits[0]); i++) {
+        ASSERT_TRUE(document_edit(&doc, offset_of(&doc, edits[i].at), edits[i].removed,
+                                  edits[i].inserted));
+        ASSERT_TRUE(doc.ast != NULL);
+    }
+    ASSERT_TRUE(document_matches(&doc));
+    document_close(&doc);
+}
+
+UTEST(parser_incremental, random_edits_in_a_row) {
+    static const char* snippets[] = {"", " ", "\n", "1", "x", ";", "}", "abeg y = 2;\n"};
+    Document doc;
+    document_open(&doc, program);
+    uint32_t seed = 12345;
+    for(int round = 0; round < 300; round++) {
+        size_t len = strlen(doc.text);
+        seed = seed * 1103515245u + 12345u;
+        size_t offset = (seed >> 8) % (len + 1);
+        seed = seed * 1103515245u + 12345u;
+        size_t removed = (seed >> 8) % 3;
+        if(removed > len - offset) {
+            removed = len - offset;
+        }
+        seed = seed * 1103515245u + 12345u;
+        const char* inserted = snippets[(seed >> 8) % (sizeof(snippets) / sizeof(snippets[0]))];
+        char undo[4] = {0};
+        memcpy(undo, doc.text + offset, removed);
+        if(!document_edit(&doc, offset, removed, inserted))
+            break;
+
+        // An edit that breaks the program is taken back, to keep editing a tree
+        if(!doc.ast) {
+            ASSERT_TRUE(document_edit(&doc, offset, strlen(inserted), undo));
+            ASSERT_TRUE(doc.ast != NULL);
+            continue;
+        }
+
+        // Settling now and then moves the pending shift back to the start
+        if(round % 10 == 9) {
+            ASSERT_TRUE(document_matches(&doc));
+        }
+    }
+    ASSERT_TRUE(document_matches(&doc));
+    document_close(&doc);
+}
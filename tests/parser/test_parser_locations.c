@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/flat_ast.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+
+// Blank lines, comments and a string spanning lines between the nodes
+static const char* located_program =
+    "// header\n"
+    "\n"
+    "oya add(a: int, b: int): int {\n"
+    "\tcomot a +\n"
+    "        b;\n"
+    "}\n"
+    "/* a block\n"
+    "   comment */ abeg s = \"two\n"
+    "lines\"; abeg t = [1,\n"
+    "\n"
+    "  add(2, 3)];\n"
+    "waka (t) { s = -s; }\n";
+
+// Line and column of offset counted straight from the text
+static void expected_position(const char* text, SourceLoc loc, uint32_t* line,
+                              uint32_t* column) {
+    *line = 1;
+    uint64_t line_start = 0;
+    for(uint64_t i = 0; i < loc; i++) {
+        if(text[i] == '\n') {
+            (*line)++;
+            line_start = i + 1;
+        }
+    }
+    *column = (uint32_t)(loc - line_start + 1);
+}
+
+typedef struct {
+    const ASTNode* ast;
+    const char* text;
+    size_t checked;
+    size_t wrong;
+} LocCheck;
+
+static void check_loc(LocCheck* check, SourceLoc loc) {
+    uint32_t line, column, want_line, want_column;
+    ast_resolve_loc(check->ast, loc, &line, &column);
+    expected_position(check->text, loc, &want_line, &want_column);
+    check->checked++;
+    if(line != want_line || column != want_column) {
+        check->wrong++;
+    }
+}
+
+static bool check_expr(void* context, Expr* expr, int depth) {
+    (void)depth;
+    check_loc(context, expr->loc);
+    return true;
+}
+
+static bool check_stmt(void* context, Stmt* stmt, int depth) {
+    (void)depth;
+    check_loc(context, stmt->loc);
+    return true;
+}
+
+// Resolve every node of ast against text; returns the number that disagree
+static size_t wrong_locations(const ASTNode* ast, const char* text, size_t* checked) {
+    LocCheck check = {ast, text, 0, 0};
+    AstVisitor visitor = {check_expr, check_stmt};
+    ast_walk_node((ASTNode*)ast, &visitor, &check);
+    *checked = check.checked;
+    return check.wrong;
+}
+
+UTEST(parser_locations, nodes_store_compact_locations) {
+    ASSERT_EQ(4, sizeof(SourceLoc));
+    ASSERT_EQ(SOURCE_LOC_MAX, source_loc((uint64_t)1 << 40));
+    ASSERT_EQ(123, source_loc(123));
+}
+
+UTEST(parser_locations, resolve_after_tokens_are_freed) {
+    size_t checked;
+
+    // Token array
+    Lexer* lexer = lexer_init(located_program, "test.soro", ".");
+    lexer->flags |= LEXER_SKIP_COMMENTS;
+    size_t count;
+    Token** tokens = lexer_tokenize(lexer, &count);
+    Parser* parser = parser_init(tokens, count, "test.soro");
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(0, wrong_locations(ast, located_program, &checked));
+    ASSERT_TRUE(checked > 20);
+    ast_free_node(ast);
+
+    // Struct-of-arrays
+    lexer = lexer_init(located_program, "test.soro", ".");
+    lexer->flags |= LEXER_SKIP_COMMENTS;
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+    parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    ast = parse(parser);
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(0, wrong_locations(ast, located_program, &checked));
+    ast_free_node(ast);
+
+    // Streaming
+    lexer = lexer_init(located_program, "test.soro", ".");
+    parser = parser_init_streaming(lexer, "test.soro");
+    ast = parse(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(0, wrong_locations(ast, located_program, &checked));
+    ast_free_node(ast);
+}
+
+UTEST(parser_locations, flat_ast_resolves_the_same) {
+    Lexer* lexer = lexer_init(located_program, "test.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+    FlatAst* flat = parse_flat(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+    ASSERT_TRUE(flat != NULL);
+
+    for(FlatExpr i = 0; i < flat->expr_count; i++) {
+        uint32_t line, column, want_line, want_column;
+        flat_ast_resolve_loc(flat, flat->expr_locs[i], &line, &column);
+        expected_position(located_program, flat->expr_locs[i], &want_line, &want_column);
+        ASSERT_EQ(want_line, line);
+        ASSERT_EQ(want_column, column);
+    }
+
+    // The converted tree carries its own copy of the line table
+    ASTNode* tree = flat_ast_to_tree(flat);
+    flat_ast_free(flat);
+    size_t checked;
+    ASSERT_EQ(0, wrong_locations(tree, located_program, &checked));
+    ast_free_node(tree);
+}
+
+UTEST(parser_locations, parallel_runs_share_one_line_table) {
+    // Enough copies for parse_parallel to split the input
+    size_t units = 1500;
+    size_t len = strlen(located_program);
+    char* input = malloc(len * units + 1);
+    for(size_t i = 0; i < units; i++) {
+        memcpy(input + i * len, located_program, len);
+    }
+    input[len * units] = '\0';
+
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    lexer->flags |= LEXER_SKIP_COMMENTS;
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    ASTNode* ast = parse_parallel(parser, 4);
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(4 * units, ast->as.program.count);
+
+    // Spot-check the statements that open each copy; resolving every node by
+    // counting from the start would be quadratic
+    for(size_t i = 0; i < units; i += 97) {
+        Stmt* fn = ast->as.program.statements[4 * i];
+        ASSERT_EQ(len * i + strlen("// header\n\n"), fn->loc);
+        uint32_t line, column;
+        ast_resolve_loc(ast, fn->loc, &line, &column);
+        ASSERT_EQ(12 * i + 3, line);
+        ASSERT_EQ(1, column);
+
+        Stmt* loop = ast->as.program.statements[4 * i + 3];
+        ast_resolve_loc(ast, loop->loc, &line, &column);
+        ASSERT_EQ(12 * i + 12, line);
+        ASSERT_EQ(1, column);
+    }
+
+    ast_free_node(ast);
+    free(input);
+}
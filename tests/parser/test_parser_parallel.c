@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+#include "ast_equal.h"
+
+// Enough copies that every worker gets a run of its own
+#define UNITS 3000
+
+static const char* program_unit =
+    "oya area(w: int, h: int): int { abi (w > 0) { comot w * h; } naso { comot -1; } }\n"
+    "abeg sizes: int[] = [1, 2, area(3, 4)];\n"
+    "abi (ready) go(); naso abi (later) wait(); naso stop();\n"
+    "waka (i < 10) i = i + 1;\n"
+    "{ nested(\"block\"); }\n";
+
+static char* repeat(const char* unit, size_t count) {
+    size_t len = strlen(unit);
+    char* text = malloc(len * count + 1);
+    for(size_t i = 0; i < count; i++) {
+        memcpy(text + i * len, unit, len);
+    }
+    text[len * count] = '\0';
+    return text;
+}
+
+// Parse input serially and in parallel over the same struct-of-arrays tokens
+static void parse_both(const char* input, ASTNode** serial, ASTNode** parallel) {
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    lexer_tokenize_soa(lexer, &buffer);
+
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    *serial = parse(parser);
+    parser_free(parser);
+
+    parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    *parallel = parse_parallel(parser, 4);
+    parser_free(parser);
+
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
+
+UTEST(parser_parallel, matches_serial_parse) {
+    char* input = repeat(program_unit, UNITS);
+    ASTNode* serial;
+    ASTNode* parallel;
+    parse_both(input, &serial, &parallel);
+
+    ASSERT_TRUE(serial != NULL);
+    ASSERT_TRUE(parallel != NULL);
+    ASSERT_EQ(5 * UNITS, parallel->as.program.count);
+    ASSERT_EQ(serial->as.program.count, parallel->as.program.count);
+    for(size_t i = 0; i < serial->as.program.count; i++) {
+        ASSERT_TRUE(
+            same_stmt(serial->as.program.statements[i], parallel->as.program.statements[i]));
+    }
+
+    ast_free_node(serial);
+    ast_free_node(parallel);
+    free(input);
+}
+
+UTEST(parser_parallel, token_array_mode) {
+    char* input = repeat(program_unit, UNITS);
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    size_t count;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    Parser* parser = parser_init(tokens, count, "test.soro");
+    ASTNode* ast = parse_parallel(parser, 3);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(5 * UNITS, ast->as.program.count);
+    ASSERT_TRUE(is_at_end(parser));
+
+    Stmt* last = ast->as.program.statements[5 * UNITS - 1];
+    ASSERT_EQ(STMT_BLOCK, last->type);
+    uint32_t line, column;
+    ast_resolve_loc(ast, last->loc, &line, &column);
+    ASSERT_EQ(5 * UNITS, line);
+    ASSERT_EQ(1, column);
+
+    ast_free_node(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    free(input);
+}
+
+UTEST(parser_parallel, error_falls_back_to_serial) {
+    char* input = repeat(program_unit, UNITS);
+    // Break a statement near the middle: its run fails and the serial
+    // reparse reports the error
+    char* middle = strstr(input + strlen(input) / 2, "abeg sizes");
+    memcpy(middle, "abeg =    ", 10);
+
+    ASTNode* serial;
+    ASTNode* parallel;
+    parse_both(input, &serial, &parallel);
+    ASSERT_TRUE(serial == NULL);
+    ASSERT_TRUE(parallel == NULL);
+
+    free(input);
+}
+
+UTEST(parser_parallel, small_input_parses_serially) {
+    ASTNode* serial;
+    ASTNode* parallel;
+    parse_both(program_unit, &serial, &parallel);
+
+    ASSERT_TRUE(parallel != NULL);
+    ASSERT_EQ(5, parallel->as.program.count);
+    for(size_t i = 0; i < 5; i++) {
+        ASSERT_TRUE(
+            same_stmt(serial->as.program.statements[i], parallel->as.program.statements[i]));
+    }
+
+    ast_free_node(serial);
+    ast_free_node(parallel);
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token.h"
+#include "../../include/token_buffer.h"
+#include "../utest.h"
+
+UTEST(parser_soa, function_and_call) {
+    const char* input =
+        "oya add(x: int, y: int): int { comot x + y; }\n"
+        "abeg total: int = add(1, 2) * 3;\n";
+
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    ASTNode* ast = parse(parser);
+
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(2, ast->as.program.count);
+
+    Stmt* fn = ast->as.program.statements[0];
+    ASSERT_EQ(STMT_FUNCTION_DECL, fn->type);
+    ASSERT_STREQ("add", symbol_name(fn->as.function_decl.name));
+    ASSERT_EQ(2, fn->as.function_decl.param_count);
+    ASSERT_STREQ("y", symbol_name(fn->as.function_decl.param_names[1]));
+    ASSERT_STREQ("int", symbol_name(fn->as.function_decl.return_type));
+
+    Stmt* decl = ast->as.program.statements[1];
+    ASSERT_EQ(STMT_VAR_DECL, decl->type);
+    ASSERT_STREQ("total", symbol_name(decl->as.var_decl.name));
+
+    Expr* init = decl->as.var_decl.initializer;
+    ASSERT_EQ(EXPR_BINARY, init->type);
+    ASSERT_EQ(TOKEN_ASTERISK, init->as.binary.op);
+    ASSERT_EQ(EXPR_CALL, init->as.binary.left->type);
+    ASSERT_EQ(2, init->as.binary.left->as.call.arg_count);
+    ASSERT_EQ(3, init->as.binary.right->as.literal.value.int_val);
+    uint32_t line, column;
+    ast_resolve_loc(ast, init->loc, &line, &column);
+    ASSERT_EQ(2, line);
+
+    ast_free_node(ast);
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
+
+UTEST(parser_soa, string_literal_is_decoded) {
+    Lexer* lexer = lexer_init("abeg s = \"a\\\"b\";", "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    ASTNode* ast = parse(parser);
+
+    ASSERT_TRUE(ast != NULL);
+    Expr* init = ast->as.program.statements[0]->as.var_decl.initializer;
+    ASSERT_EQ(LITERAL_STRING, init->as.literal.type);
+    ASSERT_STREQ("a\"b", symbol_name(init->as.literal.value.string_val));
+
+    ast_free_node(ast);
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
+
+UTEST(parser_soa, plain_string_is_interned_from_source) {
+    Lexer* lexer = lexer_init("abeg a = 'hi'; abeg b = \"hi\";", "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    ASTNode* ast = parse(parser);
+
+    ASSERT_TRUE(ast != NULL);
+    Expr* a = ast->as.program.statements[0]->as.var_decl.initializer;
+    Expr* b = ast->as.program.statements[1]->as.var_decl.initializer;
+    ASSERT_STREQ("hi", symbol_name(a->as.literal.value.string_val));
+    ASSERT_EQ(a->as.literal.value.string_val, b->as.literal.value.string_val);
+
+    ast_free_node(ast);
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
+
+UTEST(parser_soa, numeric_literals_are_int64) {
+    Lexer* lexer = lexer_init("abeg n = 0x1_0000_0000; abeg f = 0.25;", "test.soro", ".");
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_TRUE(lexer_tokenize_soa(lexer, &buffer));
+
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    ASTNode* ast = parse(parser);
+
+    ASSERT_TRUE(ast != NULL);
+    Expr* n = ast->as.program.statements[0]->as.var_decl.initializer;
+    ASSERT_EQ(LITERAL_INT, n->as.literal.type);
+    ASSERT_EQ(INT64_C(0x100000000), n->as.literal.value.int_val);
+    Expr* f = ast->as.program.statements[1]->as.var_decl.initializer;
+    ASSERT_EQ(LITERAL_FLOAT, f->as.literal.type);
+    ASSERT_EQ(0.25, f->as.literal.value.float_val);
+
+    ast_free_node(ast);
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
+
+UTEST(parser_soa, refuses_buffer_without_eof) {
+    Lexer* lexer = lexer_init("abeg q = 99999999999999999999;", "test.soro", ".");
+    lexer->flags |= LEXER_QUIET;
+    TokenBuffer buffer;
+    token_buffer_init(&buffer);
+    ASSERT_FALSE(lexer_tokenize_soa(lexer, &buffer));
+
+    Parser* parser = parser_init_soa(&buffer, lexer->source, "test.soro");
+    parser->quiet = true;
+    ASSERT_TRUE(parse(parser) == NULL);
+
+    parser_free(parser);
+    token_buffer_free(&buffer);
+    lexer_free(lexer);
+}
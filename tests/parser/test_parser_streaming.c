@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/token.h"
+#include "../utest.h"
+
+static const char* streaming_program =
+    "// leading comment\n"
+    "oya add(x: int, y: int): int { comot x + y; }\n"
+    "abeg total: int = add(1, 2) * 3;\n"
+    "abeg greeting = \"hi \\\"there\\\"\";\n"
+    "abi (total == 9) { add(\"yes\", 1); } naso { total = -total; }\n";
+
+UTEST(parser_streaming, builds_same_tree_as_token_array) {
+    Lexer* lexer = lexer_init(streaming_program, "test.soro", ".");
+    lexer->flags |= LEXER_SKIP_COMMENTS;
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+    Parser* parser = parser_init(tokens, count, "test.soro");
+    ASTNode* expected = parse(parser);
+
+    Lexer* pull = lexer_init(streaming_program, "test.soro", ".");
+    Parser* streaming = parser_init_streaming(pull, "test.soro");
+    ASTNode* ast = parse(streaming);
+
+    ASSERT_TRUE(expected != NULL);
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(expected->as.program.count, ast->as.program.count);
+    for(size_t i = 0; i < ast->as.program.count; i++) {
+        Stmt* a = expected->as.program.statements[i];
+        Stmt* b = ast->as.program.statements[i];
+        ASSERT_EQ(a->type, b->type);
+        ASSERT_EQ(a->loc, b->loc);
+
+        uint32_t line_a, column_a, line_b, column_b;
+        ast_resolve_loc(expected, a->loc, &line_a, &column_a);
+        ast_resolve_loc(ast, b->loc, &line_b, &column_b);
+        ASSERT_EQ(line_a, line_b);
+        ASSERT_EQ(column_a, column_b);
+    }
+
+    Stmt* greeting = ast->as.program.statements[2];
+    ASSERT_STREQ("hi \"there\"",
+                 symbol_name(greeting->as.var_decl.initializer->as.literal.value.string_val));
+
+    // Tokens were pulled into the parser's ring, never into the lexer's arena
+    ASSERT_TRUE(pull->arena.head == NULL);
+
+    ast_free_node(expected);
+    ast_free_node(ast);
+    parser_free(parser);
+    parser_free(streaming);
+    lexer_free(lexer);
+    lexer_free(pull);
+}
+
+UTEST(parser_streaming, nodes_carry_locations) {
+    Lexer* lexer = lexer_init("abeg x = 1;\nx = x + 2;\n", "test.soro", ".");
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+    ASTNode* ast = parse(parser);
+    parser_free(parser);
+    lexer_free(lexer);  // Locations resolve without the lexer or its tokens
+
+    ASSERT_TRUE(ast != NULL);
+    uint32_t line, column;
+    Stmt* assign_stmt = ast->as.program.statements[1];
+    ASSERT_EQ(12, assign_stmt->loc);
+    ast_resolve_loc(ast, assign_stmt->loc, &line, &column);
+    ASSERT_EQ(2, line);
+    ASSERT_EQ(1, column);
+
+    Expr* assign = assign_stmt->as.expr_stmt.expression;
+    ASSERT_EQ(EXPR_ASSIGN, assign->type);
+    ast_resolve_loc(ast, assign->loc, &line, &column);
+    ASSERT_EQ(3, column);  // The '='
+    Expr* sum = assign->as.assign.value;
+    ASSERT_EQ(EXPR_BINARY, sum->type);
+    ast_resolve_loc(ast, sum->loc, &line, &column);
+    ASSERT_EQ(2, line);
+    ASSERT_EQ(7, column);  // The '+'
+    ASSERT_EQ(TOKEN_PLUS, sum->as.binary.op);
+
+    ast_free_node(ast);
+}
+
+// Serves a string a few bytes at a time, like a slow pipe
+typedef struct {
+    const char* data;
+    size_t len;
+    size_t pos;
+} ChunkReader;
+
+static size_t read_chunks(void* context, char* buffer, size_t size) {
+    ChunkReader* reader = context;
+    size_t n = reader->len - reader->pos;
+    if(n > size)
+        n = size;
+    if(n > 5)
+        n = 5;
+    memcpy(buffer, reader->data + reader->pos, n);
+    reader->pos += n;
+    return n;
+}
+
+UTEST(parser_streaming, parses_from_stream_lexer) {
+    ChunkReader reader = {streaming_program, strlen(streaming_program), 0};
+    Lexer* lexer = lexer_init_stream(read_chunks, &reader, 16, "stdin", ".");
+    Parser* parser = parser_init_streaming(lexer, "stdin");
+    ASTNode* ast = parse(parser);
+
+    ASSERT_TRUE(ast != NULL);
+    ASSERT_EQ(4, ast->as.program.count);
+    Stmt* fn = ast->as.program.statements[0];
+    ASSERT_EQ(STMT_FUNCTION_DECL, fn->type);
+    ASSERT_STREQ("add", symbol_name(fn->as.function_decl.name));
+    ASSERT_STREQ("y", symbol_name(fn->as.function_decl.param_names[1]));
+    ASSERT_EQ(STMT_IF, ast->as.program.statements[3]->type);
+    uint32_t line, column;
+    ast_resolve_loc(ast, ast->as.program.statements[3]->loc, &line, &column);
+    ASSERT_EQ(5, line);
+    ASSERT_EQ(1, column);
+
+    ast_free_node(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+}
+
+UTEST(parser_streaming, lexer_error_fails_parse) {
+    Lexer* lexer = lexer_init("abeg s = \"never closed;", "test.soro", ".");
+    lexer->flags |= LEXER_QUIET;
+    Parser* parser = parser_init_streaming(lexer, "test.soro");
+
+    ASSERT_TRUE(parse(parser) == NULL);
+
+    parser_free(parser);
+    lexer_free(lexer);
+}
@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/parser/resolver.h"
+#include "../parse_helpers.h"
+#include "../utest.h"
+
+// Every variable reference and assignment, in source order
+typedef struct {
+    Expr* refs[32];
+    size_t count;
+} Refs;
+
+static bool collect_ref(void* context, Expr* expr, int depth) {
+    (void)depth;
+    Refs* refs = context;
+    if((expr->type == EXPR_VARIABLE || expr->type == EXPR_ASSIGN) && refs->count < 32) {
+        refs->refs[refs->count++] = expr;
+    }
+    return true;
+}
+
+static Refs collect_refs(ASTNode* ast) {
+    Refs refs = {{0}, 0};
+    AstVisitor visitor = {collect_ref, NULL};
+    ast_walk_node(ast, &visitor, &refs);
+    return refs;
+}
+
+static Binding binding_of(const Expr* expr) {
+    return expr->type == EXPR_VARIABLE ? expr->as.variable.binding : expr->as.assign.binding;
+}
+
+static bool is_local(const Expr* expr, uint32_t depth, uint32_t slot) {
+    Binding binding = binding_of(expr);
+    return binding.kind == BINDING_LOCAL && binding.depth == depth && binding.slot == slot;
+}
+
+static bool is_global(const Expr* expr, uint32_t index) {
+    Binding binding = binding_of(expr);
+    return binding.kind == BINDING_GLOBAL && binding.slot == index;
+}
+
+// ===== Bindings =====
+
+UTEST(resolver, resolves_locals_and_globals) {
+    ASTNode* ast = parse_source(
+        "abeg total = 0;\n"
+        "oya add(a: int, b: int): int {\n"
+        "    abeg sum = a + b;\n"
+        "    { abeg sum = sum + total; comot sum; }\n"
+        "}\n"
+        "total = add(1, 2);\n");
+    ASSERT_TRUE(ast != NULL);
+
+    Resolver resolver;
+    resolver_init(&resolver);
+    ASSERT_TRUE(resolver_resolve(&resolver, ast));
+    ASSERT_EQ(2, resolver.global_count);
+    ASSERT_EQ(symbol_intern_cstr("add"), resolver_global_name(&resolver, 1));
+
+    Refs refs = collect_refs(ast);
+    ASSERT_EQ(7, refs.count);
+    ASSERT_TRUE(is_local(refs.refs[0], 0, 0));  // a: parameters share the body's scope
+    ASSERT_TRUE(is_local(refs.refs[1], 0, 1));  // b
+    ASSERT_TRUE(is_local(refs.refs[2], 1, 2));  // The outer sum, in the initializer
+    ASSERT_TRUE(is_global(refs.refs[3], 0));    // total
+    ASSERT_TRUE(is_local(refs.refs[4], 0, 0));  // The inner sum
+    ASSERT_TRUE(is_global(refs.refs[5], 0));    // total =
+    ASSERT_TRUE(is_global(refs.refs[6], 1));    // add
+
+    resolver_free(&resolver);
+    ast_free_node(ast);
+}
+
+UTEST(resolver, functions_see_later_globals) {
+    ASTNode* ast = parse_source(
+        "oya f(): int { comot g(later); }\n"
+        "g(2);\n"
+        "oya g(x: int): int { comot x; }\n"
+        "abeg later = g(1);\n");
+    ASSERT_TRUE(ast != NULL);
+
+    Resolver resolver;
+    resolver_init(&resolver);
+    ASSERT_TRUE(resolver_resolve(&resolver, ast));
+
+    Refs refs = collect_refs(ast);
+    ASSERT_EQ(5, refs.count);
+    ASSERT_TRUE(is_global(refs.refs[0], 1));    // g
+    ASSERT_TRUE(is_global(refs.refs[1], 2));    // later, declared below
+    ASSERT_TRUE(is_global(refs.refs[2], 1));    // g, called before its oya
+    ASSERT_TRUE(is_local(refs.refs[3], 0, 0));  // x
+    ASSERT_TRUE(is_global(refs.refs[4], 1));
+
+    resolver_free(&resolver);
+    ast_free_node(ast);
+}
+
+UTEST(resolver, nested_functions_see_enclosing_locals) {
+    ASTNode* ast = parse_source(
+        "oya outer(n: int) {\n"
+        "    oya inner() { comot n; }\n"
+        "    comot inner();\n"
+        "}\n");
+    ASSERT_TRUE(ast != NULL);
+
+    Resolver resolver;
+    resolver_init(&resolver);
+    ASSERT_TRUE(resolver_resolve(&resolver, ast));
+
+    Refs refs = collect_refs(ast);
+    ASSERT_EQ(2, refs.count);
+    ASSERT_TRUE(is_local(refs.refs[0], 1, 0));  // n, one scope out
+    ASSERT_TRUE(is_local(refs.refs[1], 0, 1));  // inner, a local of outer
+
+    resolver_free(&resolver);
+    ast_free_node(ast);
+}
+
+// ===== Errors =====
+
+UTEST(resolver, reports_undefined_names) {
+    ASTNode* ast = parse_source(
+        "early;\n"
+        "abeg early = 1;\n"
+        "abeg x = x;\n"
+        "oya f() { abeg y = 1; }\n"
+        "y = 2;\n"
+        "log(early);\n");
+    ASSERT_TRUE(ast != NULL);
+
+    Resolver resolver;
+    resolver_init(&resolver);
+    ASSERT_FALSE(resolver_resolve(&resolver, ast));
+    ASSERT_EQ(4, resolver.error_count);
+    const char* names[] = {"early", "x", "y", "log"};
+    for(size_t i = 0; i < 4; i++) {
+        ASSERT_EQ(RESOLVE_UNDEFINED, resolver.errors[i].type);
+        ASSERT_EQ(symbol_intern_cstr(names[i]), resolver.errors[i].name);
+    }
+    Refs refs = collect_refs(ast);
+    ASSERT_EQ(BINDING_UNRESOLVED, binding_of(refs.refs[0]).kind);
+
+    char report[512] = {0};
+    FILE* out = fmemopen(report, sizeof(report) - 1, "w");
+    ASSERT_TRUE(out != NULL);
+    resolver_report(&resolver, ast, "test.soro", out);
+    fclose(out);
+    ASSERT_TRUE(strstr(report, "[test.soro:3] Error at 'x': Undefined name\n") != NULL);
+    ASSERT_TRUE(strstr(report, "[test.soro:6] Error at 'log': Undefined name\n") != NULL);
+
+    // A predefined global is visible everywhere and comes first; the run
+    // starts over, so the others are renumbered after it
+    ASSERT_EQ(0, resolver_define_global(&resolver, symbol_intern_cstr("log")));
+    ASSERT_FALSE(resolver_resolve(&resolver, ast));
+    ASSERT_EQ(3, resolver.error_count);
+    refs = collect_refs(ast);
+    ASSERT_TRUE(is_global(refs.refs[refs.count - 2], 0));  // log
+    ASSERT_TRUE(is_global(refs.refs[refs.count - 1], 1));  // early
+
+    resolver_free(&resolver);
+    ast_free_node(ast);
+}
+
+UTEST(resolver, reports_redeclarations) {
+    ASTNode* ast = parse_source(
+        "abeg a = 1;\n"
+        "abeg a = 2;\n"
+        "oya f(p: int, p: int) {\n"
+        "    abeg q = 1;\n"
+        "    { abeg q = 2; }\n"
+        "    abeg q = 3;\n"
+        "    comot q;\n"
+        "}\n");
+    ASSERT_TRUE(ast != NULL);
+
+    Resolver resolver;
+    resolver_init(&resolver);
+    ASSERT_FALSE(resolver_resolve(&resolver, ast));
+    ASSERT_EQ(3, resolver.error_count);
+    const char* names[] = {"a", "p", "q"};
+    for(size_t i = 0; i < 3; i++) {
+        ASSERT_EQ(RESOLVE_REDECLARED, resolver.errors[i].type);
+        ASSERT_EQ(symbol_intern_cstr(names[i]), resolver.errors[i].name);
+    }
+
+    // The first declaration stands: q is slot 1, after the one p
+    Refs refs = collect_refs(ast);
+    ASSERT_TRUE(is_local(refs.refs[refs.count - 1], 0, 1));
+
+    resolver_free(&resolver);
+    ast_free_node(ast);
+}
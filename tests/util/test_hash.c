@@ -0,0 +1,27 @@
+#include <string.h>
+
+#include "../../include/hash.h"
+#include "../utest.h"
+
+UTEST(hash, matches_xxh64_reference_values) {
+    ASSERT_EQ(0xEF46DB3751D8E999ULL, hash_bytes("", 0, 0));
+    ASSERT_EQ(0xD24EC4F1A98C6E5BULL, hash_bytes("a", 1, 0));
+    ASSERT_EQ(0x44BC2CF5AD770999ULL, hash_bytes("abc", 3, 0));
+    const char* long_text = "Nobody inspects the spammish repetition";
+    ASSERT_EQ(0xFBCEA83C8A378BF1ULL, hash_bytes(long_text, strlen(long_text), 0));
+}
+
+UTEST(hash, seed_and_every_byte_matter) {
+    char text[100];
+    memset(text, 'x', sizeof(text));
+    uint64_t base = hash_bytes(text, sizeof(text), 0);
+    ASSERT_NE(base, hash_bytes(text, sizeof(text), 1));
+    ASSERT_NE(base, hash_bytes(text, sizeof(text) - 1, 0));
+
+    // Stripes, whole-word tail, half-word tail and byte tail
+    for(size_t i = 0; i < sizeof(text); i++) {
+        text[i] = 'y';
+        ASSERT_NE(base, hash_bytes(text, sizeof(text), 0));
+        text[i] = 'x';
+    }
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/lexer.h"
+#include "../../include/parser/parser.h"
+#include "../../include/symbol.h"
+#include "../utest.h"
+
+UTEST(symbol, same_text_same_symbol) {
+    Symbol a = symbol_intern("counter", 7);
+    Symbol b = symbol_intern_cstr("counter");
+    Symbol c = symbol_intern("counter_2", 9);
+
+    ASSERT_NE(SYMBOL_NONE, a);
+    ASSERT_EQ(a, b);
+    ASSERT_NE(a, c);
+    ASSERT_STREQ("counter", symbol_name(a));
+    ASSERT_EQ(7, symbol_length(a));
+    ASSERT_STREQ("", symbol_name(SYMBOL_NONE));
+}
+
+UTEST(symbol, survives_table_growth) {
+    Symbol first = symbol_intern_cstr("growth_0");
+    char name[32];
+    for(int i = 1; i < 5000; i++) {
+        snprintf(name, sizeof(name), "growth_%d", i);
+        symbol_intern_cstr(name);
+    }
+
+    ASSERT_EQ(first, symbol_intern_cstr("growth_0"));
+    ASSERT_STREQ("growth_4999", symbol_name(symbol_intern_cstr("growth_4999")));
+}
+
+UTEST(symbol, tokens_and_ast_share_symbols) {
+    const char* input = "abeg total = 1; total = total + 1;";
+    Lexer* lexer = lexer_init(input, "test.soro", ".");
+    size_t count = 0;
+    Token** tokens = lexer_tokenize(lexer, &count);
+
+    Symbol total = symbol_intern_cstr("total");
+    ASSERT_EQ(total, tokens[1]->symbol);
+    ASSERT_EQ(SYMBOL_NONE, tokens[2]->symbol);
+    // The value of a name is the interned text itself
+    ASSERT_TRUE(tokens[1]->value == symbol_name(total));
+
+    Parser* parser = parser_init(tokens, count, "test.soro");
+    ASTNode* ast = parse(parser);
+    ASSERT_TRUE(ast != NULL);
+
+    Stmt* decl = ast->as.program.statements[0];
+    Expr* assign = ast->as.program.statements[1]->as.expr_stmt.expression;
+    ASSERT_EQ(total, decl->as.var_decl.name);
+    ASSERT_EQ(total, assign->as.assign.name);
+    ASSERT_EQ(total, assign->as.assign.value->as.binary.left->as.variable.name);
+
+    ast_free_node(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+}